@@ -414,6 +414,11 @@
 #define __NR_memfd_create		(__NR_SYSCALL_BASE+385)
 #define __NR_bpf			(__NR_SYSCALL_BASE+386)
 #define __NR_execveat			(__NR_SYSCALL_BASE+387)
+#define __NR_epoll_ctl_batch		(__NR_SYSCALL_BASE+388)
+#define __NR_mq_timedsend_batch		(__NR_SYSCALL_BASE+389)
+#define __NR_mq_timedreceive_batch	(__NR_SYSCALL_BASE+390)
+#define __NR_rseq			(__NR_SYSCALL_BASE+391)
+#define __NR_membarrier			(__NR_SYSCALL_BASE+392)
 
 /*
  * The following SWIs are ARM private.
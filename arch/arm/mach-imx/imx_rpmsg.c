@@ -202,7 +202,8 @@ static void imx_rpmsg_del_vqs(struct virtio_device *vdev)
 static int imx_rpmsg_find_vqs(struct virtio_device *vdev, unsigned nvqs,
 		       struct virtqueue *vqs[],
 		       vq_callback_t *callbacks[],
-		       const char *names[])
+		       const char *names[],
+		       struct irq_affinity *desc)
 {
 	struct imx_rpmsg_vproc *rpdev = to_imx_rpdev(vdev);
 	int i, err;
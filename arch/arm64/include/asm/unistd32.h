@@ -797,3 +797,13 @@ __SYSCALL(__NR_memfd_create, sys_memfd_create)
 __SYSCALL(__NR_bpf, sys_bpf)
 #define __NR_execveat 387
 __SYSCALL(__NR_execveat, compat_sys_execveat)
+#define __NR_epoll_ctl_batch 388
+__SYSCALL(__NR_epoll_ctl_batch, sys_epoll_ctl_batch)
+#define __NR_mq_timedsend_batch 389
+__SYSCALL(__NR_mq_timedsend_batch, compat_sys_mq_timedsend_batch)
+#define __NR_mq_timedreceive_batch 390
+__SYSCALL(__NR_mq_timedreceive_batch, compat_sys_mq_timedreceive_batch)
+#define __NR_rseq 391
+__SYSCALL(__NR_rseq, sys_rseq)
+#define __NR_membarrier 392
+__SYSCALL(__NR_membarrier, sys_membarrier)
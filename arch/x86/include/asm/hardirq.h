@@ -26,6 +26,13 @@ typedef struct {
 	 * subtracted from irq_call_count when displaying irq_call_count
 	 */
 	unsigned int irq_tlb_count;
+	/*
+	 * Flushes that didn't need an IPI of their own: merged into one
+	 * already pending on the target, and not sent to a target in lazy
+	 * tlb mode.  Counted on the target and on the sender respectively.
+	 */
+	unsigned int irq_tlb_coalesced_count;
+	unsigned int irq_tlb_lazy_count;
 #endif
 #ifdef CONFIG_X86_THERMAL_VECTOR
 	unsigned int irq_thermal_count;
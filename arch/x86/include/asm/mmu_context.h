@@ -134,23 +134,29 @@ static inline void switch_mm(struct mm_struct *prev, struct mm_struct *next,
 		this_cpu_write(cpu_tlbstate.state, TLBSTATE_OK);
 		BUG_ON(this_cpu_read(cpu_tlbstate.active_mm) != next);
 
-		if (!cpumask_test_cpu(cpu, mm_cpumask(next))) {
-			/*
-			 * On established mms, the mm_cpumask is only changed
-			 * from irq context, from ptep_clear_flush() while in
-			 * lazy tlb mode, and here. Irqs are blocked during
-			 * schedule, protecting us from simultaneous changes.
-			 */
-			cpumask_set_cpu(cpu, mm_cpumask(next));
+		/*
+		 * Other cpus skip flushing us while we are in lazy tlb
+		 * mode and set lazy_flush instead, then read
+		 * cpu_tlbstate.state again.  The atomic test and set
+		 * orders our TLBSTATE_OK above before reading lazy_flush:
+		 * either they see that we are back and flush us, or we
+		 * see lazy_flush and flush ourselves.
+		 */
+		if (!cpumask_test_and_set_cpu(cpu, mm_cpumask(next))) {
 			/*
 			 * We were in lazy tlb mode and leave_mm disabled
 			 * tlb flush IPI delivery. We must reload CR3
 			 * to make sure to use no freed page tables.
 			 */
+			this_cpu_write(cpu_tlbstate.lazy_flush, 0);
 			load_cr3(next->pgd);
 			trace_tlb_flush(TLB_FLUSH_ON_TASK_SWITCH, TLB_FLUSH_ALL);
 			load_mm_cr4(next);
 			load_mm_ldt(next);
+		} else if (unlikely(this_cpu_read(cpu_tlbstate.lazy_flush))) {
+			this_cpu_write(cpu_tlbstate.lazy_flush, 0);
+			local_flush_tlb();
+			trace_tlb_flush(TLB_FLUSH_ON_TASK_SWITCH, TLB_FLUSH_ALL);
 		}
 	}
 #endif
@@ -19,6 +19,8 @@ struct tlb_state {
 #ifdef CONFIG_SMP
 	struct mm_struct *active_mm;
 	int state;
+	/* a flush was skipped in lazy tlb mode, see flush_tlb_skip_lazy() */
+	int lazy_flush;
 #endif
 
 	/*
@@ -203,7 +205,8 @@ static inline void flush_tlb_range(struct vm_area_struct *vma,
 }
 
 static inline void flush_tlb_mm_range(struct mm_struct *mm,
-	   unsigned long start, unsigned long end, unsigned long vmflag)
+	   unsigned long start, unsigned long end, unsigned long vmflag,
+	   bool freed_tables)
 {
 	if (mm == current->active_mm)
 		__flush_tlb_up();
@@ -232,16 +235,18 @@ static inline void flush_tlb_kernel_range(unsigned long start,
 
 #define local_flush_tlb() __flush_tlb()
 
-#define flush_tlb_mm(mm)	flush_tlb_mm_range(mm, 0UL, TLB_FLUSH_ALL, 0UL)
+#define flush_tlb_mm(mm)	\
+		flush_tlb_mm_range(mm, 0UL, TLB_FLUSH_ALL, 0UL, true)
 
 #define flush_tlb_range(vma, start, end)	\
-		flush_tlb_mm_range(vma->vm_mm, start, end, vma->vm_flags)
+		flush_tlb_mm_range(vma->vm_mm, start, end, vma->vm_flags, false)
 
 extern void flush_tlb_all(void);
 extern void flush_tlb_current_task(void);
 extern void flush_tlb_page(struct vm_area_struct *, unsigned long);
 extern void flush_tlb_mm_range(struct mm_struct *mm, unsigned long start,
-				unsigned long end, unsigned long vmflag);
+				unsigned long end, unsigned long vmflag,
+				bool freed_tables);
 extern void flush_tlb_kernel_range(unsigned long start, unsigned long end);
 
 #define flush_tlb()	flush_tlb_current_task()
@@ -103,6 +103,14 @@ int arch_show_interrupts(struct seq_file *p, int prec)
 	for_each_online_cpu(j)
 		seq_printf(p, "%10u ", irq_stats(j)->irq_tlb_count);
 	seq_puts(p, "  TLB shootdowns\n");
+	seq_printf(p, "%*s: ", prec, "TLC");
+	for_each_online_cpu(j)
+		seq_printf(p, "%10u ", irq_stats(j)->irq_tlb_coalesced_count);
+	seq_puts(p, "  TLB shootdowns coalesced\n");
+	seq_printf(p, "%*s: ", prec, "TLZ");
+	for_each_online_cpu(j)
+		seq_printf(p, "%10u ", irq_stats(j)->irq_tlb_lazy_count);
+	seq_puts(p, "  TLB shootdowns skipped for lazy tlb\n");
 #endif
 #ifdef CONFIG_X86_THERMAL_VECTOR
 	seq_printf(p, "%*s: ", prec, "TRM");
@@ -102,12 +102,8 @@ static void flush_tlb_func(void *info)
 {
 	struct flush_tlb_info *f = info;
 
-	inc_irq_stat(irq_tlb_count);
-
 	if (f->flush_mm != this_cpu_read(cpu_tlbstate.active_mm))
 		return;
-	if (!f->flush_end)
-		f->flush_end = f->flush_start + PAGE_SIZE;
 
 	count_vm_tlb_event(NR_TLB_REMOTE_FLUSH_RECEIVED);
 	if (this_cpu_read(cpu_tlbstate.state) == TLBSTATE_OK) {
@@ -130,15 +126,182 @@ static void flush_tlb_func(void *info)
 
 }
 
+/*
+ * See Documentation/x86/tlb.txt for details.  We choose 33
+ * because it is large enough to cover the vast majority (at
+ * least 95%) of allocations, and is small enough that we are
+ * confident it will not cause too much overhead.  Each single
+ * flush is about 100 ns, so this caps the maximum overhead at
+ * _about_ 3,000 ns.
+ *
+ * This is in units of pages.
+ */
+static unsigned long tlb_single_page_flush_ceiling __read_mostly = 33;
+
+/*
+ * Flushes queued for a cpu, run by one IPI.
+ *
+ * Senders merge their range into the pending one for the same mm, and only
+ * the sender that finds the batch empty sends the IPI, so many threads of
+ * one process flushing at once cost each target one IPI rather than one per
+ * sender.  When more mms are pending than fit, the batch degrades to a full
+ * flush.
+ *
+ * @seq is twice the number of batches taken by the IPI handler, plus one
+ * while a batch is pending; @done is the number of batches flushed.  A
+ * sender is done with a target once @done reaches the batch that took its
+ * flush, which is the pending one or, if none is pending, the last one
+ * taken.
+ */
+#define TLB_FLUSH_BATCH		8
+
+struct tlb_flush_batch {
+	raw_spinlock_t		lock;
+	unsigned int		nr;
+	unsigned int		requests;
+	bool			flush_all;
+	unsigned long		seq;
+	unsigned long		done;
+	struct flush_tlb_info	info[TLB_FLUSH_BATCH];
+	struct call_single_data	csd;
+};
+
+static void flush_tlb_batch_func(void *info);
+
+static DEFINE_PER_CPU_SHARED_ALIGNED(struct tlb_flush_batch, tlb_flush_batch) = {
+	.lock	= __RAW_SPIN_LOCK_UNLOCKED(tlb_flush_batch.lock),
+	.csd	= { .func = flush_tlb_batch_func },
+};
+
+static void flush_tlb_batch_func(void *info)
+{
+	struct tlb_flush_batch *b = this_cpu_ptr(&tlb_flush_batch);
+	struct flush_tlb_info pending[TLB_FLUSH_BATCH];
+	unsigned int i, nr, requests;
+	unsigned long seq;
+	bool flush_all;
+
+	raw_spin_lock(&b->lock);
+	nr = b->nr;
+	requests = b->requests;
+	flush_all = b->flush_all;
+	memcpy(pending, b->info, nr * sizeof(pending[0]));
+	b->nr = 0;
+	b->requests = 0;
+	b->flush_all = false;
+	seq = (b->seq | 1) + 1;
+	b->seq = seq;
+	raw_spin_unlock(&b->lock);
+
+	inc_irq_stat(irq_tlb_count);
+	if (requests > 1)
+		this_cpu_add(irq_stat.irq_tlb_coalesced_count, requests - 1);
+
+	if (flush_all) {
+		count_vm_tlb_event(NR_TLB_REMOTE_FLUSH_RECEIVED);
+		if (this_cpu_read(cpu_tlbstate.state) == TLBSTATE_LAZY) {
+			leave_mm(smp_processor_id());
+		} else {
+			local_flush_tlb();
+			trace_tlb_flush(TLB_REMOTE_SHOOTDOWN, TLB_FLUSH_ALL);
+		}
+	} else {
+		for (i = 0; i < nr; i++)
+			flush_tlb_func(&pending[i]);
+	}
+
+	smp_store_release(&b->done, seq >> 1);
+}
+
+static void flush_tlb_merge(struct flush_tlb_info *f, unsigned long start,
+			    unsigned long end)
+{
+	if (f->flush_end == TLB_FLUSH_ALL)
+		return;
+	if (end == TLB_FLUSH_ALL) {
+		f->flush_start = 0UL;
+		f->flush_end = TLB_FLUSH_ALL;
+		return;
+	}
+	f->flush_start = min(f->flush_start, start);
+	f->flush_end = max(f->flush_end, end);
+	if ((f->flush_end - f->flush_start) >> PAGE_SHIFT >
+	    tlb_single_page_flush_ceiling) {
+		f->flush_start = 0UL;
+		f->flush_end = TLB_FLUSH_ALL;
+	}
+}
+
+static void flush_tlb_queue(int cpu, struct mm_struct *mm,
+			    unsigned long start, unsigned long end)
+{
+	struct tlb_flush_batch *b = &per_cpu(tlb_flush_batch, cpu);
+	struct flush_tlb_info *f;
+	unsigned long flags;
+	bool send;
+	int i;
+
+	raw_spin_lock_irqsave(&b->lock, flags);
+	send = !(b->seq & 1);
+	b->seq |= 1;
+	b->requests++;
+	if (b->flush_all)
+		goto out;
+	for (i = 0; i < b->nr; i++) {
+		if (b->info[i].flush_mm == mm) {
+			flush_tlb_merge(&b->info[i], start, end);
+			goto out;
+		}
+	}
+	if (b->nr == TLB_FLUSH_BATCH) {
+		b->flush_all = true;
+		goto out;
+	}
+	f = &b->info[b->nr++];
+	f->flush_mm = mm;
+	f->flush_start = start;
+	f->flush_end = end;
+out:
+	raw_spin_unlock_irqrestore(&b->lock, flags);
+
+	if (send)
+		smp_call_function_single_async(cpu, &b->csd);
+}
+
+static void flush_tlb_wait(int cpu)
+{
+	struct tlb_flush_batch *b = &per_cpu(tlb_flush_batch, cpu);
+	unsigned long seq = READ_ONCE(b->seq);
+	unsigned long target = (seq >> 1) + (seq & 1);
+
+	while ((long)(smp_load_acquire(&b->done) - target) < 0)
+		cpu_relax();
+}
+
+static void flush_tlb_batched(const struct cpumask *cpumask,
+			      struct mm_struct *mm, unsigned long start,
+			      unsigned long end)
+{
+	int cpu, this_cpu = smp_processor_id();
+
+	/* flush_tlb_page() passes a zero end for a single page */
+	if (!end)
+		end = start + PAGE_SIZE;
+
+	for_each_cpu_and(cpu, cpumask, cpu_online_mask) {
+		if (cpu != this_cpu)
+			flush_tlb_queue(cpu, mm, start, end);
+	}
+	for_each_cpu_and(cpu, cpumask, cpu_online_mask) {
+		if (cpu != this_cpu)
+			flush_tlb_wait(cpu);
+	}
+}
+
 void native_flush_tlb_others(const struct cpumask *cpumask,
 				 struct mm_struct *mm, unsigned long start,
 				 unsigned long end)
 {
-	struct flush_tlb_info info;
-	info.flush_mm = mm;
-	info.flush_start = start;
-	info.flush_end = end;
-
 	count_vm_tlb_event(NR_TLB_REMOTE_FLUSH);
 	if (is_uv_system()) {
 		unsigned int cpu;
@@ -146,42 +309,87 @@ void native_flush_tlb_others(const struct cpumask *cpumask,
 		cpu = smp_processor_id();
 		cpumask = uv_flush_tlb_others(cpumask, mm, start, end, cpu);
 		if (cpumask)
-			smp_call_function_many(cpumask, flush_tlb_func,
-								&info, 1);
+			flush_tlb_batched(cpumask, mm, start, end);
 		return;
 	}
-	smp_call_function_many(cpumask, flush_tlb_func, &info, 1);
+	flush_tlb_batched(cpumask, mm, start, end);
+}
+
+/*
+ * A cpu in lazy tlb mode runs no user code, so rather than flushing it we
+ * can have it flush its tlb when it comes back to the mm: switch_mm() does
+ * that when it finds lazy_flush set.  The cpu stays in mm_cpumask(mm), and
+ * still gets the flushes of freed page tables, since it has them loaded
+ * and may walk them speculatively.
+ *
+ * switch_mm() sets TLBSTATE_OK before atomically testing and setting its
+ * bit and then reads lazy_flush, and we set lazy_flush before checking
+ * the state again, so if the cpu came back to the mm without seeing
+ * lazy_flush we see TLBSTATE_OK and flush it after all.
+ */
+static bool flush_tlb_skip_lazy(int cpu)
+{
+	if (per_cpu(cpu_tlbstate.state, cpu) != TLBSTATE_LAZY)
+		return false;
+
+	WRITE_ONCE(per_cpu(cpu_tlbstate.lazy_flush, cpu), 1);
+	smp_mb();
+	return per_cpu(cpu_tlbstate.state, cpu) == TLBSTATE_LAZY;
+}
+
+static DEFINE_PER_CPU(struct cpumask, flush_tlb_mask);
+
+/*
+ * The cpus of mm_cpumask(mm) other than us that need an IPI, or NULL if
+ * there are none.
+ */
+static const struct cpumask *flush_tlb_targets(struct mm_struct *mm,
+					       bool freed_tables)
+{
+	struct cpumask *mask;
+	int cpu, this_cpu = smp_processor_id();
+
+	if (cpumask_any_but(mm_cpumask(mm), this_cpu) >= nr_cpu_ids)
+		return NULL;
+	if (freed_tables)
+		return mm_cpumask(mm);
+
+	mask = this_cpu_ptr(&flush_tlb_mask);
+	cpumask_clear(mask);
+	for_each_cpu(cpu, mm_cpumask(mm)) {
+		if (cpu == this_cpu)
+			continue;
+		if (flush_tlb_skip_lazy(cpu))
+			inc_irq_stat(irq_tlb_lazy_count);
+		else
+			cpumask_set_cpu(cpu, mask);
+	}
+	if (cpumask_empty(mask))
+		return NULL;
+	return mask;
 }
 
 void flush_tlb_current_task(void)
 {
 	struct mm_struct *mm = current->mm;
+	const struct cpumask *targets;
 
 	preempt_disable();
 
 	count_vm_tlb_event(NR_TLB_LOCAL_FLUSH_ALL);
 	local_flush_tlb();
 	trace_tlb_flush(TLB_LOCAL_SHOOTDOWN, TLB_FLUSH_ALL);
-	if (cpumask_any_but(mm_cpumask(mm), smp_processor_id()) < nr_cpu_ids)
-		flush_tlb_others(mm_cpumask(mm), mm, 0UL, TLB_FLUSH_ALL);
+	targets = flush_tlb_targets(mm, true);
+	if (targets)
+		flush_tlb_others(targets, mm, 0UL, TLB_FLUSH_ALL);
 	preempt_enable();
 }
 
-/*
- * See Documentation/x86/tlb.txt for details.  We choose 33
- * because it is large enough to cover the vast majority (at
- * least 95%) of allocations, and is small enough that we are
- * confident it will not cause too much overhead.  Each single
- * flush is about 100 ns, so this caps the maximum overhead at
- * _about_ 3,000 ns.
- *
- * This is in units of pages.
- */
-static unsigned long tlb_single_page_flush_ceiling __read_mostly = 33;
-
 void flush_tlb_mm_range(struct mm_struct *mm, unsigned long start,
-				unsigned long end, unsigned long vmflag)
+				unsigned long end, unsigned long vmflag,
+				bool freed_tables)
 {
+	const struct cpumask *targets;
 	unsigned long addr;
 	/* do a global flush by default */
 	unsigned long base_pages_to_flush = TLB_FLUSH_ALL;
@@ -215,14 +423,16 @@ out:
 		start = 0UL;
 		end = TLB_FLUSH_ALL;
 	}
-	if (cpumask_any_but(mm_cpumask(mm), smp_processor_id()) < nr_cpu_ids)
-		flush_tlb_others(mm_cpumask(mm), mm, start, end);
+	targets = flush_tlb_targets(mm, freed_tables);
+	if (targets)
+		flush_tlb_others(targets, mm, start, end);
 	preempt_enable();
 }
 
 void flush_tlb_page(struct vm_area_struct *vma, unsigned long start)
 {
 	struct mm_struct *mm = vma->vm_mm;
+	const struct cpumask *targets;
 
 	preempt_disable();
 
@@ -233,8 +443,9 @@ void flush_tlb_page(struct vm_area_struct *vma, unsigned long start)
 			leave_mm(smp_processor_id());
 	}
 
-	if (cpumask_any_but(mm_cpumask(mm), smp_processor_id()) < nr_cpu_ids)
-		flush_tlb_others(mm_cpumask(mm), mm, start, 0UL);
+	targets = flush_tlb_targets(mm, false);
+	if (targets)
+		flush_tlb_others(targets, mm, start, 0UL);
 
 	preempt_enable();
 }
@@ -484,7 +484,7 @@ static int blkcg_reset_stats(struct cgroup_subsys_state *css,
 	return 0;
 }
 
-static const char *blkg_dev_name(struct blkcg_gq *blkg)
+const char *blkg_dev_name(struct blkcg_gq *blkg)
 {
 	/* some drivers (floppy) instantiate a queue w/o disk registered */
 	if (blkg->q->backing_dev_info.dev)
@@ -859,9 +859,28 @@ done:
  */
 int blkcg_init_queue(struct request_queue *q)
 {
+	int ret;
+
 	might_sleep();
 
-	return blk_throtl_init(q);
+	ret = blk_throtl_init(q);
+	if (ret)
+		return ret;
+
+	ret = blk_iolatency_init(q);
+	if (ret)
+		goto err_throtl;
+
+	ret = blk_iocost_init(q);
+	if (ret)
+		goto err_iolatency;
+	return 0;
+
+err_iolatency:
+	blk_iolatency_exit(q);
+err_throtl:
+	blk_throtl_exit(q);
+	return ret;
 }
 
 /**
@@ -896,6 +915,8 @@ void blkcg_exit_queue(struct request_queue *q)
 	blkg_destroy_all(q);
 	spin_unlock_irq(q->queue_lock);
 
+	blk_iocost_exit(q);
+	blk_iolatency_exit(q);
 	blk_throtl_exit(q);
 }
 
@@ -0,0 +1,842 @@
+/*
+ * Proportional IO cost control for cgroups on blk-mq queues
+ *
+ * Every bio is charged a cost in nanoseconds of device time, estimated
+ * from a linear model of the device: a fixed cost per sequential or random
+ * IO plus a cost per page, separately for reads and writes.  The model
+ * defaults to typical SSD or rotational numbers and can be set through
+ * blkio.cost.model on the root cgroup.
+ *
+ * The device's capacity is handed out as virtual time.  The queue-wide
+ * vtime clock runs at vrate, which is 100% when the device does exactly as
+ * much as the model says it can.  Each active cgroup has a local vtime,
+ * which a bio advances by its cost divided by the group's hierarchical
+ * share of the device (hweight, the product of weight / sum of the active
+ * siblings' weights along the path).  A bio may be issued once the group's
+ * vtime is no longer ahead of the clock, so groups get device time in
+ * proportion to their weights while they compete, and whatever a group
+ * doesn't use goes to the others as inactive groups drop out of the sums.
+ *
+ * Once per period, vrate is adjusted from the completion latencies: if
+ * more than IOC_MISSED_PCT of the requests miss the latency target of
+ * blkio.cost.qos, the device is overloaded and vrate goes down; if groups
+ * had to wait for budget without that happening, it goes up, within the
+ * configured bounds.
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/blkdev.h>
+#include <linux/bio.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/percpu.h>
+#include <linux/seqlock.h>
+#include <linux/timer.h>
+#include "blk-cgroup.h"
+#include "blk.h"
+
+#define IOC_PERIOD		(HZ / 20)	/* 50ms */
+#define IOC_MISSED_PCT		10
+
+/* vrate and hweight are fixed point, 1 << 16 is 100% */
+#define VRATE_SHIFT		16
+#define VRATE_ONE		(1U << VRATE_SHIFT)
+#define WEIGHT_ONE		(1U << 16)
+
+#define CGROUP_WEIGHT_MIN	1
+#define CGROUP_WEIGHT_DFL	100
+#define CGROUP_WEIGHT_MAX	10000
+
+/* IOs closer than this to the previous one of the group are sequential */
+#define IOC_SEQ_DIST		(16 << (20 - 9))	/* 16MB in sectors */
+
+/* how much unused budget a group may carry */
+#define IOC_MARGIN_VTIME	(25 * NSEC_PER_MSEC)
+
+enum {
+	IOC_BPS,
+	IOC_SEQIOPS,
+	IOC_RANDIOPS,
+	NR_IOC_PARAMS,
+};
+
+/* rbps, rseqiops, rrandiops, wbps, wseqiops, wrandiops */
+static const u64 ioc_default_ssd[2][NR_IOC_PARAMS] = {
+	{ 488636629, 8932, 8518 },
+	{ 427891549, 28755, 21940 },
+};
+
+static const u64 ioc_default_hdd[2][NR_IOC_PARAMS] = {
+	{ 174019176, 41708, 370 },
+	{ 178075866, 42705, 378 },
+};
+
+static const char *ioc_param_names[2][NR_IOC_PARAMS] = {
+	{ "rbps", "rseqiops", "rrandiops" },
+	{ "wbps", "wseqiops", "wrandiops" },
+};
+
+static struct blkcg_policy blkcg_policy_iocost;
+
+struct iocost_pcpu_stat {
+	u64			nr_met[2];
+	u64			nr_missed[2];
+};
+
+struct iocost {
+	struct request_queue	*q;
+	spinlock_t		lock;
+	bool			enabled;
+
+	/* device model as configured and the coefficients derived from it */
+	u64			params[2][NR_IOC_PARAMS];
+	u64			page_ns[2];
+	u64			seqio_ns[2];
+	u64			randio_ns[2];
+
+	/* QoS: completion latency targets and the bounds of vrate */
+	u64			lat_target_ns[2];
+	/* not touched by the user yet, follow the device type */
+	bool			default_model;
+	bool			default_lat;
+	u32			vrate_min;
+	u32			vrate_max;
+
+	/* the vtime clock, see iocost_vnow() */
+	seqcount_t		period_seq;
+	u64			period_at_ns;
+	u64			period_at_vtime;
+	u32			vrate;
+	unsigned long		period;
+
+	struct timer_list	timer;
+	struct list_head	active_list;
+	atomic_t		hweight_gen;
+	/* somebody had to wait for budget during this period */
+	bool			saturated;
+
+	struct iocost_pcpu_stat __percpu *pcpu_stat;
+	u64			last_met;
+	u64			last_missed;
+};
+
+struct iocost_grp {
+	struct blkg_policy_data	pd;
+
+	unsigned int		weight;
+	atomic64_t		vtime;
+	/* where the group's last IO ended, for the sequential test */
+	sector_t		cursor;
+
+	/* the following are protected by iocost->lock */
+	bool			active;
+	struct list_head	active_node;
+	unsigned int		child_active_sum;
+	unsigned long		last_active_period;
+
+	/* cached hierarchical weight, valid while hweight_gen matches */
+	u32			hweight;
+	int			hweight_gen;
+};
+
+static inline struct iocost_grp *pd_to_iocg(struct blkg_policy_data *pd)
+{
+	return pd ? container_of(pd, struct iocost_grp, pd) : NULL;
+}
+
+static inline struct iocost_grp *blkg_to_iocg(struct blkcg_gq *blkg)
+{
+	return pd_to_iocg(blkg_to_pd(blkg, &blkcg_policy_iocost));
+}
+
+static inline struct blkcg_gq *iocg_to_blkg(struct iocost_grp *iocg)
+{
+	return pd_to_blkg(&iocg->pd);
+}
+
+static inline struct iocost_grp *iocg_parent(struct iocost_grp *iocg)
+{
+	return blkg_to_iocg(iocg_to_blkg(iocg)->parent);
+}
+
+/* Turn the configured bps/iops numbers into per IO and per page costs */
+static void iocost_calc_coefs(struct iocost *ioc)
+{
+	int rw;
+
+	for (rw = READ; rw <= WRITE; rw++) {
+		u64 *p = ioc->params[rw];
+		u64 io_ns;
+
+		ioc->page_ns[rw] = div64_u64(NSEC_PER_SEC * PAGE_SIZE,
+					     max_t(u64, p[IOC_BPS], 1));
+
+		io_ns = div64_u64(NSEC_PER_SEC, max_t(u64, p[IOC_SEQIOPS], 1));
+		ioc->seqio_ns[rw] = io_ns > ioc->page_ns[rw] ?
+				    io_ns - ioc->page_ns[rw] : 0;
+
+		io_ns = div64_u64(NSEC_PER_SEC, max_t(u64, p[IOC_RANDIOPS], 1));
+		ioc->randio_ns[rw] = io_ns > ioc->page_ns[rw] ?
+				     io_ns - ioc->page_ns[rw] : 0;
+	}
+}
+
+/*
+ * Drivers mark their queues rotational or not after the queue has been
+ * set up, so this is redone whenever the controller gets enabled.
+ */
+static void iocost_set_defaults(struct iocost *ioc)
+{
+	bool rotational = !blk_queue_nonrot(ioc->q);
+
+	if (ioc->default_model) {
+		memcpy(ioc->params,
+		       rotational ? ioc_default_hdd : ioc_default_ssd,
+		       sizeof(ioc->params));
+		iocost_calc_coefs(ioc);
+	}
+	if (ioc->default_lat)
+		ioc->lat_target_ns[READ] = ioc->lat_target_ns[WRITE] =
+			(rotational ? 250 : 25) * NSEC_PER_MSEC;
+}
+
+static u64 iocost_bio_cost(struct iocost *ioc, struct iocost_grp *iocg,
+			   struct bio *bio)
+{
+	int rw = bio_data_dir(bio);
+	sector_t sector = bio->bi_iter.bi_sector;
+	sector_t cursor = READ_ONCE(iocg->cursor);
+	u64 pages = DIV_ROUND_UP(bio->bi_iter.bi_size, PAGE_SIZE);
+	u64 cost;
+
+	if (sector >= cursor ? sector - cursor <= IOC_SEQ_DIST :
+			       cursor - sector <= IOC_SEQ_DIST)
+		cost = ioc->seqio_ns[rw];
+	else
+		cost = ioc->randio_ns[rw];
+
+	WRITE_ONCE(iocg->cursor, bio_end_sector(bio));
+	return cost + pages * ioc->page_ns[rw];
+}
+
+/*
+ * The queue's vtime.  It advances at vrate from where it was at the start
+ * of the current period, so that vrate changes don't make it jump.
+ */
+static u64 iocost_vnow(struct iocost *ioc)
+{
+	unsigned int seq;
+	u64 vnow;
+
+	do {
+		seq = read_seqcount_begin(&ioc->period_seq);
+		vnow = ioc->period_at_vtime +
+		       (((ktime_get_ns() - ioc->period_at_ns) * ioc->vrate) >>
+			VRATE_SHIFT);
+	} while (read_seqcount_retry(&ioc->period_seq, seq));
+
+	return vnow;
+}
+
+static u32 iocg_hweight(struct iocost *ioc, struct iocost_grp *iocg)
+{
+	int gen = atomic_read(&ioc->hweight_gen);
+	struct iocost_grp *pos, *parent;
+	u64 hweight = WEIGHT_ONE;
+
+	if (READ_ONCE(iocg->hweight_gen) == gen)
+		return READ_ONCE(iocg->hweight);
+
+	for (pos = iocg; (parent = iocg_parent(pos)); pos = parent) {
+		unsigned int weight = READ_ONCE(pos->weight);
+		unsigned int sum = READ_ONCE(parent->child_active_sum);
+
+		hweight = div_u64(hweight * weight, max(sum, weight));
+	}
+	hweight = max_t(u64, hweight, 1);
+
+	WRITE_ONCE(iocg->hweight, hweight);
+	WRITE_ONCE(iocg->hweight_gen, gen);
+	return hweight;
+}
+
+/* Don't let a group bank more than IOC_MARGIN_VTIME of unused budget */
+static void iocg_clamp_vtime(struct iocost_grp *iocg, u64 vnow)
+{
+	u64 vtime = atomic64_read(&iocg->vtime);
+	u64 vmin = vnow - IOC_MARGIN_VTIME;
+
+	if ((s64)(vtime - vmin) < 0)
+		atomic64_cmpxchg(&iocg->vtime, vtime, vmin);
+}
+
+static void iocg_activate(struct iocost *ioc, struct iocost_grp *iocg,
+			  u64 vnow)
+{
+	struct iocost_grp *parent;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ioc->lock, flags);
+	for (; (parent = iocg_parent(iocg)); iocg = parent) {
+		iocg->last_active_period = ioc->period;
+		if (iocg->active)
+			break;
+		iocg->active = true;
+		list_add(&iocg->active_node, &ioc->active_list);
+		parent->child_active_sum += iocg->weight;
+		iocg_clamp_vtime(iocg, vnow);
+	}
+	atomic_inc(&ioc->hweight_gen);
+
+	if (!timer_pending(&ioc->timer))
+		mod_timer(&ioc->timer, jiffies + IOC_PERIOD);
+	spin_unlock_irqrestore(&ioc->lock, flags);
+}
+
+/* Called with iocost->lock held */
+static void iocg_deactivate(struct iocost *ioc, struct iocost_grp *iocg)
+{
+	iocg->active = false;
+	list_del_init(&iocg->active_node);
+	iocg_parent(iocg)->child_active_sum -= iocg->weight;
+	atomic_inc(&ioc->hweight_gen);
+}
+
+static void iocost_timer_fn(unsigned long data)
+{
+	struct iocost *ioc = (struct iocost *)data;
+	struct iocost_grp *iocg, *tmp;
+	u64 met = 0, missed = 0;
+	u64 now, vnow;
+	u32 vrate;
+	int cpu, rw;
+
+	spin_lock_irq(&ioc->lock);
+
+	for_each_possible_cpu(cpu) {
+		struct iocost_pcpu_stat *stat = per_cpu_ptr(ioc->pcpu_stat, cpu);
+
+		for (rw = READ; rw <= WRITE; rw++) {
+			met += stat->nr_met[rw];
+			missed += stat->nr_missed[rw];
+		}
+	}
+	met -= ioc->last_met;
+	missed -= ioc->last_missed;
+	ioc->last_met += met;
+	ioc->last_missed += missed;
+
+	/*
+	 * Too many requests missing the latency target means the device is
+	 * fed more than it can do, otherwise if groups are waiting for
+	 * budget the device can probably do more than the model says.
+	 */
+	vrate = ioc->vrate;
+	if (missed * 100 > (met + missed) * IOC_MISSED_PCT)
+		vrate = max(vrate - vrate / 8, ioc->vrate_min);
+	else if (ioc->saturated)
+		vrate = min(vrate + vrate / 16, ioc->vrate_max);
+	ioc->saturated = false;
+
+	vnow = iocost_vnow(ioc);
+	now = ktime_get_ns();
+	write_seqcount_begin(&ioc->period_seq);
+	ioc->period_at_ns = now;
+	ioc->period_at_vtime = vnow;
+	ioc->vrate = vrate;
+	write_seqcount_end(&ioc->period_seq);
+	ioc->period++;
+
+	/* groups without IO for a whole period give their share back */
+	list_for_each_entry_safe(iocg, tmp, &ioc->active_list, active_node)
+		if (time_before(iocg->last_active_period + 1, ioc->period) &&
+		    !iocg->child_active_sum)
+			iocg_deactivate(ioc, iocg);
+
+	if (!list_empty(&ioc->active_list))
+		mod_timer(&ioc->timer, jiffies + IOC_PERIOD);
+
+	spin_unlock_irq(&ioc->lock);
+}
+
+/**
+ * blk_iocost_throttle - charge a bio's cost to its cgroup
+ * @q: the blk-mq request_queue @bio is being submitted to
+ * @bio: the bio
+ *
+ * Charges the cost of @bio to its cgroup's vtime, after waiting for the
+ * group's vtime to be no longer ahead of the queue's.  Returns %true if
+ * the request for @bio should be tracked for the latency feedback.  May
+ * sleep.
+ */
+bool blk_iocost_throttle(struct request_queue *q, struct bio *bio)
+{
+	struct iocost *ioc = q->iocost;
+	struct iocost_grp *iocg;
+	struct blkcg_gq *blkg;
+	struct blkcg *blkcg;
+	u64 cost, vnow;
+	u32 hweight;
+
+	if (!ioc || !READ_ONCE(ioc->enabled))
+		return false;
+
+	rcu_read_lock();
+	blkcg = bio_blkcg(bio);
+	blkg = blkg_lookup(blkcg, q);
+	if (unlikely(!blkg)) {
+		spin_lock_irq(q->queue_lock);
+		blkg = blkg_lookup_create(blkcg, q);
+		if (IS_ERR(blkg))
+			blkg = NULL;
+		spin_unlock_irq(q->queue_lock);
+	}
+	/* the root cgroup isn't controlled, nor a blkg on its way out */
+	if (!blkg || !blkg->parent || !atomic_inc_not_zero(&blkg->refcnt)) {
+		rcu_read_unlock();
+		return true;
+	}
+	rcu_read_unlock();
+
+	iocg = blkg_to_iocg(blkg);
+	cost = iocost_bio_cost(ioc, iocg, bio);
+	vnow = iocost_vnow(ioc);
+
+	if (!READ_ONCE(iocg->active) ||
+	    READ_ONCE(iocg->last_active_period) != READ_ONCE(ioc->period))
+		iocg_activate(ioc, iocg, vnow);
+	else
+		iocg_clamp_vtime(iocg, vnow);
+
+	for (;;) {
+		u64 vtime = atomic64_read(&iocg->vtime);
+		ktime_t delay;
+		u32 vrate;
+
+		vnow = iocost_vnow(ioc);
+		if ((s64)(vtime - vnow) <= 0)
+			break;
+
+		/* sleep until the queue's vtime catches up */
+		WRITE_ONCE(ioc->saturated, true);
+		vrate = max(READ_ONCE(ioc->vrate), 1U);
+		delay = ns_to_ktime(div_u64((vtime - vnow) << VRATE_SHIFT,
+					    vrate));
+		__set_current_state(TASK_UNINTERRUPTIBLE);
+		schedule_hrtimeout(&delay, HRTIMER_MODE_REL);
+	}
+
+	hweight = iocg_hweight(ioc, iocg);
+	atomic64_add(div_u64(cost * WEIGHT_ONE, hweight), &iocg->vtime);
+
+	blkg_put(blkg);
+	return true;
+}
+
+/**
+ * blk_iocost_done - feed a request's completion latency back
+ * @rq: the request being freed
+ *
+ * Counts whether @rq met the latency target for its direction, if it was
+ * issued to the driver at all.
+ */
+void blk_iocost_done(struct request *rq)
+{
+	struct iocost *ioc = rq->q->iocost;
+	int rw = rq_data_dir(rq);
+	u64 lat;
+
+	if (!rq->iocost_start_ns)
+		return;
+
+	if (test_bit(REQ_ATOM_STARTED, &rq->atomic_flags)) {
+		lat = ktime_get_ns() - rq->iocost_start_ns;
+		if (ioc->lat_target_ns[rw] && lat > ioc->lat_target_ns[rw])
+			this_cpu_inc(ioc->pcpu_stat->nr_missed[rw]);
+		else
+			this_cpu_inc(ioc->pcpu_stat->nr_met[rw]);
+	}
+	rq->iocost_start_ns = 0;
+}
+
+static void iocost_pd_init(struct blkcg_gq *blkg)
+{
+	struct iocost_grp *iocg = blkg_to_iocg(blkg);
+
+	iocg->weight = CGROUP_WEIGHT_DFL;
+	atomic64_set(&iocg->vtime, blkg->q->iocost ?
+				   iocost_vnow(blkg->q->iocost) : 0);
+	iocg->cursor = 0;
+	iocg->active = false;
+	INIT_LIST_HEAD(&iocg->active_node);
+	iocg->child_active_sum = 0;
+	iocg->last_active_period = 0;
+	iocg->hweight = WEIGHT_ONE;
+	iocg->hweight_gen = -1;
+}
+
+static void iocost_pd_offline(struct blkcg_gq *blkg)
+{
+	struct iocost_grp *iocg = blkg_to_iocg(blkg);
+	struct iocost *ioc = blkg->q->iocost;
+	unsigned long flags;
+
+	if (!ioc)
+		return;
+
+	spin_lock_irqsave(&ioc->lock, flags);
+	if (iocg->active)
+		iocg_deactivate(ioc, iocg);
+	spin_unlock_irqrestore(&ioc->lock, flags);
+}
+
+static u64 iocost_prfill_weight(struct seq_file *sf,
+				struct blkg_policy_data *pd, int off)
+{
+	struct iocost_grp *iocg = pd_to_iocg(pd);
+
+	if (iocg->weight == CGROUP_WEIGHT_DFL)
+		return 0;
+	return __blkg_prfill_u64(sf, pd, iocg->weight);
+}
+
+static int iocost_print_weight(struct seq_file *sf, void *v)
+{
+	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)),
+			  iocost_prfill_weight, &blkcg_policy_iocost,
+			  0, false);
+	return 0;
+}
+
+static ssize_t iocost_set_weight(struct kernfs_open_file *of,
+				 char *buf, size_t nbytes, loff_t off)
+{
+	struct blkcg *blkcg = css_to_blkcg(of_css(of));
+	struct blkg_conf_ctx ctx;
+	struct iocost_grp *iocg;
+	struct iocost *ioc;
+	unsigned int weight;
+	int ret;
+
+	ret = blkg_conf_prep(blkcg, &blkcg_policy_iocost, buf, &ctx);
+	if (ret)
+		return ret;
+
+	ret = -EINVAL;
+	weight = ctx.v ?: CGROUP_WEIGHT_DFL;
+	if (weight < CGROUP_WEIGHT_MIN || weight > CGROUP_WEIGHT_MAX)
+		goto out_finish;
+
+	ioc = ctx.disk->queue->iocost;
+	iocg = blkg_to_iocg(ctx.blkg);
+
+	spin_lock(&ioc->lock);
+	if (iocg->active)
+		iocg_parent(iocg)->child_active_sum += weight - iocg->weight;
+	iocg->weight = weight;
+	atomic_inc(&ioc->hweight_gen);
+	spin_unlock(&ioc->lock);
+	ret = 0;
+
+out_finish:
+	blkg_conf_finish(&ctx);
+	return ret ?: nbytes;
+}
+
+static u64 iocost_prfill_model(struct seq_file *sf,
+			       struct blkg_policy_data *pd, int off)
+{
+	const char *dname = blkg_dev_name(pd->blkg);
+	struct iocost *ioc = pd->blkg->q->iocost;
+	int rw, i;
+
+	if (!dname || !ioc || !ioc->q->mq_ops)
+		return 0;
+
+	seq_printf(sf, "%s", dname);
+	for (rw = READ; rw <= WRITE; rw++)
+		for (i = 0; i < NR_IOC_PARAMS; i++)
+			seq_printf(sf, " %s=%llu", ioc_param_names[rw][i],
+				   ioc->params[rw][i]);
+	seq_putc(sf, '\n');
+	return 0;
+}
+
+static u64 iocost_prfill_qos(struct seq_file *sf,
+			     struct blkg_policy_data *pd, int off)
+{
+	const char *dname = blkg_dev_name(pd->blkg);
+	struct iocost *ioc = pd->blkg->q->iocost;
+
+	if (!dname || !ioc || !ioc->q->mq_ops)
+		return 0;
+
+	seq_printf(sf, "%s enable=%d rlat=%llu wlat=%llu min=%u max=%u vrate=%u\n",
+		   dname, ioc->enabled,
+		   div_u64(ioc->lat_target_ns[READ], NSEC_PER_USEC),
+		   div_u64(ioc->lat_target_ns[WRITE], NSEC_PER_USEC),
+		   ioc->vrate_min * 100 >> VRATE_SHIFT,
+		   ioc->vrate_max * 100 >> VRATE_SHIFT,
+		   ioc->vrate * 100 >> VRATE_SHIFT);
+	return 0;
+}
+
+static int iocost_print_model(struct seq_file *sf, void *v)
+{
+	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)),
+			  iocost_prfill_model, &blkcg_policy_iocost,
+			  0, false);
+	return 0;
+}
+
+static int iocost_print_qos(struct seq_file *sf, void *v)
+{
+	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)),
+			  iocost_prfill_qos, &blkcg_policy_iocost,
+			  0, false);
+	return 0;
+}
+
+/*
+ * Parses "MAJ:MIN key=value ..." for the root-only files.  Returns the
+ * disk with a reference held and points @body at the key=value part.
+ */
+static struct gendisk *iocost_conf_disk(char *input, char **body)
+{
+	unsigned int major, minor;
+	struct gendisk *disk;
+	int part, len;
+
+	if (sscanf(input, "%u:%u%n", &major, &minor, &len) != 2)
+		return ERR_PTR(-EINVAL);
+
+	disk = get_gendisk(MKDEV(major, minor), &part);
+	if (!disk)
+		return ERR_PTR(-ENODEV);
+	if (part || !disk->queue->mq_ops || !disk->queue->iocost) {
+		put_disk(disk);
+		return ERR_PTR(part ? -EINVAL : -EOPNOTSUPP);
+	}
+
+	*body = input + len;
+	return disk;
+}
+
+static ssize_t iocost_set_model(struct kernfs_open_file *of,
+				char *buf, size_t nbytes, loff_t off)
+{
+	u64 params[2][NR_IOC_PARAMS];
+	struct gendisk *disk;
+	struct iocost *ioc;
+	char *body, *p;
+	int ret = 0;
+
+	disk = iocost_conf_disk(strstrip(buf), &body);
+	if (IS_ERR(disk))
+		return PTR_ERR(disk);
+	ioc = disk->queue->iocost;
+
+	spin_lock_irq(&ioc->lock);
+	memcpy(params, ioc->params, sizeof(params));
+	spin_unlock_irq(&ioc->lock);
+
+	while ((p = strsep(&body, " \t\n"))) {
+		char key[16];
+		u64 v;
+		int rw, i;
+
+		if (!*p)
+			continue;
+		if (sscanf(p, "%15[^=]=%llu", key, &v) != 2 || !v) {
+			ret = -EINVAL;
+			goto out_put;
+		}
+		for (rw = READ; rw <= WRITE; rw++)
+			for (i = 0; i < NR_IOC_PARAMS; i++)
+				if (!strcmp(key, ioc_param_names[rw][i]))
+					goto found;
+		ret = -EINVAL;
+		goto out_put;
+found:
+		params[rw][i] = v;
+	}
+
+	spin_lock_irq(&ioc->lock);
+	memcpy(ioc->params, params, sizeof(params));
+	ioc->default_model = false;
+	iocost_calc_coefs(ioc);
+	spin_unlock_irq(&ioc->lock);
+
+out_put:
+	put_disk(disk);
+	return ret ?: nbytes;
+}
+
+static ssize_t iocost_set_qos(struct kernfs_open_file *of,
+			      char *buf, size_t nbytes, loff_t off)
+{
+	struct gendisk *disk;
+	struct iocost *ioc;
+	u64 lat[2], enable;
+	bool lat_set = false;
+	u32 vmin, vmax;
+	char *body, *p;
+	int ret = 0;
+
+	disk = iocost_conf_disk(strstrip(buf), &body);
+	if (IS_ERR(disk))
+		return PTR_ERR(disk);
+	ioc = disk->queue->iocost;
+
+	spin_lock_irq(&ioc->lock);
+	enable = ioc->enabled;
+	lat[READ] = ioc->lat_target_ns[READ];
+	lat[WRITE] = ioc->lat_target_ns[WRITE];
+	vmin = ioc->vrate_min;
+	vmax = ioc->vrate_max;
+	spin_unlock_irq(&ioc->lock);
+
+	while ((p = strsep(&body, " \t\n"))) {
+		char key[16];
+		u64 v;
+
+		if (!*p)
+			continue;
+		if (sscanf(p, "%15[^=]=%llu", key, &v) != 2)
+			goto einval;
+
+		if (!strcmp(key, "enable") && v <= 1) {
+			enable = v;
+		} else if (!strcmp(key, "rlat")) {
+			lat[READ] = v * NSEC_PER_USEC;
+			lat_set = true;
+		} else if (!strcmp(key, "wlat")) {
+			lat[WRITE] = v * NSEC_PER_USEC;
+			lat_set = true;
+		} else if (!strcmp(key, "min") && v && v <= 10000) {
+			vmin = div_u64(v << VRATE_SHIFT, 100);
+		} else if (!strcmp(key, "max") && v && v <= 10000) {
+			vmax = div_u64(v << VRATE_SHIFT, 100);
+		} else {
+			goto einval;
+		}
+	}
+	if (vmin > vmax)
+		goto einval;
+
+	spin_lock_irq(&ioc->lock);
+	if (lat_set) {
+		ioc->default_lat = false;
+		ioc->lat_target_ns[READ] = lat[READ];
+		ioc->lat_target_ns[WRITE] = lat[WRITE];
+	}
+	if (enable && !ioc->enabled)
+		iocost_set_defaults(ioc);
+	ioc->enabled = enable;
+	ioc->vrate_min = vmin;
+	ioc->vrate_max = vmax;
+	ioc->vrate = clamp(ioc->vrate, vmin, vmax);
+	spin_unlock_irq(&ioc->lock);
+	goto out_put;
+
+einval:
+	ret = -EINVAL;
+out_put:
+	put_disk(disk);
+	return ret ?: nbytes;
+}
+
+static struct cftype iocost_files[] = {
+	{
+		.name = "cost.weight",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = iocost_print_weight,
+		.write = iocost_set_weight,
+	},
+	{
+		.name = "cost.model",
+		.flags = CFTYPE_ONLY_ON_ROOT,
+		.seq_show = iocost_print_model,
+		.write = iocost_set_model,
+	},
+	{
+		.name = "cost.qos",
+		.flags = CFTYPE_ONLY_ON_ROOT,
+		.seq_show = iocost_print_qos,
+		.write = iocost_set_qos,
+	},
+	{ }	/* terminate */
+};
+
+static struct blkcg_policy blkcg_policy_iocost = {
+	.pd_size		= sizeof(struct iocost_grp),
+	.cftypes		= iocost_files,
+
+	.pd_init_fn		= iocost_pd_init,
+	.pd_offline_fn		= iocost_pd_offline,
+};
+
+int blk_iocost_init(struct request_queue *q)
+{
+	struct iocost *ioc;
+	int ret;
+
+	ioc = kzalloc_node(sizeof(*ioc), GFP_KERNEL, q->node);
+	if (!ioc)
+		return -ENOMEM;
+
+	ioc->pcpu_stat = alloc_percpu(struct iocost_pcpu_stat);
+	if (!ioc->pcpu_stat) {
+		kfree(ioc);
+		return -ENOMEM;
+	}
+
+	ioc->q = q;
+	spin_lock_init(&ioc->lock);
+	seqcount_init(&ioc->period_seq);
+	setup_timer(&ioc->timer, iocost_timer_fn, (unsigned long)ioc);
+	INIT_LIST_HEAD(&ioc->active_list);
+	atomic_set(&ioc->hweight_gen, 0);
+
+	ioc->vrate = VRATE_ONE;
+	ioc->vrate_min = VRATE_ONE / 4;
+	ioc->vrate_max = VRATE_ONE * 4;
+	ioc->period_at_ns = ktime_get_ns();
+
+	ioc->default_model = true;
+	ioc->default_lat = true;
+	iocost_set_defaults(ioc);
+
+	q->iocost = ioc;
+
+	ret = blkcg_activate_policy(q, &blkcg_policy_iocost);
+	if (ret) {
+		q->iocost = NULL;
+		free_percpu(ioc->pcpu_stat);
+		kfree(ioc);
+	}
+	return ret;
+}
+
+void blk_iocost_exit(struct request_queue *q)
+{
+	struct iocost *ioc = q->iocost;
+
+	if (!ioc)
+		return;
+
+	del_timer_sync(&ioc->timer);
+	/* the groups are freed as they go, don't touch the active sums */
+	q->iocost = NULL;
+	blkcg_deactivate_policy(q, &blkcg_policy_iocost);
+	free_percpu(ioc->pcpu_stat);
+	kfree(ioc);
+}
+
+static int __init iocost_init(void)
+{
+	return blkcg_policy_register(&blkcg_policy_iocost);
+}
+
+module_init(iocost_init);
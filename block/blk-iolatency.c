@@ -0,0 +1,508 @@
+/*
+ * Block IO latency targets for cgroups on blk-mq queues
+ *
+ * Each cgroup can set a target completion latency per device through
+ * blkio.latency.  Requests are tracked from allocation to completion and
+ * their latency is averaged over a window of a few times the target.  When
+ * a group misses its target, it lowers its parent's scale_cookie, which
+ * tells the siblings with looser or no targets to halve the number of
+ * requests they may have in flight.  When the group with the tightest
+ * target among the siblings meets it again, or stops doing IO, the cookie
+ * goes back up and the siblings get their depth back step by step.
+ *
+ * The cost for queues without any target is one atomic read per bio.
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/blkdev.h>
+#include <linux/bio.h>
+#include <linux/wait.h>
+#include <linux/ktime.h>
+#include "blk-cgroup.h"
+#include "blk.h"
+
+#define DEFAULT_SCALE_COOKIE	1000000U
+
+/* Latencies are averaged over 16 times the target, within these bounds */
+#define MIN_WINDOW_NSEC		(100ULL * NSEC_PER_MSEC)
+#define MAX_WINDOW_NSEC		(1ULL * NSEC_PER_SEC)
+
+static struct blkcg_policy blkcg_policy_iolatency;
+
+struct iolatency_grp {
+	struct blkg_policy_data	pd;
+
+	/* target completion latency, 0 if none */
+	u64			min_lat_nsec;
+	u64			cur_win_nsec;
+	atomic64_t		window_start;
+	atomic64_t		lat_total;
+	atomic_t		lat_nr;
+	/* number of windows in which the target was missed */
+	u64			nr_missed;
+
+	/* requests in flight and how many are allowed, UINT_MAX if any */
+	atomic_t		inflight;
+	unsigned int		max_depth;
+	wait_queue_head_t	wait;
+
+	/* as a parent: lowered whenever a child misses its target */
+	atomic_t		scale_cookie;
+	u64			last_scale_nsec;
+	/* as a parent: the tightest target among the children */
+	u64			child_min_lat_nsec;
+	/* as a child: the parent's scale_cookie last acted upon */
+	unsigned int		last_scale_cookie;
+
+	/* root only: number of groups on the queue with a target */
+	atomic_t		nr_targets;
+};
+
+static inline struct iolatency_grp *pd_to_iolat(struct blkg_policy_data *pd)
+{
+	return pd ? container_of(pd, struct iolatency_grp, pd) : NULL;
+}
+
+static inline struct iolatency_grp *blkg_to_iolat(struct blkcg_gq *blkg)
+{
+	return pd_to_iolat(blkg_to_pd(blkg, &blkcg_policy_iolatency));
+}
+
+static inline struct blkcg_gq *iolat_to_blkg(struct iolatency_grp *iolat)
+{
+	return pd_to_blkg(&iolat->pd);
+}
+
+static bool iolatency_inc_below(atomic_t *v, unsigned int below)
+{
+	unsigned int cur = atomic_read(v);
+
+	for (;;) {
+		unsigned int old;
+
+		if (cur >= below)
+			return false;
+		old = atomic_cmpxchg(v, cur, cur + 1);
+		if (old == cur)
+			return true;
+		cur = old;
+	}
+}
+
+static void iolatency_scale_depth(struct iolatency_grp *iolat, bool up)
+{
+	unsigned int qd = iolat_to_blkg(iolat)->q->nr_requests;
+	unsigned int depth = READ_ONCE(iolat->max_depth);
+
+	if (up) {
+		if (depth == UINT_MAX)
+			return;
+		depth += max(qd / 16, 1U);
+		if (depth >= qd)
+			depth = UINT_MAX;
+	} else {
+		depth = min(depth, qd);
+		depth = max(depth / 2, 1U);
+	}
+
+	WRITE_ONCE(iolat->max_depth, depth);
+	if (up)
+		wake_up_all(&iolat->wait);
+}
+
+/*
+ * Called before each request of @iolat, adjusts its depth to what the
+ * parent's scale_cookie says.
+ */
+static void iolatency_check_scale(struct iolatency_grp *iolat)
+{
+	struct iolatency_grp *parent = blkg_to_iolat(iolat_to_blkg(iolat)->parent);
+	unsigned int last = READ_ONCE(iolat->last_scale_cookie);
+	unsigned int cookie = atomic_read(&parent->scale_cookie);
+	u64 now;
+
+	/*
+	 * The group with the tightest target may have gone idle after
+	 * missing it.  Don't keep its siblings throttled forever, give
+	 * them back one step per max window without a miss.
+	 */
+	if (cookie < DEFAULT_SCALE_COOKIE) {
+		now = ktime_get_ns();
+		if (now - READ_ONCE(parent->last_scale_nsec) > MAX_WINDOW_NSEC &&
+		    atomic_cmpxchg(&parent->scale_cookie, cookie,
+				   cookie + 1) == cookie) {
+			WRITE_ONCE(parent->last_scale_nsec, now);
+			cookie++;
+		}
+	}
+
+	if (cookie == last)
+		return;
+	/* Only one request acts on each change */
+	if (cmpxchg(&iolat->last_scale_cookie, last, cookie) != last)
+		return;
+
+	if (cookie > last) {
+		if (cookie >= DEFAULT_SCALE_COOKIE) {
+			WRITE_ONCE(iolat->max_depth, UINT_MAX);
+			wake_up_all(&iolat->wait);
+		} else {
+			iolatency_scale_depth(iolat, true);
+		}
+		return;
+	}
+
+	/* The groups being protected are never throttled themselves */
+	if (iolat->min_lat_nsec &&
+	    iolat->min_lat_nsec <= READ_ONCE(parent->child_min_lat_nsec))
+		return;
+	iolatency_scale_depth(iolat, false);
+}
+
+/* Called at the end of a window of @iolat, which has a target */
+static void iolatency_check_window(struct iolatency_grp *iolat)
+{
+	struct iolatency_grp *parent = blkg_to_iolat(iolat_to_blkg(iolat)->parent);
+	unsigned int nr = atomic_xchg(&iolat->lat_nr, 0);
+	u64 total = atomic64_xchg(&iolat->lat_total, 0);
+	unsigned int cookie;
+
+	if (!nr)
+		return;
+
+	if (div_u64(total, nr) > iolat->min_lat_nsec) {
+		iolat->nr_missed++;
+		atomic_dec(&parent->scale_cookie);
+		WRITE_ONCE(parent->last_scale_nsec, ktime_get_ns());
+		return;
+	}
+
+	/* Only the tightest target decides when the siblings may scale up */
+	if (iolat->min_lat_nsec > READ_ONCE(parent->child_min_lat_nsec))
+		return;
+	cookie = atomic_read(&parent->scale_cookie);
+	if (cookie < DEFAULT_SCALE_COOKIE)
+		atomic_cmpxchg(&parent->scale_cookie, cookie, cookie + 1);
+}
+
+static void iolatency_record(struct iolatency_grp *iolat, u64 lat, u64 now)
+{
+	u64 start = atomic64_read(&iolat->window_start);
+
+	atomic64_add(lat, &iolat->lat_total);
+	atomic_inc(&iolat->lat_nr);
+
+	if (now - start < iolat->cur_win_nsec)
+		return;
+	if (atomic64_cmpxchg(&iolat->window_start, start, now) == start)
+		iolatency_check_window(iolat);
+}
+
+static void iolatency_release(struct iolatency_grp *iolat)
+{
+	atomic_dec(&iolat->inflight);
+	smp_mb__after_atomic();
+	if (waitqueue_active(&iolat->wait))
+		wake_up(&iolat->wait);
+}
+
+/**
+ * blk_iolatency_throttle - wait for room in a bio's groups
+ * @q: the blk-mq request_queue @bio is being submitted to
+ * @bio: the bio
+ *
+ * Waits until the cgroup of @bio and all of its ancestors may have another
+ * request in flight on @q and charges one to each.  Returns the blkg to be
+ * passed to blk_iolatency_track() or blk_iolatency_cancel(), with a
+ * reference held, or %NULL if the request doesn't need tracking.  May
+ * sleep.
+ */
+struct blkcg_gq *blk_iolatency_throttle(struct request_queue *q,
+					struct bio *bio)
+{
+	struct iolatency_grp *root;
+	struct blkcg_gq *blkg, *pos;
+	struct blkcg *blkcg;
+
+	rcu_read_lock();
+	root = blkg_to_iolat(q->root_blkg);
+	if (!root || !atomic_read(&root->nr_targets))
+		goto out_unlock;
+
+	blkcg = bio_blkcg(bio);
+	blkg = blkg_lookup(blkcg, q);
+	if (unlikely(!blkg)) {
+		spin_lock_irq(q->queue_lock);
+		blkg = blkg_lookup_create(blkcg, q);
+		if (IS_ERR(blkg))
+			blkg = NULL;
+		spin_unlock_irq(q->queue_lock);
+	}
+	/* the blkg may be on its way out, don't bother tracking then */
+	if (!blkg || !blkg->parent || !atomic_inc_not_zero(&blkg->refcnt))
+		goto out_unlock;
+	rcu_read_unlock();
+
+	/* a blkg holds a reference on its parent */
+	for (pos = blkg; pos->parent; pos = pos->parent) {
+		struct iolatency_grp *iolat = blkg_to_iolat(pos);
+
+		iolatency_check_scale(iolat);
+		io_wait_event(iolat->wait,
+			      iolatency_inc_below(&iolat->inflight,
+						  READ_ONCE(iolat->max_depth)));
+	}
+	return blkg;
+
+out_unlock:
+	rcu_read_unlock();
+	return NULL;
+}
+
+/**
+ * blk_iolatency_cancel - undo blk_iolatency_throttle()
+ * @blkg: the blkg it returned
+ *
+ * For when no request could be allocated for the bio.
+ */
+void blk_iolatency_cancel(struct blkcg_gq *blkg)
+{
+	struct blkcg_gq *pos;
+
+	if (!blkg)
+		return;
+
+	for (pos = blkg; pos->parent; pos = pos->parent)
+		iolatency_release(blkg_to_iolat(pos));
+	blkg_put(blkg);
+}
+
+/**
+ * blk_iolatency_done - account the end of a tracked request
+ * @rq: the request being freed
+ *
+ * Releases @rq's charge on its groups and, if it was issued to the
+ * driver, records its latency.  Requests freed without having been
+ * issued, e.g. after their bio got merged into another one, don't count.
+ */
+void blk_iolatency_done(struct request *rq)
+{
+	struct blkcg_gq *blkg = rq->iolat_blkg;
+	struct blkcg_gq *pos;
+	bool issued;
+	u64 now = 0;
+
+	if (!blkg)
+		return;
+	rq->iolat_blkg = NULL;
+
+	issued = test_bit(REQ_ATOM_STARTED, &rq->atomic_flags);
+	if (issued)
+		now = ktime_get_ns();
+
+	for (pos = blkg; pos->parent; pos = pos->parent) {
+		struct iolatency_grp *iolat = blkg_to_iolat(pos);
+
+		iolatency_release(iolat);
+		if (issued && iolat->min_lat_nsec)
+			iolatency_record(iolat, now - rq->iolat_start_ns, now);
+	}
+	blkg_put(blkg);
+}
+
+/* Recalculates the tightest target among the children of @blkg */
+static void iolatency_update_child_min(struct blkcg_gq *blkg)
+{
+	struct iolatency_grp *iolat = blkg_to_iolat(blkg);
+	struct cgroup_subsys_state *pos_css;
+	struct blkcg_gq *child;
+	u64 min_lat = 0;
+
+	rcu_read_lock();
+	blkg_for_each_descendant_pre(child, pos_css, blkg) {
+		u64 lat;
+
+		if (child == blkg)
+			continue;
+		/* only the direct children count, skip their subtrees */
+		pos_css = css_rightmost_descendant(pos_css);
+
+		lat = blkg_to_iolat(child)->min_lat_nsec;
+		if (lat && (!min_lat || lat < min_lat))
+			min_lat = lat;
+	}
+	rcu_read_unlock();
+
+	WRITE_ONCE(iolat->child_min_lat_nsec, min_lat);
+}
+
+/* Called with the queue lock held */
+static void iolatency_set_target(struct iolatency_grp *iolat, u64 lat_nsec)
+{
+	struct blkcg_gq *blkg = iolat_to_blkg(iolat);
+	struct iolatency_grp *root = blkg_to_iolat(blkg->q->root_blkg);
+	struct iolatency_grp *parent = blkg_to_iolat(blkg->parent);
+
+	if (!iolat->min_lat_nsec != !lat_nsec && root) {
+		if (lat_nsec)
+			atomic_inc(&root->nr_targets);
+		else
+			atomic_dec(&root->nr_targets);
+	}
+
+	iolat->min_lat_nsec = lat_nsec;
+	iolat->cur_win_nsec = clamp_t(u64, lat_nsec * 16, MIN_WINDOW_NSEC,
+				      MAX_WINDOW_NSEC);
+	atomic_set(&iolat->lat_nr, 0);
+	atomic64_set(&iolat->lat_total, 0);
+	atomic64_set(&iolat->window_start, ktime_get_ns());
+
+	if (!parent)
+		return;
+	iolatency_update_child_min(blkg->parent);
+	/* start over with all the siblings unthrottled */
+	atomic_set(&parent->scale_cookie, DEFAULT_SCALE_COOKIE);
+}
+
+static void iolatency_pd_init(struct blkcg_gq *blkg)
+{
+	struct iolatency_grp *iolat = blkg_to_iolat(blkg);
+
+	iolat->min_lat_nsec = 0;
+	iolat->cur_win_nsec = MIN_WINDOW_NSEC;
+	atomic64_set(&iolat->window_start, ktime_get_ns());
+	atomic64_set(&iolat->lat_total, 0);
+	atomic_set(&iolat->lat_nr, 0);
+	iolat->nr_missed = 0;
+
+	atomic_set(&iolat->inflight, 0);
+	iolat->max_depth = UINT_MAX;
+	init_waitqueue_head(&iolat->wait);
+
+	atomic_set(&iolat->scale_cookie, DEFAULT_SCALE_COOKIE);
+	iolat->last_scale_nsec = 0;
+	iolat->child_min_lat_nsec = 0;
+	iolat->last_scale_cookie = DEFAULT_SCALE_COOKIE;
+	atomic_set(&iolat->nr_targets, 0);
+}
+
+static void iolatency_pd_offline(struct blkcg_gq *blkg)
+{
+	struct iolatency_grp *iolat = blkg_to_iolat(blkg);
+
+	if (blkg->parent && iolat->min_lat_nsec)
+		iolatency_set_target(iolat, 0);
+
+	/* whoever still waits for this group shouldn't wait any longer */
+	iolat->max_depth = UINT_MAX;
+	wake_up_all(&iolat->wait);
+}
+
+static void iolatency_pd_reset_stats(struct blkcg_gq *blkg)
+{
+	blkg_to_iolat(blkg)->nr_missed = 0;
+}
+
+static u64 iolatency_prfill_target(struct seq_file *sf,
+				   struct blkg_policy_data *pd, int off)
+{
+	struct iolatency_grp *iolat = pd_to_iolat(pd);
+
+	if (!iolat->min_lat_nsec)
+		return 0;
+	return __blkg_prfill_u64(sf, pd, div_u64(iolat->min_lat_nsec,
+						 NSEC_PER_USEC));
+}
+
+static u64 iolatency_prfill_missed(struct seq_file *sf,
+				   struct blkg_policy_data *pd, int off)
+{
+	return __blkg_prfill_u64(sf, pd, pd_to_iolat(pd)->nr_missed);
+}
+
+static int iolatency_print_target(struct seq_file *sf, void *v)
+{
+	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)),
+			  iolatency_prfill_target, &blkcg_policy_iolatency,
+			  0, false);
+	return 0;
+}
+
+static int iolatency_print_missed(struct seq_file *sf, void *v)
+{
+	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)),
+			  iolatency_prfill_missed, &blkcg_policy_iolatency,
+			  0, false);
+	return 0;
+}
+
+static ssize_t iolatency_set_target_conf(struct kernfs_open_file *of,
+					 char *buf, size_t nbytes, loff_t off)
+{
+	struct blkcg *blkcg = css_to_blkcg(of_css(of));
+	struct blkg_conf_ctx ctx;
+	int ret;
+
+	ret = blkg_conf_prep(blkcg, &blkcg_policy_iolatency, buf, &ctx);
+	if (ret)
+		return ret;
+
+	/* the root has no siblings to throttle for it */
+	ret = -EINVAL;
+	if (!ctx.blkg->parent)
+		goto out_finish;
+	/* requests are only tracked on blk-mq queues */
+	ret = -EOPNOTSUPP;
+	if (!ctx.disk->queue->mq_ops)
+		goto out_finish;
+
+	iolatency_set_target(blkg_to_iolat(ctx.blkg),
+			     ctx.v * NSEC_PER_USEC);
+	ret = 0;
+
+out_finish:
+	blkg_conf_finish(&ctx);
+	return ret ?: nbytes;
+}
+
+static struct cftype iolatency_files[] = {
+	{
+		.name = "latency",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = iolatency_print_target,
+		.write = iolatency_set_target_conf,
+	},
+	{
+		.name = "latency.missed",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = iolatency_print_missed,
+	},
+	{ }	/* terminate */
+};
+
+static struct blkcg_policy blkcg_policy_iolatency = {
+	.pd_size		= sizeof(struct iolatency_grp),
+	.cftypes		= iolatency_files,
+
+	.pd_init_fn		= iolatency_pd_init,
+	.pd_offline_fn		= iolatency_pd_offline,
+	.pd_reset_stats_fn	= iolatency_pd_reset_stats,
+};
+
+int blk_iolatency_init(struct request_queue *q)
+{
+	return blkcg_activate_policy(q, &blkcg_policy_iolatency);
+}
+
+void blk_iolatency_exit(struct request_queue *q)
+{
+	blkcg_deactivate_policy(q, &blkcg_policy_iolatency);
+}
+
+static int __init iolatency_init(void)
+{
+	return blkcg_policy_register(&blkcg_policy_iolatency);
+}
+
+module_init(iolatency_init);
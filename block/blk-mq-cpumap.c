@@ -85,6 +85,18 @@ int blk_mq_update_queue_map(unsigned int *map, unsigned int nr_queues)
 	return 0;
 }
 
+/*
+ * Let the driver map the queues if it knows better, typically from the
+ * irq affinity of its completion vectors.
+ */
+int blk_mq_map_queues(struct blk_mq_tag_set *set, unsigned int *map)
+{
+	if (set->ops->map_queues && !set->ops->map_queues(set, map))
+		return 0;
+
+	return blk_mq_update_queue_map(map, set->nr_hw_queues);
+}
+
 unsigned int *blk_mq_make_queue_map(struct blk_mq_tag_set *set)
 {
 	unsigned int *map;
@@ -95,7 +107,7 @@ unsigned int *blk_mq_make_queue_map(struct blk_mq_tag_set *set)
 	if (!map)
 		return NULL;
 
-	if (!blk_mq_update_queue_map(map, set->nr_hw_queues))
+	if (!blk_mq_map_queues(set, map))
 		return map;
 
 	kfree(map);
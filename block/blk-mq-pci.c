@@ -0,0 +1,46 @@
+/*
+ * CPU <-> hardware queue mapping from the MSI-X affinity of PCI devices
+ *
+ * This file is licensed under GPLv2.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blk-mq.h>
+#include <linux/blk-mq-pci.h>
+#include <linux/pci.h>
+
+/**
+ * blk_mq_pci_map_queues - provide a default queue mapping for PCI device
+ * @set:	tagset to provide the mapping for
+ * @pdev:	PCI device associated with @set.
+ * @map:	cpu -> hardware queue map to fill in
+ *
+ * This function assumes the PCI device @pdev has at least as many available
+ * interrupt vectors as @set has queues, that hardware queue N completes on
+ * vector N, and that the vectors were spread with
+ * pci_enable_msix_range_affinity().  It maps each cpu to the queue whose
+ * vector is affine to it, so submission and completion happen on the same
+ * cpus.
+ */
+int blk_mq_pci_map_queues(struct blk_mq_tag_set *set, struct pci_dev *pdev,
+			  unsigned int *map)
+{
+	const struct cpumask *mask;
+	unsigned int queue, cpu;
+
+	/* cpus not covered by any of the queues go to the first one */
+	for_each_possible_cpu(cpu)
+		map[cpu] = 0;
+
+	for (queue = 0; queue < set->nr_hw_queues; queue++) {
+		mask = pci_irq_get_affinity(pdev, queue);
+		if (!mask)
+			return -EINVAL;
+
+		for_each_cpu(cpu, mask)
+			map[cpu] = queue;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(blk_mq_pci_map_queues);
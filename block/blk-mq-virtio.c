@@ -0,0 +1,51 @@
+/*
+ * CPU <-> hardware queue mapping from the virtqueue affinity of virtio
+ * devices
+ *
+ * This file is licensed under GPLv2.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blk-mq.h>
+#include <linux/blk-mq-virtio.h>
+#include <linux/virtio_config.h>
+
+/**
+ * blk_mq_virtio_map_queues - provide a default queue mapping for virtio device
+ * @set:	tagset to provide the mapping for
+ * @vdev:	virtio device associated with @set.
+ * @map:	cpu -> hardware queue map to fill in
+ * @first_vec:	first interrupt vectors to use for queues (usually 0)
+ *
+ * This function assumes the virtio device @vdev has at least as many
+ * virtqueues as @set has queues, starting at virtqueue @first_vec, and
+ * that their interrupts were spread by passing a struct irq_affinity to
+ * find_vqs().  It maps each cpu to the queue whose interrupt is affine to
+ * it.
+ */
+int blk_mq_virtio_map_queues(struct blk_mq_tag_set *set,
+			     struct virtio_device *vdev, unsigned int *map,
+			     int first_vec)
+{
+	const struct cpumask *mask;
+	unsigned int queue, cpu;
+
+	if (!vdev->config->get_vq_affinity)
+		return -EINVAL;
+
+	/* cpus not covered by any of the queues go to the first one */
+	for_each_possible_cpu(cpu)
+		map[cpu] = 0;
+
+	for (queue = 0; queue < set->nr_hw_queues; queue++) {
+		mask = vdev->config->get_vq_affinity(vdev, first_vec + queue);
+		if (!mask)
+			return -EINVAL;
+
+		for_each_cpu(cpu, mask)
+			map[cpu] = queue;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(blk_mq_virtio_map_queues);
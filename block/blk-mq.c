@@ -201,6 +201,12 @@ static void blk_mq_rq_ctx_init(struct request_queue *q, struct blk_mq_ctx *ctx,
 	rq->rl = NULL;
 	set_start_time_ns(rq);
 	rq->io_start_time_ns = 0;
+#endif
+#ifdef CONFIG_BLK_CGROUP_IOLATENCY
+	rq->iolat_blkg = NULL;
+#endif
+#ifdef CONFIG_BLK_CGROUP_IOCOST
+	rq->iocost_start_ns = 0;
 #endif
 	rq->nr_phys_segments = 0;
 #if defined(CONFIG_BLK_DEV_INTEGRITY)
@@ -295,6 +301,9 @@ static void __blk_mq_free_request(struct blk_mq_hw_ctx *hctx,
 	const int tag = rq->tag;
 	struct request_queue *q = rq->q;
 
+	blk_iocost_done(rq);
+	blk_iolatency_done(rq);
+
 	if (rq->cmd_flags & REQ_MQ_INFLIGHT)
 		atomic_dec(&hctx->nr_active);
 	rq->cmd_flags = 0;
@@ -1247,6 +1256,8 @@ static void blk_mq_make_request(struct request_queue *q, struct bio *bio)
 	const int is_sync = rw_is_sync(bio->bi_rw);
 	const int is_flush_fua = bio->bi_rw & (REQ_FLUSH | REQ_FUA);
 	struct blk_map_ctx data;
+	struct blkcg_gq *iolat_blkg;
+	bool iocost_tracked;
 	struct request *rq;
 
 	blk_queue_bounce(q, &bio);
@@ -1256,9 +1267,16 @@ static void blk_mq_make_request(struct request_queue *q, struct bio *bio)
 		return;
 	}
 
+	iocost_tracked = blk_iocost_throttle(q, bio);
+	iolat_blkg = blk_iolatency_throttle(q, bio);
+
 	rq = blk_mq_map_request(q, bio, &data);
-	if (unlikely(!rq))
+	if (unlikely(!rq)) {
+		blk_iolatency_cancel(iolat_blkg);
 		return;
+	}
+	blk_iocost_track(rq, iocost_tracked);
+	blk_iolatency_track(rq, iolat_blkg);
 
 	if (unlikely(is_flush_fua)) {
 		blk_mq_bio_to_request(rq, bio);
@@ -1324,6 +1342,8 @@ static void blk_sq_make_request(struct request_queue *q, struct bio *bio)
 	const int is_flush_fua = bio->bi_rw & (REQ_FLUSH | REQ_FUA);
 	unsigned int use_plug, request_count = 0;
 	struct blk_map_ctx data;
+	struct blkcg_gq *iolat_blkg;
+	bool iocost_tracked;
 	struct request *rq;
 
 	/*
@@ -1343,9 +1363,16 @@ static void blk_sq_make_request(struct request_queue *q, struct bio *bio)
 	    blk_attempt_plug_merge(q, bio, &request_count))
 		return;
 
+	iocost_tracked = blk_iocost_throttle(q, bio);
+	iolat_blkg = blk_iolatency_throttle(q, bio);
+
 	rq = blk_mq_map_request(q, bio, &data);
-	if (unlikely(!rq))
+	if (unlikely(!rq)) {
+		blk_iolatency_cancel(iolat_blkg);
 		return;
+	}
+	blk_iocost_track(rq, iocost_tracked);
+	blk_iolatency_track(rq, iolat_blkg);
 
 	if (unlikely(is_flush_fua)) {
 		blk_mq_bio_to_request(rq, bio);
@@ -2060,7 +2087,7 @@ static void blk_mq_queue_reinit(struct request_queue *q)
 
 	blk_mq_sysfs_unregister(q);
 
-	blk_mq_update_queue_map(q->mq_map, q->nr_hw_queues);
+	blk_mq_map_queues(q->tag_set, q->mq_map);
 
 	/*
 	 * redo blk_mq_init_cpu_queues and blk_mq_init_hw_queues. FIXME: maybe
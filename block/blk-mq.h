@@ -52,6 +52,7 @@ void blk_mq_disable_hotplug(void);
  */
 extern unsigned int *blk_mq_make_queue_map(struct blk_mq_tag_set *set);
 extern int blk_mq_update_queue_map(unsigned int *map, unsigned int nr_queues);
+extern int blk_mq_map_queues(struct blk_mq_tag_set *set, unsigned int *map);
 extern int blk_mq_hw_queue_to_node(unsigned int *map, unsigned int);
 
 /*
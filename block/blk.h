@@ -281,4 +281,62 @@ static inline int blk_throtl_init(struct request_queue *q) { return 0; }
 static inline void blk_throtl_exit(struct request_queue *q) { }
 #endif /* CONFIG_BLK_DEV_THROTTLING */
 
+/*
+ * Internal IO latency target interface
+ */
+#ifdef CONFIG_BLK_CGROUP_IOLATENCY
+extern struct blkcg_gq *blk_iolatency_throttle(struct request_queue *q,
+					       struct bio *bio);
+extern void blk_iolatency_cancel(struct blkcg_gq *blkg);
+extern void blk_iolatency_done(struct request *rq);
+extern int blk_iolatency_init(struct request_queue *q);
+extern void blk_iolatency_exit(struct request_queue *q);
+
+static inline void blk_iolatency_track(struct request *rq,
+				       struct blkcg_gq *blkg)
+{
+	rq->iolat_blkg = blkg;
+	if (blkg)
+		rq->iolat_start_ns = ktime_get_ns();
+}
+#else /* CONFIG_BLK_CGROUP_IOLATENCY */
+static inline struct blkcg_gq *blk_iolatency_throttle(struct request_queue *q,
+						      struct bio *bio)
+{
+	return NULL;
+}
+static inline void blk_iolatency_cancel(struct blkcg_gq *blkg) { }
+static inline void blk_iolatency_done(struct request *rq) { }
+static inline int blk_iolatency_init(struct request_queue *q) { return 0; }
+static inline void blk_iolatency_exit(struct request_queue *q) { }
+static inline void blk_iolatency_track(struct request *rq,
+				       struct blkcg_gq *blkg) { }
+#endif /* CONFIG_BLK_CGROUP_IOLATENCY */
+
+/*
+ * Internal IO cost control interface
+ */
+#ifdef CONFIG_BLK_CGROUP_IOCOST
+extern bool blk_iocost_throttle(struct request_queue *q, struct bio *bio);
+extern void blk_iocost_done(struct request *rq);
+extern int blk_iocost_init(struct request_queue *q);
+extern void blk_iocost_exit(struct request_queue *q);
+
+static inline void blk_iocost_track(struct request *rq, bool tracked)
+{
+	if (tracked)
+		rq->iocost_start_ns = ktime_get_ns();
+}
+#else /* CONFIG_BLK_CGROUP_IOCOST */
+static inline bool blk_iocost_throttle(struct request_queue *q,
+				       struct bio *bio)
+{
+	return false;
+}
+static inline void blk_iocost_done(struct request *rq) { }
+static inline int blk_iocost_init(struct request_queue *q) { return 0; }
+static inline void blk_iocost_exit(struct request_queue *q) { }
+static inline void blk_iocost_track(struct request *rq, bool tracked) { }
+#endif /* CONFIG_BLK_CGROUP_IOCOST */
+
 #endif /* BLK_INTERNAL_H */
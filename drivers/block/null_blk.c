@@ -37,6 +37,10 @@ struct nullb {
 	unsigned int queue_depth;
 	spinlock_t lock;
 
+	/* commands waiting for completion with serial_completion */
+	spinlock_t serial_lock;
+	struct list_head serial_list;
+
 	struct nullb_queue *queues;
 	unsigned int nr_queues;
 };
@@ -139,6 +143,10 @@ static int completion_nsec = 10000;
 module_param(completion_nsec, int, S_IRUGO);
 MODULE_PARM_DESC(completion_nsec, "Time in ns to complete a request in hardware. Default: 10,000ns");
 
+static bool serial_completion;
+module_param(serial_completion, bool, S_IRUGO);
+MODULE_PARM_DESC(serial_completion, "With the timer irqmode, complete the requests of a device one at a time, each taking completion_nsec. Default: false");
+
 static int hw_queue_depth = 64;
 module_param(hw_queue_depth, int, S_IRUGO);
 MODULE_PARM_DESC(hw_queue_depth, "Queue depth for each hardware queue. Default: 64");
@@ -263,6 +271,55 @@ static void null_cmd_end_timer(struct nullb_cmd *cmd)
 	put_cpu();
 }
 
+static struct nullb *cmd_to_nullb(struct nullb_cmd *cmd)
+{
+	if (queue_mode == NULL_Q_BIO)
+		return cmd->bio->bi_bdev->bd_disk->private_data;
+	return cmd->rq->q->queuedata;
+}
+
+/*
+ * Serial completion makes a device behave like one that services a single
+ * request at a time: the latency of a request grows with the number of
+ * requests queued ahead of it.
+ */
+static enum hrtimer_restart null_serial_timer_expired(struct hrtimer *timer)
+{
+	struct nullb *nullb = container_of(timer, struct nullb, timer);
+	struct nullb_cmd *cmd;
+	unsigned long flags;
+	bool more;
+
+	spin_lock_irqsave(&nullb->serial_lock, flags);
+	cmd = list_first_entry(&nullb->serial_list, struct nullb_cmd, list);
+	list_del_init(&cmd->list);
+	more = !list_empty(&nullb->serial_list);
+	spin_unlock_irqrestore(&nullb->serial_lock, flags);
+
+	end_cmd(cmd);
+
+	if (!more)
+		return HRTIMER_NORESTART;
+	hrtimer_forward_now(timer, ktime_set(0, completion_nsec));
+	return HRTIMER_RESTART;
+}
+
+static void null_cmd_end_serial(struct nullb_cmd *cmd)
+{
+	struct nullb *nullb = cmd_to_nullb(cmd);
+	unsigned long flags;
+	bool first;
+
+	spin_lock_irqsave(&nullb->serial_lock, flags);
+	first = list_empty(&nullb->serial_list);
+	list_add_tail(&cmd->list, &nullb->serial_list);
+	spin_unlock_irqrestore(&nullb->serial_lock, flags);
+
+	if (first)
+		hrtimer_start(&nullb->timer, ktime_set(0, completion_nsec),
+			      HRTIMER_MODE_REL);
+}
+
 static void null_softirq_done_fn(struct request *rq)
 {
 	if (queue_mode == NULL_Q_MQ)
@@ -295,7 +352,10 @@ static inline void null_handle_cmd(struct nullb_cmd *cmd)
 		end_cmd(cmd);
 		break;
 	case NULL_IRQ_TIMER:
-		null_cmd_end_timer(cmd);
+		if (serial_completion)
+			null_cmd_end_serial(cmd);
+		else
+			null_cmd_end_timer(cmd);
 		break;
 	}
 }
@@ -400,6 +460,7 @@ static void null_del_dev(struct nullb *nullb)
 
 	del_gendisk(nullb->disk);
 	blk_cleanup_queue(nullb->q);
+	hrtimer_cancel(&nullb->timer);
 	if (queue_mode == NULL_Q_MQ)
 		blk_mq_free_tag_set(&nullb->tag_set);
 	put_disk(nullb->disk);
@@ -508,6 +569,10 @@ static int null_add_dev(void)
 	}
 
 	spin_lock_init(&nullb->lock);
+	spin_lock_init(&nullb->serial_lock);
+	INIT_LIST_HEAD(&nullb->serial_list);
+	hrtimer_init(&nullb->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	nullb->timer.function = null_serial_timer_expired;
 
 	if (queue_mode == NULL_Q_MQ && use_per_node_hctx)
 		submit_queues = nr_online_nodes;
@@ -16,6 +16,7 @@
 #include <linux/bitops.h>
 #include <linux/blkdev.h>
 #include <linux/blk-mq.h>
+#include <linux/blk-mq-pci.h>
 #include <linux/cpu.h>
 #include <linux/delay.h>
 #include <linux/errno.h>
@@ -1558,9 +1559,18 @@ static struct blk_mq_ops nvme_mq_admin_ops = {
 	.timeout	= nvme_timeout,
 };
 
+/* I/O queue N completes on vector N - 1, hardware context N - 1 */
+static int nvme_pci_map_queues(struct blk_mq_tag_set *set, unsigned int *map)
+{
+	struct nvme_dev *dev = set->driver_data;
+
+	return blk_mq_pci_map_queues(set, dev->pci_dev, map);
+}
+
 static struct blk_mq_ops nvme_mq_ops = {
 	.queue_rq	= nvme_queue_rq,
 	.map_queue	= blk_mq_map_queue,
+	.map_queues	= nvme_pci_map_queues,
 	.init_hctx	= nvme_init_hctx,
 	.exit_hctx	= nvme_exit_hctx,
 	.init_request	= nvme_init_request,
@@ -2207,6 +2217,7 @@ static int nvme_setup_io_queues(struct nvme_dev *dev)
 {
 	struct nvme_queue *adminq = dev->queues[0];
 	struct pci_dev *pdev = dev->pci_dev;
+	struct irq_affinity affd = { 0, };
 	int result, i, vecs, nr_io_queues, size;
 
 	nr_io_queues = num_possible_cpus();
@@ -2243,7 +2254,8 @@ static int nvme_setup_io_queues(struct nvme_dev *dev)
 
 	for (i = 0; i < nr_io_queues; i++)
 		dev->entry[i].entry = i;
-	vecs = pci_enable_msix_range(pdev, dev->entry, 1, nr_io_queues);
+	vecs = pci_enable_msix_range_affinity(pdev, dev->entry, 1, nr_io_queues,
+					      &affd);
 	if (vecs < 0) {
 		vecs = pci_enable_msi_range(pdev, 1, min(nr_io_queues, 32));
 		if (vecs < 0) {
@@ -2808,6 +2820,10 @@ static void nvme_set_irq_hints(struct nvme_dev *dev)
 		if (!nvmeq->hctx)
 			continue;
 
+		/* Spread vectors already have their affinity */
+		if (pci_irq_get_affinity(dev->pci_dev, nvmeq->cq_vector))
+			continue;
+
 		irq_set_affinity_hint(dev->entry[nvmeq->cq_vector].vector,
 							nvmeq->hctx->cpumask);
 	}
@@ -152,6 +152,9 @@ void dbs_check_cpu(struct dbs_data *dbs_data, int cpu)
 			j_cdbs->prev_load = load;
 		}
 
+		/* honour the utilization clamps of the tasks on j */
+		load = uclamp_cpu_load(j, load);
+
 		if (load > max_load)
 			max_load = load;
 	}
@@ -26,6 +26,7 @@
 #include <linux/if_vlan.h>
 #include <linux/slab.h>
 #include <linux/cpu.h>
+#include <linux/interrupt.h>
 #include <linux/average.h>
 #include <net/busy_poll.h>
 
@@ -1252,8 +1253,8 @@ static void virtnet_clean_affinity(struct virtnet_info *vi, long hcpu)
 
 	if (vi->affinity_hint_set) {
 		for (i = 0; i < vi->max_queue_pairs; i++) {
-			virtqueue_set_affinity(vi->rq[i].vq, -1);
-			virtqueue_set_affinity(vi->sq[i].vq, -1);
+			virtqueue_set_affinity(vi->rq[i].vq, NULL);
+			virtqueue_set_affinity(vi->sq[i].vq, NULL);
 		}
 
 		vi->affinity_hint_set = false;
@@ -1262,26 +1263,31 @@ static void virtnet_clean_affinity(struct virtnet_info *vi, long hcpu)
 
 static void virtnet_set_affinity(struct virtnet_info *vi)
 {
+	struct irq_affinity desc = { 0 };
+	struct cpumask *masks;
 	int i;
-	int cpu;
 
-	/* In multiqueue mode, when the number of cpu is equal to the number of
-	 * queue pairs, we let the queue pairs to be private to one cpu by
-	 * setting the affinity hint to eliminate the contention.
+	if (vi->curr_queue_pairs == 1) {
+		virtnet_clean_affinity(vi, -1);
+		return;
+	}
+
+	/* In multiqueue mode, spread the queue pairs over the cpus, NUMA
+	 * node by NUMA node, and have each cpu transmit on the pair whose
+	 * interrupts it handles, so a flow stays on the same cpus.
 	 */
-	if (vi->curr_queue_pairs == 1 ||
-	    vi->max_queue_pairs != num_online_cpus()) {
+	masks = irq_create_affinity_masks(vi->curr_queue_pairs, &desc);
+	if (!masks) {
 		virtnet_clean_affinity(vi, -1);
 		return;
 	}
 
-	i = 0;
-	for_each_online_cpu(cpu) {
-		virtqueue_set_affinity(vi->rq[i].vq, cpu);
-		virtqueue_set_affinity(vi->sq[i].vq, cpu);
-		netif_set_xps_queue(vi->dev, cpumask_of(cpu), i);
-		i++;
+	for (i = 0; i < vi->curr_queue_pairs; i++) {
+		virtqueue_set_affinity(vi->rq[i].vq, &masks[i]);
+		virtqueue_set_affinity(vi->sq[i].vq, &masks[i]);
+		netif_set_xps_queue(vi->dev, &masks[i], i);
 	}
+	kfree(masks);
 
 	vi->affinity_hint_set = true;
 }
@@ -1565,7 +1571,7 @@ static int virtnet_find_vqs(struct virtnet_info *vi)
 	}
 
 	ret = vi->vdev->config->find_vqs(vi->vdev, total_vqs, vqs, callbacks,
-					 names);
+					 names, NULL);
 	if (ret)
 		goto err_find;
 
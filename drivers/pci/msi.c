@@ -20,6 +20,8 @@
 #include <linux/io.h>
 #include <linux/slab.h>
 #include <linux/irqdomain.h>
+#include <linux/cpu.h>
+#include <linux/mutex.h>
 
 #include "pci.h"
 
@@ -403,6 +405,7 @@ static void free_msi_irqs(struct pci_dev *dev)
 		}
 
 		list_del(&entry->list);
+		kfree(entry->affinity);
 		kfree(entry);
 	}
 
@@ -711,18 +714,32 @@ static void __iomem *msix_map_region(struct pci_dev *dev, unsigned nr_entries)
 }
 
 static int msix_setup_entries(struct pci_dev *dev, void __iomem *base,
-			      struct msix_entry *entries, int nvec)
+			      struct msix_entry *entries, int nvec,
+			      const struct irq_affinity *affd)
 {
+	struct cpumask *masks = NULL;
 	struct msi_desc *entry;
 	int i;
 
+	if (affd)
+		masks = irq_create_affinity_masks(nvec, affd);
+
 	for (i = 0; i < nvec; i++) {
 		entry = alloc_msi_entry(dev);
+		if (entry && masks) {
+			entry->affinity = kmemdup(&masks[i], sizeof(*masks),
+						  GFP_KERNEL);
+			if (!entry->affinity) {
+				kfree(entry);
+				entry = NULL;
+			}
+		}
 		if (!entry) {
 			if (!i)
 				iounmap(base);
 			else
 				free_msi_irqs(dev);
+			kfree(masks);
 			/* No enough memory. Don't try again */
 			return -ENOMEM;
 		}
@@ -737,6 +754,7 @@ static int msix_setup_entries(struct pci_dev *dev, void __iomem *base,
 		list_add_tail(&entry->list, &dev->msi_list);
 	}
 
+	kfree(masks);
 	return 0;
 }
 
@@ -757,18 +775,87 @@ static void msix_program_entries(struct pci_dev *dev,
 	}
 }
 
+/*
+ * Apply the spread affinity right away, request_irq() leaves an affinity
+ * which was set before it alone.  The irq chips refuse a mask without any
+ * online cpu, such an irq stays on the default affinity until one of its
+ * cpus comes up and msix_affinity_cpu_callback() applies the mask.
+ */
+static void msix_apply_affinity(struct pci_dev *dev)
+{
+	struct msi_desc *entry;
+
+	list_for_each_entry(entry, &dev->msi_list, list) {
+		if (entry->affinity &&
+		    cpumask_intersects(entry->affinity, cpu_online_mask))
+			irq_set_affinity(entry->irq, entry->affinity);
+	}
+}
+
+/* Serializes the walk in the cpu callback against enabling/disabling MSI-X */
+static DEFINE_MUTEX(msix_affinity_mutex);
+
+static void msix_set_enabled(struct pci_dev *dev, int enabled)
+{
+	mutex_lock(&msix_affinity_mutex);
+	dev->msix_enabled = enabled;
+	mutex_unlock(&msix_affinity_mutex);
+}
+
+/*
+ * Apply the masks which had no online cpu so far, and only those: an irq
+ * whose mask was applied before may have been moved by the admin since.
+ */
+static int msix_affinity_cpu_callback(struct notifier_block *nfb,
+				      unsigned long action, void *hcpu)
+{
+	unsigned int cpu = (unsigned long)hcpu;
+	struct pci_dev *dev = NULL;
+	struct msi_desc *entry;
+
+	if ((action & ~CPU_TASKS_FROZEN) != CPU_ONLINE)
+		return NOTIFY_OK;
+
+	for_each_pci_dev(dev) {
+		mutex_lock(&msix_affinity_mutex);
+		if (!dev->msix_enabled)
+			goto next;
+		list_for_each_entry(entry, &dev->msi_list, list) {
+			if (!entry->affinity ||
+			    cpumask_first_and(entry->affinity,
+					      cpu_online_mask) != cpu ||
+			    cpumask_next_and(cpu, entry->affinity,
+					     cpu_online_mask) < nr_cpu_ids)
+				continue;
+			irq_set_affinity(entry->irq, entry->affinity);
+		}
+next:
+		mutex_unlock(&msix_affinity_mutex);
+	}
+	return NOTIFY_OK;
+}
+
+static int __init pci_msix_affinity_init(void)
+{
+	hotcpu_notifier(msix_affinity_cpu_callback, 0);
+	return 0;
+}
+subsys_initcall(pci_msix_affinity_init);
+
 /**
  * msix_capability_init - configure device's MSI-X capability
  * @dev: pointer to the pci_dev data structure of MSI-X device function
  * @entries: pointer to an array of struct msix_entry entries
  * @nvec: number of @entries
+ * @affd: optional description of the affinity requirements
  *
  * Setup the MSI-X capability structure of device function with a
  * single MSI-X irq. A return of zero indicates the successful setup of
  * requested MSI-X entries with allocated irqs or non-zero for otherwise.
  **/
 static int msix_capability_init(struct pci_dev *dev,
-				struct msix_entry *entries, int nvec)
+				struct msix_entry *entries, int nvec,
+				const struct irq_affinity *affd)
 {
 	int ret;
 	u16 control;
@@ -783,7 +870,7 @@ static int msix_capability_init(struct pci_dev *dev,
 	if (!base)
 		return -ENOMEM;
 
-	ret = msix_setup_entries(dev, base, entries, nvec);
+	ret = msix_setup_entries(dev, base, entries, nvec, affd);
 	if (ret)
 		return ret;
 
@@ -805,6 +892,7 @@ static int msix_capability_init(struct pci_dev *dev,
 				PCI_MSIX_FLAGS_MASKALL | PCI_MSIX_FLAGS_ENABLE);
 
 	msix_program_entries(dev, entries);
+	msix_apply_affinity(dev);
 
 	ret = populate_msi_sysfs(dev);
 	if (ret)
@@ -812,7 +900,7 @@ static int msix_capability_init(struct pci_dev *dev,
 
 	/* Set MSI-X enabled bits and unmask the function */
 	pci_intx_for_msi(dev, 0);
-	dev->msix_enabled = 1;
+	msix_set_enabled(dev, 1);
 
 	msix_clear_and_set_ctrl(dev, PCI_MSIX_FLAGS_MASKALL, 0);
 
@@ -977,7 +1065,8 @@ EXPORT_SYMBOL(pci_msix_vec_count);
  * of irqs or MSI-X vectors available. Driver should use the returned value to
  * re-send its request.
  **/
-int pci_enable_msix(struct pci_dev *dev, struct msix_entry *entries, int nvec)
+static int __pci_enable_msix(struct pci_dev *dev, struct msix_entry *entries,
+			     int nvec, const struct irq_affinity *affd)
 {
 	int nr_entries;
 	int i, j;
@@ -1010,7 +1099,12 @@ int pci_enable_msix(struct pci_dev *dev, struct msix_entry *entries, int nvec)
 		dev_info(&dev->dev, "can't enable MSI-X (MSI IRQ already assigned)\n");
 		return -EINVAL;
 	}
-	return msix_capability_init(dev, entries, nvec);
+	return msix_capability_init(dev, entries, nvec, affd);
+}
+
+int pci_enable_msix(struct pci_dev *dev, struct msix_entry *entries, int nvec)
+{
+	return __pci_enable_msix(dev, entries, nvec, NULL);
 }
 EXPORT_SYMBOL(pci_enable_msix);
 
@@ -1029,7 +1123,7 @@ void pci_msix_shutdown(struct pci_dev *dev)
 
 	msix_clear_and_set_ctrl(dev, PCI_MSIX_FLAGS_ENABLE, 0);
 	pci_intx_for_msi(dev, 1);
-	dev->msix_enabled = 0;
+	msix_set_enabled(dev, 0);
 }
 
 void pci_disable_msix(struct pci_dev *dev)
@@ -1146,8 +1240,9 @@ EXPORT_SYMBOL(pci_enable_msi_range);
  * indicates the successful configuration of MSI-X capability structure
  * with new allocated MSI-X interrupts.
  **/
-int pci_enable_msix_range(struct pci_dev *dev, struct msix_entry *entries,
-			       int minvec, int maxvec)
+static int __pci_enable_msix_range(struct pci_dev *dev,
+				   struct msix_entry *entries, int minvec,
+				   int maxvec, const struct irq_affinity *affd)
 {
 	int nvec = maxvec;
 	int rc;
@@ -1156,7 +1251,7 @@ int pci_enable_msix_range(struct pci_dev *dev, struct msix_entry *entries,
 		return -ERANGE;
 
 	do {
-		rc = pci_enable_msix(dev, entries, nvec);
+		rc = __pci_enable_msix(dev, entries, nvec, affd);
 		if (rc < 0) {
 			return rc;
 		} else if (rc > 0) {
@@ -1168,8 +1263,65 @@ int pci_enable_msix_range(struct pci_dev *dev, struct msix_entry *entries,
 
 	return nvec;
 }
+
+int pci_enable_msix_range(struct pci_dev *dev, struct msix_entry *entries,
+			       int minvec, int maxvec)
+{
+	return __pci_enable_msix_range(dev, entries, minvec, maxvec, NULL);
+}
 EXPORT_SYMBOL(pci_enable_msix_range);
 
+/**
+ * pci_enable_msix_range_affinity - configure MSI-X with spread affinity
+ * @dev: pointer to the pci_dev data structure of MSI-X device function
+ * @entries: pointer to an array of MSI-X entries
+ * @minvec: minimum number of MSI-X irqs requested
+ * @maxvec: maximum number of MSI-X irqs requested
+ * @affd: description of the affinity requirements
+ *
+ * Same as pci_enable_msix_range(), but the vectors not reserved by @affd
+ * are spread over all possible cpus, NUMA node by NUMA node, and get
+ * their irq affinity set accordingly.  No more vectors than there are
+ * possible cpus are allocated.  The masks can be retrieved with
+ * pci_irq_get_affinity() to build the matching cpu -> queue mapping.
+ **/
+int pci_enable_msix_range_affinity(struct pci_dev *dev,
+				   struct msix_entry *entries, int minvec,
+				   int maxvec, const struct irq_affinity *affd)
+{
+	if (maxvec >= minvec)
+		maxvec = max(irq_calc_affinity_vectors(maxvec, affd), minvec);
+
+	return __pci_enable_msix_range(dev, entries, minvec, maxvec, affd);
+}
+EXPORT_SYMBOL(pci_enable_msix_range_affinity);
+
+/**
+ * pci_irq_get_affinity - return the affinity of a particular MSI-X vector
+ * @dev: PCI device to operate on
+ * @nr: device-relative interrupt vector index (0-based)
+ *
+ * Returns the mask assigned by pci_enable_msix_range_affinity(), or NULL
+ * if the vector was not spread.
+ **/
+const struct cpumask *pci_irq_get_affinity(struct pci_dev *dev, int nr)
+{
+	struct msi_desc *entry;
+	int i = 0;
+
+	if (!dev->msix_enabled)
+		return NULL;
+
+	list_for_each_entry(entry, &dev->msi_list, list) {
+		if (i == nr)
+			return entry->affinity;
+		i++;
+	}
+	WARN_ON_ONCE(1);
+	return NULL;
+}
+EXPORT_SYMBOL(pci_irq_get_affinity);
+
 #ifdef CONFIG_PCI_MSI_IRQ_DOMAIN
 /**
  * pci_msi_domain_write_msg - Helper to write MSI message to PCI config space
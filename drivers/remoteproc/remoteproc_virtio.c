@@ -147,7 +147,8 @@ static void rproc_virtio_del_vqs(struct virtio_device *vdev)
 static int rproc_virtio_find_vqs(struct virtio_device *vdev, unsigned nvqs,
 		       struct virtqueue *vqs[],
 		       vq_callback_t *callbacks[],
-		       const char *names[])
+		       const char *names[],
+		       struct irq_affinity *desc)
 {
 	struct rproc *rproc = vdev_to_rproc(vdev);
 	int i, ret;
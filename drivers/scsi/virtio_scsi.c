@@ -823,7 +823,8 @@ static void __virtscsi_set_affinity(struct virtio_scsi *vscsi, bool affinity)
 	if (affinity) {
 		i = 0;
 		for_each_online_cpu(cpu) {
-			virtqueue_set_affinity(vscsi->req_vqs[i].vq, cpu);
+			virtqueue_set_affinity(vscsi->req_vqs[i].vq,
+					       cpumask_of(cpu));
 			i++;
 		}
 
@@ -833,7 +834,7 @@ static void __virtscsi_set_affinity(struct virtio_scsi *vscsi, bool affinity)
 			if (!vscsi->req_vqs[i].vq)
 				continue;
 
-			virtqueue_set_affinity(vscsi->req_vqs[i].vq, -1);
+			virtqueue_set_affinity(vscsi->req_vqs[i].vq, NULL);
 		}
 
 		vscsi->affinity_hint_set = false;
@@ -914,7 +915,8 @@ static int virtscsi_init(struct virtio_device *vdev,
 	}
 
 	/* Discover virtqueues and write information to configuration.  */
-	err = vdev->config->find_vqs(vdev, num_vqs, vqs, callbacks, names);
+	err = vdev->config->find_vqs(vdev, num_vqs, vqs, callbacks, names,
+				     NULL);
 	if (err)
 		goto out;
 
@@ -138,7 +138,8 @@ static void vp_free_vectors(struct virtio_device *vdev)
 }
 
 static int vp_request_msix_vectors(struct virtio_device *vdev, int nvectors,
-				   bool per_vq_vectors)
+				   bool per_vq_vectors,
+				   const struct irq_affinity *desc)
 {
 	struct virtio_pci_device *vp_dev = to_vp_device(vdev);
 	const char *name = dev_name(&vp_dev->vdev.dev);
@@ -168,8 +169,22 @@ static int vp_request_msix_vectors(struct virtio_device *vdev, int nvectors,
 	for (i = 0; i < nvectors; ++i)
 		vp_dev->msix_entries[i].entry = i;
 
-	err = pci_enable_msix_exact(vp_dev->pci_dev,
-				    vp_dev->msix_entries, nvectors);
+	if (per_vq_vectors && desc) {
+		/* The config vector comes first and is not spread */
+		struct irq_affinity affd = {
+			.pre_vectors	= desc->pre_vectors + 1,
+			.post_vectors	= desc->post_vectors,
+		};
+
+		err = pci_enable_msix_range_affinity(vp_dev->pci_dev,
+						     vp_dev->msix_entries,
+						     nvectors, nvectors, &affd);
+		if (err > 0)
+			err = 0;
+	} else {
+		err = pci_enable_msix_exact(vp_dev->pci_dev,
+					    vp_dev->msix_entries, nvectors);
+	}
 	if (err)
 		goto error;
 	vp_dev->msix_enabled = 1;
@@ -298,7 +313,8 @@ static int vp_try_to_find_vqs(struct virtio_device *vdev, unsigned nvqs,
 			      vq_callback_t *callbacks[],
 			      const char *names[],
 			      bool use_msix,
-			      bool per_vq_vectors)
+			      bool per_vq_vectors,
+			      const struct irq_affinity *desc)
 {
 	struct virtio_pci_device *vp_dev = to_vp_device(vdev);
 	u16 msix_vec;
@@ -325,7 +341,8 @@ static int vp_try_to_find_vqs(struct virtio_device *vdev, unsigned nvqs,
 			nvectors = 2;
 		}
 
-		err = vp_request_msix_vectors(vdev, nvectors, per_vq_vectors);
+		err = vp_request_msix_vectors(vdev, nvectors, per_vq_vectors,
+					      desc);
 		if (err)
 			goto error_find;
 	}
@@ -376,22 +393,24 @@ error_find:
 int vp_find_vqs(struct virtio_device *vdev, unsigned nvqs,
 		struct virtqueue *vqs[],
 		vq_callback_t *callbacks[],
-		const char *names[])
+		const char *names[],
+		struct irq_affinity *desc)
 {
 	int err;
 
 	/* Try MSI-X with one vector per queue. */
-	err = vp_try_to_find_vqs(vdev, nvqs, vqs, callbacks, names, true, true);
+	err = vp_try_to_find_vqs(vdev, nvqs, vqs, callbacks, names,
+				 true, true, desc);
 	if (!err)
 		return 0;
 	/* Fallback: MSI-X with one vector for config, one shared for queues. */
 	err = vp_try_to_find_vqs(vdev, nvqs, vqs, callbacks, names,
-				 true, false);
+				 true, false, NULL);
 	if (!err)
 		return 0;
 	/* Finally fall back to regular interrupts. */
 	return vp_try_to_find_vqs(vdev, nvqs, vqs, callbacks, names,
-				  false, false);
+				  false, false, NULL);
 }
 
 const char *vp_bus_name(struct virtio_device *vdev)
@@ -406,7 +425,7 @@ const char *vp_bus_name(struct virtio_device *vdev)
  * - OR over all affinities for shared MSI
  * - ignore the affinity request if we're using INTX
  */
-int vp_set_vq_affinity(struct virtqueue *vq, int cpu)
+int vp_set_vq_affinity(struct virtqueue *vq, const struct cpumask *cpu_mask)
 {
 	struct virtio_device *vdev = vq->vdev;
 	struct virtio_pci_device *vp_dev = to_vp_device(vdev);
@@ -420,17 +439,29 @@ int vp_set_vq_affinity(struct virtqueue *vq, int cpu)
 	if (vp_dev->msix_enabled) {
 		mask = vp_dev->msix_affinity_masks[info->msix_vector];
 		irq = vp_dev->msix_entries[info->msix_vector].vector;
-		if (cpu == -1)
+		if (!cpu_mask)
 			irq_set_affinity_hint(irq, NULL);
 		else {
-			cpumask_clear(mask);
-			cpumask_set_cpu(cpu, mask);
+			cpumask_copy(mask, cpu_mask);
 			irq_set_affinity_hint(irq, mask);
 		}
 	}
 	return 0;
 }
 
+/* the config->get_vq_affinity() implementation, only spread vectors */
+const struct cpumask *vp_get_vq_affinity(struct virtio_device *vdev, int index)
+{
+	struct virtio_pci_device *vp_dev = to_vp_device(vdev);
+
+	if (!vp_dev->per_vq_vectors ||
+	    vp_dev->vqs[index]->msix_vector == VIRTIO_MSI_NO_VECTOR)
+		return NULL;
+
+	return pci_irq_get_affinity(vp_dev->pci_dev,
+				    vp_dev->vqs[index]->msix_vector);
+}
+
 #ifdef CONFIG_PM_SLEEP
 static int virtio_pci_freeze(struct device *dev)
 {
@@ -1359,6 +1359,33 @@ enum btrfs_orphan_cleanup_state {
 	ORPHAN_CLEANUP_DONE	= 2,
 };
 
+/*
+ * the phases of a transaction commit we keep latency numbers for, see
+ * btrfs_commit_transaction
+ */
+enum btrfs_commit_phase {
+	/* delayed refs run before the commit is started */
+	BTRFS_COMMIT_PHASE_DELAYED_REFS,
+	/* delalloc flush and waiting for the external writers to go away */
+	BTRFS_COMMIT_PHASE_FLUSH,
+	/* from COMMIT_DOING until the transaction is unblocked */
+	BTRFS_COMMIT_PHASE_CRITICAL,
+	/* writing the dirty tree blocks and the super blocks */
+	BTRFS_COMMIT_PHASE_WRITEOUT,
+	BTRFS_COMMIT_PHASE_NR,
+};
+
+struct btrfs_commit_stats {
+	spinlock_t lock;
+	u64 commits;
+	u64 last_ns[BTRFS_COMMIT_PHASE_NR];
+	u64 max_ns[BTRFS_COMMIT_PHASE_NR];
+	u64 total_ns[BTRFS_COMMIT_PHASE_NR];
+	/* batches of delayed refs run in the background and refs they ran */
+	u64 bg_delayed_ref_runs;
+	u64 bg_delayed_refs;
+};
+
 /* used by the raid56 code to lock stripes for read/modify/write */
 struct btrfs_stripe_hash {
 	struct list_head hash_list;
@@ -1437,6 +1464,14 @@ struct btrfs_fs_info {
 	u64 last_trans_committed;
 	u64 avg_delayed_ref_runtime;
 
+	/*
+	 * set while a background batch of delayed refs is queued on the
+	 * extent workers, so that ending transactions don't pile up more
+	 */
+	atomic_t delayed_refs_bg_running;
+
+	struct btrfs_commit_stats commit_stats;
+
 	/*
 	 * this is updated to the current trans every time a full commit
 	 * is required instead of the faster short fsync log commits
@@ -1615,6 +1650,9 @@ struct btrfs_fs_info {
 
 	/* the extent workers do delayed refs on the extent allocation tree */
 	struct btrfs_workqueue *extent_workers;
+
+	/* the csum workers checksum large data bios in parallel */
+	struct btrfs_workqueue *csum_workers;
 	struct task_struct *transaction_kthread;
 	struct task_struct *cleaner_kthread;
 	int thread_pool_size;
@@ -3356,6 +3394,9 @@ int btrfs_run_delayed_refs(struct btrfs_trans_handle *trans,
 			   struct btrfs_root *root, unsigned long count);
 int btrfs_async_run_delayed_refs(struct btrfs_root *root,
 				 unsigned long count, int wait);
+unsigned long btrfs_delayed_refs_bg_batch(struct btrfs_trans_handle *trans,
+					  struct btrfs_root *root);
+void btrfs_run_delayed_refs_bg(struct btrfs_root *root, unsigned long count);
 int btrfs_lookup_data_extent(struct btrfs_root *root, u64 start, u64 len);
 int btrfs_lookup_extent_info(struct btrfs_trans_handle *trans,
 			     struct btrfs_root *root, u64 bytenr,
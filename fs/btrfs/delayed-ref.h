@@ -128,6 +128,14 @@ struct btrfs_delayed_data_ref {
 	u64 offset;
 };
 
+/*
+ * once this many ref heads are ready, ending a transaction kicks a
+ * background batch of about BTRFS_DELAYED_REFS_BG_BATCH heads, see
+ * btrfs_delayed_refs_bg_batch()
+ */
+#define BTRFS_DELAYED_REFS_BG_THRESH	64
+#define BTRFS_DELAYED_REFS_BG_BATCH	32
+
 struct btrfs_delayed_ref_root {
 	/* head ref rbtree */
 	struct rb_root href_root;
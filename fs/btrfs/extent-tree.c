@@ -2552,6 +2552,8 @@ static noinline int __btrfs_run_delayed_refs(struct btrfs_trans_handle *trans,
 		cond_resched();
 	}
 
+	trans->delayed_refs_run += actual_count;
+
 	/*
 	 * We don't want to include ref heads since we can have empty ref heads
 	 * and those will drastically skew our runtime down since we just do
@@ -2712,6 +2714,7 @@ struct async_delayed_refs {
 	int count;
 	int error;
 	int sync;
+	int background;
 	struct completion wait;
 	struct btrfs_work work;
 };
@@ -2720,6 +2723,7 @@ static void delayed_ref_async_start(struct btrfs_work *work)
 {
 	struct async_delayed_refs *async;
 	struct btrfs_trans_handle *trans;
+	unsigned long run = 0;
 	int ret;
 
 	async = container_of(work, struct async_delayed_refs, work);
@@ -2738,38 +2742,60 @@ static void delayed_ref_async_start(struct btrfs_work *work)
 	ret = btrfs_run_delayed_refs(trans, async->root, async->count);
 	if (ret)
 		async->error = ret;
+	run = trans->delayed_refs_run;
 
 	ret = btrfs_end_transaction(trans, async->root);
 	if (ret && !async->error)
 		async->error = ret;
 done:
+	if (async->background) {
+		struct btrfs_fs_info *fs_info = async->root->fs_info;
+
+		spin_lock(&fs_info->commit_stats.lock);
+		fs_info->commit_stats.bg_delayed_ref_runs++;
+		fs_info->commit_stats.bg_delayed_refs += run;
+		spin_unlock(&fs_info->commit_stats.lock);
+		atomic_set(&fs_info->delayed_refs_bg_running, 0);
+	}
 	if (async->sync)
 		complete(&async->wait);
 	else
 		kfree(async);
 }
 
-int btrfs_async_run_delayed_refs(struct btrfs_root *root,
-				 unsigned long count, int wait)
+static struct async_delayed_refs *
+alloc_async_delayed_refs(struct btrfs_root *root, unsigned long count)
 {
 	struct async_delayed_refs *async;
-	int ret;
 
 	async = kmalloc(sizeof(*async), GFP_NOFS);
 	if (!async)
-		return -ENOMEM;
+		return NULL;
 
 	async->root = root->fs_info->tree_root;
 	async->count = count;
 	async->error = 0;
-	if (wait)
-		async->sync = 1;
-	else
-		async->sync = 0;
+	async->sync = 0;
+	async->background = 0;
 	init_completion(&async->wait);
 
 	btrfs_init_work(&async->work, btrfs_extent_refs_helper,
 			delayed_ref_async_start, NULL, NULL);
+	return async;
+}
+
+int btrfs_async_run_delayed_refs(struct btrfs_root *root,
+				 unsigned long count, int wait)
+{
+	struct async_delayed_refs *async;
+	int ret;
+
+	async = alloc_async_delayed_refs(root, count);
+	if (!async)
+		return -ENOMEM;
+
+	if (wait)
+		async->sync = 1;
 
 	btrfs_queue_work(root->fs_info->extent_workers, &async->work);
 
@@ -2782,6 +2808,65 @@ int btrfs_async_run_delayed_refs(struct btrfs_root *root,
 	return 0;
 }
 
+/*
+ * Decide if the caller should kick off a background batch of delayed refs.
+ * We do this well before btrfs_should_throttle_delayed_refs() would make
+ * somebody wait, so the backlog is worked off a little at a time and the
+ * commit only has to run whatever came in since the last batch.
+ *
+ * Returns the number of refs the batch should run, or 0.
+ */
+unsigned long btrfs_delayed_refs_bg_batch(struct btrfs_trans_handle *trans,
+					  struct btrfs_root *root)
+{
+	struct btrfs_delayed_ref_root *delayed_refs;
+	unsigned long heads_ready;
+	unsigned long per_head;
+
+	delayed_refs = &trans->transaction->delayed_refs;
+	if (delayed_refs->flushing ||
+	    trans->transaction->state >= TRANS_STATE_BLOCKED)
+		return 0;
+
+	heads_ready = ACCESS_ONCE(delayed_refs->num_heads_ready);
+	if (heads_ready < BTRFS_DELAYED_REFS_BG_THRESH)
+		return 0;
+
+	if (atomic_read(&root->fs_info->delayed_refs_bg_running))
+		return 0;
+
+	/*
+	 * __btrfs_run_delayed_refs always finishes the head (bytenr) it is
+	 * working on, size the batch so it covers about
+	 * BTRFS_DELAYED_REFS_BG_BATCH heads worth of refs.
+	 */
+	per_head = atomic_read(&delayed_refs->num_entries) /
+		   max_t(unsigned long, delayed_refs->num_heads, 1);
+	return BTRFS_DELAYED_REFS_BG_BATCH * max_t(unsigned long, per_head, 1);
+}
+
+/*
+ * queue a batch of @count delayed refs on the extent workers without
+ * waiting for it.  Only one background batch is in flight per fs.
+ */
+void btrfs_run_delayed_refs_bg(struct btrfs_root *root, unsigned long count)
+{
+	struct btrfs_fs_info *fs_info = root->fs_info;
+	struct async_delayed_refs *async;
+
+	if (atomic_cmpxchg(&fs_info->delayed_refs_bg_running, 0, 1))
+		return;
+
+	async = alloc_async_delayed_refs(root, count);
+	if (!async) {
+		atomic_set(&fs_info->delayed_refs_bg_running, 0);
+		return;
+	}
+	async->background = 1;
+
+	btrfs_queue_work(fs_info->extent_workers, &async->work);
+}
+
 /*
  * this starts processing the delayed reference count updates and
  * extent insertions we have queued up so far.  count can be
@@ -37,6 +37,13 @@
 				   sizeof(struct btrfs_ordered_sum)) / \
 				   sizeof(u32) * (r)->sectorsize)
 
+/*
+ * write bios at least this big get their data checksums computed in
+ * parallel by the csum workers, in chunks of BTRFS_CSUM_CHUNK_BYTES
+ */
+#define BTRFS_CSUM_PARALLEL_MIN		(256 * 1024)
+#define BTRFS_CSUM_CHUNK_BYTES		(64 * 1024)
+
 int btrfs_insert_file_extent(struct btrfs_trans_handle *trans,
 			     struct btrfs_root *root,
 			     u64 objectid, u64 pos,
@@ -423,6 +430,91 @@ fail:
 	return ret;
 }
 
+struct btrfs_csum_work {
+	struct btrfs_work work;
+	struct bio_vec *bvec;
+	u32 *sums;
+	int nr;
+	atomic_t *pending;
+	struct completion *done;
+};
+
+static void csum_bvecs(struct bio_vec *bvec, u32 *sums, int nr)
+{
+	char *data;
+	int i;
+
+	for (i = 0; i < nr; i++, bvec++) {
+		data = kmap_atomic(bvec->bv_page);
+		sums[i] = btrfs_csum_data(data + bvec->bv_offset, ~(u32)0,
+					  bvec->bv_len);
+		kunmap_atomic(data);
+		btrfs_csum_final(sums[i], (char *)(sums + i));
+	}
+}
+
+static void csum_work_fn(struct btrfs_work *work)
+{
+	struct btrfs_csum_work *cw;
+
+	cw = container_of(work, struct btrfs_csum_work, work);
+	csum_bvecs(cw->bvec, cw->sums, cw->nr);
+	if (atomic_dec_and_test(cw->pending))
+		complete(cw->done);
+}
+
+/*
+ * checksum every bvec of a large bio into @sums, one entry per bvec.  The
+ * bio is split into chunks which are handed to the csum workers so the
+ * crc32c runs on several cpus at once, the caller does the first chunk
+ * itself and then waits for the rest.
+ *
+ * Returns -ENOMEM if the work items can't be allocated, the caller should
+ * fall back to checksumming the bio inline.
+ */
+static int csum_bio_parallel(struct btrfs_root *root, struct bio *bio,
+			     u32 *sums)
+{
+	struct btrfs_csum_work *works;
+	struct completion done;
+	atomic_t pending;
+	int per_chunk;
+	int nr_chunks;
+	int i;
+
+	per_chunk = max_t(int, 1, BTRFS_CSUM_CHUNK_BYTES / root->sectorsize);
+	nr_chunks = DIV_ROUND_UP(bio->bi_vcnt, per_chunk);
+	if (nr_chunks < 2) {
+		csum_bvecs(bio->bi_io_vec, sums, bio->bi_vcnt);
+		return 0;
+	}
+
+	works = kmalloc_array(nr_chunks - 1, sizeof(*works), GFP_NOFS);
+	if (!works)
+		return -ENOMEM;
+
+	init_completion(&done);
+	atomic_set(&pending, nr_chunks - 1);
+	for (i = 1; i < nr_chunks; i++) {
+		struct btrfs_csum_work *cw = &works[i - 1];
+		int start = i * per_chunk;
+
+		cw->bvec = bio->bi_io_vec + start;
+		cw->sums = sums + start;
+		cw->nr = min(per_chunk, bio->bi_vcnt - start);
+		cw->pending = &pending;
+		cw->done = &done;
+		btrfs_init_work(&cw->work, btrfs_csum_helper,
+				csum_work_fn, NULL, NULL);
+		btrfs_queue_work(root->fs_info->csum_workers, &cw->work);
+	}
+
+	csum_bvecs(bio->bi_io_vec, sums, per_chunk);
+	wait_for_completion(&done);
+	kfree(works);
+	return 0;
+}
+
 int btrfs_csum_one_bio(struct btrfs_root *root, struct inode *inode,
 		       struct bio *bio, u64 file_start, int contig)
 {
@@ -430,6 +522,7 @@ int btrfs_csum_one_bio(struct btrfs_root *root, struct inode *inode,
 	struct btrfs_ordered_extent *ordered;
 	char *data;
 	struct bio_vec *bvec = bio->bi_io_vec;
+	u32 *bio_sums = NULL;
 	int bio_index = 0;
 	int index;
 	unsigned long total_bytes = 0;
@@ -442,6 +535,15 @@ int btrfs_csum_one_bio(struct btrfs_root *root, struct inode *inode,
 	if (!sums)
 		return -ENOMEM;
 
+	if (bio->bi_iter.bi_size >= BTRFS_CSUM_PARALLEL_MIN &&
+	    num_online_cpus() > 1) {
+		bio_sums = kmalloc_array(bio->bi_vcnt, sizeof(u32), GFP_NOFS);
+		if (bio_sums && csum_bio_parallel(root, bio, bio_sums)) {
+			kfree(bio_sums);
+			bio_sums = NULL;
+		}
+	}
+
 	sums->len = bio->bi_iter.bi_size;
 	INIT_LIST_HEAD(&sums->list);
 
@@ -480,14 +582,19 @@ int btrfs_csum_one_bio(struct btrfs_root *root, struct inode *inode,
 			index = 0;
 		}
 
-		data = kmap_atomic(bvec->bv_page);
-		sums->sums[index] = ~(u32)0;
-		sums->sums[index] = btrfs_csum_data(data + bvec->bv_offset,
-						    sums->sums[index],
-						    bvec->bv_len);
-		kunmap_atomic(data);
-		btrfs_csum_final(sums->sums[index],
-				 (char *)(sums->sums + index));
+		if (bio_sums) {
+			sums->sums[index] = bio_sums[bio_index];
+		} else {
+			data = kmap_atomic(bvec->bv_page);
+			sums->sums[index] = ~(u32)0;
+			sums->sums[index] = btrfs_csum_data(data +
+							    bvec->bv_offset,
+							    sums->sums[index],
+							    bvec->bv_len);
+			kunmap_atomic(data);
+			btrfs_csum_final(sums->sums[index],
+					 (char *)(sums->sums + index));
+		}
 
 		bio_index++;
 		index++;
@@ -499,6 +606,7 @@ int btrfs_csum_one_bio(struct btrfs_root *root, struct inode *inode,
 	this_sum_bytes = 0;
 	btrfs_add_ordered_sum(inode, ordered, sums);
 	btrfs_put_ordered_extent(ordered);
+	kfree(bio_sums);
 	return 0;
 }
 
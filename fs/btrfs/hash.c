@@ -29,6 +29,11 @@ void btrfs_hash_exit(void)
 	crypto_free_shash(tfm);
 }
 
+const char *btrfs_crc32c_impl(void)
+{
+	return crypto_tfm_alg_driver_name(crypto_shash_tfm(tfm));
+}
+
 u32 btrfs_crc32c(u32 crc, const void *address, unsigned int length)
 {
 	SHASH_DESC_ON_STACK(shash, tfm);
@@ -428,11 +428,83 @@ static ssize_t btrfs_clone_alignment_show(struct kobject *kobj,
 
 BTRFS_ATTR(clone_alignment, btrfs_clone_alignment_show);
 
+static const char * const btrfs_commit_phase_names[BTRFS_COMMIT_PHASE_NR] = {
+	[BTRFS_COMMIT_PHASE_DELAYED_REFS]	= "delayed_refs",
+	[BTRFS_COMMIT_PHASE_FLUSH]		= "flush",
+	[BTRFS_COMMIT_PHASE_CRITICAL]		= "critical",
+	[BTRFS_COMMIT_PHASE_WRITEOUT]		= "writeout",
+};
+
+/*
+ * one line per commit phase: last, max and total time spent in it, in
+ * milliseconds
+ */
+static ssize_t btrfs_commit_stats_show(struct kobject *kobj,
+				       struct kobj_attribute *a, char *buf)
+{
+	struct btrfs_fs_info *fs_info = to_fs_info(kobj);
+	struct btrfs_commit_stats *stats = &fs_info->commit_stats;
+	ssize_t len;
+	int i;
+
+	spin_lock(&stats->lock);
+	len = snprintf(buf, PAGE_SIZE, "commits %llu\n", stats->commits);
+	for (i = 0; i < BTRFS_COMMIT_PHASE_NR; i++)
+		len += snprintf(buf + len, PAGE_SIZE - len,
+				"%s %llu %llu %llu\n",
+				btrfs_commit_phase_names[i],
+				div_u64(stats->last_ns[i], NSEC_PER_MSEC),
+				div_u64(stats->max_ns[i], NSEC_PER_MSEC),
+				div_u64(stats->total_ns[i], NSEC_PER_MSEC));
+	spin_unlock(&stats->lock);
+	return len;
+}
+
+BTRFS_ATTR(commit_stats, btrfs_commit_stats_show);
+
+/* backlog of the running transaction and the background runs so far */
+static ssize_t btrfs_delayed_refs_show(struct kobject *kobj,
+				       struct kobj_attribute *a, char *buf)
+{
+	struct btrfs_fs_info *fs_info = to_fs_info(kobj);
+	struct btrfs_transaction *cur_trans;
+	unsigned long entries = 0;
+	unsigned long heads = 0;
+	unsigned long heads_ready = 0;
+	u64 bg_runs;
+	u64 bg_refs;
+
+	spin_lock(&fs_info->trans_lock);
+	cur_trans = fs_info->running_transaction;
+	if (cur_trans) {
+		entries = atomic_read(&cur_trans->delayed_refs.num_entries);
+		heads = cur_trans->delayed_refs.num_heads;
+		heads_ready = cur_trans->delayed_refs.num_heads_ready;
+	}
+	spin_unlock(&fs_info->trans_lock);
+
+	spin_lock(&fs_info->commit_stats.lock);
+	bg_runs = fs_info->commit_stats.bg_delayed_ref_runs;
+	bg_refs = fs_info->commit_stats.bg_delayed_refs;
+	spin_unlock(&fs_info->commit_stats.lock);
+
+	return snprintf(buf, PAGE_SIZE,
+			"entries %lu\nheads %lu\nheads_ready %lu\n"
+			"avg_runtime_ns %llu\nbg_runs %llu\nbg_refs %llu\n",
+			entries, heads, heads_ready,
+			ACCESS_ONCE(fs_info->avg_delayed_ref_runtime),
+			bg_runs, bg_refs);
+}
+
+BTRFS_ATTR(delayed_refs, btrfs_delayed_refs_show);
+
 static struct attribute *btrfs_attrs[] = {
 	BTRFS_ATTR_PTR(label),
 	BTRFS_ATTR_PTR(nodesize),
 	BTRFS_ATTR_PTR(sectorsize),
 	BTRFS_ATTR_PTR(clone_alignment),
+	BTRFS_ATTR_PTR(commit_stats),
+	BTRFS_ATTR_PTR(delayed_refs),
 	NULL,
 };
 
@@ -511,6 +511,7 @@ again:
 	h->bytes_reserved = 0;
 	h->root = root;
 	h->delayed_ref_updates = 0;
+	h->delayed_refs_run = 0;
 	h->use_count = 1;
 	h->adding_csums = 0;
 	h->block_rsv = NULL;
@@ -740,6 +741,7 @@ static int __btrfs_end_transaction(struct btrfs_trans_handle *trans,
 	struct btrfs_transaction *cur_trans = trans->transaction;
 	struct btrfs_fs_info *info = root->fs_info;
 	unsigned long cur = trans->delayed_ref_updates;
+	unsigned long bg_batch = 0;
 	int lock = (trans->type != TRANS_JOIN_NOLOCK);
 	int err = 0;
 	int must_run_delayed_refs = 0;
@@ -775,6 +777,8 @@ static int __btrfs_end_transaction(struct btrfs_trans_handle *trans,
 		if (must_run_delayed_refs == 1 &&
 		    (trans->type & (__TRANS_JOIN_NOLOCK | __TRANS_ATTACH)))
 			must_run_delayed_refs = 2;
+		else if (!must_run_delayed_refs)
+			bg_batch = btrfs_delayed_refs_bg_batch(trans, root);
 	}
 
 	if (trans->qgroup_reserved) {
@@ -838,6 +842,8 @@ static int __btrfs_end_transaction(struct btrfs_trans_handle *trans,
 	if (must_run_delayed_refs) {
 		btrfs_async_run_delayed_refs(root, cur,
 					     must_run_delayed_refs == 1);
+	} else if (bg_batch) {
+		btrfs_run_delayed_refs_bg(root, bg_batch);
 	}
 	return err;
 }
@@ -1767,12 +1773,41 @@ btrfs_wait_pending_ordered(struct btrfs_transaction *cur_trans,
 	spin_unlock(&fs_info->trans_lock);
 }
 
+static void update_commit_stats(struct btrfs_fs_info *fs_info,
+				u64 *phase_ns)
+{
+	struct btrfs_commit_stats *stats = &fs_info->commit_stats;
+	int i;
+
+	spin_lock(&stats->lock);
+	stats->commits++;
+	for (i = 0; i < BTRFS_COMMIT_PHASE_NR; i++) {
+		stats->last_ns[i] = phase_ns[i];
+		stats->total_ns[i] += phase_ns[i];
+		if (phase_ns[i] > stats->max_ns[i])
+			stats->max_ns[i] = phase_ns[i];
+	}
+	spin_unlock(&stats->lock);
+}
+
+/* record the time since *start for @phase and restart the clock */
+static void commit_phase_done(u64 *phase_ns, enum btrfs_commit_phase phase,
+			      u64 *start)
+{
+	u64 now = ktime_get_ns();
+
+	phase_ns[phase] = now - *start;
+	*start = now;
+}
+
 int btrfs_commit_transaction(struct btrfs_trans_handle *trans,
 			     struct btrfs_root *root)
 {
 	struct btrfs_transaction *cur_trans = trans->transaction;
 	struct btrfs_transaction *prev_trans = NULL;
 	struct btrfs_inode *btree_ino = BTRFS_I(root->fs_info->btree_inode);
+	u64 phase_ns[BTRFS_COMMIT_PHASE_NR];
+	u64 phase_start = ktime_get_ns();
 	int ret;
 
 	/* Stop the commit early if ->aborted is set */
@@ -1866,6 +1901,8 @@ int btrfs_commit_transaction(struct btrfs_trans_handle *trans,
 
 	cur_trans->state = TRANS_STATE_COMMIT_START;
 	wake_up(&root->fs_info->transaction_blocked_wait);
+	commit_phase_done(phase_ns, BTRFS_COMMIT_PHASE_DELAYED_REFS,
+			  &phase_start);
 
 	if (cur_trans->list.prev != &root->fs_info->trans_list) {
 		prev_trans = list_entry(cur_trans->list.prev,
@@ -1920,6 +1957,7 @@ int btrfs_commit_transaction(struct btrfs_trans_handle *trans,
 	spin_unlock(&root->fs_info->trans_lock);
 	wait_event(cur_trans->writer_wait,
 		   atomic_read(&cur_trans->num_writers) == 1);
+	commit_phase_done(phase_ns, BTRFS_COMMIT_PHASE_FLUSH, &phase_start);
 
 	/* ->aborted might be set after the previous check, so check it */
 	if (unlikely(ACCESS_ONCE(cur_trans->aborted))) {
@@ -2064,6 +2102,7 @@ int btrfs_commit_transaction(struct btrfs_trans_handle *trans,
 	mutex_unlock(&root->fs_info->reloc_mutex);
 
 	wake_up(&root->fs_info->transaction_wait);
+	commit_phase_done(phase_ns, BTRFS_COMMIT_PHASE_CRITICAL, &phase_start);
 
 	ret = btrfs_write_and_wait_transaction(trans, root);
 	if (ret) {
@@ -2098,6 +2137,9 @@ int btrfs_commit_transaction(struct btrfs_trans_handle *trans,
 	cur_trans->state = TRANS_STATE_COMPLETED;
 	wake_up(&cur_trans->commit_wait);
 
+	commit_phase_done(phase_ns, BTRFS_COMMIT_PHASE_WRITEOUT, &phase_start);
+	update_commit_stats(root->fs_info, phase_ns);
+
 	spin_lock(&root->fs_info->trans_lock);
 	list_del_init(&cur_trans->list);
 	spin_unlock(&root->fs_info->trans_lock);
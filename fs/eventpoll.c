@@ -92,7 +92,16 @@
  */
 
 /* Epoll private bits inside the event mask */
-#define EP_PRIVATE_BITS (EPOLLWAKEUP | EPOLLONESHOT | EPOLLET)
+#define EP_PRIVATE_BITS (EPOLLWAKEUP | EPOLLONESHOT | EPOLLET | \
+			 EPOLLEXCLUSIVE | EPOLLROUNDROBIN)
+
+/* The events that make sense for an exclusive wakeup */
+#define EPOLLEXCLUSIVE_OK_BITS (POLLIN | POLLOUT | POLLERR | POLLHUP | \
+				EPOLLWAKEUP | EPOLLET | EPOLLEXCLUSIVE | \
+				EPOLLROUNDROBIN)
+
+/* Maximum number of commands of one epoll_ctl_batch() call */
+#define EP_MAX_BATCH 1024
 
 /* Maximum number of nesting allowed inside epoll sets */
 #define EP_MAX_NESTS 4
@@ -998,7 +1007,7 @@ static struct epitem *ep_find(struct eventpoll *ep, struct file *file, int fd)
  */
 static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *key)
 {
-	int pwake = 0;
+	int pwake = 0, ewake = 0;
 	unsigned long flags;
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
@@ -1041,6 +1050,8 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * chained in ep->ovflist and requeued later on.
 	 */
 	if (unlikely(ep->ovflist != EP_UNACTIVE_PTR)) {
+		/* somebody is busy with this set, it counts as woken */
+		ewake = 1;
 		if (epi->next == EP_UNACTIVE_PTR) {
 			epi->next = ep->ovflist;
 			ep->ovflist = epi;
@@ -1066,8 +1077,10 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
 	 * wait list.
 	 */
-	if (waitqueue_active(&ep->wq))
+	if (waitqueue_active(&ep->wq)) {
+		ewake = 1;
 		wake_up_locked(&ep->wq);
+	}
 	if (waitqueue_active(&ep->poll_wait))
 		pwake++;
 
@@ -1078,7 +1091,21 @@ out_unlock:
 	if (pwake)
 		ep_poll_safewake(&ep->poll_wait);
 
-	return 1;
+	if (!(wait->flags & WQ_FLAG_EXCLUSIVE))
+		return 1;
+
+	/*
+	 * An exclusive wakeup only counts if it got a task out of
+	 * epoll_wait(), otherwise the next epoll set in line gets it.  With
+	 * EPOLLROUNDROBIN the set that took it goes to the back of the line,
+	 * the wakeup loop stops right after us so we can move ourselves.
+	 * whead->lock is held by the caller.
+	 */
+	if (ewake && (epi->event.events & EPOLLROUNDROBIN) &&
+	    !((unsigned long)key & POLLFREE))
+		list_move_tail(&wait->task_list,
+			       &ep_pwq_from_wait(wait)->whead->task_list);
+	return ewake;
 }
 
 /*
@@ -1095,7 +1122,10 @@ static void ep_ptable_queue_proc(struct file *file, wait_queue_head_t *whead,
 		init_waitqueue_func_entry(&pwq->wait, ep_poll_callback);
 		pwq->whead = whead;
 		pwq->base = epi;
-		add_wait_queue(whead, &pwq->wait);
+		if (epi->event.events & EPOLLEXCLUSIVE)
+			add_wait_queue_exclusive(whead, &pwq->wait);
+		else
+			add_wait_queue(whead, &pwq->wait);
 		list_add_tail(&pwq->llink, &epi->pwqlist);
 		epi->nwait++;
 	} else {
@@ -1815,33 +1845,24 @@ SYSCALL_DEFINE1(epoll_create, int, size)
 /*
  * The following function implements the controller interface for
  * the eventpoll file that enables the insertion/removal/change of
- * file descriptors inside the interest set.
+ * file descriptors inside the interest set.  @file is the eventpoll
+ * file, @epds is only used by the ops that have an event.
  */
-SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
-		struct epoll_event __user *, event)
+static int ep_ctl(struct file *file, int op, int fd,
+		  struct epoll_event *epds)
 {
 	int error;
 	int full_check = 0;
-	struct fd f, tf;
+	struct fd tf;
 	struct eventpoll *ep;
 	struct epitem *epi;
-	struct epoll_event epds;
 	struct eventpoll *tep = NULL;
 
-	error = -EFAULT;
-	if (ep_op_has_event(op) &&
-	    copy_from_user(&epds, event, sizeof(struct epoll_event)))
-		goto error_return;
-
-	error = -EBADF;
-	f = fdget(epfd);
-	if (!f.file)
-		goto error_return;
-
 	/* Get the "struct file *" for the target file */
+	error = -EBADF;
 	tf = fdget(fd);
 	if (!tf.file)
-		goto error_fput;
+		goto error_return;
 
 	/* The target file descriptor must support poll */
 	error = -EPERM;
@@ -1850,7 +1871,7 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 
 	/* Check if EPOLLWAKEUP is allowed */
 	if (ep_op_has_event(op))
-		ep_take_care_of_epollwakeup(&epds);
+		ep_take_care_of_epollwakeup(epds);
 
 	/*
 	 * We have to check that the file structure underneath the file descriptor
@@ -1858,14 +1879,29 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 	 * adding an epoll file descriptor inside itself.
 	 */
 	error = -EINVAL;
-	if (f.file == tf.file || !is_file_epoll(f.file))
+	if (file == tf.file || !is_file_epoll(file))
 		goto error_tgt_fput;
 
+	/*
+	 * EPOLLEXCLUSIVE can only be set on add, and not for nested epoll
+	 * files, whose wakeups have to reach every set they are part of.
+	 * EPOLLROUNDROBIN is a kind of exclusive wakeup.
+	 */
+	if (ep_op_has_event(op) && (epds->events & EPOLLROUNDROBIN))
+		epds->events |= EPOLLEXCLUSIVE;
+	if (ep_op_has_event(op) && (epds->events & EPOLLEXCLUSIVE)) {
+		if (op == EPOLL_CTL_MOD)
+			goto error_tgt_fput;
+		if (is_file_epoll(tf.file) ||
+		    (epds->events & ~EPOLLEXCLUSIVE_OK_BITS))
+			goto error_tgt_fput;
+	}
+
 	/*
 	 * At this point it is safe to assume that the "private_data" contains
 	 * our own data structure.
 	 */
-	ep = f.file->private_data;
+	ep = file->private_data;
 
 	/*
 	 * When we insert an epoll file descriptor, inside another epoll file
@@ -1884,7 +1920,7 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 	 */
 	mutex_lock_nested(&ep->mtx, 0);
 	if (op == EPOLL_CTL_ADD) {
-		if (!list_empty(&f.file->f_ep_links) ||
+		if (!list_empty(&file->f_ep_links) ||
 						is_file_epoll(tf.file)) {
 			full_check = 1;
 			mutex_unlock(&ep->mtx);
@@ -1917,8 +1953,8 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 	switch (op) {
 	case EPOLL_CTL_ADD:
 		if (!epi) {
-			epds.events |= POLLERR | POLLHUP;
-			error = ep_insert(ep, &epds, tf.file, fd, full_check);
+			epds->events |= POLLERR | POLLHUP;
+			error = ep_insert(ep, epds, tf.file, fd, full_check);
 		} else
 			error = -EEXIST;
 		if (full_check)
@@ -1932,8 +1968,10 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 		break;
 	case EPOLL_CTL_MOD:
 		if (epi) {
-			epds.events |= POLLERR | POLLHUP;
-			error = ep_modify(ep, epi, &epds);
+			if (!(epi->event.events & EPOLLEXCLUSIVE)) {
+				epds->events |= POLLERR | POLLHUP;
+				error = ep_modify(ep, epi, epds);
+			}
 		} else
 			error = -ENOENT;
 		break;
@@ -1947,13 +1985,79 @@ error_tgt_fput:
 		mutex_unlock(&epmutex);
 
 	fdput(tf);
-error_fput:
-	fdput(f);
 error_return:
 
 	return error;
 }
 
+SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
+		struct epoll_event __user *, event)
+{
+	int error;
+	struct fd f;
+	struct epoll_event epds;
+
+	if (ep_op_has_event(op) &&
+	    copy_from_user(&epds, event, sizeof(struct epoll_event)))
+		return -EFAULT;
+
+	f = fdget(epfd);
+	if (!f.file)
+		return -EBADF;
+
+	error = ep_ctl(f.file, op, fd, &epds);
+
+	fdput(f);
+	return error;
+}
+
+/*
+ * Runs a batch of epoll_ctl() commands on one eventpoll file, in order,
+ * up to the first one that fails.  The result of each command that ran is
+ * stored in its @result field, and the number of commands that succeeded
+ * is returned.
+ */
+SYSCALL_DEFINE4(epoll_ctl_batch, int, epfd, int, flags,
+		int, ncmds, struct epoll_ctl_cmd __user *, cmds)
+{
+	struct epoll_ctl_cmd *kcmds;
+	struct epoll_event epds;
+	struct fd f;
+	int done, error;
+
+	if (flags || ncmds <= 0 || ncmds > EP_MAX_BATCH)
+		return -EINVAL;
+
+	kcmds = memdup_user(cmds, ncmds * sizeof(*kcmds));
+	if (IS_ERR(kcmds))
+		return PTR_ERR(kcmds);
+
+	error = -EBADF;
+	f = fdget(epfd);
+	if (!f.file)
+		goto out_free;
+
+	for (done = 0; done < ncmds; done++) {
+		epds.events = kcmds[done].events;
+		epds.data = kcmds[done].data;
+		kcmds[done].result = ep_ctl(f.file, kcmds[done].op,
+					    kcmds[done].fd, &epds);
+		if (kcmds[done].result)
+			break;
+	}
+	fdput(f);
+
+	/* the result of the command that failed goes back too */
+	error = -EFAULT;
+	if (copy_to_user(cmds, kcmds, min(done + 1, ncmds) * sizeof(*kcmds)))
+		goto out_free;
+	error = done;
+
+out_free:
+	kfree(kcmds);
+	return error;
+}
+
 /*
  * Implement the event wait interface for the eventpoll file. It is the kernel
  * part of the user space epoll_wait(2).
@@ -27,9 +27,18 @@
  */
 #define TARGET_BUCKET_SIZE	64
 
+/*
+ * The cache is sharded by XID hash.  Besides its entries each bucket
+ * keeps its own share of the statistics under its cache_lock, so that
+ * threads working on different buckets don't write to shared lines.
+ */
 struct nfsd_drc_bucket {
 	struct list_head lru_head;
 	spinlock_t cache_lock;
+	unsigned int mem_usage;
+	unsigned int payload_misses;
+	unsigned int longest_chain;
+	unsigned int longest_chain_cachesize;
 };
 
 static struct nfsd_drc_bucket	*drc_hashtbl;
@@ -42,26 +51,9 @@ static unsigned int		max_drc_entries;
 static unsigned int		maskbits;
 static unsigned int		drc_hashsize;
 
-/*
- * Stats and other tracking of on the duplicate reply cache. All of these and
- * the "rc" fields in nfsdstats are protected by the cache_lock
- */
-
 /* total number of entries */
 static atomic_t			num_drc_entries;
 
-/* cache misses due only to checksum comparison failures */
-static unsigned int		payload_misses;
-
-/* amount of memory (in bytes) currently consumed by the DRC */
-static unsigned int		drc_mem_usage;
-
-/* longest hash chain seen */
-static unsigned int		longest_chain;
-
-/* size of cache when we saw the longest hash chain */
-static unsigned int		longest_chain_cachesize;
-
 static int	nfsd_cache_append(struct svc_rqst *rqstp, struct kvec *vec);
 static void	cache_cleaner_func(struct work_struct *unused);
 static unsigned long nfsd_reply_cache_count(struct shrinker *shrink,
@@ -141,15 +133,16 @@ nfsd_reply_cache_alloc(void)
 }
 
 static void
-nfsd_reply_cache_free_locked(struct svc_cacherep *rp)
+nfsd_reply_cache_free_locked(struct nfsd_drc_bucket *b,
+			     struct svc_cacherep *rp)
 {
 	if (rp->c_type == RC_REPLBUFF && rp->c_replvec.iov_base) {
-		drc_mem_usage -= rp->c_replvec.iov_len;
+		b->mem_usage -= rp->c_replvec.iov_len;
 		kfree(rp->c_replvec.iov_base);
 	}
 	list_del(&rp->c_lru);
 	atomic_dec(&num_drc_entries);
-	drc_mem_usage -= sizeof(*rp);
+	b->mem_usage -= sizeof(*rp);
 	kmem_cache_free(drc_slab, rp);
 }
 
@@ -157,7 +150,7 @@ static void
 nfsd_reply_cache_free(struct nfsd_drc_bucket *b, struct svc_cacherep *rp)
 {
 	spin_lock(&b->cache_lock);
-	nfsd_reply_cache_free_locked(rp);
+	nfsd_reply_cache_free_locked(b, rp);
 	spin_unlock(&b->cache_lock);
 }
 
@@ -209,7 +202,7 @@ void nfsd_reply_cache_shutdown(void)
 		struct list_head *head = &drc_hashtbl[i].lru_head;
 		while (!list_empty(head)) {
 			rp = list_first_entry(head, struct svc_cacherep, c_lru);
-			nfsd_reply_cache_free_locked(rp);
+			nfsd_reply_cache_free_locked(&drc_hashtbl[i], rp);
 		}
 	}
 
@@ -225,14 +218,16 @@ void nfsd_reply_cache_shutdown(void)
 
 /*
  * Move cache entry to end of LRU list, and queue the cleaner to run if it's
- * not already scheduled.
+ * not already scheduled.  The cleaner is nearly always pending, so check
+ * that before dirtying its cacheline from every nfsd thread.
  */
 static void
 lru_put_end(struct nfsd_drc_bucket *b, struct svc_cacherep *rp)
 {
 	rp->c_timestamp = jiffies;
 	list_move_tail(&rp->c_lru, &b->lru_head);
-	schedule_delayed_work(&cache_cleaner, RC_EXPIRE);
+	if (!delayed_work_pending(&cache_cleaner))
+		schedule_delayed_work(&cache_cleaner, RC_EXPIRE);
 }
 
 static long
@@ -251,7 +246,7 @@ prune_bucket(struct nfsd_drc_bucket *b)
 		if (atomic_read(&num_drc_entries) <= max_drc_entries &&
 		    time_before(jiffies, rp->c_timestamp + RC_EXPIRE))
 			break;
-		nfsd_reply_cache_free_locked(rp);
+		nfsd_reply_cache_free_locked(b, rp);
 		freed++;
 	}
 	return freed;
@@ -340,14 +335,15 @@ nfsd_cache_csum(struct svc_rqst *rqstp)
 }
 
 static bool
-nfsd_cache_match(struct svc_rqst *rqstp, __wsum csum, struct svc_cacherep *rp)
+nfsd_cache_match(struct nfsd_drc_bucket *b, struct svc_rqst *rqstp,
+		 __wsum csum, struct svc_cacherep *rp)
 {
 	/* Check RPC XID first */
 	if (rqstp->rq_xid != rp->c_xid)
 		return false;
 	/* compare checksum of NFS data */
 	if (csum != rp->c_csum) {
-		++payload_misses;
+		++b->payload_misses;
 		return false;
 	}
 
@@ -378,20 +374,20 @@ nfsd_cache_search(struct nfsd_drc_bucket *b, struct svc_rqst *rqstp,
 
 	list_for_each_entry(rp, rh, c_lru) {
 		++entries;
-		if (nfsd_cache_match(rqstp, csum, rp)) {
+		if (nfsd_cache_match(b, rqstp, csum, rp)) {
 			ret = rp;
 			break;
 		}
 	}
 
 	/* tally hash chain length stats */
-	if (entries > longest_chain) {
-		longest_chain = entries;
-		longest_chain_cachesize = atomic_read(&num_drc_entries);
-	} else if (entries == longest_chain) {
+	if (entries > b->longest_chain) {
+		b->longest_chain = entries;
+		b->longest_chain_cachesize = atomic_read(&num_drc_entries);
+	} else if (entries == b->longest_chain) {
 		/* prefer to keep the smallest cachesize possible here */
-		longest_chain_cachesize = min_t(unsigned int,
-				longest_chain_cachesize,
+		b->longest_chain_cachesize = min_t(unsigned int,
+				b->longest_chain_cachesize,
 				atomic_read(&num_drc_entries));
 	}
 
@@ -436,7 +432,7 @@ nfsd_cache_lookup(struct svc_rqst *rqstp)
 	spin_lock(&b->cache_lock);
 	if (likely(rp)) {
 		atomic_inc(&num_drc_entries);
-		drc_mem_usage += sizeof(*rp);
+		b->mem_usage += sizeof(*rp);
 	}
 
 	/* go ahead and prune the cache */
@@ -445,7 +441,7 @@ nfsd_cache_lookup(struct svc_rqst *rqstp)
 	found = nfsd_cache_search(b, rqstp, csum);
 	if (found) {
 		if (likely(rp))
-			nfsd_reply_cache_free_locked(rp);
+			nfsd_reply_cache_free_locked(b, rp);
 		rp = found;
 		goto found_entry;
 	}
@@ -471,7 +467,7 @@ nfsd_cache_lookup(struct svc_rqst *rqstp)
 
 	/* release any buffer */
 	if (rp->c_type == RC_REPLBUFF) {
-		drc_mem_usage -= rp->c_replvec.iov_len;
+		b->mem_usage -= rp->c_replvec.iov_len;
 		kfree(rp->c_replvec.iov_base);
 		rp->c_replvec.iov_base = NULL;
 	}
@@ -512,7 +508,7 @@ found_entry:
 		break;
 	default:
 		printk(KERN_WARNING "nfsd: bad repcache type %d\n", rp->c_type);
-		nfsd_reply_cache_free_locked(rp);
+		nfsd_reply_cache_free_locked(b, rp);
 	}
 
 	goto out;
@@ -581,7 +577,7 @@ nfsd_cache_update(struct svc_rqst *rqstp, int cachetype, __be32 *statp)
 		return;
 	}
 	spin_lock(&b->cache_lock);
-	drc_mem_usage += bufsize;
+	b->mem_usage += bufsize;
 	lru_put_end(b, rp);
 	rp->c_secure = test_bit(RQ_SECURE, &rqstp->rq_flags);
 	rp->c_type = cachetype;
@@ -617,6 +613,25 @@ nfsd_cache_append(struct svc_rqst *rqstp, struct kvec *data)
  */
 static int nfsd_reply_cache_stats_show(struct seq_file *m, void *v)
 {
+	unsigned int drc_mem_usage = 0, payload_misses = 0;
+	unsigned int longest_chain = 0, longest_chain_cachesize = 0;
+	unsigned int i;
+
+	for (i = 0; i < drc_hashsize; i++) {
+		struct nfsd_drc_bucket *b = &drc_hashtbl[i];
+
+		spin_lock(&b->cache_lock);
+		drc_mem_usage += b->mem_usage;
+		payload_misses += b->payload_misses;
+		if (b->longest_chain > longest_chain ||
+		    (b->longest_chain == longest_chain &&
+		     b->longest_chain_cachesize < longest_chain_cachesize)) {
+			longest_chain = b->longest_chain;
+			longest_chain_cachesize = b->longest_chain_cachesize;
+		}
+		spin_unlock(&b->cache_lock);
+	}
+
 	seq_printf(m, "max entries:           %u\n", max_drc_entries);
 	seq_printf(m, "num entries:           %u\n",
 			atomic_read(&num_drc_entries));
@@ -8,9 +8,27 @@
 #include <linux/sched.h>
 #include <linux/types.h>
 #include <linux/wait.h>
+#include <linux/exportfs.h>
 
 #include "fanotify.h"
 
+/*
+ * Only look this far back in the queue for an event to merge with, so that
+ * queueing doesn't get slower the longer the listener falls behind.
+ */
+#define FANOTIFY_MERGE_DEPTH	128
+
+static bool fanotify_fid_equal(struct fanotify_event_info *old,
+			       struct fanotify_event_info *new)
+{
+	return old->fh_type == new->fh_type &&
+	       old->fh_len == new->fh_len &&
+	       old->fid.fsid.val[0] == new->fid.fsid.val[0] &&
+	       old->fid.fsid.val[1] == new->fid.fsid.val[1] &&
+	       !memcmp(fanotify_event_fh(old), fanotify_event_fh(new),
+		       old->fh_len);
+}
+
 static bool should_merge(struct fsnotify_event *old_fsn,
 			 struct fsnotify_event *new_fsn)
 {
@@ -20,10 +38,17 @@ static bool should_merge(struct fsnotify_event *old_fsn,
 	old = FANOTIFY_E(old_fsn);
 	new = FANOTIFY_E(new_fsn);
 
-	if (old_fsn->inode == new_fsn->inode && old->tgid == new->tgid &&
-	    old->path.mnt == new->path.mnt &&
-	    old->path.dentry == new->path.dentry)
-		return true;
+	if (old_fsn->inode != new_fsn->inode || old->tgid != new->tgid)
+		return false;
+
+	if (fanotify_event_has_path(old))
+		return fanotify_event_has_path(new) &&
+		       old->path.mnt == new->path.mnt &&
+		       old->path.dentry == new->path.dentry;
+
+	if (fanotify_event_has_fid(old))
+		return fanotify_fid_equal(old, new);
+
 	return false;
 }
 
@@ -32,6 +57,7 @@ static int fanotify_merge(struct list_head *list, struct fsnotify_event *event)
 {
 	struct fsnotify_event *test_event;
 	bool do_merge = false;
+	int depth = 0;
 
 	pr_debug("%s: list=%p event=%p\n", __func__, list, event);
 
@@ -46,6 +72,8 @@ static int fanotify_merge(struct list_head *list, struct fsnotify_event *event)
 #endif
 
 	list_for_each_entry_reverse(test_event, list, list) {
+		if (++depth > FANOTIFY_MERGE_DEPTH)
+			break;
 		if (should_merge(test_event, event)) {
 			do_merge = true;
 			break;
@@ -98,26 +126,41 @@ static int fanotify_get_response(struct fsnotify_group *group,
 }
 #endif
 
-static bool fanotify_should_send_event(struct fsnotify_mark *inode_mark,
+static bool fanotify_should_send_event(struct fsnotify_group *group,
+				       struct fsnotify_mark *inode_mark,
 				       struct fsnotify_mark *vfsmnt_mark,
 				       u32 event_mask,
 				       void *data, int data_type)
 {
 	__u32 marks_mask, marks_ignored_mask;
-	struct path *path = data;
+	bool is_dir;
 
 	pr_debug("%s: inode_mark=%p vfsmnt_mark=%p mask=%x data=%p"
 		 " data_type=%d\n", __func__, inode_mark, vfsmnt_mark,
 		 event_mask, data, data_type);
 
-	/* if we don't have enough info to send an event to userspace say no */
-	if (data_type != FSNOTIFY_EVENT_PATH)
-		return false;
+	if (event_mask & FANOTIFY_DIRENT_EVENTS) {
+		/* the directory is reported, the mask says what the child is */
+		is_dir = event_mask & FS_ISDIR;
+	} else if (data_type == FSNOTIFY_EVENT_PATH) {
+		struct path *path = data;
 
-	/* sorry, fanotify only gives a damn about files and dirs */
-	if (!d_is_reg(path->dentry) &&
-	    !d_can_lookup(path->dentry))
+		/* sorry, fanotify only gives a damn about files and dirs */
+		if (!d_is_reg(path->dentry) &&
+		    !d_can_lookup(path->dentry))
+			return false;
+		is_dir = d_is_dir(path->dentry);
+	} else if (data_type == FSNOTIFY_EVENT_INODE &&
+		   FAN_GROUP_FLAG(group, FAN_REPORT_FID)) {
+		struct inode *inode = data;
+
+		if (!S_ISREG(inode->i_mode) && !S_ISDIR(inode->i_mode))
+			return false;
+		is_dir = S_ISDIR(inode->i_mode);
+	} else {
+		/* if we don't have enough info to send an event to userspace say no */
 		return false;
+	}
 
 	if (inode_mark && vfsmnt_mark) {
 		marks_mask = (vfsmnt_mark->mask | inode_mark->mask);
@@ -139,7 +182,7 @@ static bool fanotify_should_send_event(struct fsnotify_mark *inode_mark,
 		BUG();
 	}
 
-	if (d_is_dir(path->dentry) &&
+	if (is_dir &&
 	    !(marks_mask & FS_ISDIR & ~marks_ignored_mask))
 		return false;
 
@@ -150,8 +193,70 @@ static bool fanotify_should_send_event(struct fsnotify_mark *inode_mark,
 	return false;
 }
 
-struct fanotify_event_info *fanotify_alloc_event(struct inode *inode, u32 mask,
-						 struct path *path)
+/*
+ * The object a FAN_REPORT_FID event is reported against: the directory for
+ * directory entry events, else the object the event happened to.
+ */
+static struct inode *fanotify_fid_inode(struct inode *to_tell, u32 mask,
+					void *data, int data_type)
+{
+	if (mask & FANOTIFY_DIRENT_EVENTS)
+		return to_tell;
+	if (data_type == FSNOTIFY_EVENT_PATH)
+		return ((struct path *)data)->dentry->d_inode;
+	if (data_type == FSNOTIFY_EVENT_INODE)
+		return data;
+	return NULL;
+}
+
+static void fanotify_encode_fid(struct fanotify_event_info *event,
+				struct inode *inode, __kernel_fsid_t *fsid)
+{
+	unsigned char *buf = event->fid.fh;
+	int dwords = 0, bytes, type;
+
+	event->fh_type = FILEID_INVALID;
+	event->fh_len = 0;
+	if (!inode)
+		return;
+
+	/* ask for the handle size first */
+	exportfs_encode_inode_fh(inode, NULL, &dwords, NULL);
+	bytes = dwords << 2;
+	if (!bytes || bytes > MAX_HANDLE_SZ)
+		goto err;
+
+	if (bytes > FANOTIFY_INLINE_FH_LEN) {
+		buf = kmalloc(bytes, GFP_KERNEL);
+		if (!buf)
+			goto err;
+	}
+
+	type = exportfs_encode_inode_fh(inode, (struct fid *)buf, &dwords,
+					NULL);
+	if (type == FILEID_ROOT || type == FILEID_INVALID ||
+	    bytes != dwords << 2)
+		goto err_free;
+
+	if (bytes > FANOTIFY_INLINE_FH_LEN)
+		event->fid.ext_fh = buf;
+	event->fid.fsid = *fsid;
+	event->fh_type = type;
+	event->fh_len = bytes;
+	return;
+
+err_free:
+	if (bytes > FANOTIFY_INLINE_FH_LEN)
+		kfree(buf);
+err:
+	pr_warn_ratelimited("fanotify: failed to encode fid (bytes=%d)\n",
+			    bytes);
+}
+
+struct fanotify_event_info *fanotify_alloc_event(struct fsnotify_group *group,
+						 struct inode *inode, u32 mask,
+						 void *data, int data_type,
+						 __kernel_fsid_t *fsid)
 {
 	struct fanotify_event_info *event;
 
@@ -174,10 +279,16 @@ struct fanotify_event_info *fanotify_alloc_event(struct inode *inode, u32 mask,
 init: __maybe_unused
 	fsnotify_init_event(&event->fse, inode, mask);
 	event->tgid = get_pid(task_tgid(current));
-	if (path) {
-		event->path = *path;
+	if (FAN_GROUP_FLAG(group, FAN_REPORT_FID) && fsid) {
+		fanotify_encode_fid(event, fanotify_fid_inode(inode, mask, data,
+							      data_type),
+				    fsid);
+	} else if (data_type == FSNOTIFY_EVENT_PATH) {
+		event->fh_type = FILEID_ROOT;
+		event->path = *(struct path *)data;
 		path_get(&event->path);
 	} else {
+		event->fh_type = FILEID_ROOT;
 		event->path.mnt = NULL;
 		event->path.dentry = NULL;
 	}
@@ -194,26 +305,34 @@ static int fanotify_handle_event(struct fsnotify_group *group,
 	int ret = 0;
 	struct fanotify_event_info *event;
 	struct fsnotify_event *fsn_event;
+	struct fsnotify_mark *mark = inode_mark ?: fanotify_mark;
 
 	BUILD_BUG_ON(FAN_ACCESS != FS_ACCESS);
 	BUILD_BUG_ON(FAN_MODIFY != FS_MODIFY);
 	BUILD_BUG_ON(FAN_CLOSE_NOWRITE != FS_CLOSE_NOWRITE);
 	BUILD_BUG_ON(FAN_CLOSE_WRITE != FS_CLOSE_WRITE);
 	BUILD_BUG_ON(FAN_OPEN != FS_OPEN);
+	BUILD_BUG_ON(FAN_MOVED_FROM != FS_MOVED_FROM);
+	BUILD_BUG_ON(FAN_MOVED_TO != FS_MOVED_TO);
+	BUILD_BUG_ON(FAN_CREATE != FS_CREATE);
+	BUILD_BUG_ON(FAN_DELETE != FS_DELETE);
+	BUILD_BUG_ON(FAN_DELETE_SELF != FS_DELETE_SELF);
+	BUILD_BUG_ON(FAN_MOVE_SELF != FS_MOVE_SELF);
 	BUILD_BUG_ON(FAN_EVENT_ON_CHILD != FS_EVENT_ON_CHILD);
 	BUILD_BUG_ON(FAN_Q_OVERFLOW != FS_Q_OVERFLOW);
 	BUILD_BUG_ON(FAN_OPEN_PERM != FS_OPEN_PERM);
 	BUILD_BUG_ON(FAN_ACCESS_PERM != FS_ACCESS_PERM);
 	BUILD_BUG_ON(FAN_ONDIR != FS_ISDIR);
 
-	if (!fanotify_should_send_event(inode_mark, fanotify_mark, mask, data,
-					data_type))
+	if (!fanotify_should_send_event(group, inode_mark, fanotify_mark, mask,
+					data, data_type))
 		return 0;
 
 	pr_debug("%s: group=%p inode=%p mask=%x\n", __func__, group, inode,
 		 mask);
 
-	event = fanotify_alloc_event(inode, mask, data);
+	event = fanotify_alloc_event(group, inode, mask, data, data_type,
+				     &FANOTIFY_M(mark)->fsid);
 	if (unlikely(!event))
 		return -ENOMEM;
 
@@ -251,7 +370,10 @@ static void fanotify_free_event(struct fsnotify_event *fsn_event)
 	struct fanotify_event_info *event;
 
 	event = FANOTIFY_E(fsn_event);
-	path_put(&event->path);
+	if (fanotify_event_has_path(event))
+		path_put(&event->path);
+	else if (event->fh_len > FANOTIFY_INLINE_FH_LEN)
+		kfree(event->fid.ext_fh);
 	put_pid(event->tgid);
 #ifdef CONFIG_FANOTIFY_ACCESS_PERMISSIONS
 	if (fsn_event->mask & FAN_ALL_PERM_EVENTS) {
@@ -1,10 +1,44 @@
 #include <linux/fsnotify_backend.h>
 #include <linux/path.h>
 #include <linux/slab.h>
+#include <linux/exportfs.h>
 
 extern struct kmem_cache *fanotify_event_cachep;
 extern struct kmem_cache *fanotify_perm_event_cachep;
 
+#define FAN_GROUP_FLAG(group, flag)	((group)->fanotify_data.flags & (flag))
+
+/* Events reported against the directory, not the object that changed */
+#define FANOTIFY_DIRENT_EVENTS	(FAN_MOVE | FAN_CREATE | FAN_DELETE)
+
+/*
+ * fanotify mark.  The fsid of the marked filesystem is looked up once when
+ * the mark is created and copied into each FAN_REPORT_FID event.
+ */
+struct fanotify_mark {
+	struct fsnotify_mark fsn_mark;
+	__kernel_fsid_t fsid;
+};
+
+static inline struct fanotify_mark *FANOTIFY_M(struct fsnotify_mark *mark)
+{
+	return container_of(mark, struct fanotify_mark, fsn_mark);
+}
+
+/*
+ * File handles that fit are stored inline, longer ones are allocated.
+ * Most filesystems encode an inode in 8 bytes.
+ */
+#define FANOTIFY_INLINE_FH_LEN	8
+
+struct fanotify_fid {
+	__kernel_fsid_t fsid;
+	union {
+		unsigned char fh[FANOTIFY_INLINE_FH_LEN];
+		unsigned char *ext_fh;
+	};
+};
+
 /*
  * Structure for normal fanotify events. It gets allocated in
  * fanotify_handle_event() and freed when the information is retrieved by
@@ -12,14 +46,37 @@ extern struct kmem_cache *fanotify_perm_event_cachep;
  */
 struct fanotify_event_info {
 	struct fsnotify_event fse;
-	/*
-	 * We hold ref to this path so it may be dereferenced at any point
-	 * during this object's lifetime
-	 */
-	struct path path;
+	union {
+		/*
+		 * We hold ref to this path so it may be dereferenced at any
+		 * point during this object's lifetime
+		 */
+		struct path path;
+		/* With FAN_REPORT_FID the object is identified by handle */
+		struct fanotify_fid fid;
+	};
+	u8 fh_type;	/* FILEID_ROOT if path is used instead of fid */
+	u8 fh_len;	/* length of fid handle in bytes */
 	struct pid *tgid;
 };
 
+static inline bool fanotify_event_has_path(struct fanotify_event_info *event)
+{
+	return event->fh_type == FILEID_ROOT;
+}
+
+static inline bool fanotify_event_has_fid(struct fanotify_event_info *event)
+{
+	return event->fh_type != FILEID_ROOT &&
+	       event->fh_type != FILEID_INVALID;
+}
+
+static inline void *fanotify_event_fh(struct fanotify_event_info *event)
+{
+	return event->fh_len <= FANOTIFY_INLINE_FH_LEN ?
+		event->fid.fh : event->fid.ext_fh;
+}
+
 #ifdef CONFIG_FANOTIFY_ACCESS_PERMISSIONS
 /*
  * Structure for permission fanotify events. It gets allocated and freed in
@@ -46,5 +103,7 @@ static inline struct fanotify_event_info *FANOTIFY_E(struct fsnotify_event *fse)
 	return container_of(fse, struct fanotify_event_info, fse);
 }
 
-struct fanotify_event_info *fanotify_alloc_event(struct inode *inode, u32 mask,
-						 struct path *path);
+struct fanotify_event_info *fanotify_alloc_event(struct fsnotify_group *group,
+						 struct inode *inode, u32 mask,
+						 void *data, int data_type,
+						 __kernel_fsid_t *fsid);
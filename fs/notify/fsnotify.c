@@ -42,6 +42,11 @@ void __fsnotify_vfsmount_delete(struct vfsmount *mnt)
 	fsnotify_clear_marks_by_mount(mnt);
 }
 
+void __fsnotify_sb_delete(struct super_block *sb)
+{
+	fsnotify_clear_marks_by_sb(sb);
+}
+
 /*
  * Given an inode, first check if we care what happens to our children.  Inotify
  * and dnotify both tell their parents about events.  If we care about any event
@@ -126,6 +131,7 @@ EXPORT_SYMBOL_GPL(__fsnotify_parent);
 static int send_to_group(struct inode *to_tell,
 			 struct fsnotify_mark *inode_mark,
 			 struct fsnotify_mark *vfsmount_mark,
+			 struct fsnotify_mark *sb_mark,
 			 __u32 mask, void *data,
 			 int data_is, u32 cookie,
 			 const unsigned char *file_name)
@@ -133,8 +139,9 @@ static int send_to_group(struct inode *to_tell,
 	struct fsnotify_group *group = NULL;
 	__u32 inode_test_mask = 0;
 	__u32 vfsmount_test_mask = 0;
+	__u32 sb_test_mask = 0;
 
-	if (unlikely(!inode_mark && !vfsmount_mark)) {
+	if (unlikely(!inode_mark && !vfsmount_mark && !sb_mark)) {
 		BUG();
 		return 0;
 	}
@@ -147,6 +154,9 @@ static int send_to_group(struct inode *to_tell,
 		if (vfsmount_mark &&
 		    !(vfsmount_mark->flags & FSNOTIFY_MARK_FLAG_IGNORED_SURV_MODIFY))
 			vfsmount_mark->ignored_mask = 0;
+		if (sb_mark &&
+		    !(sb_mark->flags & FSNOTIFY_MARK_FLAG_IGNORED_SURV_MODIFY))
+			sb_mark->ignored_mask = 0;
 	}
 
 	/* does the inode mark tell us to do something? */
@@ -167,6 +177,16 @@ static int send_to_group(struct inode *to_tell,
 			vfsmount_test_mask &= ~inode_mark->ignored_mask;
 	}
 
+	/* does the sb_mark tell us to do something? */
+	if (sb_mark) {
+		sb_test_mask = (mask & ~FS_EVENT_ON_CHILD);
+		group = sb_mark->group;
+		sb_test_mask &= sb_mark->mask;
+		sb_test_mask &= ~sb_mark->ignored_mask;
+		if (inode_mark)
+			sb_test_mask &= ~inode_mark->ignored_mask;
+	}
+
 	pr_debug("%s: group=%p to_tell=%p mask=%x inode_mark=%p"
 		 " inode_test_mask=%x vfsmount_mark=%p vfsmount_test_mask=%x"
 		 " data=%p data_is=%d cookie=%d\n",
@@ -174,9 +194,17 @@ static int send_to_group(struct inode *to_tell,
 		 inode_test_mask, vfsmount_mark, vfsmount_test_mask, data,
 		 data_is, cookie);
 
-	if (!inode_test_mask && !vfsmount_test_mask)
+	if (!inode_test_mask && !vfsmount_test_mask && !sb_test_mask)
 		return 0;
 
+	/*
+	 * Groups get handed one mark besides the inode mark.  The superblock
+	 * mark stands in for the vfsmount mark, unless the group has both and
+	 * only the vfsmount mark wants this event.
+	 */
+	if (sb_mark && (!vfsmount_mark || (sb_test_mask && !vfsmount_test_mask)))
+		vfsmount_mark = sb_mark;
+
 	return group->ops->handle_event(group, to_tell, inode_mark,
 					vfsmount_mark, mask, data, data_is,
 					file_name, cookie);
@@ -192,8 +220,12 @@ int fsnotify(struct inode *to_tell, __u32 mask, void *data, int data_is,
 	     const unsigned char *file_name, u32 cookie)
 {
 	struct hlist_node *inode_node = NULL, *vfsmount_node = NULL;
+	struct hlist_node *sb_node = NULL;
 	struct fsnotify_mark *inode_mark = NULL, *vfsmount_mark = NULL;
-	struct fsnotify_group *inode_group, *vfsmount_group;
+	struct fsnotify_mark *sb_mark = NULL;
+	struct fsnotify_group *inode_group, *vfsmount_group, *sb_group;
+	struct fsnotify_group *group;
+	struct super_block *sb = to_tell->i_sb;
 	struct mount *mnt;
 	int idx, ret = 0;
 	/* global tests shouldn't care about events on child only the specific event */
@@ -204,14 +236,22 @@ int fsnotify(struct inode *to_tell, __u32 mask, void *data, int data_is,
 	else
 		mnt = NULL;
 
+	/*
+	 * Events on a child are also reported to the child itself, superblock
+	 * marks catch them there rather than seeing them twice.
+	 */
+	if (mask & FS_EVENT_ON_CHILD)
+		sb = NULL;
+
 	/*
 	 * if this is a modify event we may need to clear the ignored masks
-	 * otherwise return if neither the inode nor the vfsmount care about
-	 * this type of event.
+	 * otherwise return if neither the inode, the vfsmount nor the
+	 * superblock care about this type of event.
 	 */
 	if (!(mask & FS_MODIFY) &&
 	    !(test_mask & to_tell->i_fsnotify_mask) &&
-	    !(mnt && test_mask & mnt->mnt_fsnotify_mask))
+	    !(mnt && test_mask & mnt->mnt_fsnotify_mask) &&
+	    !(sb && test_mask & sb->s_fsnotify_mask))
 		return 0;
 
 	idx = srcu_read_lock(&fsnotify_mark_srcu);
@@ -229,16 +269,26 @@ int fsnotify(struct inode *to_tell, __u32 mask, void *data, int data_is,
 					      &fsnotify_mark_srcu);
 	}
 
+	if (sb && ((mask & FS_MODIFY) ||
+		   (test_mask & sb->s_fsnotify_mask))) {
+		sb_node = srcu_dereference(sb->s_fsnotify_marks.first,
+					   &fsnotify_mark_srcu);
+		inode_node = srcu_dereference(to_tell->i_fsnotify_marks.first,
+					      &fsnotify_mark_srcu);
+	}
+
 	/*
-	 * We need to merge inode & vfsmount mark lists so that inode mark
-	 * ignore masks are properly reflected for mount mark notifications.
-	 * That's why this traversal is so complicated...
+	 * We need to merge inode, vfsmount & superblock mark lists so that
+	 * inode mark ignore masks are properly reflected for mount and sb mark
+	 * notifications.  That's why this traversal is so complicated...
 	 */
-	while (inode_node || vfsmount_node) {
+	while (inode_node || vfsmount_node || sb_node) {
 		inode_group = NULL;
 		inode_mark = NULL;
 		vfsmount_group = NULL;
 		vfsmount_mark = NULL;
+		sb_group = NULL;
+		sb_mark = NULL;
 
 		if (inode_node) {
 			inode_mark = hlist_entry(srcu_dereference(inode_node, &fsnotify_mark_srcu),
@@ -252,19 +302,34 @@ int fsnotify(struct inode *to_tell, __u32 mask, void *data, int data_is,
 			vfsmount_group = vfsmount_mark->group;
 		}
 
-		if (inode_group && vfsmount_group) {
-			int cmp = fsnotify_compare_groups(inode_group,
-							  vfsmount_group);
-			if (cmp > 0) {
-				inode_group = NULL;
-				inode_mark = NULL;
-			} else if (cmp < 0) {
-				vfsmount_group = NULL;
-				vfsmount_mark = NULL;
-			}
+		if (sb_node) {
+			sb_mark = hlist_entry(srcu_dereference(sb_node, &fsnotify_mark_srcu),
+					      struct fsnotify_mark, obj_list);
+			sb_group = sb_mark->group;
 		}
-		ret = send_to_group(to_tell, inode_mark, vfsmount_mark, mask,
-				    data, data_is, cookie, file_name);
+
+		/* find the group to handle next, and drop the marks of others */
+		group = inode_group;
+		if (fsnotify_compare_groups(group, vfsmount_group) > 0)
+			group = vfsmount_group;
+		if (fsnotify_compare_groups(group, sb_group) > 0)
+			group = sb_group;
+
+		if (inode_group != group) {
+			inode_group = NULL;
+			inode_mark = NULL;
+		}
+		if (vfsmount_group != group) {
+			vfsmount_group = NULL;
+			vfsmount_mark = NULL;
+		}
+		if (sb_group != group) {
+			sb_group = NULL;
+			sb_mark = NULL;
+		}
+
+		ret = send_to_group(to_tell, inode_mark, vfsmount_mark, sb_mark,
+				    mask, data, data_is, cookie, file_name);
 
 		if (ret && (mask & ALL_FSNOTIFY_PERM_EVENTS))
 			goto out;
@@ -275,6 +340,9 @@ int fsnotify(struct inode *to_tell, __u32 mask, void *data, int data_is,
 		if (vfsmount_group)
 			vfsmount_node = srcu_dereference(vfsmount_node->next,
 							 &fsnotify_mark_srcu);
+		if (sb_group)
+			sb_node = srcu_dereference(sb_node->next,
+						   &fsnotify_mark_srcu);
 	}
 	ret = 0;
 out:
@@ -9,7 +9,7 @@
 /* destroy all events sitting in this groups notification queue */
 extern void fsnotify_flush_notify(struct fsnotify_group *group);
 
-/* protects reads of inode and vfsmount marks list */
+/* protects reads of inode, vfsmount and superblock marks list */
 extern struct srcu_struct fsnotify_mark_srcu;
 
 /* Calculate mask of events for a list of marks */
@@ -34,6 +34,13 @@ extern int fsnotify_add_vfsmount_mark(struct fsnotify_mark *mark,
 				      struct fsnotify_group *group, struct vfsmount *mnt,
 				      int allow_dups);
 
+/* add a mark to a superblock */
+extern int fsnotify_add_sb_mark(struct fsnotify_mark *mark,
+				struct fsnotify_group *group, struct super_block *sb,
+				int allow_dups);
+
+/* superblock specific destruction of a mark */
+extern void fsnotify_destroy_sb_mark(struct fsnotify_mark *mark);
 /* vfsmount specific destruction of a mark */
 extern void fsnotify_destroy_vfsmount_mark(struct fsnotify_mark *mark);
 /* inode specific destruction of a mark */
@@ -47,6 +54,8 @@ extern struct fsnotify_mark *fsnotify_find_mark(struct hlist_head *head,
 extern void fsnotify_clear_marks_by_inode(struct inode *inode);
 /* run the list of all marks associated with vfsmount and flag them to be freed */
 extern void fsnotify_clear_marks_by_mount(struct vfsmount *mnt);
+/* run the list of all marks associated with superblock and flag them to be freed */
+extern void fsnotify_clear_marks_by_sb(struct super_block *sb);
 /*
  * update the dentry->d_flags of all of inode's children to indicate if inode cares
  * about events that happen to its children.
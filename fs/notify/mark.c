@@ -148,6 +148,8 @@ void fsnotify_destroy_mark_locked(struct fsnotify_mark *mark,
 		fsnotify_destroy_inode_mark(mark);
 	} else if (mark->flags & FSNOTIFY_MARK_FLAG_VFSMOUNT)
 		fsnotify_destroy_vfsmount_mark(mark);
+	else if (mark->flags & FSNOTIFY_MARK_FLAG_SUPERBLOCK)
+		fsnotify_destroy_sb_mark(mark);
 	else
 		BUG();
 
@@ -315,14 +317,14 @@ int fsnotify_add_mark_list(struct hlist_head *head, struct fsnotify_mark *mark,
  * These marks may be used for the fsnotify backend to determine which
  * event types should be delivered to which group.
  */
-int fsnotify_add_mark_locked(struct fsnotify_mark *mark,
-			     struct fsnotify_group *group, struct inode *inode,
-			     struct vfsmount *mnt, int allow_dups)
+static int fsnotify_add_mark_obj(struct fsnotify_mark *mark,
+				 struct fsnotify_group *group,
+				 struct inode *inode, struct vfsmount *mnt,
+				 struct super_block *sb, int allow_dups)
 {
 	int ret = 0;
 
-	BUG_ON(inode && mnt);
-	BUG_ON(!inode && !mnt);
+	BUG_ON(!!inode + !!mnt + !!sb != 1);
 	BUG_ON(!mutex_is_locked(&group->mark_mutex));
 
 	/*
@@ -348,6 +350,10 @@ int fsnotify_add_mark_locked(struct fsnotify_mark *mark,
 		ret = fsnotify_add_vfsmount_mark(mark, group, mnt, allow_dups);
 		if (ret)
 			goto err;
+	} else if (sb) {
+		ret = fsnotify_add_sb_mark(mark, group, sb, allow_dups);
+		if (ret)
+			goto err;
 	} else {
 		BUG();
 	}
@@ -377,6 +383,20 @@ err:
 	return ret;
 }
 
+int fsnotify_add_mark_locked(struct fsnotify_mark *mark,
+			     struct fsnotify_group *group, struct inode *inode,
+			     struct vfsmount *mnt, int allow_dups)
+{
+	return fsnotify_add_mark_obj(mark, group, inode, mnt, NULL, allow_dups);
+}
+
+int fsnotify_add_sb_mark_locked(struct fsnotify_mark *mark,
+				struct fsnotify_group *group,
+				struct super_block *sb, int allow_dups)
+{
+	return fsnotify_add_mark_obj(mark, group, NULL, NULL, sb, allow_dups);
+}
+
 int fsnotify_add_mark(struct fsnotify_mark *mark, struct fsnotify_group *group,
 		      struct inode *inode, struct vfsmount *mnt, int allow_dups)
 {
@@ -196,7 +196,7 @@ int ovl_set_attr(struct dentry *upperdentry, struct kstat *stat)
 static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 			      struct dentry *dentry, struct path *lowerpath,
 			      struct kstat *stat, struct iattr *attr,
-			      const char *link)
+			      const char *link, bool metacopy)
 {
 	struct inode *wdir = workdir->d_inode;
 	struct inode *udir = upperdir->d_inode;
@@ -223,7 +223,16 @@ static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 	if (err)
 		goto out2;
 
-	if (S_ISREG(stat->mode)) {
+	if (metacopy) {
+		/* Fall back to a full copy if upper can't store the marker */
+		err = ovl_do_setxattr(newdentry, OVL_XATTR_METACOPY, "y", 1, 0);
+		if (err == -EOPNOTSUPP)
+			metacopy = false;
+		else if (err)
+			goto out_cleanup;
+	}
+
+	if (S_ISREG(stat->mode) && !metacopy) {
 		struct path upperpath;
 		ovl_path_upper(dentry, &upperpath);
 		BUG_ON(upperpath.dentry != NULL);
@@ -250,6 +259,7 @@ static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 	if (err)
 		goto out_cleanup;
 
+	ovl_dentry_set_metacopy(dentry, metacopy);
 	ovl_dentry_update(dentry, newdentry);
 	newdentry = NULL;
 
@@ -270,6 +280,34 @@ out_cleanup:
 	goto out2;
 }
 
+static struct cred *ovl_copy_up_creds(struct kstat *stat)
+{
+	struct cred *override_cred;
+
+	override_cred = prepare_creds();
+	if (!override_cred)
+		return NULL;
+
+	override_cred->fsuid = stat->uid;
+	override_cred->fsgid = stat->gid;
+	/*
+	 * CAP_SYS_ADMIN for copying up extended attributes
+	 * CAP_DAC_OVERRIDE for create
+	 * CAP_FOWNER for chmod, timestamp update
+	 * CAP_FSETID for chmod
+	 * CAP_CHOWN for chown
+	 * CAP_MKNOD for mknod
+	 */
+	cap_raise(override_cred->cap_effective, CAP_SYS_ADMIN);
+	cap_raise(override_cred->cap_effective, CAP_DAC_OVERRIDE);
+	cap_raise(override_cred->cap_effective, CAP_FOWNER);
+	cap_raise(override_cred->cap_effective, CAP_FSETID);
+	cap_raise(override_cred->cap_effective, CAP_CHOWN);
+	cap_raise(override_cred->cap_effective, CAP_MKNOD);
+
+	return override_cred;
+}
+
 /*
  * Copy up a single dentry
  *
@@ -284,10 +322,14 @@ out_cleanup:
  * up uses upper parent i_mutex for exclusion.  Since rename can change
  * d_parent it is possible that the copy up will lock the old parent.  At
  * that point the file will have already been copied up anyway.
+ *
+ * With @metacopy a regular file only gets its inode and xattrs copied and
+ * is marked with OVL_XATTR_METACOPY; the data keeps being read from the
+ * lower layer until ovl_copy_up_meta_data() is called.
  */
 int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
 		    struct path *lowerpath, struct kstat *stat,
-		    struct iattr *attr)
+		    struct iattr *attr, bool metacopy)
 {
 	struct dentry *workdir = ovl_workdir(dentry);
 	int err;
@@ -315,27 +357,14 @@ int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
 			return PTR_ERR(link);
 	}
 
+	if (!S_ISREG(stat->mode) || !ovl_metacopy_enabled(dentry) ||
+	    (attr && (attr->ia_valid & ATTR_SIZE)))
+		metacopy = false;
+
 	err = -ENOMEM;
-	override_cred = prepare_creds();
+	override_cred = ovl_copy_up_creds(stat);
 	if (!override_cred)
 		goto out_free_link;
-
-	override_cred->fsuid = stat->uid;
-	override_cred->fsgid = stat->gid;
-	/*
-	 * CAP_SYS_ADMIN for copying up extended attributes
-	 * CAP_DAC_OVERRIDE for create
-	 * CAP_FOWNER for chmod, timestamp update
-	 * CAP_FSETID for chmod
-	 * CAP_CHOWN for chown
-	 * CAP_MKNOD for mknod
-	 */
-	cap_raise(override_cred->cap_effective, CAP_SYS_ADMIN);
-	cap_raise(override_cred->cap_effective, CAP_DAC_OVERRIDE);
-	cap_raise(override_cred->cap_effective, CAP_FOWNER);
-	cap_raise(override_cred->cap_effective, CAP_FSETID);
-	cap_raise(override_cred->cap_effective, CAP_CHOWN);
-	cap_raise(override_cred->cap_effective, CAP_MKNOD);
 	old_cred = override_creds(override_cred);
 
 	err = -EIO;
@@ -357,7 +386,7 @@ int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
 	}
 
 	err = ovl_copy_up_locked(workdir, upperdir, dentry, lowerpath,
-				 stat, attr, link);
+				 stat, attr, link, metacopy);
 	if (!err) {
 		/* Restore timestamps on parent (best effort) */
 		ovl_set_timestamps(upperdir, &pstat);
@@ -375,7 +404,78 @@ out_free_link:
 	return err;
 }
 
-int ovl_copy_up(struct dentry *dentry)
+/*
+ * Finish the copy up of a metacopy file by filling in the data from the
+ * lower layer.  With @no_data (open with O_TRUNC) the data is dropped
+ * instead.  The upper parent's i_mutex serializes against another
+ * completion and against ovl_copy_up_one() on the same name.
+ */
+int ovl_copy_up_meta_data(struct dentry *dentry, bool no_data)
+{
+	int err;
+	struct dentry *parent;
+	struct dentry *upperdir;
+	struct path lowerpath;
+	struct path upperpath;
+	struct kstat stat;
+	const struct cred *old_cred;
+	struct cred *override_cred;
+
+	if (!ovl_dentry_is_metacopy(dentry))
+		return 0;
+
+	ovl_path_lower(dentry, &lowerpath);
+	ovl_path_upper(dentry, &upperpath);
+	err = vfs_getattr(&upperpath, &stat);
+	if (err)
+		return err;
+
+	err = -ENOMEM;
+	override_cred = ovl_copy_up_creds(&stat);
+	if (!override_cred)
+		return err;
+	old_cred = override_creds(override_cred);
+
+	parent = dget_parent(dentry);
+	upperdir = ovl_dentry_upper(parent);
+	mutex_lock_nested(&upperdir->d_inode->i_mutex, I_MUTEX_PARENT);
+	err = 0;
+	if (!ovl_dentry_is_metacopy(dentry))
+		goto out_unlock;
+
+	if (!no_data) {
+		struct kstat lowerstat;
+
+		err = vfs_getattr(&lowerpath, &lowerstat);
+		if (!err)
+			err = ovl_copy_up_data(&lowerpath, &upperpath,
+					       lowerstat.size);
+		if (err)
+			goto out_unlock;
+	}
+
+	err = ovl_do_removexattr(upperpath.dentry, OVL_XATTR_METACOPY);
+	if (err)
+		goto out_unlock;
+
+	/* Writing the data must not show up as a modification */
+	mutex_lock(&upperpath.dentry->d_inode->i_mutex);
+	ovl_set_timestamps(upperpath.dentry, &stat);
+	mutex_unlock(&upperpath.dentry->d_inode->i_mutex);
+
+	/* Data must be visible before readers switch to upper */
+	smp_wmb();
+	ovl_dentry_set_metacopy(dentry, false);
+out_unlock:
+	mutex_unlock(&upperdir->d_inode->i_mutex);
+	dput(parent);
+	revert_creds(old_cred);
+	put_cred(override_cred);
+
+	return err;
+}
+
+static int ovl_copy_up_flags(struct dentry *dentry, bool metacopy)
 {
 	int err;
 
@@ -406,7 +506,8 @@ int ovl_copy_up(struct dentry *dentry)
 		ovl_path_lower(next, &lowerpath);
 		err = vfs_getattr(&lowerpath, &stat);
 		if (!err)
-			err = ovl_copy_up_one(parent, next, &lowerpath, &stat, NULL);
+			err = ovl_copy_up_one(parent, next, &lowerpath, &stat,
+					      NULL, metacopy && next == dentry);
 
 		dput(parent);
 		dput(next);
@@ -414,3 +515,23 @@ int ovl_copy_up(struct dentry *dentry)
 
 	return err;
 }
+
+int ovl_copy_up(struct dentry *dentry)
+{
+	int err;
+
+	err = ovl_copy_up_flags(dentry, false);
+	if (!err)
+		err = ovl_copy_up_meta_data(dentry, false);
+
+	return err;
+}
+
+/*
+ * Copy up for operations that only change metadata, leaving the data of a
+ * regular file in the lower layer if metacopy is enabled.
+ */
+int ovl_copy_up_meta(struct dentry *dentry)
+{
+	return ovl_copy_up_flags(dentry, true);
+}
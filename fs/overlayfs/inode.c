@@ -33,7 +33,9 @@ static int ovl_copy_up_last(struct dentry *dentry, struct iattr *attr,
 	if (no_data)
 		stat.size = 0;
 
-	err = ovl_copy_up_one(parent, dentry, &lowerpath, &stat, attr);
+	/* Only a truncating open throws away the data, no use in metacopy */
+	err = ovl_copy_up_one(parent, dentry, &lowerpath, &stat, attr,
+			      !no_data);
 
 out_dput_parent:
 	dput(parent);
@@ -51,12 +53,19 @@ int ovl_setattr(struct dentry *dentry, struct iattr *attr)
 
 	upperdentry = ovl_dentry_upper(dentry);
 	if (upperdentry) {
+		/* Truncating a metacopy file needs the data first */
+		if (attr->ia_valid & ATTR_SIZE) {
+			err = ovl_copy_up_meta_data(dentry, false);
+			if (err)
+				goto out_drop_write;
+		}
 		mutex_lock(&upperdentry->d_inode->i_mutex);
 		err = notify_change(upperdentry, attr, NULL);
 		mutex_unlock(&upperdentry->d_inode->i_mutex);
 	} else {
 		err = ovl_copy_up_last(dentry, attr, false);
 	}
+out_drop_write:
 	ovl_drop_write(dentry);
 out:
 	return err;
@@ -66,9 +75,24 @@ static int ovl_getattr(struct vfsmount *mnt, struct dentry *dentry,
 			 struct kstat *stat)
 {
 	struct path realpath;
+	struct path lowerpath;
+	struct kstat lowerstat;
+	int err;
 
 	ovl_path_real(dentry, &realpath);
-	return vfs_getattr(&realpath, stat);
+	err = vfs_getattr(&realpath, stat);
+	if (err || !ovl_dentry_is_metacopy(dentry))
+		return err;
+
+	/* Size and allocation of a metacopy file come from the data */
+	ovl_path_lower(dentry, &lowerpath);
+	err = vfs_getattr(&lowerpath, &lowerstat);
+	if (err)
+		return err;
+
+	stat->size = lowerstat.size;
+	stat->blocks = lowerstat.blocks;
+	return 0;
 }
 
 int ovl_permission(struct inode *inode, int mask)
@@ -222,7 +246,7 @@ int ovl_setxattr(struct dentry *dentry, const char *name,
 	if (ovl_is_private_xattr(name))
 		goto out_drop_write;
 
-	err = ovl_copy_up(dentry);
+	err = ovl_copy_up_meta(dentry);
 	if (err)
 		goto out_drop_write;
 
@@ -239,7 +263,8 @@ static bool ovl_need_xattr_filter(struct dentry *dentry,
 				  enum ovl_path_type type)
 {
 	if ((type & (__OVL_PATH_PURE | __OVL_PATH_UPPER)) == __OVL_PATH_UPPER)
-		return S_ISDIR(dentry->d_inode->i_mode);
+		return S_ISDIR(dentry->d_inode->i_mode) ||
+		       S_ISREG(dentry->d_inode->i_mode);
 	else
 		return false;
 }
@@ -307,7 +332,7 @@ int ovl_removexattr(struct dentry *dentry, const char *name)
 		if (err < 0)
 			goto out_drop_write;
 
-		err = ovl_copy_up(dentry);
+		err = ovl_copy_up_meta(dentry);
 		if (err)
 			goto out_drop_write;
 
@@ -346,7 +371,22 @@ struct inode *ovl_d_select_inode(struct dentry *dentry, unsigned file_flags)
 		return d_backing_inode(dentry);
 
 	type = ovl_path_real(dentry, &realpath);
-	if (ovl_open_need_copy_up(file_flags, type, realpath.dentry)) {
+	if (OVL_TYPE_UPPER(type) && ovl_dentry_is_metacopy(dentry)) {
+		if (!(OPEN_FMODE(file_flags) & FMODE_WRITE) &&
+		    !(file_flags & O_TRUNC)) {
+			ovl_path_lower(dentry, &realpath);
+			return d_backing_inode(realpath.dentry);
+		}
+
+		err = ovl_want_write(dentry);
+		if (err)
+			return ERR_PTR(err);
+
+		err = ovl_copy_up_meta_data(dentry, file_flags & O_TRUNC);
+		ovl_drop_write(dentry);
+		if (err)
+			return ERR_PTR(err);
+	} else if (ovl_open_need_copy_up(file_flags, type, realpath.dentry)) {
 		err = ovl_want_write(dentry);
 		if (err)
 			return ERR_PTR(err);
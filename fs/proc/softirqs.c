@@ -4,10 +4,13 @@
 #include <linux/seq_file.h>
 
 /*
- * /proc/softirqs  ... display the number of softirqs
+ * /proc/softirqs  ... display the number of softirqs, followed by the
+ * time spent in each vector (usecs) and the number of times it exceeded
+ * its budget and was deferred to ksoftirqd
  */
 static int show_softirqs(struct seq_file *p, void *v)
 {
+	char name[24];
 	int i, j;
 
 	seq_puts(p, "                    ");
@@ -21,6 +24,24 @@ static int show_softirqs(struct seq_file *p, void *v)
 			seq_printf(p, " %10u", kstat_softirqs_cpu(i, j));
 		seq_putc(p, '\n');
 	}
+
+	for (i = 0; i < NR_SOFTIRQS; i++) {
+		snprintf(name, sizeof(name), "%s_US", softirq_to_name[i]);
+		seq_printf(p, "%12s:", name);
+		for_each_possible_cpu(j)
+			seq_printf(p, " %10llu",
+				   div_u64(kstat_softirqs_time_cpu(i, j),
+					   NSEC_PER_USEC));
+		seq_putc(p, '\n');
+	}
+
+	for (i = 0; i < NR_SOFTIRQS; i++) {
+		snprintf(name, sizeof(name), "%s_DEFER", softirq_to_name[i]);
+		seq_printf(p, "%12s:", name);
+		for_each_possible_cpu(j)
+			seq_printf(p, " %10u", kstat_softirqs_deferred_cpu(i, j));
+		seq_putc(p, '\n');
+	}
 	return 0;
 }
 
@@ -78,6 +78,33 @@ static struct buffer_head *get_block_length(struct super_block *sb,
 }
 
 
+/*
+ * Start reading the device blocks holding a datablock without waiting for
+ * them, so the I/O for several datablocks can be issued together before
+ * squashfs_read_data() is called on each of them.
+ */
+void squashfs_prefetch_data(struct super_block *sb, u64 index, int length)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	int offset = index & ((1 << msblk->devblksize_log2) - 1);
+	u64 cur_index = index >> msblk->devblksize_log2;
+	struct buffer_head *bh;
+	int bytes;
+
+	length = SQUASHFS_COMPRESSED_SIZE_BLOCK(length);
+	if (length <= 0 || (index + length) > msblk->bytes_used)
+		return;
+
+	for (bytes = -offset; bytes < length; bytes += msblk->devblksize) {
+		bh = sb_getblk(sb, cur_index++);
+		if (bh == NULL)
+			return;
+		ll_rw_block(READA, 1, &bh);
+		put_bh(bh);
+	}
+}
+
+
 /*
  * Read and decompress a metadata block or datablock.  Length is non-zero
  * if a datablock is being read (the size is stored elsewhere in the
@@ -20,8 +20,9 @@
 #include "squashfs.h"
 #include "page_actor.h"
 
-static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
-	int pages, struct page **page);
+static int squashfs_read_cache(struct super_block *sb,
+	struct page *target_page, u64 block, int bsize, int pages,
+	struct page **page);
 
 /* Read separately compressed datablock directly into page cache */
 int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
@@ -34,10 +35,8 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
 	int start_index = target_page->index & ~mask;
 	int end_index = start_index | mask;
-	int i, n, pages, missing_pages, bytes, res = -ENOMEM;
+	int i, n, pages, missing_pages, res = -ENOMEM;
 	struct page **page;
-	struct squashfs_page_actor *actor;
-	void *pageaddr;
 
 	if (end_index > file_end)
 		end_index = file_end;
@@ -48,14 +47,6 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 	if (page == NULL)
 		return res;
 
-	/*
-	 * Create a "page actor" which will kmap and kunmap the
-	 * page cache pages appropriately within the decompressor
-	 */
-	actor = squashfs_page_actor_init_special(page, pages, 0);
-	if (actor == NULL)
-		goto out;
-
 	/* Try to grab all the pages covered by the Squashfs block */
 	for (missing_pages = 0, i = 0, n = start_index; i < pages; i++, n++) {
 		page[i] = (n == target_page->index) ? target_page :
@@ -74,6 +65,36 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 		}
 	}
 
+	res = squashfs_read_block_pages(inode->i_sb, target_page, block, bsize,
+		page, pages, missing_pages);
+
+	kfree(page);
+	return res;
+}
+
+
+/*
+ * Fill the locked page cache pages covering a datablock, mark them
+ * uptodate, unlock them and release all but target_page (which may be
+ * NULL).  Entries of page[] that are NULL weren't available, in which
+ * case the block goes through the intermediate buffer.  On error the
+ * pages other than target_page are marked errored and released.
+ */
+int squashfs_read_block_pages(struct super_block *sb, struct page *target_page,
+	u64 block, int bsize, struct page **page, int pages, int missing_pages)
+{
+	int i, bytes, res = -ENOMEM;
+	struct squashfs_page_actor *actor;
+	void *pageaddr;
+
+	/*
+	 * Create a "page actor" which will kmap and kunmap the
+	 * page cache pages appropriately within the decompressor
+	 */
+	actor = squashfs_page_actor_init_special(page, pages, 0);
+	if (actor == NULL)
+		goto mark_errored;
+
 	if (missing_pages) {
 		/*
 		 * Couldn't get one or more pages, this page has either
@@ -82,7 +103,7 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 		 * squashfs_readpage also trying to grab them.  Fall back to
 		 * using an intermediate buffer.
 		 */
-		res = squashfs_read_cache(target_page, block, bsize, pages,
+		res = squashfs_read_cache(sb, target_page, block, bsize, pages,
 								page);
 		if (res < 0)
 			goto mark_errored;
@@ -91,7 +112,7 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 	}
 
 	/* Decompress directly into the page cache buffers */
-	res = squashfs_read_data(inode->i_sb, block, bsize, NULL, actor);
+	res = squashfs_read_data(sb, block, bsize, NULL, actor);
 	if (res < 0)
 		goto mark_errored;
 
@@ -113,7 +134,6 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 	}
 
 	kfree(actor);
-	kfree(page);
 
 	return 0;
 
@@ -132,16 +152,15 @@ mark_errored:
 
 out:
 	kfree(actor);
-	kfree(page);
 	return res;
 }
 
 
-static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
-	int pages, struct page **page)
+static int squashfs_read_cache(struct super_block *sb,
+	struct page *target_page, u64 block, int bsize, int pages,
+	struct page **page)
 {
-	struct inode *i = target_page->mapping->host;
-	struct squashfs_cache_entry *buffer = squashfs_get_datablock(i->i_sb,
+	struct squashfs_cache_entry *buffer = squashfs_get_datablock(sb,
 						 block, bsize);
 	int bytes = buffer->length, res = buffer->error, n, offset = 0;
 	void *pageaddr;
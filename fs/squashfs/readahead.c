@@ -0,0 +1,211 @@
+/*
+ * Squashfs - a compressed read only filesystem for Linux
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2. See
+ * the COPYING file in the top-level directory.
+ *
+ * readahead.c
+ */
+
+/*
+ * Readahead of file data.
+ *
+ * squashfs_readpage() decompresses one datablock at a time in the reading
+ * task, waiting for its I/O first.  For a readahead window covering many
+ * datablocks that serialises the whole window on one CPU.  Here the pages
+ * of the window are added to the page cache, the I/O for all of its
+ * datablocks is started in one plugged batch, and each datablock is then
+ * decompressed directly into its pages by a work item on an unbound
+ * workqueue.  The pages stay locked until their datablock is done, so
+ * readers simply wait on the page lock as usual.
+ *
+ * Tail-end fragments and sparse blocks are left to squashfs_readpage().
+ */
+
+#include <linux/fs.h>
+#include <linux/vfs.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/pagemap.h>
+#include <linux/blkdev.h>
+#include <linux/workqueue.h>
+
+#include "squashfs_fs.h"
+#include "squashfs_fs_sb.h"
+#include "squashfs_fs_i.h"
+#include "squashfs.h"
+
+static struct workqueue_struct *squashfs_read_wq;
+
+struct squashfs_ra_block {
+	struct work_struct	work;
+	struct list_head	list;
+	struct super_block	*sb;
+	u64			block;
+	int			bsize;
+	int			index;		/* datablock index in file */
+	int			pages;
+	int			missing_pages;
+	struct page		*page[0];
+};
+
+static void squashfs_ra_work(struct work_struct *work)
+{
+	struct squashfs_ra_block *ra = container_of(work,
+					struct squashfs_ra_block, work);
+	int res;
+
+	res = squashfs_read_block_pages(ra->sb, NULL, ra->block, ra->bsize,
+		ra->page, ra->pages, ra->missing_pages);
+	if (res < 0)
+		ERROR("Unable to read page, block %llx, size %x\n", ra->block,
+			ra->bsize);
+	kfree(ra);
+}
+
+static struct squashfs_ra_block *squashfs_ra_alloc(struct inode *inode,
+	int index)
+{
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_CACHE_SHIFT;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int start_index = index << shift;
+	int pages = min(1 << shift, file_end - start_index + 1);
+	struct squashfs_ra_block *ra;
+	u64 block = 0;
+	int bsize;
+
+	bsize = squashfs_read_blocklist(inode, index, &block);
+	if (bsize <= 0)
+		return NULL;
+
+	ra = kzalloc(sizeof(*ra) + pages * sizeof(struct page *), GFP_KERNEL);
+	if (ra == NULL)
+		return NULL;
+
+	INIT_WORK(&ra->work, squashfs_ra_work);
+	ra->sb = inode->i_sb;
+	ra->block = block;
+	ra->bsize = bsize;
+	ra->index = index;
+	ra->pages = pages;
+	return ra;
+}
+
+/*
+ * Grab the pages of the datablock readahead didn't ask for, and issue
+ * the I/O for it.
+ */
+static void squashfs_ra_prepare(struct address_space *mapping,
+	struct squashfs_ra_block *ra)
+{
+	struct squashfs_sb_info *msblk = ra->sb->s_fs_info;
+	int start_index = ra->index << (msblk->block_log - PAGE_CACHE_SHIFT);
+	int i;
+
+	for (i = 0; i < ra->pages; i++) {
+		if (ra->page[i])
+			continue;
+
+		ra->page[i] = grab_cache_page_nowait(mapping, start_index + i);
+		if (ra->page[i] == NULL) {
+			ra->missing_pages++;
+			continue;
+		}
+
+		if (PageUptodate(ra->page[i])) {
+			unlock_page(ra->page[i]);
+			page_cache_release(ra->page[i]);
+			ra->page[i] = NULL;
+			ra->missing_pages++;
+		}
+	}
+
+	squashfs_prefetch_data(ra->sb, ra->block, ra->bsize);
+}
+
+int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_CACHE_SHIFT;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	bool fragment = squashfs_i(inode)->fragment_block !=
+					SQUASHFS_INVALID_BLK;
+	struct squashfs_ra_block *ra = NULL, *next;
+	struct blk_plug plug;
+	LIST_HEAD(blocks);
+
+	blk_start_plug(&plug);
+
+	/* The list is in reverse order, start from the lowest index */
+	while (!list_empty(pages)) {
+		struct page *page = list_entry(pages->prev, struct page, lru);
+		int index = page->index >> shift;
+
+		/*
+		 * Leave the tail end fragment to squashfs_readpage(), it is
+		 * read once into the fragment cache anyway.
+		 */
+		if (index >= file_end && fragment)
+			break;
+
+		if (ra == NULL || ra->index != index) {
+			if (ra) {
+				squashfs_ra_prepare(mapping, ra);
+				list_add_tail(&ra->list, &blocks);
+			}
+			ra = squashfs_ra_alloc(inode, index);
+			if (ra == NULL)
+				break;
+		}
+
+		list_del(&page->lru);
+		if (add_to_page_cache_lru(page, mapping, page->index,
+					  GFP_KERNEL)) {
+			page_cache_release(page);
+			continue;
+		}
+		ra->page[page->index - (index << shift)] = page;
+	}
+
+	if (ra) {
+		squashfs_ra_prepare(mapping, ra);
+		list_add_tail(&ra->list, &blocks);
+	}
+
+	blk_finish_plug(&plug);
+
+	list_for_each_entry_safe(ra, next, &blocks, list)
+		queue_work(squashfs_read_wq, &ra->work);
+
+	/*
+	 * Whatever is left on the list is dropped by read_pages(), those
+	 * pages are read by squashfs_readpage() when they are accessed.
+	 */
+	return 0;
+}
+
+int __init squashfs_readahead_init(void)
+{
+	squashfs_read_wq = alloc_workqueue("squashfs_read", WQ_UNBOUND, 0);
+	if (squashfs_read_wq == NULL)
+		return -ENOMEM;
+	return 0;
+}
+
+void squashfs_readahead_destroy(void)
+{
+	destroy_workqueue(squashfs_read_wq);
+}
+
+/*
+ * The work items still use the caches of the superblock after unlocking
+ * their pages, so evicting the inodes doesn't wait for all of them.
+ * Called from squashfs_put_super() before the caches go away.
+ */
+void squashfs_readahead_flush(void)
+{
+	flush_workqueue(squashfs_read_wq);
+}
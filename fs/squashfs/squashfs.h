@@ -30,6 +30,7 @@
 /* block.c */
 extern int squashfs_read_data(struct super_block *, u64, int, u64 *,
 				struct squashfs_page_actor *);
+extern void squashfs_prefetch_data(struct super_block *, u64, int);
 
 /* cache.c */
 extern struct squashfs_cache *squashfs_cache_init(char *, int, int);
@@ -69,10 +70,37 @@ extern __le64 *squashfs_read_fragment_index_table(struct super_block *,
 /* file.c */
 void squashfs_copy_cache(struct page *, struct squashfs_cache_entry *, int,
 				int);
+extern int squashfs_read_blocklist(struct inode *, int, u64 *);
 
 /* file_xxx.c */
 extern int squashfs_readpage_block(struct page *, u64, int);
 
+/* file_direct.c */
+extern int squashfs_read_block_pages(struct super_block *, struct page *,
+				u64, int, struct page **, int, int);
+
+/* readahead.c */
+#ifdef CONFIG_SQUASHFS_READAHEAD
+extern int squashfs_readahead_init(void);
+extern void squashfs_readahead_destroy(void);
+extern void squashfs_readahead_flush(void);
+extern int squashfs_readpages(struct file *, struct address_space *,
+				struct list_head *, unsigned);
+#else
+static inline int squashfs_readahead_init(void)
+{
+	return 0;
+}
+
+static inline void squashfs_readahead_destroy(void)
+{
+}
+
+static inline void squashfs_readahead_flush(void)
+{
+}
+#endif
+
 /* id.c */
 extern int squashfs_get_id(struct super_block *, unsigned int, unsigned int *);
 extern __le64 *squashfs_read_id_index_table(struct super_block *, u64, u64,
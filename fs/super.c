@@ -191,6 +191,10 @@ static struct super_block *alloc_super(struct file_system_type *type, int flags)
 	INIT_HLIST_NODE(&s->s_instances);
 	INIT_HLIST_BL_HEAD(&s->s_anon);
 	INIT_LIST_HEAD(&s->s_inodes);
+#ifdef CONFIG_FSNOTIFY
+	spin_lock_init(&s->s_fsnotify_lock);
+	INIT_HLIST_HEAD(&s->s_fsnotify_marks);
+#endif
 
 	if (list_lru_init_memcg(&s->s_dentry_lru))
 		goto fail;
@@ -400,6 +404,7 @@ void generic_shutdown_super(struct super_block *sb)
 		sb->s_flags &= ~MS_ACTIVE;
 
 		fsnotify_unmount_inodes(&sb->s_inodes);
+		fsnotify_sb_delete(sb);
 
 		evict_inodes(sb);
 
@@ -86,6 +86,7 @@ struct blk_mq_queue_data {
 
 typedef int (queue_rq_fn)(struct blk_mq_hw_ctx *, const struct blk_mq_queue_data *);
 typedef struct blk_mq_hw_ctx *(map_queue_fn)(struct request_queue *, const int);
+typedef int (map_queues_fn)(struct blk_mq_tag_set *, unsigned int *);
 typedef enum blk_eh_timer_return (timeout_fn)(struct request *, bool);
 typedef int (init_hctx_fn)(struct blk_mq_hw_ctx *, void *, unsigned int);
 typedef void (exit_hctx_fn)(struct blk_mq_hw_ctx *, unsigned int);
@@ -108,6 +109,13 @@ struct blk_mq_ops {
 	 */
 	map_queue_fn		*map_queue;
 
+	/*
+	 * Fill in the cpu -> hardware queue map, usually following the
+	 * irq affinity of the queues.  Optional, the default spreading
+	 * is used if not set or if it fails.
+	 */
+	map_queues_fn		*map_queues;
+
 	/*
 	 * Called on request timeout
 	 */
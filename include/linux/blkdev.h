@@ -45,7 +45,7 @@ struct blk_flush_queue;
  * Maximum number of blkcg policies allowed to be registered concurrently.
  * Defined here to simplify include dependency.
  */
-#define BLKCG_MAX_POLS		2
+#define BLKCG_MAX_POLS		4
 
 struct request;
 typedef void (rq_end_io_fn)(struct request *, int);
@@ -168,6 +168,13 @@ struct request {
 	struct request_list *rl;		/* rl this rq is alloced from */
 	unsigned long long start_time_ns;
 	unsigned long long io_start_time_ns;    /* when passed to hardware */
+#endif
+#ifdef CONFIG_BLK_CGROUP_IOLATENCY
+	struct blkcg_gq *iolat_blkg;		/* charged to for blkio.latency */
+	u64 iolat_start_ns;
+#endif
+#ifdef CONFIG_BLK_CGROUP_IOCOST
+	u64 iocost_start_ns;			/* for blkio.cost.qos feedback */
 #endif
 	/* Number of scatter-gather DMA addr+len pairs after
 	 * physical address coalescing is performed.
@@ -480,6 +487,9 @@ struct request_queue {
 #ifdef CONFIG_BLK_DEV_THROTTLING
 	/* Throttle data */
 	struct throtl_data *td;
+#endif
+#ifdef CONFIG_BLK_CGROUP_IOCOST
+	struct iocost *iocost;
 #endif
 	struct rcu_head		rcu_head;
 	wait_queue_head_t	mq_freeze_wq;
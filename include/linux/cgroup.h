@@ -22,6 +22,7 @@
 #include <linux/seq_file.h>
 #include <linux/kernfs.h>
 #include <linux/wait.h>
+#include <linux/psi_types.h>
 
 #ifdef CONFIG_CGROUPS
 
@@ -88,6 +89,9 @@ struct cgroup_subsys_state {
 	 */
 	u64 serial_nr;
 
+	/* linked on ->cgroup->rstat_css_list if ->ss has css_rstat_flush */
+	struct list_head rstat_css_node;
+
 	/* percpu_ref killing and RCU release */
 	struct rcu_head rcu_head;
 	struct work_struct destroy_work;
@@ -197,6 +201,18 @@ enum {
 	CGRP_CPUSET_CLONE_CHILDREN,
 };
 
+/*
+ * Per-cpu updated tree.  A cgroup with pending stat updates on a cpu is
+ * linked on its parent's ->updated_children through ->updated_next.  The
+ * list ends at the parent itself, and an unlinked cgroup has NULL
+ * ->updated_next.  ->updated_children points to the cgroup itself while
+ * the list is empty.  Protected by the per-cpu cgroup_rstat_cpu_lock.
+ */
+struct cgroup_rstat_cpu {
+	struct cgroup *updated_children;	/* terminated by self cgroup */
+	struct cgroup *updated_next;		/* NULL iff not on the list */
+};
+
 struct cgroup {
 	/* self css with NULL ->ss, points back to this cgroup */
 	struct cgroup_subsys_state self;
@@ -267,6 +283,18 @@ struct cgroup {
 
 	/* used to schedule release agent */
 	struct work_struct release_agent_work;
+
+	/*
+	 * Recursive statistics.  ->rstat_cpu tracks, for each cpu, the
+	 * children which have been updated since the last flush, see
+	 * kernel/cgroup_rstat.c.  ->rstat_css_list lists the csses whose
+	 * ->css_rstat_flush() is called on flush, RCU protected.
+	 */
+	struct cgroup_rstat_cpu __percpu *rstat_cpu;
+	struct list_head rstat_css_list;
+
+	/* used to track pressure stalls */
+	struct psi_group psi;
 };
 
 #define MAX_CGROUP_ROOT_NAMELEN 64
@@ -612,6 +640,15 @@ int cgroup_rm_cftypes(struct cftype *cfts);
 
 bool cgroup_is_descendant(struct cgroup *cgrp, struct cgroup *ancestor);
 
+static inline struct cgroup *cgroup_parent(struct cgroup *cgrp)
+{
+	struct cgroup_subsys_state *parent_css = cgrp->self.parent;
+
+	if (parent_css)
+		return container_of(parent_css, struct cgroup, self);
+	return NULL;
+}
+
 /*
  * Control Group taskset, used to pass around set of tasks to cgroup_subsys
  * methods.
@@ -642,6 +679,7 @@ struct cgroup_subsys {
 	void (*css_free)(struct cgroup_subsys_state *css);
 	void (*css_reset)(struct cgroup_subsys_state *css);
 	void (*css_e_css_changed)(struct cgroup_subsys_state *css);
+	void (*css_rstat_flush)(struct cgroup_subsys_state *css, int cpu);
 
 	int (*can_attach)(struct cgroup_subsys_state *css,
 			  struct cgroup_taskset *tset);
@@ -941,6 +979,14 @@ struct cgroup_subsys_state *cgroup_get_e_css(struct cgroup *cgroup,
 struct cgroup_subsys_state *css_tryget_online_from_dir(struct dentry *dentry,
 						       struct cgroup_subsys *ss);
 
+/* recursive statistics, see kernel/cgroup_rstat.c */
+void cgroup_rstat_updated(struct cgroup *cgrp, int cpu);
+void cgroup_rstat_flush(struct cgroup *cgrp);
+void cgroup_rstat_flush_irqsafe(struct cgroup *cgrp);
+int cgroup_rstat_init(struct cgroup *cgrp);
+void cgroup_rstat_exit(struct cgroup *cgrp);
+void cgroup_rstat_boot(void);
+
 #else /* !CONFIG_CGROUPS */
 
 struct cgroup_subsys_state;
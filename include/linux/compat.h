@@ -304,6 +304,7 @@ struct compat_sysinfo;
 struct compat_sysctl_args;
 struct compat_kexec_segment;
 struct compat_mq_attr;
+struct mq_batch_msg;
 struct compat_msgbuf;
 
 extern void compat_exit_robust_list(struct task_struct *curr);
@@ -662,6 +663,14 @@ asmlinkage ssize_t compat_sys_mq_timedreceive(mqd_t mqdes,
 			char __user *u_msg_ptr,
 			compat_size_t msg_len, unsigned int __user *u_msg_prio,
 			const struct compat_timespec __user *u_abs_timeout);
+asmlinkage long compat_sys_mq_timedsend_batch(mqd_t mqdes,
+			struct mq_batch_msg __user *u_msgs,
+			unsigned int vlen, unsigned int flags,
+			const struct compat_timespec __user *u_abs_timeout);
+asmlinkage long compat_sys_mq_timedreceive_batch(mqd_t mqdes,
+			struct mq_batch_msg __user *u_msgs,
+			unsigned int vlen, unsigned int flags,
+			const struct compat_timespec __user *u_abs_timeout);
 asmlinkage long compat_sys_socketcall(int call, u32 __user *args);
 asmlinkage long compat_sys_sysctl(struct compat_sysctl_args __user *args);
 
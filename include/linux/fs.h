@@ -1354,6 +1354,12 @@ struct super_block {
 	struct workqueue_struct *s_dio_done_wq;
 	struct hlist_head s_pins;
 
+#ifdef CONFIG_FSNOTIFY
+	__u32			s_fsnotify_mask; /* all events sb marks care about */
+	spinlock_t		s_fsnotify_lock; /* protects s_fsnotify_marks */
+	struct hlist_head	s_fsnotify_marks;
+#endif
+
 	/*
 	 * Keep the lru lists last in the structure so they always sit on their
 	 * own individual cachelines.
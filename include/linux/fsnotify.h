@@ -130,17 +130,38 @@ static inline void fsnotify_vfsmount_delete(struct vfsmount *mnt)
 	__fsnotify_vfsmount_delete(mnt);
 }
 
+/*
+ * fsnotify_sb_delete - a superblock is being shut down, clean up is needed
+ */
+static inline void fsnotify_sb_delete(struct super_block *sb)
+{
+	__fsnotify_sb_delete(sb);
+}
+
 /*
  * fsnotify_nameremove - a filename was removed from a directory
  */
 static inline void fsnotify_nameremove(struct dentry *dentry, int isdir)
 {
+	struct dentry *parent;
 	__u32 mask = FS_DELETE;
 
 	if (isdir)
 		mask |= FS_ISDIR;
 
-	fsnotify_parent(NULL, dentry, mask);
+	/*
+	 * Superblock marks want to hear about every directory, not only the
+	 * ones that have a mark watching their children.
+	 */
+	if (!fsnotify_sb_watched(dentry->d_sb, mask)) {
+		fsnotify_parent(NULL, dentry, mask);
+		return;
+	}
+
+	parent = dget_parent(dentry);
+	fsnotify(parent->d_inode, mask, dentry->d_inode, FSNOTIFY_EVENT_INODE,
+		 dentry->d_name.name, 0);
+	dput(parent);
 }
 
 /*
@@ -184,6 +184,7 @@ struct fsnotify_group {
 			atomic_t bypass_perm;
 #endif /* CONFIG_FANOTIFY_ACCESS_PERMISSIONS */
 			int f_flags;
+			unsigned int flags;	/* fanotify_init() flags */
 			unsigned int max_marks;
 			struct user_struct *user;
 		} fanotify_data;
@@ -218,11 +219,12 @@ struct fsnotify_mark {
 					 * the end of SRCU period before it can
 					 * be freed */
 	spinlock_t lock;		/* protect group and inode */
-	struct hlist_node obj_list;	/* list of marks for inode / vfsmount */
+	struct hlist_node obj_list;	/* list of marks for inode / vfsmount / sb */
 	struct list_head free_list;	/* tmp list used when freeing this mark */
 	union {
 		struct inode *inode;	/* inode this mark is associated with */
 		struct vfsmount *mnt;	/* vfsmount this mark is associated with */
+		struct super_block *sb;	/* superblock this mark is associated with */
 	};
 	__u32 ignored_mask;		/* events types to ignore */
 #define FSNOTIFY_MARK_FLAG_INODE		0x01
@@ -230,7 +232,8 @@ struct fsnotify_mark {
 #define FSNOTIFY_MARK_FLAG_OBJECT_PINNED	0x04
 #define FSNOTIFY_MARK_FLAG_IGNORED_SURV_MODIFY	0x08
 #define FSNOTIFY_MARK_FLAG_ALIVE		0x10
-	unsigned int flags;		/* vfsmount or inode mark? */
+#define FSNOTIFY_MARK_FLAG_SUPERBLOCK		0x20
+	unsigned int flags;		/* vfsmount, sb or inode mark? */
 	void (*free_mark)(struct fsnotify_mark *mark); /* called on final put+free */
 };
 
@@ -244,8 +247,15 @@ extern int fsnotify(struct inode *to_tell, __u32 mask, void *data, int data_is,
 extern int __fsnotify_parent(struct path *path, struct dentry *dentry, __u32 mask);
 extern void __fsnotify_inode_delete(struct inode *inode);
 extern void __fsnotify_vfsmount_delete(struct vfsmount *mnt);
+extern void __fsnotify_sb_delete(struct super_block *sb);
 extern u32 fsnotify_get_cookie(void);
 
+/* does any superblock mark on sb care about these events? */
+static inline bool fsnotify_sb_watched(struct super_block *sb, __u32 mask)
+{
+	return sb->s_fsnotify_mask & mask;
+}
+
 static inline int fsnotify_inode_watches_children(struct inode *inode)
 {
 	/* FS_EVENT_ON_CHILD is set if the inode may care */
@@ -328,11 +338,15 @@ extern struct fsnotify_event *fsnotify_remove_first_event(struct fsnotify_group
 extern void fsnotify_recalc_vfsmount_mask(struct vfsmount *mnt);
 /* run all marks associated with an inode and update inode->i_fsnotify_mask */
 extern void fsnotify_recalc_inode_mask(struct inode *inode);
+/* run all marks associated with a superblock and update sb->s_fsnotify_mask */
+extern void fsnotify_recalc_sb_mask(struct super_block *sb);
 extern void fsnotify_init_mark(struct fsnotify_mark *mark, void (*free_mark)(struct fsnotify_mark *mark));
 /* find (and take a reference) to a mark associated with group and inode */
 extern struct fsnotify_mark *fsnotify_find_inode_mark(struct fsnotify_group *group, struct inode *inode);
 /* find (and take a reference) to a mark associated with group and vfsmount */
 extern struct fsnotify_mark *fsnotify_find_vfsmount_mark(struct fsnotify_group *group, struct vfsmount *mnt);
+/* find (and take a reference) to a mark associated with group and superblock */
+extern struct fsnotify_mark *fsnotify_find_sb_mark(struct fsnotify_group *group, struct super_block *sb);
 /* copy the values from old into new */
 extern void fsnotify_duplicate_mark(struct fsnotify_mark *new, struct fsnotify_mark *old);
 /* set the ignored_mask of a mark */
@@ -344,6 +358,9 @@ extern int fsnotify_add_mark(struct fsnotify_mark *mark, struct fsnotify_group *
 			     struct inode *inode, struct vfsmount *mnt, int allow_dups);
 extern int fsnotify_add_mark_locked(struct fsnotify_mark *mark, struct fsnotify_group *group,
 				    struct inode *inode, struct vfsmount *mnt, int allow_dups);
+/* attach the mark to both the group and the superblock */
+extern int fsnotify_add_sb_mark_locked(struct fsnotify_mark *mark, struct fsnotify_group *group,
+				       struct super_block *sb, int allow_dups);
 /* given a group and a mark, flag mark to be freed when all references are dropped */
 extern void fsnotify_destroy_mark(struct fsnotify_mark *mark,
 				  struct fsnotify_group *group);
@@ -353,6 +370,8 @@ extern void fsnotify_destroy_mark_locked(struct fsnotify_mark *mark,
 extern void fsnotify_clear_vfsmount_marks_by_group(struct fsnotify_group *group);
 /* run all the marks in a group, and clear all of the inode marks */
 extern void fsnotify_clear_inode_marks_by_group(struct fsnotify_group *group);
+/* run all the marks in a group, and clear all of the superblock marks */
+extern void fsnotify_clear_sb_marks_by_group(struct fsnotify_group *group);
 /* run all the marks in a group, and clear all of the marks where mark->flags & flags is true*/
 extern void fsnotify_clear_marks_by_group_flags(struct fsnotify_group *group, unsigned int flags);
 /* run all the marks in a group, and flag them to be freed */
@@ -384,6 +403,14 @@ static inline void __fsnotify_inode_delete(struct inode *inode)
 static inline void __fsnotify_vfsmount_delete(struct vfsmount *mnt)
 {}
 
+static inline void __fsnotify_sb_delete(struct super_block *sb)
+{}
+
+static inline bool fsnotify_sb_watched(struct super_block *sb, __u32 mask)
+{
+	return false;
+}
+
 static inline void __fsnotify_update_dcache_flags(struct dentry *dentry)
 {}
 
@@ -38,6 +38,8 @@ struct kernel_cpustat {
 struct kernel_stat {
 	unsigned long irqs_sum;
 	unsigned int softirqs[NR_SOFTIRQS];
+	unsigned int softirqs_deferred[NR_SOFTIRQS];
+	u64 softirqs_time[NR_SOFTIRQS];
 };
 
 DECLARE_PER_CPU(struct kernel_stat, kstat);
@@ -64,6 +66,17 @@ static inline unsigned int kstat_softirqs_cpu(unsigned int irq, int cpu)
        return kstat_cpu(cpu).softirqs[irq];
 }
 
+static inline unsigned int kstat_softirqs_deferred_cpu(unsigned int irq, int cpu)
+{
+	return kstat_cpu(cpu).softirqs_deferred[irq];
+}
+
+/* Time spent in the handler of each softirq vector, in nanoseconds */
+static inline u64 kstat_softirqs_time_cpu(unsigned int irq, int cpu)
+{
+	return kstat_cpu(cpu).softirqs_time[irq];
+}
+
 /*
  * Number of interrupts per specific IRQ source, since bootup
  */
@@ -57,6 +57,8 @@ enum mem_cgroup_events_index {
 	MEM_CGROUP_EVENTS_PGPGOUT,	/* # of pages paged out */
 	MEM_CGROUP_EVENTS_PGFAULT,	/* # of page-faults */
 	MEM_CGROUP_EVENTS_PGMAJFAULT,	/* # of major page-faults */
+	MEM_CGROUP_EVENTS_WORKINGSET_REFAULT,	/* # of detected refaults */
+	MEM_CGROUP_EVENTS_WORKINGSET_ACTIVATE,	/* # of refaults activated */
 	MEM_CGROUP_EVENTS_NSTATS,
 	/* default hierarchy events */
 	MEMCG_LOW = MEM_CGROUP_EVENTS_NSTATS,
@@ -66,6 +68,13 @@ enum mem_cgroup_events_index {
 	MEMCG_NR_EVENTS,
 };
 
+/*
+ * Memory cgroup IDs are restricted to [1, 65535] so that they fit into
+ * an unsigned short, e.g. in swap records and page cache shadow entries.
+ */
+#define MEM_CGROUP_ID_SHIFT	16
+#define MEM_CGROUP_ID_MAX	USHRT_MAX
+
 #ifdef CONFIG_MEMCG
 void mem_cgroup_events(struct mem_cgroup *memcg,
 		       enum mem_cgroup_events_index idx,
@@ -86,6 +95,10 @@ void mem_cgroup_migrate(struct page *oldpage, struct page *newpage,
 
 struct lruvec *mem_cgroup_zone_lruvec(struct zone *, struct mem_cgroup *);
 struct lruvec *mem_cgroup_page_lruvec(struct page *, struct zone *);
+struct mem_cgroup *mem_cgroup_lruvec_memcg(struct lruvec *lruvec);
+
+unsigned short mem_cgroup_id(struct mem_cgroup *memcg);
+struct mem_cgroup *mem_cgroup_from_id(unsigned short id);
 
 bool mem_cgroup_is_descendant(struct mem_cgroup *memcg,
 			      struct mem_cgroup *root);
@@ -252,6 +265,21 @@ static inline struct lruvec *mem_cgroup_page_lruvec(struct page *page,
 	return &zone->lruvec;
 }
 
+static inline struct mem_cgroup *mem_cgroup_lruvec_memcg(struct lruvec *lruvec)
+{
+	return NULL;
+}
+
+static inline unsigned short mem_cgroup_id(struct mem_cgroup *memcg)
+{
+	return 0;
+}
+
+static inline struct mem_cgroup *mem_cgroup_from_id(unsigned short id)
+{
+	return NULL;
+}
+
 static inline struct mem_cgroup *try_get_mem_cgroup_from_page(struct page *page)
 {
 	return NULL;
@@ -22,10 +22,178 @@ static inline int page_is_file_cache(struct page *page)
 	return !PageSwapBacked(page);
 }
 
+#ifdef CONFIG_LRU_GEN
+
+extern struct static_key lru_gen_key;
+
+static inline bool lru_gen_enabled(void)
+{
+	return static_key_false(&lru_gen_key);
+}
+
+static inline int lru_gen_from_seq(unsigned long seq)
+{
+	return seq % MAX_NR_GENS;
+}
+
+/* Returns the generation of @page, or -1 if it is not on a gen list */
+static inline int page_lru_gen(struct page *page)
+{
+	return (int)((READ_ONCE(page->flags) & LRU_GEN_MASK) >>
+		     LRU_GEN_PGOFF) - 1;
+}
+
+static inline bool lru_gen_is_active(struct lruvec *lruvec, int gen)
+{
+	unsigned long max_seq = lruvec->lrugen.max_seq;
+
+	return gen == lru_gen_from_seq(max_seq) ||
+	       gen == lru_gen_from_seq(max_seq - 1);
+}
+
+/*
+ * Account @delta pages of @type in generation @gen.  The generation
+ * counts towards the active or inactive LRU size depending on its age.
+ */
+static inline void lru_gen_update_size(struct lruvec *lruvec, int type,
+				       int gen, int delta)
+{
+	enum lru_list lru = type * LRU_FILE;
+
+	if (lru_gen_is_active(lruvec, gen))
+		lru += LRU_ACTIVE;
+	lruvec->lrugen.nr_pages[gen][type] += delta;
+	mem_cgroup_update_lru_size(lruvec, lru, delta);
+	__mod_zone_page_state(lruvec_zone(lruvec), NR_LRU_BASE + lru, delta);
+}
+
+static inline void lru_gen_set_gen(struct page *page, int gen)
+{
+	set_mask_bits(&page->flags, LRU_GEN_MASK,
+		      (gen + 1UL) << LRU_GEN_PGOFF);
+}
+
+static inline bool lru_gen_add_page(struct lruvec *lruvec, struct page *page)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int type = page_is_file_cache(page);
+	unsigned long seq;
+	int gen;
+
+	if (!lru_gen_enabled() || PageUnevictable(page))
+		return false;
+
+	/*
+	 * Active pages start out in the youngest generation.  Anon pages
+	 * that were never swapped out and pages that reclaim has started
+	 * writing back get one more round in the second oldest, all other
+	 * pages go to the oldest.
+	 */
+	if (PageActive(page))
+		seq = lrugen->max_seq;
+	else if ((!type && !PageSwapCache(page)) ||
+		 (PageReclaim(page) &&
+		  (PageDirty(page) || PageWriteback(page))))
+		seq = lrugen->min_seq[type] + 1;
+	else
+		seq = lrugen->min_seq[type];
+
+	gen = lru_gen_from_seq(seq);
+	VM_BUG_ON_PAGE(page_lru_gen(page) != -1, page);
+	ClearPageActive(page);
+	lru_gen_set_gen(page, gen);
+	lru_gen_update_size(lruvec, type, gen, hpage_nr_pages(page));
+	list_add(&page->lru, &lrugen->lists[gen][type]);
+	return true;
+}
+
+static inline bool lru_gen_del_page(struct lruvec *lruvec, struct page *page,
+				    bool reclaiming)
+{
+	int gen = page_lru_gen(page);
+
+	if (gen < 0)
+		return false;
+
+	lru_gen_update_size(lruvec, page_is_file_cache(page), gen,
+			    -hpage_nr_pages(page));
+	set_mask_bits(&page->flags, LRU_GEN_MASK, 0);
+	list_del(&page->lru);
+	/*
+	 * Pages isolated for anything but reclaim, e.g. migration, keep
+	 * their age as PG_active across the trip off the list.  Pages
+	 * being freed have no references left and must not get it.
+	 */
+	if (!reclaiming && page_count(page) && lru_gen_is_active(lruvec, gen))
+		SetPageActive(page);
+	return true;
+}
+
+static inline bool lru_gen_move_tail(struct lruvec *lruvec, struct page *page)
+{
+	int gen = page_lru_gen(page);
+
+	if (gen < 0)
+		return false;
+
+	list_move_tail(&page->lru,
+		       &lruvec->lrugen.lists[gen][page_is_file_cache(page)]);
+	return true;
+}
+
+static inline void lru_gen_eviction(struct lruvec *lruvec, int type)
+{
+	if (lru_gen_enabled())
+		atomic_long_inc(&lruvec->lrugen.evicted[type]);
+}
+
+static inline void lru_gen_refault(struct lruvec *lruvec, int type)
+{
+	if (lru_gen_enabled())
+		atomic_long_inc(&lruvec->lrugen.refaulted[type]);
+}
+
+#else /* !CONFIG_LRU_GEN */
+
+static inline bool lru_gen_enabled(void)
+{
+	return false;
+}
+
+static inline bool lru_gen_add_page(struct lruvec *lruvec, struct page *page)
+{
+	return false;
+}
+
+static inline bool lru_gen_del_page(struct lruvec *lruvec, struct page *page,
+				    bool reclaiming)
+{
+	return false;
+}
+
+static inline bool lru_gen_move_tail(struct lruvec *lruvec, struct page *page)
+{
+	return false;
+}
+
+static inline void lru_gen_eviction(struct lruvec *lruvec, int type)
+{
+}
+
+static inline void lru_gen_refault(struct lruvec *lruvec, int type)
+{
+}
+
+#endif /* CONFIG_LRU_GEN */
+
 static __always_inline void add_page_to_lru_list(struct page *page,
 				struct lruvec *lruvec, enum lru_list lru)
 {
 	int nr_pages = hpage_nr_pages(page);
+
+	if (lru_gen_add_page(lruvec, page))
+		return;
+
 	mem_cgroup_update_lru_size(lruvec, lru, nr_pages);
 	list_add(&page->lru, &lruvec->lists[lru]);
 	__mod_zone_page_state(lruvec_zone(lruvec), NR_LRU_BASE + lru, nr_pages);
@@ -35,11 +203,27 @@ static __always_inline void del_page_from_lru_list(struct page *page,
 				struct lruvec *lruvec, enum lru_list lru)
 {
 	int nr_pages = hpage_nr_pages(page);
+
+	if (lru_gen_del_page(lruvec, page, false))
+		return;
+
 	mem_cgroup_update_lru_size(lruvec, lru, -nr_pages);
 	list_del(&page->lru);
 	__mod_zone_page_state(lruvec_zone(lruvec), NR_LRU_BASE + lru, -nr_pages);
 }
 
+/*
+ * Move @page to the tail of the LRU list it is on, to be reclaimed next.
+ */
+static __always_inline void move_page_to_lru_tail(struct page *page,
+				struct lruvec *lruvec, enum lru_list lru)
+{
+	if (lru_gen_move_tail(lruvec, page))
+		return;
+
+	list_move_tail(&page->lru, &lruvec->lists[lru]);
+}
+
 /**
  * page_lru_base_type - which LRU list type should a page be on?
  * @page: the page to test
@@ -213,9 +213,43 @@ struct zone_reclaim_stat {
 	unsigned long		recent_scanned[2];
 };
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * The multi-gen LRU sorts the evictable pages of a lruvec into
+ * generations instead of the active and inactive lists.  Generations
+ * are numbered by sequence: max_seq is the youngest, min_seq[] the
+ * oldest of anon (0) and file (1) pages, and seq % MAX_NR_GENS indexes
+ * the lists.  A page's generation is kept in page->flags, see
+ * LRU_GEN_MASK.
+ *
+ * The two youngest generations are what is accounted as active, and
+ * can't be evicted from; at least MIN_NR_GENS generations exist per
+ * type at any time.  Aging adds a generation by walking the page
+ * tables of the processes using the lruvec, eviction takes from the
+ * oldest one.  All of it is protected by zone->lru_lock.
+ */
+#define MIN_NR_GENS		2
+#define MAX_NR_GENS		4
+
+struct lru_gen_struct {
+	unsigned long max_seq;
+	unsigned long min_seq[2];
+	struct list_head lists[MAX_NR_GENS][2];
+	long nr_pages[MAX_NR_GENS][2];
+	/* Decaying eviction and refault counts, balancing anon vs file */
+	atomic_long_t evicted[2];
+	atomic_long_t refaulted[2];
+};
+#endif
+
 struct lruvec {
 	struct list_head lists[NR_LRU_LISTS];
 	struct zone_reclaim_stat reclaim_stat;
+	/* Evictions & activations on the inactive lists */
+	atomic_long_t inactive_age;
+#ifdef CONFIG_LRU_GEN
+	struct lru_gen_struct lrugen;
+#endif
 #ifdef CONFIG_MEMCG
 	struct zone *zone;
 #endif
@@ -491,9 +525,6 @@ struct zone {
 	spinlock_t		lru_lock;
 	struct lruvec		lruvec;
 
-	/* Evictions & activations on the inactive file list */
-	atomic_long_t		inactive_age;
-
 	/*
 	 * When free pages are below this point, additional steps are taken
 	 * when reading the number of free pages to avoid per-cpu counter
@@ -2,11 +2,15 @@
 #define _LINUX_MSG_H
 
 #include <linux/list.h>
+#include <linux/llist.h>
 #include <uapi/linux/msg.h>
 
 /* one msg_msg structure for each message */
 struct msg_msg {
-	struct list_head m_list;
+	union {
+		struct list_head m_list;
+		struct llist_node m_llist;	/* on q_pending */
+	};
 	long m_type;
 	size_t m_ts;		/* message text size */
 	struct msg_msgseg *next;
@@ -29,6 +33,12 @@ struct msg_queue {
 	struct list_head q_messages;
 	struct list_head q_receivers;
 	struct list_head q_senders;
+
+	/* messages of lockless senders, not on q_messages yet */
+	struct llist_head q_pending;
+	/* room reserved by senders, not in q_cbytes/q_qnum yet */
+	atomic_long_t q_pending_bytes;
+	atomic_long_t q_pending_num;
 };
 
 /* Helper routines for sys_msgsnd and sys_msgrcv */
@@ -32,6 +32,7 @@ struct msi_desc {
 	unsigned int irq;
 	unsigned int nvec_used;		/* number of messages */
 	struct list_head list;
+	struct cpumask *affinity;	/* spread affinity, or NULL */
 
 	union {
 		void __iomem *mask_base;
@@ -251,6 +251,7 @@ struct pcie_link_state;
 struct pci_vpd;
 struct pci_sriov;
 struct pci_ats;
+struct irq_affinity;
 
 /*
  * The pci_dev structure is used to describe PCI devices.
@@ -1236,6 +1237,10 @@ static inline int pci_enable_msi_exact(struct pci_dev *dev, int nvec)
 }
 int pci_enable_msix_range(struct pci_dev *dev, struct msix_entry *entries,
 			  int minvec, int maxvec);
+int pci_enable_msix_range_affinity(struct pci_dev *dev,
+				   struct msix_entry *entries, int minvec,
+				   int maxvec, const struct irq_affinity *affd);
+const struct cpumask *pci_irq_get_affinity(struct pci_dev *dev, int nr);
 static inline int pci_enable_msix_exact(struct pci_dev *dev,
 					struct msix_entry *entries, int nvec)
 {
@@ -1267,6 +1272,13 @@ static inline int pci_enable_msix_range(struct pci_dev *dev,
 static inline int pci_enable_msix_exact(struct pci_dev *dev,
 		      struct msix_entry *entries, int nvec)
 { return -ENOSYS; }
+static inline int pci_enable_msix_range_affinity(struct pci_dev *dev,
+		      struct msix_entry *entries, int minvec, int maxvec,
+		      const struct irq_affinity *affd)
+{ return -ENOSYS; }
+static inline const struct cpumask *pci_irq_get_affinity(struct pci_dev *dev,
+							  int nr)
+{ return NULL; }
 #endif
 
 #ifdef CONFIG_PCIEPORTBUS
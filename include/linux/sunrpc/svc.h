@@ -18,6 +18,8 @@
 #include <linux/sunrpc/svcauth.h>
 #include <linux/wait.h>
 #include <linux/mm.h>
+#include <linux/llist.h>
+#include <linux/ktime.h>
 
 /*
  * This is the RPC server thread function prototype
@@ -27,11 +29,22 @@ typedef int		(*svc_thread_fn)(void *);
 /* statistics for svc_pool structures */
 struct svc_pool_stats {
 	atomic_long_t	packets;
-	unsigned long	sockets_queued;
+	atomic_long_t	sockets_queued;
 	atomic_long_t	threads_woken;
 	atomic_long_t	threads_timedout;
 };
 
+/*
+ * Per-request statistics, updated by every thread for every request, so
+ * they are kept per cpu and summed by svc_pool_stats_show().
+ */
+struct svc_pool_cpu_stats {
+	unsigned long	xprts_handled;	/* transports picked up by a thread */
+	u64		wait_ns;	/* ...and how long they waited for it */
+	unsigned long	requests;	/* replies sent */
+	u64		service_ns;	/* from receive to reply sent */
+};
+
 /*
  *
  * RPC service thread pool.
@@ -46,9 +59,14 @@ struct svc_pool {
 	unsigned int		sp_id;	    	/* pool id; also node id on NUMA */
 	spinlock_t		sp_lock;	/* protects all fields */
 	struct list_head	sp_sockets;	/* pending sockets */
+	struct llist_head	sp_ready;	/* sockets queued without sp_lock,
+						 * moved to sp_sockets on dequeue */
+	struct svc_rqst * __percpu *sp_idle_hint; /* last thread to go idle
+						 * on each cpu */
 	unsigned int		sp_nrthreads;	/* # of threads in pool */
 	struct list_head	sp_all_threads;	/* all server threads */
 	struct svc_pool_stats	sp_stats;	/* statistics on pool operation */
+	struct svc_pool_cpu_stats __percpu *sp_cpu_stats;
 #define	SP_TASK_PENDING		(0)		/* still work to do even if no
 						 * xprt is queued. */
 	unsigned long		sp_flags;
@@ -285,6 +303,7 @@ struct svc_rqst {
 	struct svc_cacherep *	rq_cacherep;	/* cache info */
 	struct task_struct	*rq_task;	/* service thread */
 	spinlock_t		rq_lock;	/* per-request lock */
+	ktime_t			rq_stime;	/* when the request was received */
 };
 
 #define SVC_NET(svc_rqst)	(svc_rqst->rq_xprt->xpt_net)
@@ -188,6 +188,8 @@ static inline void tracehook_notify_resume(struct pt_regs *regs)
 	smp_mb__after_atomic();
 	if (unlikely(current->task_works))
 		task_work_run();
+
+	rseq_handle_notify_resume(regs);
 }
 
 #endif	/* <linux/tracehook.h> */
@@ -709,9 +709,22 @@ __SYSCALL(__NR_memfd_create, sys_memfd_create)
 __SYSCALL(__NR_bpf, sys_bpf)
 #define __NR_execveat 281
 __SC_COMP(__NR_execveat, sys_execveat, compat_sys_execveat)
+#define __NR_epoll_ctl_batch 282
+__SYSCALL(__NR_epoll_ctl_batch, sys_epoll_ctl_batch)
+#define __NR_mq_timedsend_batch 283
+__SC_COMP(__NR_mq_timedsend_batch, sys_mq_timedsend_batch, \
+	  compat_sys_mq_timedsend_batch)
+#define __NR_mq_timedreceive_batch 284
+__SC_COMP(__NR_mq_timedreceive_batch, sys_mq_timedreceive_batch, \
+	  compat_sys_mq_timedreceive_batch)
+
+#define __NR_rseq 285
+__SYSCALL(__NR_rseq, sys_rseq)
+#define __NR_membarrier 286
+__SYSCALL(__NR_membarrier, sys_membarrier)
 
 #undef __NR_syscalls
-#define __NR_syscalls 282
+#define __NR_syscalls 287
 
 /*
  * All syscalls below here should go away really,
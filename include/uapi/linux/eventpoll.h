@@ -26,6 +26,19 @@
 #define EPOLL_CTL_DEL 2
 #define EPOLL_CTL_MOD 3
 
+/*
+ * Round-robin the wakeups among the epoll sets that watch the same file
+ * with EPOLLEXCLUSIVE: a set that gets woken goes to the back of the
+ * file's wait queue.  Implies EPOLLEXCLUSIVE.
+ */
+#define EPOLLROUNDROBIN (1 << 27)
+
+/*
+ * Only wake up one of the epoll sets that watch the same file with this
+ * flag set, instead of all of them.  Can only be set with EPOLL_CTL_ADD.
+ */
+#define EPOLLEXCLUSIVE (1 << 28)
+
 /*
  * Request the handling of system wakeup events so as to prevent system suspends
  * from happening while those events are being processed.
@@ -61,6 +74,19 @@ struct epoll_event {
 	__u64 data;
 } EPOLL_PACKED;
 
+/*
+ * One command of epoll_ctl_batch(): the same as an epoll_ctl() call with
+ * @op, @fd and an epoll_event of @events and @data.  The result of the
+ * command is stored in @result.
+ */
+struct epoll_ctl_cmd {
+	__s32 op;
+	__s32 fd;
+	__u32 events;
+	__s32 result;
+	__u64 data;
+};
+
 #ifdef CONFIG_PM_SLEEP
 static inline void ep_take_care_of_epollwakeup(struct epoll_event *epev)
 {
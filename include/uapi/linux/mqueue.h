@@ -18,6 +18,8 @@
 #ifndef _LINUX_MQUEUE_H
 #define _LINUX_MQUEUE_H
 
+#include <linux/types.h>
+
 #define MQ_PRIO_MAX 	32768
 /* per-uid limit of kernel memory used by mqueue, in bytes */
 #define MQ_BYTES_MAX	819200
@@ -30,6 +32,14 @@ struct mq_attr {
 	__kernel_long_t	__reserved[4];	/* ignored for input, zeroed for output */
 };
 
+/* one message for mq_timedsend_batch() and mq_timedreceive_batch() */
+struct mq_batch_msg {
+	__u64	msg_ptr;	/* message buffer				*/
+	__u64	msg_len;	/* message size; buffer size for receive	*/
+	__u32	msg_prio;	/* message priority, set by receive		*/
+	__u32	__reserved;	/* must be zero					*/
+};
+
 /*
  * SIGEV_THREAD implementation:
  * SIGEV_THREAD must be implemented in user space. If SIGEV_THREAD is passed
@@ -190,4 +190,15 @@ struct prctl_mm_map {
 # define PR_FP_MODE_FR		(1 << 0)	/* 64b FP registers */
 # define PR_FP_MODE_FRE		(1 << 1)	/* 32b compatibility */
 
+/* Core scheduling cookies, see sched_core_share_pid() */
+#define PR_SCHED_CORE			47
+# define PR_SCHED_CORE_GET		0
+# define PR_SCHED_CORE_CREATE		1	/* create unique cookie */
+# define PR_SCHED_CORE_SHARE_TO		2	/* push our cookie to pid */
+# define PR_SCHED_CORE_SHARE_FROM	3	/* pull cookie from pid */
+# define PR_SCHED_CORE_MAX		4
+# define PR_SCHED_CORE_SCOPE_THREAD		0
+# define PR_SCHED_CORE_SCOPE_THREAD_GROUP	1
+# define PR_SCHED_CORE_SCOPE_PROCESS_GROUP	2
+
 #endif /* _LINUX_PRCTL_H */
@@ -92,6 +92,32 @@ COMPAT_SYSCALL_DEFINE5(mq_timedreceive, mqd_t, mqdes,
 			u_msg_prio, u_ts);
 }
 
+COMPAT_SYSCALL_DEFINE5(mq_timedsend_batch, mqd_t, mqdes,
+		       struct mq_batch_msg __user *, u_msgs,
+		       unsigned int, vlen, unsigned int, flags,
+		       const struct compat_timespec __user *, u_abs_timeout)
+{
+	struct timespec __user *u_ts;
+
+	if (compat_convert_timespec(&u_ts, u_abs_timeout))
+		return -EFAULT;
+
+	return sys_mq_timedsend_batch(mqdes, u_msgs, vlen, flags, u_ts);
+}
+
+COMPAT_SYSCALL_DEFINE5(mq_timedreceive_batch, mqd_t, mqdes,
+		       struct mq_batch_msg __user *, u_msgs,
+		       unsigned int, vlen, unsigned int, flags,
+		       const struct compat_timespec __user *, u_abs_timeout)
+{
+	struct timespec __user *u_ts;
+
+	if (compat_convert_timespec(&u_ts, u_abs_timeout))
+		return -EFAULT;
+
+	return sys_mq_timedreceive_batch(mqdes, u_msgs, vlen, flags, u_ts);
+}
+
 COMPAT_SYSCALL_DEFINE2(mq_notify, mqd_t, mqdes,
 		       const struct compat_sigevent __user *, u_notification)
 {
@@ -47,8 +47,10 @@
 #define RECV		1
 
 #define STATE_NONE	0
-#define STATE_PENDING	1
-#define STATE_READY	2
+#define STATE_READY	1
+
+/* messages moved under one hold of info->lock by the batch syscalls */
+#define MQ_BATCH_CHUNK	16
 
 struct posix_msg_tree_node {
 	struct rb_node		rb_node;
@@ -69,6 +71,7 @@ struct mqueue_inode_info {
 	wait_queue_head_t wait_q;
 
 	struct rb_root msg_tree;
+	struct rb_node *msg_tree_rightmost;	/* highest priority leaf */
 	struct posix_msg_tree_node *node_cache;
 	struct mq_attr attr;
 
@@ -122,6 +125,15 @@ static int msg_insert(struct msg_msg *msg, struct mqueue_inode_info *info)
 {
 	struct rb_node **p, *parent = NULL;
 	struct posix_msg_tree_node *leaf;
+	bool rightmost = true;
+
+	/* most senders use the highest priority in the queue, or only one */
+	if (info->msg_tree_rightmost) {
+		leaf = rb_entry(info->msg_tree_rightmost,
+				struct posix_msg_tree_node, rb_node);
+		if (likely(leaf->priority == msg->m_type))
+			goto insert_msg;
+	}
 
 	p = &info->msg_tree.rb_node;
 	while (*p) {
@@ -130,9 +142,10 @@ static int msg_insert(struct msg_msg *msg, struct mqueue_inode_info *info)
 
 		if (likely(leaf->priority == msg->m_type))
 			goto insert_msg;
-		else if (msg->m_type < leaf->priority)
+		else if (msg->m_type < leaf->priority) {
 			p = &(*p)->rb_left;
-		else
+			rightmost = false;
+		} else
 			p = &(*p)->rb_right;
 	}
 	if (info->node_cache) {
@@ -145,6 +158,10 @@ static int msg_insert(struct msg_msg *msg, struct mqueue_inode_info *info)
 		INIT_LIST_HEAD(&leaf->msg_list);
 	}
 	leaf->priority = msg->m_type;
+
+	if (rightmost)
+		info->msg_tree_rightmost = &leaf->rb_node;
+
 	rb_link_node(&leaf->rb_node, parent, p);
 	rb_insert_color(&leaf->rb_node, &info->msg_tree);
 insert_msg:
@@ -154,23 +171,35 @@ insert_msg:
 	return 0;
 }
 
+static inline void msg_tree_erase(struct posix_msg_tree_node *leaf,
+				  struct mqueue_inode_info *info)
+{
+	struct rb_node *node = &leaf->rb_node;
+
+	if (info->msg_tree_rightmost == node)
+		info->msg_tree_rightmost = rb_prev(node);
+
+	rb_erase(node, &info->msg_tree);
+	if (info->node_cache) {
+		kfree(leaf);
+	} else {
+		info->node_cache = leaf;
+	}
+}
+
 static inline struct msg_msg *msg_get(struct mqueue_inode_info *info)
 {
-	struct rb_node **p, *parent = NULL;
+	struct rb_node *parent = NULL;
 	struct posix_msg_tree_node *leaf;
 	struct msg_msg *msg;
 
 try_again:
-	p = &info->msg_tree.rb_node;
-	while (*p) {
-		parent = *p;
-		/*
-		 * During insert, low priorities go to the left and high to the
-		 * right.  On receive, we want the highest priorities first, so
-		 * walk all the way to the right.
-		 */
-		p = &(*p)->rb_right;
-	}
+	/*
+	 * During insert, low priorities go to the left and high to the
+	 * right.  On receive, we want the highest priorities first, which
+	 * is the rightmost leaf, cached by msg_insert() and msg_tree_erase().
+	 */
+	parent = info->msg_tree_rightmost;
 	if (!parent) {
 		if (info->attr.mq_curmsgs) {
 			pr_warn_once("Inconsistency in POSIX message queue, "
@@ -185,24 +214,14 @@ try_again:
 		pr_warn_once("Inconsistency in POSIX message queue, "
 			     "empty leaf node but we haven't implemented "
 			     "lazy leaf delete!\n");
-		rb_erase(&leaf->rb_node, &info->msg_tree);
-		if (info->node_cache) {
-			kfree(leaf);
-		} else {
-			info->node_cache = leaf;
-		}
+		msg_tree_erase(leaf, info);
 		goto try_again;
 	} else {
 		msg = list_first_entry(&leaf->msg_list,
 				       struct msg_msg, m_list);
 		list_del(&msg->m_list);
 		if (list_empty(&leaf->msg_list)) {
-			rb_erase(&leaf->rb_node, &info->msg_tree);
-			if (info->node_cache) {
-				kfree(leaf);
-			} else {
-				info->node_cache = leaf;
-			}
+			msg_tree_erase(leaf, info);
 		}
 	}
 	info->attr.mq_curmsgs--;
@@ -245,6 +264,7 @@ static struct inode *mqueue_get_inode(struct super_block *sb,
 		info->qsize = 0;
 		info->user = NULL;	/* set when all is ok */
 		info->msg_tree = RB_ROOT;
+		info->msg_tree_rightmost = NULL;
 		info->node_cache = NULL;
 		memset(&info->attr, 0, sizeof(info->attr));
 		info->attr.mq_maxmsg = min(ipc_ns->mq_msg_max,
@@ -574,10 +594,8 @@ static int wq_sleep(struct mqueue_inode_info *info, int sr,
 		time = schedule_hrtimeout_range_clock(timeout, 0,
 			HRTIMER_MODE_ABS, CLOCK_REALTIME);
 
-		while (ewp->state == STATE_PENDING)
-			cpu_relax();
-
-		if (ewp->state == STATE_READY) {
+		/* pairs with the release in __pipelined_op(), orders ewp->msg */
+		if (smp_load_acquire(&ewp->state) == STATE_READY) {
 			retval = 0;
 			goto out;
 		}
@@ -906,31 +924,39 @@ out_name:
  * bypasses the message array and directly hands the message over to the
  * receiver.
  * The receiver accepts the message and returns without grabbing the queue
- * spinlock. Therefore an intermediate STATE_PENDING state and memory barriers
- * are necessary. The same algorithm is used for sysv semaphores, see
- * ipc/sem.c for more details.
+ * spinlock: the waker queues the task on a wake_q, which holds a reference
+ * to it, before it sets STATE_READY, and wakes it up after dropping the
+ * lock.
  *
  * The same algorithm is used for senders.
  */
 
+static inline void __pipelined_op(struct wake_q_head *wake_q,
+				  struct mqueue_inode_info *info,
+				  struct ext_wait_queue *this)
+{
+	list_del(&this->list);
+	wake_q_add(wake_q, this->task);
+	/* once STATE_READY is set, the task may return and go away */
+	smp_store_release(&this->state, STATE_READY);
+}
+
 /* pipelined_send() - send a message directly to the task waiting in
  * sys_mq_timedreceive() (without inserting message into a queue).
  */
-static inline void pipelined_send(struct mqueue_inode_info *info,
+static inline void pipelined_send(struct wake_q_head *wake_q,
+				  struct mqueue_inode_info *info,
 				  struct msg_msg *message,
 				  struct ext_wait_queue *receiver)
 {
 	receiver->msg = message;
-	list_del(&receiver->list);
-	receiver->state = STATE_PENDING;
-	wake_up_process(receiver->task);
-	smp_wmb();
-	receiver->state = STATE_READY;
+	__pipelined_op(wake_q, info, receiver);
 }
 
 /* pipelined_receive() - if there is task waiting in sys_mq_timedsend()
  * gets its message and put to the queue (we have one free place for sure). */
-static inline void pipelined_receive(struct mqueue_inode_info *info)
+static inline void pipelined_receive(struct wake_q_head *wake_q,
+				     struct mqueue_inode_info *info)
 {
 	struct ext_wait_queue *sender = wq_get_first_waiter(info, SEND);
 
@@ -941,11 +967,8 @@ static inline void pipelined_receive(struct mqueue_inode_info *info)
 	}
 	if (msg_insert(sender->msg, info))
 		return;
-	list_del(&sender->list);
-	sender->state = STATE_PENDING;
-	wake_up_process(sender->task);
-	smp_wmb();
-	sender->state = STATE_READY;
+
+	__pipelined_op(wake_q, info, sender);
 }
 
 SYSCALL_DEFINE5(mq_timedsend, mqd_t, mqdes, const char __user *, u_msg_ptr,
@@ -962,6 +985,7 @@ SYSCALL_DEFINE5(mq_timedsend, mqd_t, mqdes, const char __user *, u_msg_ptr,
 	struct timespec ts;
 	struct posix_msg_tree_node *new_leaf = NULL;
 	int ret = 0;
+	WAKE_Q(wake_q);
 
 	if (u_abs_timeout) {
 		int res = prepare_timeout(u_abs_timeout, &expires, &ts);
@@ -1045,7 +1069,7 @@ SYSCALL_DEFINE5(mq_timedsend, mqd_t, mqdes, const char __user *, u_msg_ptr,
 	} else {
 		receiver = wq_get_first_waiter(info, RECV);
 		if (receiver) {
-			pipelined_send(info, msg_ptr, receiver);
+			pipelined_send(&wake_q, info, msg_ptr, receiver);
 		} else {
 			/* adds message to the queue */
 			ret = msg_insert(msg_ptr, info);
@@ -1058,6 +1082,7 @@ SYSCALL_DEFINE5(mq_timedsend, mqd_t, mqdes, const char __user *, u_msg_ptr,
 	}
 out_unlock:
 	spin_unlock(&info->lock);
+	wake_up_q(&wake_q);
 out_free:
 	if (ret)
 		free_msg(msg_ptr);
@@ -1144,14 +1169,17 @@ SYSCALL_DEFINE5(mq_timedreceive, mqd_t, mqdes, char __user *, u_msg_ptr,
 			msg_ptr = wait.msg;
 		}
 	} else {
+		WAKE_Q(wake_q);
+
 		msg_ptr = msg_get(info);
 
 		inode->i_atime = inode->i_mtime = inode->i_ctime =
 				CURRENT_TIME;
 
 		/* There is now free space in queue. */
-		pipelined_receive(info);
+		pipelined_receive(&wake_q, info);
 		spin_unlock(&info->lock);
+		wake_up_q(&wake_q);
 		ret = 0;
 	}
 	if (ret == 0) {
@@ -1169,6 +1197,313 @@ out:
 	return ret;
 }
 
+/*
+ * Batched send and receive.
+ *
+ * Both move up to @vlen messages described by an array of struct
+ * mq_batch_msg.  Messages are loaded (or copied out) outside of the queue
+ * lock and handed over MQ_BATCH_CHUNK at a time under one hold of it, and
+ * the tasks they wake up are woken after the lock is dropped.  Only the
+ * first message may block; once one message has been moved the call
+ * returns as soon as the queue is full (or empty).  Returns the number of
+ * messages moved, or an error if none was.
+ */
+static inline void __user *u64_to_ptr(__u64 val)
+{
+	return (void __user *)(unsigned long)val;
+}
+
+static struct file *mq_batch_fdget(mqd_t mqdes, fmode_t mode, struct fd *f)
+{
+	*f = fdget(mqdes);
+	if (unlikely(!f->file))
+		return ERR_PTR(-EBADF);
+
+	if (unlikely(f->file->f_op != &mqueue_file_operations ||
+		     !(f->file->f_mode & mode))) {
+		fdput(*f);
+		return ERR_PTR(-EBADF);
+	}
+	audit_file(f->file);
+	return f->file;
+}
+
+/* Hands over or queues messages until the queue is full */
+static unsigned int mq_send_chunk(struct wake_q_head *wake_q,
+				  struct mqueue_inode_info *info,
+				  struct msg_msg **msgs, unsigned int n,
+				  int *err)
+{
+	struct ext_wait_queue *receiver;
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		if (info->attr.mq_curmsgs == info->attr.mq_maxmsg)
+			break;
+		receiver = wq_get_first_waiter(info, RECV);
+		if (receiver) {
+			pipelined_send(wake_q, info, msgs[i], receiver);
+		} else {
+			*err = msg_insert(msgs[i], info);
+			if (*err)
+				break;
+			__do_notify(info);
+		}
+	}
+	return i;
+}
+
+SYSCALL_DEFINE5(mq_timedsend_batch, mqd_t, mqdes,
+		struct mq_batch_msg __user *, u_msgs, unsigned int, vlen,
+		unsigned int, flags, const struct timespec __user *, u_abs_timeout)
+{
+	struct mq_batch_msg m[MQ_BATCH_CHUNK];
+	struct msg_msg *msgs[MQ_BATCH_CHUNK];
+	struct mqueue_inode_info *info;
+	struct ext_wait_queue wait;
+	ktime_t expires, *timeout = NULL;
+	struct timespec ts;
+	struct inode *inode;
+	struct file *file;
+	struct fd f;
+	unsigned int sent = 0, n, done, i;
+	int ret = 0;
+
+	if (flags)
+		return -EINVAL;
+	if (vlen > UIO_MAXIOV)
+		vlen = UIO_MAXIOV;
+	if (!vlen)
+		return 0;
+
+	if (u_abs_timeout) {
+		ret = prepare_timeout(u_abs_timeout, &expires, &ts);
+		if (ret)
+			return ret;
+		timeout = &expires;
+	}
+
+	file = mq_batch_fdget(mqdes, FMODE_WRITE, &f);
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+	inode = file_inode(file);
+	info = MQUEUE_I(inode);
+
+	while (sent < vlen) {
+		struct posix_msg_tree_node *new_leaf = NULL;
+		WAKE_Q(wake_q);
+
+		/* load a chunk of messages before taking the lock */
+		n = min_t(unsigned int, vlen - sent, MQ_BATCH_CHUNK);
+		if (copy_from_user(m, &u_msgs[sent], n * sizeof(*m))) {
+			ret = -EFAULT;
+			break;
+		}
+		for (i = 0; i < n; i++) {
+			if (unlikely(m[i].msg_prio >= (unsigned long) MQ_PRIO_MAX ||
+				     m[i].__reserved)) {
+				ret = -EINVAL;
+				break;
+			}
+			if (unlikely(m[i].msg_len > info->attr.mq_msgsize)) {
+				ret = -EMSGSIZE;
+				break;
+			}
+			audit_mq_sendrecv(mqdes, m[i].msg_len, m[i].msg_prio,
+					  timeout ? &ts : NULL);
+
+			msgs[i] = load_msg(u64_to_ptr(m[i].msg_ptr),
+					   m[i].msg_len);
+			if (IS_ERR(msgs[i])) {
+				ret = PTR_ERR(msgs[i]);
+				break;
+			}
+			msgs[i]->m_ts = m[i].msg_len;
+			msgs[i]->m_type = m[i].msg_prio;
+		}
+		n = i;
+		if (!n)
+			break;
+
+		if (!info->node_cache)
+			new_leaf = kmalloc(sizeof(*new_leaf), GFP_KERNEL);
+
+		spin_lock(&info->lock);
+
+		if (!info->node_cache && new_leaf) {
+			/* Save our speculative allocation into the cache */
+			INIT_LIST_HEAD(&new_leaf->msg_list);
+			info->node_cache = new_leaf;
+		} else {
+			kfree(new_leaf);
+		}
+
+		done = mq_send_chunk(&wake_q, info, msgs, n, &ret);
+		if (!done && !sent && !ret) {
+			if (file->f_flags & O_NONBLOCK) {
+				ret = -EAGAIN;
+			} else {
+				/* queue full, wait for room for the first one */
+				wait.task = current;
+				wait.msg = msgs[0];
+				wait.state = STATE_NONE;
+				ret = wq_sleep(info, SEND, timeout, &wait);
+				/*
+				 * wq_sleep must be called with info->lock held,
+				 * and returns with the lock released
+				 */
+				spin_lock(&info->lock);
+				if (!ret) {
+					done = 1 + mq_send_chunk(&wake_q, info,
+								 msgs + 1, n - 1,
+								 &ret);
+				}
+			}
+		}
+		if (done)
+			inode->i_atime = inode->i_mtime = inode->i_ctime =
+					CURRENT_TIME;
+		spin_unlock(&info->lock);
+		wake_up_q(&wake_q);
+
+		for (i = done; i < n; i++)
+			free_msg(msgs[i]);
+		sent += done;
+		if (done < n || ret)
+			break;
+	}
+
+	fdput(f);
+	return sent ? sent : ret;
+}
+
+SYSCALL_DEFINE5(mq_timedreceive_batch, mqd_t, mqdes,
+		struct mq_batch_msg __user *, u_msgs, unsigned int, vlen,
+		unsigned int, flags, const struct timespec __user *, u_abs_timeout)
+{
+	struct mq_batch_msg m[MQ_BATCH_CHUNK];
+	struct msg_msg *msgs[MQ_BATCH_CHUNK];
+	struct mqueue_inode_info *info;
+	struct ext_wait_queue wait;
+	ktime_t expires, *timeout = NULL;
+	struct timespec ts;
+	struct inode *inode;
+	struct file *file;
+	struct fd f;
+	unsigned int received = 0, n, done, i;
+	bool fault = false;
+	int ret = 0;
+
+	if (flags)
+		return -EINVAL;
+	if (vlen > UIO_MAXIOV)
+		vlen = UIO_MAXIOV;
+	if (!vlen)
+		return 0;
+
+	if (u_abs_timeout) {
+		ret = prepare_timeout(u_abs_timeout, &expires, &ts);
+		if (ret)
+			return ret;
+		timeout = &expires;
+	}
+
+	file = mq_batch_fdget(mqdes, FMODE_READ, &f);
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+	inode = file_inode(file);
+	info = MQUEUE_I(inode);
+
+	while (received < vlen) {
+		struct posix_msg_tree_node *new_leaf = NULL;
+		WAKE_Q(wake_q);
+
+		n = min_t(unsigned int, vlen - received, MQ_BATCH_CHUNK);
+		if (copy_from_user(m, &u_msgs[received], n * sizeof(*m))) {
+			ret = -EFAULT;
+			break;
+		}
+		/* checks if the buffers are big enough */
+		for (i = 0; i < n; i++) {
+			if (unlikely(m[i].msg_len < info->attr.mq_msgsize)) {
+				ret = -EMSGSIZE;
+				break;
+			}
+			audit_mq_sendrecv(mqdes, m[i].msg_len, 0,
+					  timeout ? &ts : NULL);
+		}
+		n = i;
+		if (!n)
+			break;
+
+		/*
+		 * msg_insert really wants us to have a valid, spare node struct
+		 * so it doesn't have to kmalloc a GFP_ATOMIC allocation, but it
+		 * will fall back to that if necessary.
+		 */
+		if (!info->node_cache)
+			new_leaf = kmalloc(sizeof(*new_leaf), GFP_KERNEL);
+
+		spin_lock(&info->lock);
+
+		if (!info->node_cache && new_leaf) {
+			/* Save our speculative allocation into the cache */
+			INIT_LIST_HEAD(&new_leaf->msg_list);
+			info->node_cache = new_leaf;
+		} else {
+			kfree(new_leaf);
+		}
+
+		for (done = 0; done < n && info->attr.mq_curmsgs; done++) {
+			msgs[done] = msg_get(info);
+			/* There is now free space in queue. */
+			pipelined_receive(&wake_q, info);
+		}
+		if (!done && !received) {
+			if (file->f_flags & O_NONBLOCK) {
+				spin_unlock(&info->lock);
+				ret = -EAGAIN;
+			} else {
+				wait.task = current;
+				wait.state = STATE_NONE;
+				ret = wq_sleep(info, RECV, timeout, &wait);
+				if (!ret)
+					msgs[done++] = wait.msg;
+			}
+		} else {
+			if (done)
+				inode->i_atime = inode->i_mtime =
+					inode->i_ctime = CURRENT_TIME;
+			spin_unlock(&info->lock);
+		}
+		wake_up_q(&wake_q);
+
+		/* copy out after dropping the lock */
+		for (i = 0; i < done; i++) {
+			m[i].msg_len = msgs[i]->m_ts;
+			m[i].msg_prio = msgs[i]->m_type;
+			if (store_msg(u64_to_ptr(m[i].msg_ptr), msgs[i],
+				      msgs[i]->m_ts))
+				fault = true;
+			free_msg(msgs[i]);
+		}
+		if (done && copy_to_user(&u_msgs[received], m,
+					 done * sizeof(*m)))
+			fault = true;
+		/* like mq_timedreceive(), messages that faulted are lost */
+		if (fault) {
+			ret = -EFAULT;
+			break;
+		}
+		received += done;
+		if (done < n || ret)
+			break;
+	}
+
+	fdput(f);
+	return received ? received : ret;
+}
+
 /*
  * Notes: the case when user wants us to deregister (with NULL as pointer)
  * and he isn't currently owner of notification, will be silently discarded.
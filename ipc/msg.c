@@ -51,13 +51,7 @@ struct msg_receiver {
 	long			r_msgtype;
 	long			r_maxsize;
 
-	/*
-	 * Mark r_msg volatile so that the compiler
-	 * does not try to get smart and optimize
-	 * it. We rely on this for the lockless
-	 * receive algorithm.
-	 */
-	struct msg_msg		*volatile r_msg;
+	struct msg_msg		*r_msg;
 };
 
 /* one msg_sender for each sleeping sender */
@@ -145,6 +139,9 @@ static int newque(struct ipc_namespace *ns, struct ipc_params *params)
 	INIT_LIST_HEAD(&msq->q_messages);
 	INIT_LIST_HEAD(&msq->q_receivers);
 	INIT_LIST_HEAD(&msq->q_senders);
+	init_llist_head(&msq->q_pending);
+	atomic_long_set(&msq->q_pending_bytes, 0);
+	atomic_long_set(&msq->q_pending_num, 0);
 
 	/* ipc_addid() locks msq upon success. */
 	id = ipc_addid(&msg_ids(ns), &msq->q_perm, ns->msg_ctlmni);
@@ -172,32 +169,138 @@ static inline void ss_del(struct msg_sender *mss)
 		list_del(&mss->list);
 }
 
-static void ss_wakeup(struct list_head *h, int kill)
+static void ss_wakeup(struct list_head *h,
+		      struct wake_q_head *wake_q, bool kill)
 {
 	struct msg_sender *mss, *t;
 
 	list_for_each_entry_safe(mss, t, h, list) {
 		if (kill)
 			mss->list.next = NULL;
-		wake_up_process(mss->tsk);
+		wake_q_add(wake_q, mss->tsk);
 	}
 }
 
-static void expunge_all(struct msg_queue *msq, int res)
+static void expunge_all(struct msg_queue *msq, int res,
+			struct wake_q_head *wake_q)
 {
 	struct msg_receiver *msr, *t;
 
 	list_for_each_entry_safe(msr, t, &msq->q_receivers, r_list) {
-		msr->r_msg = NULL; /* initialize expunge ordering */
-		wake_up_process(msr->r_tsk);
+		wake_q_add(wake_q, msr->r_tsk);
 		/*
-		 * Ensure that the wakeup is visible before setting r_msg as
-		 * the receiving end depends on it: either spinning on a nil,
-		 * or dealing with -EAGAIN cases. See lockless receive part 1
-		 * and 2 in do_msgrcv().
+		 * The wake-queue holds a reference on the task before r_msg
+		 * lets it go.  The release pairs with the acquire in the
+		 * lockless receive in do_msgrcv().
 		 */
-		smp_mb();
-		msr->r_msg = ERR_PTR(res);
+		smp_store_release(&msr->r_msg, ERR_PTR(res));
+	}
+}
+
+/*
+ * Lockless send:
+ * A sender that finds nobody waiting on the queue reserves room for its
+ * message and pushes it onto q_pending without taking the queue lock.
+ * Whoever takes the lock to look at q_messages moves the pending messages
+ * over first (msg_flush_pending()), so the order of the messages is kept.
+ *
+ * Room is reserved in q_pending_bytes/q_pending_num by every sender, locked
+ * or not, and messages are accounted in q_cbytes/q_qnum before their
+ * reservation is dropped.  A reservation is only added if it fits, so
+ * racing senders can't get the queue over its limit, and don't see room
+ * taken by a sender that is going to fail anyway.
+ */
+static bool msg_reserve_one(atomic_long_t *pending, long val, long used,
+			    long limit)
+{
+	long old = atomic_long_read(pending);
+	long cur;
+
+	for (;;) {
+		if (old + val + used > limit)
+			return false;
+		cur = atomic_long_cmpxchg(pending, old, old + val);
+		if (cur == old)
+			return true;
+		old = cur;
+	}
+}
+
+/*
+ * Returns false if there is no room for @msgsz bytes.  @raced is set if a
+ * slot had to be given back after the byte check failed: a locked sender
+ * may have seen it, found the queue full and gone to sleep.
+ */
+static bool msg_reserve(struct msg_queue *msq, size_t msgsz, bool *raced)
+{
+	long qbytes = READ_ONCE(msq->q_qbytes);
+
+	if (!msg_reserve_one(&msq->q_pending_num, 1,
+			     READ_ONCE(msq->q_qnum), qbytes))
+		return false;
+	if (msg_reserve_one(&msq->q_pending_bytes, msgsz,
+			    READ_ONCE(msq->q_cbytes), qbytes))
+		return true;
+
+	atomic_long_dec(&msq->q_pending_num);
+	*raced = true;
+	return false;
+}
+
+static void msg_unreserve(struct msg_queue *msq, size_t msgsz)
+{
+	/* the message must be visible in q_cbytes first */
+	smp_mb__before_atomic();
+	atomic_long_sub(msgsz, &msq->q_pending_bytes);
+	atomic_long_dec(&msq->q_pending_num);
+}
+
+/* Called with the queue lock held */
+static void msg_enqueue(struct ipc_namespace *ns, struct msg_queue *msq,
+			struct msg_msg *msg)
+{
+	list_add_tail(&msg->m_list, &msq->q_messages);
+	msq->q_cbytes += msg->m_ts;
+	msq->q_qnum++;
+	atomic_add(msg->m_ts, &ns->msg_bytes);
+	atomic_inc(&ns->msg_hdrs);
+	msg_unreserve(msq, msg->m_ts);
+}
+
+static int pipelined_send(struct msg_queue *msq, struct msg_msg *msg,
+			  struct wake_q_head *wake_q);
+
+/*
+ * Moves the messages of lockless senders over to waiting receivers or to
+ * q_messages.  Called with the queue lock held.
+ */
+static void msg_flush_pending(struct ipc_namespace *ns, struct msg_queue *msq,
+			      struct wake_q_head *wake_q)
+{
+	struct llist_node *node = llist_del_all(&msq->q_pending);
+	struct msg_msg *msg, *t;
+
+	node = llist_reverse_order(node);
+	llist_for_each_entry_safe(msg, t, node, m_llist) {
+		/* the receiver may free msg as soon as it gets it */
+		size_t msgsz = msg->m_ts;
+
+		if (pipelined_send(msq, msg, wake_q))
+			msg_unreserve(msq, msgsz);
+		else
+			msg_enqueue(ns, msq, msg);
+	}
+}
+
+/* Frees the messages of lockless senders to a removed queue */
+static void msg_drop_pending(struct msg_queue *msq)
+{
+	struct llist_node *node = llist_del_all(&msq->q_pending);
+	struct msg_msg *msg, *t;
+
+	llist_for_each_entry_safe(msg, t, node, m_llist) {
+		msg_unreserve(msq, msg->m_ts);
+		free_msg(msg);
 	}
 }
 
@@ -213,11 +316,19 @@ static void freeque(struct ipc_namespace *ns, struct kern_ipc_perm *ipcp)
 {
 	struct msg_msg *msg, *t;
 	struct msg_queue *msq = container_of(ipcp, struct msg_queue, q_perm);
+	WAKE_Q(wake_q);
 
-	expunge_all(msq, -EIDRM);
-	ss_wakeup(&msq->q_senders, 1);
+	expunge_all(msq, -EIDRM, &wake_q);
+	ss_wakeup(&msq->q_senders, &wake_q, true);
 	msg_rmid(ns, msq);
+	/*
+	 * Pairs with the barrier in msg_send_lockless(): a lockless sender
+	 * either has its message dropped here or sees the queue removed.
+	 */
+	smp_mb();
+	msg_drop_pending(msq);
 	ipc_unlock_object(&msq->q_perm);
+	wake_up_q(&wake_q);
 	rcu_read_unlock();
 
 	list_for_each_entry_safe(msg, t, &msq->q_messages, m_list) {
@@ -342,6 +453,7 @@ static int msgctl_down(struct ipc_namespace *ns, int msqid, int cmd,
 	struct kern_ipc_perm *ipcp;
 	struct msqid64_ds uninitialized_var(msqid64);
 	struct msg_queue *msq;
+	WAKE_Q(wake_q);
 	int err;
 
 	if (cmd == IPC_SET) {
@@ -389,11 +501,11 @@ static int msgctl_down(struct ipc_namespace *ns, int msqid, int cmd,
 		/* sleeping receivers might be excluded by
 		 * stricter permissions.
 		 */
-		expunge_all(msq, -EAGAIN);
+		expunge_all(msq, -EAGAIN, &wake_q);
 		/* sleeping senders might be able to send
 		 * due to a larger queue size.
 		 */
-		ss_wakeup(&msq->q_senders, 0);
+		ss_wakeup(&msq->q_senders, &wake_q, false);
 		break;
 	default:
 		err = -EINVAL;
@@ -402,6 +514,7 @@ static int msgctl_down(struct ipc_namespace *ns, int msqid, int cmd,
 
 out_unlock0:
 	ipc_unlock_object(&msq->q_perm);
+	wake_up_q(&wake_q);
 out_unlock1:
 	rcu_read_unlock();
 out_up:
@@ -497,8 +610,10 @@ static int msgctl_nolock(struct ipc_namespace *ns, int msqid,
 		tbuf.msg_stime  = msq->q_stime;
 		tbuf.msg_rtime  = msq->q_rtime;
 		tbuf.msg_ctime  = msq->q_ctime;
-		tbuf.msg_cbytes = msq->q_cbytes;
-		tbuf.msg_qnum   = msq->q_qnum;
+		tbuf.msg_cbytes = msq->q_cbytes +
+				  atomic_long_read(&msq->q_pending_bytes);
+		tbuf.msg_qnum   = msq->q_qnum +
+				  atomic_long_read(&msq->q_pending_num);
 		tbuf.msg_qbytes = msq->q_qbytes;
 		tbuf.msg_lspid  = msq->q_lspid;
 		tbuf.msg_lrpid  = msq->q_lrpid;
@@ -566,7 +681,8 @@ static int testmsg(struct msg_msg *msg, long type, int mode)
 	return 0;
 }
 
-static inline int pipelined_send(struct msg_queue *msq, struct msg_msg *msg)
+static int pipelined_send(struct msg_queue *msq, struct msg_msg *msg,
+			  struct wake_q_head *wake_q)
 {
 	struct msg_receiver *msr, *t;
 
@@ -577,25 +693,20 @@ static inline int pipelined_send(struct msg_queue *msq, struct msg_msg *msg)
 
 			list_del(&msr->r_list);
 			if (msr->r_maxsize < msg->m_ts) {
-				/* initialize pipelined send ordering */
-				msr->r_msg = NULL;
-				wake_up_process(msr->r_tsk);
-				smp_mb(); /* see barrier comment below */
-				msr->r_msg = ERR_PTR(-E2BIG);
+				wake_q_add(wake_q, msr->r_tsk);
+				smp_store_release(&msr->r_msg, ERR_PTR(-E2BIG));
 			} else {
-				msr->r_msg = NULL;
 				msq->q_lrpid = task_pid_vnr(msr->r_tsk);
 				msq->q_rtime = get_seconds();
-				wake_up_process(msr->r_tsk);
 				/*
-				 * Ensure that the wakeup is visible before
-				 * setting r_msg, as the receiving end depends
-				 * on it. See lockless receive part 1 and 2 in
+				 * The wake-queue holds a reference on the
+				 * task before r_msg lets it go, and the
+				 * release orders the stores above and to the
+				 * message before it.  See lockless receive in
 				 * do_msgrcv().
 				 */
-				smp_mb();
-				msr->r_msg = msg;
-
+				wake_q_add(wake_q, msr->r_tsk);
+				smp_store_release(&msr->r_msg, msg);
 				return 1;
 			}
 		}
@@ -604,6 +715,58 @@ static inline int pipelined_send(struct msg_queue *msq, struct msg_msg *msg)
 	return 0;
 }
 
+/*
+ * Sends @msg without the queue lock if nobody is waiting on the queue and
+ * there is room.  Called under rcu_read_lock(), after the permission
+ * checks.
+ */
+static bool msg_send_lockless(struct ipc_namespace *ns, struct msg_queue *msq,
+			      struct msg_msg *msg)
+{
+	bool raced = false;
+	WAKE_Q(wake_q);
+
+	if (!list_empty(&msq->q_receivers) || !list_empty(&msq->q_senders))
+		return false;
+	if (!msg_reserve(msq, msg->m_ts, &raced)) {
+		/*
+		 * Let the senders that saw our slot check again.  Taking the
+		 * lock orders this against them finding the queue full.
+		 */
+		if (raced) {
+			ipc_lock_object(&msq->q_perm);
+			if (ipc_valid_object(&msq->q_perm))
+				ss_wakeup(&msq->q_senders, &wake_q, false);
+			ipc_unlock_object(&msq->q_perm);
+			wake_up_q(&wake_q);
+		}
+		return false;
+	}
+
+	WRITE_ONCE(msq->q_lspid, task_tgid_vnr(current));
+	WRITE_ONCE(msq->q_stime, get_seconds());
+	llist_add(&msg->m_llist, &msq->q_pending);
+
+	/*
+	 * Pairs with the barriers in do_msgrcv() and freeque(): a receiver
+	 * that is going to sleep sees the message, or we see the receiver
+	 * and hand the message over under the lock.  Same for RMID, which
+	 * drops pending messages.
+	 */
+	smp_mb();
+	if (list_empty(&msq->q_receivers) && ipc_valid_object(&msq->q_perm))
+		return true;
+
+	ipc_lock_object(&msq->q_perm);
+	if (ipc_valid_object(&msq->q_perm))
+		msg_flush_pending(ns, msq, &wake_q);
+	else
+		msg_drop_pending(msq);
+	ipc_unlock_object(&msq->q_perm);
+	wake_up_q(&wake_q);
+	return true;
+}
+
 long do_msgsnd(int msqid, long mtype, void __user *mtext,
 		size_t msgsz, int msgflg)
 {
@@ -611,6 +774,7 @@ long do_msgsnd(int msqid, long mtype, void __user *mtext,
 	struct msg_msg *msg;
 	int err;
 	struct ipc_namespace *ns;
+	WAKE_Q(wake_q);
 
 	ns = current->nsproxy->ipc_ns;
 
@@ -633,10 +797,25 @@ long do_msgsnd(int msqid, long mtype, void __user *mtext,
 		goto out_unlock1;
 	}
 
+	err = -EACCES;
+	if (ipcperms(ns, &msq->q_perm, S_IWUGO))
+		goto out_unlock1;
+
+	err = security_msg_queue_msgsnd(msq, msg, msgflg);
+	if (err)
+		goto out_unlock1;
+
+	if (ipc_valid_object(&msq->q_perm) &&
+	    msg_send_lockless(ns, msq, msg)) {
+		msg = NULL;
+		goto out_unlock1;
+	}
+
 	ipc_lock_object(&msq->q_perm);
 
 	for (;;) {
 		struct msg_sender s;
+		bool raced = false;
 
 		err = -EACCES;
 		if (ipcperms(ns, &msq->q_perm, S_IWUGO))
@@ -652,10 +831,12 @@ long do_msgsnd(int msqid, long mtype, void __user *mtext,
 		if (err)
 			goto out_unlock0;
 
-		if (msgsz + msq->q_cbytes <= msq->q_qbytes &&
-				1 + msq->q_qnum <= msq->q_qbytes) {
+		/* keep the order of the messages of lockless senders */
+		msg_flush_pending(ns, msq, &wake_q);
+
+		/* lockless senders don't sleep on a slot we give back */
+		if (msg_reserve(msq, msgsz, &raced))
 			break;
-		}
 
 		/* queue full, wait: */
 		if (msgflg & IPC_NOWAIT) {
@@ -673,6 +854,8 @@ long do_msgsnd(int msqid, long mtype, void __user *mtext,
 
 		ipc_unlock_object(&msq->q_perm);
 		rcu_read_unlock();
+		wake_up_q(&wake_q);
+		wake_q_init(&wake_q);
 		schedule();
 
 		rcu_read_lock();
@@ -696,14 +879,11 @@ long do_msgsnd(int msqid, long mtype, void __user *mtext,
 	msq->q_lspid = task_tgid_vnr(current);
 	msq->q_stime = get_seconds();
 
-	if (!pipelined_send(msq, msg)) {
+	if (pipelined_send(msq, msg, &wake_q))
+		msg_unreserve(msq, msgsz);
+	else
 		/* no one is waiting for this message, enqueue it */
-		list_add_tail(&msg->m_list, &msq->q_messages);
-		msq->q_cbytes += msgsz;
-		msq->q_qnum++;
-		atomic_add(msgsz, &ns->msg_bytes);
-		atomic_inc(&ns->msg_hdrs);
-	}
+		msg_enqueue(ns, msq, msg);
 
 	err = 0;
 	msg = NULL;
@@ -712,6 +892,7 @@ out_unlock0:
 	ipc_unlock_object(&msq->q_perm);
 out_unlock1:
 	rcu_read_unlock();
+	wake_up_q(&wake_q);
 	if (msg != NULL)
 		free_msg(msg);
 	return err;
@@ -827,6 +1008,7 @@ long do_msgrcv(int msqid, void __user *buf, size_t bufsz, long msgtyp, int msgfl
 	struct msg_queue *msq;
 	struct ipc_namespace *ns;
 	struct msg_msg *msg, *copy = NULL;
+	WAKE_Q(wake_q);
 
 	ns = current->nsproxy->ipc_ns;
 
@@ -865,6 +1047,7 @@ long do_msgrcv(int msqid, void __user *buf, size_t bufsz, long msgtyp, int msgfl
 			goto out_unlock0;
 		}
 
+		msg_flush_pending(ns, msq, &wake_q);
 		msg = find_msg(msq, &msgtyp, mode);
 		if (!IS_ERR(msg)) {
 			/*
@@ -891,7 +1074,7 @@ long do_msgrcv(int msqid, void __user *buf, size_t bufsz, long msgtyp, int msgfl
 			msq->q_cbytes -= msg->m_ts;
 			atomic_sub(msg->m_ts, &ns->msg_bytes);
 			atomic_dec(&ns->msg_hdrs);
-			ss_wakeup(&msq->q_senders, 0);
+			ss_wakeup(&msq->q_senders, &wake_q, false);
 
 			goto out_unlock0;
 		}
@@ -913,49 +1096,57 @@ long do_msgrcv(int msqid, void __user *buf, size_t bufsz, long msgtyp, int msgfl
 		msr_d.r_msg = ERR_PTR(-EAGAIN);
 		__set_current_state(TASK_INTERRUPTIBLE);
 
+		/*
+		 * Pairs with the barrier in msg_send_lockless(): either a
+		 * lockless sender sees us on q_receivers and hands its
+		 * message over, or we see the message here.
+		 */
+		smp_mb();
+		if (!llist_empty(&msq->q_pending)) {
+			list_del(&msr_d.r_list);
+			__set_current_state(TASK_RUNNING);
+			ipc_unlock_object(&msq->q_perm);
+			continue;
+		}
+
 		ipc_unlock_object(&msq->q_perm);
 		rcu_read_unlock();
+		wake_up_q(&wake_q);
+		wake_q_init(&wake_q);
 		schedule();
 
-		/* Lockless receive, part 1:
-		 * Disable preemption.  We don't hold a reference to the queue
-		 * and getting a reference would defeat the idea of a lockless
-		 * operation, thus the code relies on rcu to guarantee the
-		 * existence of msq:
+		/*
+		 * Lockless receive, part 1:
+		 * We don't hold a reference to the queue and getting a
+		 * reference would defeat the idea of a lockless operation,
+		 * thus the code relies on rcu to guarantee the existence of
+		 * msq:
 		 * Prior to destruction, expunge_all(-EIRDM) changes r_msg.
 		 * Thus if r_msg is -EAGAIN, then the queue not yet destroyed.
-		 * rcu_read_lock() prevents preemption between reading r_msg
-		 * and acquiring the q_perm.lock in ipc_lock_object().
 		 */
 		rcu_read_lock();
 
-		/* Lockless receive, part 2:
-		 * Wait until pipelined_send or expunge_all are outside of
-		 * wake_up_process(). There is a race with exit(), see
-		 * ipc/mqueue.c for the details.
-		 */
-		msg = (struct msg_msg *)msr_d.r_msg;
-		while (msg == NULL) {
-			cpu_relax();
-			msg = (struct msg_msg *)msr_d.r_msg;
-		}
-
-		/* Lockless receive, part 3:
-		 * If there is a message or an error then accept it without
-		 * locking.
+		/*
+		 * Lockless receive, part 2:
+		 * pipelined_send() and expunge_all() add us to a wake-queue,
+		 * which holds a reference on us, before setting r_msg with
+		 * release semantics, and wake us up after dropping the lock.
+		 * If we got woken up some other way in between, we either see
+		 * the message or error and go with it, or see -EAGAIN and
+		 * check again under the lock.  The acquire pairs with their
+		 * release, so the message is complete when we see it.
 		 */
+		msg = smp_load_acquire(&msr_d.r_msg);
 		if (msg != ERR_PTR(-EAGAIN))
 			goto out_unlock1;
 
-		/* Lockless receive, part 3:
-		 * Acquire the queue spinlock.
+		/*
+		 * Lockless receive, part 3:
+		 * Acquire the queue spinlock and repeat the test.
 		 */
 		ipc_lock_object(&msq->q_perm);
 
-		/* Lockless receive, part 4:
-		 * Repeat test after acquiring the spinlock.
-		 */
-		msg = (struct msg_msg *)msr_d.r_msg;
+		msg = msr_d.r_msg;
 		if (msg != ERR_PTR(-EAGAIN))
 			goto out_unlock0;
 
@@ -972,6 +1163,7 @@ out_unlock0:
 	ipc_unlock_object(&msq->q_perm);
 out_unlock1:
 	rcu_read_unlock();
+	wake_up_q(&wake_q);
 	if (IS_ERR(msg)) {
 		free_copy(copy);
 		return PTR_ERR(msg);
@@ -1020,8 +1212,8 @@ static int sysvipc_msg_proc_show(struct seq_file *s, void *it)
 		   msq->q_perm.key,
 		   msq->q_perm.id,
 		   msq->q_perm.mode,
-		   msq->q_cbytes,
-		   msq->q_qnum,
+		   msq->q_cbytes + atomic_long_read(&msq->q_pending_bytes),
+		   msq->q_qnum + atomic_long_read(&msq->q_pending_num),
 		   msq->q_lspid,
 		   msq->q_lrpid,
 		   from_kuid_munged(user_ns, msq->q_perm.uid),
@@ -59,6 +59,7 @@
 #include <linux/rwsem.h>
 #include <linux/memory.h>
 #include <linux/ipc_namespace.h>
+#include <linux/percpu.h>
 
 #include <asm/unistd.h>
 
@@ -71,6 +72,80 @@ struct ipc_proc_iface {
 	int (*show)(struct seq_file *, void *);
 };
 
+/*
+ * Per-cpu cache of the last ids looked up by ipc_obtain_object_check(),
+ * which saves the idr walk for tasks that keep operating on the same few
+ * queues or semaphore sets.
+ *
+ * Entries are only filled in by their own cpu with preemption disabled,
+ * and only cleared by ipc_rmid(), which sets perm->deleted before it
+ * looks for the object in the caches.  A cpu that fills in an entry
+ * checks perm->deleted afterwards, so either it sees the object removed
+ * or ipc_rmid() sees its entry.  The object itself is kept alive by rcu.
+ */
+#define IPC_ID_CACHE_SIZE	8
+
+struct ipc_id_cache {
+	struct ipc_ids *ids;
+	int id;
+	struct kern_ipc_perm *perm;
+};
+
+static DEFINE_PER_CPU(struct ipc_id_cache [IPC_ID_CACHE_SIZE], ipc_id_cache);
+
+static inline int ipc_id_cache_slot(int id)
+{
+	return ipcid_to_idx(id) % IPC_ID_CACHE_SIZE;
+}
+
+static struct kern_ipc_perm *ipc_id_cache_lookup(struct ipc_ids *ids, int id)
+{
+	struct ipc_id_cache *c;
+	struct kern_ipc_perm *perm;
+
+	preempt_disable();
+	c = this_cpu_ptr(&ipc_id_cache[ipc_id_cache_slot(id)]);
+	perm = READ_ONCE(c->perm);
+	if (perm && (c->ids != ids || c->id != id))
+		perm = NULL;
+	preempt_enable();
+
+	return perm;
+}
+
+static void ipc_id_cache_insert(struct ipc_ids *ids, int id,
+				struct kern_ipc_perm *perm)
+{
+	struct ipc_id_cache *c;
+
+	preempt_disable();
+	c = this_cpu_ptr(&ipc_id_cache[ipc_id_cache_slot(id)]);
+	c->ids = ids;
+	c->id = id;
+	WRITE_ONCE(c->perm, perm);
+
+	/* pairs with the barrier in ipc_id_cache_remove() */
+	smp_mb();
+	if (READ_ONCE(perm->deleted))
+		cmpxchg(&c->perm, perm, NULL);
+	preempt_enable();
+}
+
+static void ipc_id_cache_remove(struct kern_ipc_perm *ipcp)
+{
+	int slot = ipc_id_cache_slot(ipcp->id);
+	int cpu;
+
+	/* ipcp->deleted must be visible before we look at the caches */
+	smp_mb();
+	for_each_possible_cpu(cpu) {
+		struct ipc_id_cache *c = &per_cpu(ipc_id_cache, cpu)[slot];
+
+		if (READ_ONCE(c->perm) == ipcp)
+			cmpxchg(&c->perm, ipcp, NULL);
+	}
+}
+
 /**
  * ipc_init - initialise ipc subsystem
  *
@@ -392,6 +467,7 @@ void ipc_rmid(struct ipc_ids *ids, struct kern_ipc_perm *ipcp)
 	idr_remove(&ids->ipcs_idr, lid);
 	ids->in_use--;
 	ipcp->deleted = true;
+	ipc_id_cache_remove(ipcp);
 }
 
 /**
@@ -609,20 +685,27 @@ err1:
  * @id: ipc id to look for
  *
  * Similar to ipc_obtain_object() but also checks
- * the ipc object reference counter.
+ * the ipc object reference counter.  Hits in the per-cpu id cache
+ * skip the idr lookup.
  *
  * Call inside the RCU critical section.
  * The ipc object is *not* locked on exit.
  */
 struct kern_ipc_perm *ipc_obtain_object_check(struct ipc_ids *ids, int id)
 {
-	struct kern_ipc_perm *out = ipc_obtain_object(ids, id);
+	struct kern_ipc_perm *out = ipc_id_cache_lookup(ids, id);
 
+	if (out)
+		return out;
+
+	out = ipc_obtain_object(ids, id);
 	if (IS_ERR(out))
 		goto out;
 
 	if (ipc_checkid(out, id))
 		return ERR_PTR(-EIDRM);
+
+	ipc_id_cache_insert(ids, id, out);
 out:
 	return out;
 }
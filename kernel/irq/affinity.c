@@ -0,0 +1,221 @@
+/*
+ * linux/kernel/irq/affinity.c
+ *
+ * Spreading of the interrupt vectors of multiqueue devices over cpus and
+ * NUMA nodes.
+ *
+ * This file is licensed under GPLv2.
+ *
+ * Each vector gets a set of cpus on a single node where possible, sibling
+ * threads are kept together, and every possible cpu ends up in exactly one
+ * vector's mask.  The same masks are meant to be used for the irq affinity
+ * and for the cpu -> queue mapping of the device (blk-mq, XPS), so that
+ * submissions and completions of a queue stay on the same cpus.
+ */
+#include <linux/interrupt.h>
+#include <linux/kernel.h>
+#include <linux/nodemask.h>
+#include <linux/slab.h>
+#include <linux/cpu.h>
+
+static void irq_spread_init_one(struct cpumask *irqmsk, struct cpumask *nmsk,
+				int cpus_per_vec)
+{
+	const struct cpumask *siblmsk;
+	int cpu, sibl;
+
+	while (cpus_per_vec > 0) {
+		cpu = cpumask_first(nmsk);
+		if (cpu >= nr_cpu_ids)
+			return;
+
+		cpumask_clear_cpu(cpu, nmsk);
+		cpumask_set_cpu(cpu, irqmsk);
+		cpus_per_vec--;
+
+		/* If the cpu has siblings, use them first */
+		siblmsk = topology_thread_cpumask(cpu);
+		for (sibl = -1; cpus_per_vec > 0; ) {
+			sibl = cpumask_next(sibl, siblmsk);
+			if (sibl >= nr_cpu_ids)
+				break;
+			if (!cpumask_test_and_clear_cpu(sibl, nmsk))
+				continue;
+			cpumask_set_cpu(sibl, irqmsk);
+			cpus_per_vec--;
+		}
+	}
+}
+
+/*
+ * cpumask_of_node() only covers the cpus which are online on some
+ * architectures, build the node -> possible cpus map from cpu_to_node().
+ */
+static cpumask_var_t *alloc_node_to_possible_cpumask(void)
+{
+	cpumask_var_t *masks;
+	int node, cpu;
+
+	masks = kcalloc(nr_node_ids, sizeof(cpumask_var_t), GFP_KERNEL);
+	if (!masks)
+		return NULL;
+
+	for (node = 0; node < nr_node_ids; node++) {
+		if (!zalloc_cpumask_var(&masks[node], GFP_KERNEL))
+			goto out_unwind;
+	}
+
+	for_each_possible_cpu(cpu)
+		cpumask_set_cpu(cpu, masks[cpu_to_node(cpu)]);
+
+	return masks;
+
+out_unwind:
+	while (--node >= 0)
+		free_cpumask_var(masks[node]);
+	kfree(masks);
+	return NULL;
+}
+
+static void free_node_to_possible_cpumask(cpumask_var_t *masks)
+{
+	int node;
+
+	for (node = 0; node < nr_node_ids; node++)
+		free_cpumask_var(masks[node]);
+	kfree(masks);
+}
+
+static int get_nodes_in_cpumask(cpumask_var_t *node_to_possible,
+				nodemask_t *nodemsk)
+{
+	int n, nodes = 0;
+
+	for (n = 0; n < nr_node_ids; n++) {
+		if (!cpumask_empty(node_to_possible[n])) {
+			node_set(n, *nodemsk);
+			nodes++;
+		}
+	}
+	return nodes;
+}
+
+/**
+ * irq_create_affinity_masks - Create affinity masks for multiqueue spreading
+ * @nvecs:	The total number of vectors
+ * @affd:	Description of the affinity requirements
+ *
+ * Returns an array of @nvecs cpumasks, to be freed with kfree(), or NULL
+ * if there is nothing to spread or the allocation failed.  The vectors
+ * reserved by @affd get irq_default_affinity.
+ */
+struct cpumask *
+irq_create_affinity_masks(int nvecs, const struct irq_affinity *affd)
+{
+	int affv = nvecs - affd->pre_vectors - affd->post_vectors;
+	int last_affv = affd->pre_vectors + affv;
+	int curvec, n, nodes, v, extra_vecs, cpus_per_vec;
+	nodemask_t nodemsk = NODE_MASK_NONE;
+	cpumask_var_t *node_to_possible;
+	struct cpumask *masks = NULL;
+	cpumask_var_t nmsk;
+
+	if (affv <= 0)
+		return NULL;
+
+	if (!zalloc_cpumask_var(&nmsk, GFP_KERNEL))
+		return NULL;
+
+	node_to_possible = alloc_node_to_possible_cpumask();
+	if (!node_to_possible)
+		goto out;
+
+	masks = kcalloc(nvecs, sizeof(*masks), GFP_KERNEL);
+	if (!masks)
+		goto out_node;
+
+	/* Fill out vectors at the beginning that don't need affinity */
+	for (curvec = 0; curvec < affd->pre_vectors; curvec++)
+		cpumask_copy(masks + curvec, irq_default_affinity);
+
+	nodes = get_nodes_in_cpumask(node_to_possible, &nodemsk);
+
+	/*
+	 * No more vectors than nodes: each vector gets whole nodes, handed
+	 * out round robin so that no cpu is left without a vector.
+	 */
+	if (affv <= nodes) {
+		v = 0;
+		for_each_node_mask(n, nodemsk) {
+			cpumask_or(masks + curvec + v, masks + curvec + v,
+				   node_to_possible[n]);
+			if (++v == affv)
+				v = 0;
+		}
+		curvec = last_affv;
+		goto done;
+	}
+
+	for_each_node_mask(n, nodemsk) {
+		int ncpus, vecs_to_assign, vecs_per_node;
+
+		/* Spread the remaining vectors evenly over the remaining nodes */
+		vecs_per_node = max((last_affv - curvec) / nodes, 1);
+
+		cpumask_copy(nmsk, node_to_possible[n]);
+		ncpus = cpumask_weight(nmsk);
+		vecs_to_assign = min(vecs_per_node, ncpus);
+
+		/* Account for rounding errors */
+		extra_vecs = ncpus - vecs_to_assign * (ncpus / vecs_to_assign);
+
+		for (v = 0; curvec < last_affv && v < vecs_to_assign;
+		     curvec++, v++) {
+			cpus_per_vec = ncpus / vecs_to_assign;
+
+			/* Hand out the cpus left over by the division */
+			if (extra_vecs) {
+				cpus_per_vec++;
+				--extra_vecs;
+			}
+			irq_spread_init_one(masks + curvec, nmsk, cpus_per_vec);
+		}
+
+		if (curvec >= last_affv)
+			break;
+		--nodes;
+	}
+
+done:
+	/*
+	 * Fill out vectors at the end that don't need affinity, and those
+	 * left over when there are more vectors than cpus.
+	 */
+	for (; curvec < nvecs; curvec++)
+		cpumask_copy(masks + curvec, irq_default_affinity);
+out_node:
+	free_node_to_possible_cpumask(node_to_possible);
+out:
+	free_cpumask_var(nmsk);
+	return masks;
+}
+EXPORT_SYMBOL_GPL(irq_create_affinity_masks);
+
+/**
+ * irq_calc_affinity_vectors - Calculate the optimal number of vectors
+ * @maxvec:	The maximum number of vectors available
+ * @affd:	Description of the affinity requirements
+ *
+ * Spreading more vectors than there are possible cpus is pointless.
+ */
+int irq_calc_affinity_vectors(int maxvec, const struct irq_affinity *affd)
+{
+	int resv = affd->pre_vectors + affd->post_vectors;
+	int vecs = maxvec - resv;
+
+	if (vecs <= 0)
+		return maxvec;
+
+	return min_t(int, num_possible_cpus(), vecs) + resv;
+}
+EXPORT_SYMBOL_GPL(irq_calc_affinity_vectors);
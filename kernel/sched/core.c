@@ -74,6 +74,7 @@
 #include <linux/binfmts.h>
 #include <linux/context_tracking.h>
 #include <linux/compiler.h>
+#include <linux/prctl.h>
 
 #include <asm/switch_to.h>
 #include <asm/tlb.h>
@@ -802,10 +803,279 @@ static void set_load_weight(struct task_struct *p)
 	load->inv_weight = prio_to_wmult[prio];
 }
 
+#ifdef CONFIG_UCLAMP_TASK
+/*
+ * Utilization clamping: a task can ask, through sched_setattr(), for its
+ * utilization to be taken as at least util_min and at most util_max when
+ * picking a cpu or a frequency.  The clamps of the runnable RT and CFS
+ * tasks are aggregated per rq, see struct uclamp_rq, and the task groups
+ * other than the root cap what their tasks can ask for, see
+ * cpu.uclamp.{min,max}.
+ */
+static DEFINE_MUTEX(uclamp_mutex);
+
+static inline unsigned int uclamp_none(enum uclamp_id clamp_id)
+{
+	if (clamp_id == UCLAMP_MIN)
+		return 0;
+	return SCHED_CAPACITY_SCALE;
+}
+
+static inline void uclamp_se_set(struct uclamp_se *uc_se, unsigned int value,
+				 bool user_defined)
+{
+	struct uclamp_se uc = {
+		.value = value,
+		.bucket_id = min_t(unsigned int, value / UCLAMP_BUCKET_DELTA,
+				   UCLAMP_BUCKETS - 1),
+		.user_defined = user_defined,
+	};
+
+	/* in one go, readers don't all hold uclamp_mutex */
+	*uc_se = uc;
+}
+
+/*
+ * The clamp asked for by @p, capped by its task group.  A task which
+ * didn't ask for a clamp gets that of its group.
+ */
+static struct uclamp_se
+uclamp_eff_get(struct task_struct *p, enum uclamp_id clamp_id)
+{
+	struct uclamp_se uc_req = p->uclamp_req[clamp_id];
+#ifdef CONFIG_UCLAMP_TASK_GROUP
+	struct task_group *tg = task_group(p);
+	struct uclamp_se uc_max;
+
+	if (tg == &root_task_group || task_group_is_autogroup(tg))
+		return uc_req;
+
+	uc_max = tg->uclamp[clamp_id];
+	if (uc_max.value < uc_req.value || !uc_req.user_defined)
+		return uc_max;
+#endif
+	return uc_req;
+}
+
+unsigned int uclamp_eff_value(struct task_struct *p, enum uclamp_id clamp_id)
+{
+	if (p->uclamp[clamp_id].active)
+		return p->uclamp[clamp_id].value;
+
+	return uclamp_eff_get(p, clamp_id).value;
+}
+
+/*
+ * The clamp of @rq once its bucket holding @clamp_value emptied: that of
+ * the highest bucket still in use.  With none left, UCLAMP_MAX keeps the
+ * value of the last task, so that frequency doesn't shoot up while the cpu
+ * is idle, until the next task comes in.
+ */
+static unsigned int uclamp_rq_max_value(struct rq *rq, enum uclamp_id clamp_id,
+					unsigned int clamp_value)
+{
+	struct uclamp_bucket *bucket = rq->uclamp[clamp_id].bucket;
+	int bucket_id;
+
+	for (bucket_id = UCLAMP_BUCKETS - 1; bucket_id >= 0; bucket_id--) {
+		if (bucket[bucket_id].tasks)
+			return bucket[bucket_id].value;
+	}
+
+	if (clamp_id == UCLAMP_MIN)
+		return uclamp_none(UCLAMP_MIN);
+
+	rq->uclamp_flags |= UCLAMP_FLAG_IDLE;
+	return clamp_value;
+}
+
+static void uclamp_rq_inc_id(struct rq *rq, struct task_struct *p,
+			     enum uclamp_id clamp_id)
+{
+	struct uclamp_rq *uc_rq = &rq->uclamp[clamp_id];
+	struct uclamp_se *uc_se = &p->uclamp[clamp_id];
+	struct uclamp_bucket *bucket;
+
+	*uc_se = uclamp_eff_get(p, clamp_id);
+	uc_se->active = true;
+
+	bucket = &uc_rq->bucket[uc_se->bucket_id];
+	bucket->tasks++;
+	if (bucket->tasks == 1 || uc_se->value > bucket->value)
+		bucket->value = uc_se->value;
+
+	/*
+	 * The first task after idle sets UCLAMP_MAX, see
+	 * uclamp_rq_max_value().  That may be a task whose clamp is being
+	 * updated while it is the only one queued, so the idle state ends
+	 * here rather than in uclamp_rq_inc().
+	 */
+	if ((rq->uclamp_flags & UCLAMP_FLAG_IDLE) && clamp_id == UCLAMP_MAX) {
+		WRITE_ONCE(uc_rq->value, uc_se->value);
+		rq->uclamp_flags &= ~UCLAMP_FLAG_IDLE;
+	} else if (uc_se->value > uc_rq->value)
+		WRITE_ONCE(uc_rq->value, uc_se->value);
+}
+
+static void uclamp_rq_dec_id(struct rq *rq, struct task_struct *p,
+			     enum uclamp_id clamp_id)
+{
+	struct uclamp_rq *uc_rq = &rq->uclamp[clamp_id];
+	struct uclamp_se *uc_se = &p->uclamp[clamp_id];
+	struct uclamp_bucket *bucket;
+
+	bucket = &uc_rq->bucket[uc_se->bucket_id];
+	if (!WARN_ON_ONCE(!bucket->tasks))
+		bucket->tasks--;
+	uc_se->active = false;
+
+	/*
+	 * While the bucket is in use its value may be that of a task that
+	 * has left, which overestimates the clamp by less than a bucket.
+	 */
+	if (bucket->tasks)
+		return;
+
+	if (bucket->value >= uc_rq->value)
+		WRITE_ONCE(uc_rq->value,
+			   uclamp_rq_max_value(rq, clamp_id, bucket->value));
+}
+
+static inline void uclamp_rq_inc(struct rq *rq, struct task_struct *p)
+{
+	enum uclamp_id clamp_id;
+
+	if (p->sched_class != &fair_sched_class &&
+	    p->sched_class != &rt_sched_class)
+		return;
+
+	for (clamp_id = 0; clamp_id < UCLAMP_CNT; clamp_id++)
+		uclamp_rq_inc_id(rq, p, clamp_id);
+}
+
+static inline void uclamp_rq_dec(struct rq *rq, struct task_struct *p)
+{
+	enum uclamp_id clamp_id;
+
+	for (clamp_id = 0; clamp_id < UCLAMP_CNT; clamp_id++) {
+		if (p->uclamp[clamp_id].active)
+			uclamp_rq_dec_id(rq, p, clamp_id);
+	}
+}
+
+/*
+ * Clamp @load, the percentage of its capacity @cpu was busy for according
+ * to a cpufreq governor, to the clamps of the tasks runnable there.
+ */
+unsigned int uclamp_cpu_load(int cpu, unsigned int load)
+{
+	struct rq *rq = cpu_rq(cpu);
+	unsigned int min, max;
+
+	if (!READ_ONCE(rq->nr_running))
+		return load;
+
+	min = READ_ONCE(rq->uclamp[UCLAMP_MIN].value);
+	max = READ_ONCE(rq->uclamp[UCLAMP_MAX].value);
+
+	return clamp_t(unsigned int, load,
+		       DIV_ROUND_UP(min * 100, SCHED_CAPACITY_SCALE),
+		       DIV_ROUND_UP(max * 100, SCHED_CAPACITY_SCALE));
+}
+EXPORT_SYMBOL_GPL(uclamp_cpu_load);
+
+static int uclamp_validate(struct task_struct *p,
+			   const struct sched_attr *attr)
+{
+	unsigned int lower = p->uclamp_req[UCLAMP_MIN].value;
+	unsigned int upper = p->uclamp_req[UCLAMP_MAX].value;
+
+	if (attr->sched_flags & SCHED_FLAG_UTIL_CLAMP_MIN)
+		lower = attr->sched_util_min;
+	if (attr->sched_flags & SCHED_FLAG_UTIL_CLAMP_MAX)
+		upper = attr->sched_util_max;
+
+	if (lower > upper || upper > SCHED_CAPACITY_SCALE)
+		return -EINVAL;
+
+	return 0;
+}
+
+/* Called with @p dequeued, if it was queued. */
+static void __setscheduler_uclamp(struct task_struct *p,
+				  const struct sched_attr *attr)
+{
+	if (attr->sched_flags & SCHED_FLAG_UTIL_CLAMP_MIN)
+		uclamp_se_set(&p->uclamp_req[UCLAMP_MIN],
+			      attr->sched_util_min, true);
+	if (attr->sched_flags & SCHED_FLAG_UTIL_CLAMP_MAX)
+		uclamp_se_set(&p->uclamp_req[UCLAMP_MAX],
+			      attr->sched_util_max, true);
+}
+
+static void uclamp_fork(struct task_struct *p)
+{
+	enum uclamp_id clamp_id;
+
+	for (clamp_id = 0; clamp_id < UCLAMP_CNT; clamp_id++)
+		p->uclamp[clamp_id].active = false;
+
+	if (likely(!p->sched_reset_on_fork))
+		return;
+
+	for (clamp_id = 0; clamp_id < UCLAMP_CNT; clamp_id++)
+		uclamp_se_set(&p->uclamp_req[clamp_id],
+			      uclamp_none(clamp_id), false);
+}
+
+static void __init init_uclamp(void)
+{
+	enum uclamp_id clamp_id;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct rq *rq = cpu_rq(cpu);
+
+		memset(rq->uclamp, 0, sizeof(rq->uclamp));
+		rq->uclamp[UCLAMP_MAX].value = uclamp_none(UCLAMP_MAX);
+		rq->uclamp_flags = UCLAMP_FLAG_IDLE;
+	}
+
+	for (clamp_id = 0; clamp_id < UCLAMP_CNT; clamp_id++) {
+		uclamp_se_set(&init_task.uclamp_req[clamp_id],
+			      uclamp_none(clamp_id), false);
+#ifdef CONFIG_UCLAMP_TASK_GROUP
+		/* the root group caps nothing, its children up to 100% */
+		uclamp_se_set(&root_task_group.uclamp_req[clamp_id],
+			      uclamp_none(UCLAMP_MAX), false);
+		root_task_group.uclamp[clamp_id] =
+			root_task_group.uclamp_req[clamp_id];
+		root_task_group.uclamp_pct[clamp_id] = 100;
+#endif
+	}
+}
+#else
+static inline void uclamp_rq_inc(struct rq *rq, struct task_struct *p) { }
+static inline void uclamp_rq_dec(struct rq *rq, struct task_struct *p) { }
+
+static inline int uclamp_validate(struct task_struct *p,
+				  const struct sched_attr *attr)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline void __setscheduler_uclamp(struct task_struct *p,
+					 const struct sched_attr *attr) { }
+static inline void uclamp_fork(struct task_struct *p) { }
+static inline void init_uclamp(void) { }
+#endif /* CONFIG_UCLAMP_TASK */
+
 static void enqueue_task(struct rq *rq, struct task_struct *p, int flags)
 {
 	update_rq_clock(rq);
 	sched_info_queued(rq, p);
+	psi_enqueue(p, flags & ENQUEUE_WAKEUP);
+	uclamp_rq_inc(rq, p);
 	p->sched_class->enqueue_task(rq, p, flags);
 }
 
@@ -813,6 +1083,8 @@ static void dequeue_task(struct rq *rq, struct task_struct *p, int flags)
 {
 	update_rq_clock(rq);
 	sched_info_dequeued(rq, p);
+	psi_dequeue(p, flags & DEQUEUE_SLEEP);
+	uclamp_rq_dec(rq, p);
 	p->sched_class->dequeue_task(rq, p, flags);
 }
 
@@ -1049,6 +1321,7 @@ void set_task_cpu(struct task_struct *p, unsigned int new_cpu)
 		if (p->sched_class->migrate_task_rq)
 			p->sched_class->migrate_task_rq(p, new_cpu);
 		p->se.nr_migrations++;
+		rseq_migrate(p);
 		perf_sw_event_sched(PERF_COUNT_SW_CPU_MIGRATIONS, 1, 0);
 	}
 
@@ -1696,6 +1969,7 @@ try_to_wake_up(struct task_struct *p, unsigned int state, int wake_flags)
 	cpu = select_task_rq(p, p->wake_cpu, SD_BALANCE_WAKE, wake_flags);
 	if (task_cpu(p) != cpu) {
 		wake_flags |= WF_MIGRATED;
+		psi_ttwu_dequeue(p);
 		set_task_cpu(p, cpu);
 	}
 #endif /* CONFIG_SMP */
@@ -1769,6 +2043,50 @@ int wake_up_state(struct task_struct *p, unsigned int state)
 	return try_to_wake_up(p, state, 0);
 }
 
+void wake_q_add(struct wake_q_head *head, struct task_struct *task)
+{
+	struct wake_q_node *node = &task->wake_q;
+
+	/*
+	 * Atomically grab the task, if ->wake_q is !nil already it means
+	 * it's already queued (either by us or someone else) and will get the
+	 * wakeup due to that.
+	 *
+	 * This cmpxchg() implies a full barrier, which pairs with the write
+	 * barrier implied by the wakeup in wake_up_q().
+	 */
+	if (cmpxchg(&node->next, NULL, WAKE_Q_TAIL))
+		return;
+
+	get_task_struct(task);
+
+	/* The head is context local, there can be no concurrency. */
+	*head->lastp = node;
+	head->lastp = &node->next;
+}
+
+void wake_up_q(struct wake_q_head *head)
+{
+	struct wake_q_node *node = head->first;
+
+	while (node != WAKE_Q_TAIL) {
+		struct task_struct *task;
+
+		task = container_of(node, struct task_struct, wake_q);
+		BUG_ON(!task);
+		/* task can safely be re-inserted now */
+		node = node->next;
+		task->wake_q.next = NULL;
+
+		/*
+		 * wake_up_process() implies a wmb() to pair with the queueing
+		 * in wake_q_add() so as not to miss wakeups.
+		 */
+		wake_up_process(task);
+		put_task_struct(task);
+	}
+}
+
 /*
  * This function clears the sched_dl_entity static params.
  */
@@ -1796,6 +2114,10 @@ void __dl_clear_params(struct task_struct *p)
 static void __sched_fork(unsigned long clone_flags, struct task_struct *p)
 {
 	p->on_rq			= 0;
+#ifdef CONFIG_PSI
+	p->psi_flags			= 0;
+	p->sched_psi_wake_requeue	= 0;
+#endif
 
 	p->se.on_rq			= 0;
 	p->se.exec_start		= 0;
@@ -1907,6 +2229,8 @@ int sched_fork(unsigned long clone_flags, struct task_struct *p)
 	 */
 	p->prio = current->normal_prio;
 
+	uclamp_fork(p);
+
 	/*
 	 * Revert to default priority/policy on fork if requested.
 	 */
@@ -2179,6 +2503,7 @@ prepare_task_switch(struct rq *rq, struct task_struct *prev,
 	trace_sched_switch(prev, next);
 	sched_info_switch(rq, prev, next);
 	perf_event_task_sched_out(prev, next);
+	rseq_preempt(prev);
 	fire_sched_out_preempt_notifiers(prev, next);
 	prepare_lock_switch(rq, next);
 	prepare_arch_switch(next);
@@ -2488,6 +2813,272 @@ unsigned long long task_sched_runtime(struct task_struct *p)
 	return ns;
 }
 
+#ifdef CONFIG_SCHED_CORE
+/*
+ * Core scheduling: SMT siblings share caches and execution units, so tasks
+ * that don't trust each other must not run on the same core at the same
+ * time.  Tasks carry a cookie, from prctl(PR_SCHED_CORE) or else from the
+ * cpu.core_tag of their cgroup, and siblings only run tasks with the same
+ * cookie together; untagged tasks have cookie 0 and only run next to each
+ * other.
+ *
+ * After pick_next_task() a cpu publishes what it runs in its rq, under the
+ * core_lock of the first sibling.  If a sibling runs another cookie the cpu
+ * runs its idle task instead, "forced idle", until the sibling changes what
+ * it runs and kicks it into picking again.  To keep one cookie from holding
+ * a core forever, a busy cpu hands the core over, by going forced idle in
+ * turn, to a sibling that has waited for longer than sysctl_sched_latency
+ * and longer than itself.
+ */
+static struct static_key sched_core_used = STATIC_KEY_INIT_FALSE;
+static DEFINE_MUTEX(sched_core_mutex);
+static atomic_long_t sched_core_cookie_seq;
+
+static inline unsigned long sched_core_cookie(struct task_struct *p)
+{
+	if (p->core_cookie)
+		return p->core_cookie;
+#ifdef CONFIG_CGROUP_SCHED
+	return READ_ONCE(task_group(p)->core_cookie);
+#else
+	return 0;
+#endif
+}
+
+/* Called with sched_core_mutex held; cookies are never 0. */
+static unsigned long sched_core_alloc_cookie(void)
+{
+	if (!static_key_enabled(&sched_core_used))
+		static_key_slow_inc(&sched_core_used);
+
+	return atomic_long_inc_return(&sched_core_cookie_seq);
+}
+
+static inline struct rq *sched_core_rq(int cpu)
+{
+	return cpu_rq(cpumask_first(cpu_smt_mask(cpu)));
+}
+
+/*
+ * Whether the forced idle sibling @srq should be handed the core @rq runs
+ * on: it must have waited long enough, and longer than @rq.
+ */
+static bool sched_core_handover(struct rq *rq, struct rq *srq, u64 now)
+{
+	u64 start = srq->core_forceidle_start;
+	u64 ours = rq->core_forceidle_start;
+
+	if (!start || (s64)(now - start) < (s64)sysctl_sched_latency)
+		return false;
+	if (!ours)
+		return true;
+
+	return start < ours || (start == ours && cpu_of(srq) < cpu_of(rq));
+}
+
+/* Make the forced idle siblings of @cpu pick again. */
+static void sched_core_kick(int cpu)
+{
+	int i;
+
+	for_each_cpu(i, cpu_smt_mask(cpu)) {
+		struct rq *srq = cpu_rq(i);
+
+		if (i == cpu || !READ_ONCE(srq->core_forceidle_start))
+			continue;
+		if (set_nr_and_not_polling(srq->idle))
+			smp_send_reschedule(i);
+	}
+}
+
+/*
+ * Called by __schedule() with rq->lock held, after @next was picked.
+ * Returns the task to run instead, the idle task if @next can't run next
+ * to what the siblings run.
+ */
+static struct task_struct *
+sched_core_pick(struct rq *rq, struct task_struct *next)
+{
+	int i, cpu = cpu_of(rq);
+	struct rq *core = sched_core_rq(cpu);
+	unsigned long cookie = 0;
+	bool busy, forceidle = false, kick;
+	u64 now;
+
+	busy = next != rq->idle && next->sched_class != &stop_sched_class;
+	if (busy)
+		cookie = sched_core_cookie(next);
+
+	raw_spin_lock(&core->core_lock);
+	now = sched_clock_cpu(cpu);
+	for_each_cpu(i, cpu_smt_mask(cpu)) {
+		struct rq *srq = cpu_rq(i);
+
+		if (i == cpu || !busy)
+			continue;
+		if (srq->core_busy && srq->core_cookie != cookie)
+			forceidle = true;
+		else if (srq->core_wait_cookie != cookie &&
+			 sched_core_handover(rq, srq, now))
+			forceidle = true;
+	}
+
+	/* whatever we ran or waited for before, siblings may now run */
+	kick = rq->core_busy || rq->core_forceidle_start;
+
+	if (forceidle) {
+		if (!rq->core_forceidle_start)
+			rq->core_forceidle_start = now;
+		rq->core_wait_cookie = cookie;
+		rq->core_busy = 0;
+		next = idle_sched_class.pick_next_task(rq, next);
+	} else {
+		if (rq->core_forceidle_start) {
+			rq->core_forceidle_sum += now - rq->core_forceidle_start;
+			rq->core_forceidle_start = 0;
+		}
+		rq->core_busy = busy;
+		rq->core_cookie = cookie;
+	}
+	raw_spin_unlock(&core->core_lock);
+
+	if (kick)
+		sched_core_kick(cpu);
+
+	return next;
+}
+
+/* Called by scheduler_tick() with rq->lock held. */
+static void sched_core_tick(struct rq *rq)
+{
+	int i, cpu = cpu_of(rq);
+	struct rq *core = sched_core_rq(cpu);
+	u64 now;
+
+	if (!rq->core_busy)
+		return;
+
+	raw_spin_lock(&core->core_lock);
+	now = sched_clock_cpu(cpu);
+	for_each_cpu(i, cpu_smt_mask(cpu)) {
+		struct rq *srq = cpu_rq(i);
+
+		if (i != cpu && srq->core_wait_cookie != rq->core_cookie &&
+		    sched_core_handover(rq, srq, now)) {
+			resched_curr(rq);
+			break;
+		}
+	}
+	raw_spin_unlock(&core->core_lock);
+}
+
+static void sched_core_set_cookie(struct task_struct *p, unsigned long cookie)
+{
+	unsigned long flags;
+	struct rq *rq;
+
+	rq = task_rq_lock(p, &flags);
+	p->core_cookie = cookie;
+	if (task_running(rq, p))
+		resched_curr(rq);
+	task_rq_unlock(rq, p, &flags);
+}
+
+static void sched_core_resched(void *info)
+{
+	struct rq *rq = this_rq();
+
+	raw_spin_lock(&rq->lock);
+	resched_curr(rq);
+	raw_spin_unlock(&rq->lock);
+}
+
+/*
+ * prctl(PR_SCHED_CORE, cmd, pid, scope, uaddr)
+ *
+ * GET stores the cookie of thread @pid at @uaddr; the value is only good
+ * for comparing against other cookies.  CREATE gives @pid a new cookie of
+ * its own, SHARE_TO gives it the cookie of the caller, and SHARE_FROM
+ * gives the caller the cookie of @pid.  CREATE and SHARE_TO apply to the
+ * thread, thread group or process group of @pid, according to @scope.
+ * A @pid of 0 means the caller.
+ */
+int sched_core_share_pid(unsigned long cmd, pid_t pid, unsigned long scope,
+			 unsigned long uaddr)
+{
+	struct task_struct *task, *p;
+	unsigned long cookie = 0;
+	struct pid *grp;
+	int err = 0;
+
+	if (cmd >= PR_SCHED_CORE_MAX || pid < 0 ||
+	    scope > PR_SCHED_CORE_SCOPE_PROCESS_GROUP)
+		return -EINVAL;
+	if ((cmd == PR_SCHED_CORE_GET) != !!uaddr)
+		return -EINVAL;
+	if ((cmd == PR_SCHED_CORE_GET || cmd == PR_SCHED_CORE_SHARE_FROM) &&
+	    scope != PR_SCHED_CORE_SCOPE_THREAD)
+		return -EINVAL;
+	if (uaddr & 7)
+		return -EINVAL;
+
+	rcu_read_lock();
+	task = pid ? find_task_by_vpid(pid) : current;
+	if (!task) {
+		rcu_read_unlock();
+		return -ESRCH;
+	}
+	get_task_struct(task);
+	rcu_read_unlock();
+
+	if (!ptrace_may_access(task, PTRACE_MODE_READ)) {
+		err = -EPERM;
+		goto out;
+	}
+
+	mutex_lock(&sched_core_mutex);
+	switch (cmd) {
+	case PR_SCHED_CORE_GET:
+		err = put_user((u64)task->core_cookie, (u64 __user *)uaddr);
+		goto out_unlock;
+	case PR_SCHED_CORE_SHARE_FROM:
+		sched_core_set_cookie(current, task->core_cookie);
+		goto out_unlock;
+	case PR_SCHED_CORE_CREATE:
+		cookie = sched_core_alloc_cookie();
+		break;
+	case PR_SCHED_CORE_SHARE_TO:
+		cookie = current->core_cookie;
+		break;
+	}
+
+	if (scope == PR_SCHED_CORE_SCOPE_THREAD) {
+		sched_core_set_cookie(task, cookie);
+		goto out_unlock;
+	}
+
+	rcu_read_lock();
+	if (scope == PR_SCHED_CORE_SCOPE_THREAD_GROUP) {
+		for_each_thread(task, p)
+			sched_core_set_cookie(p, cookie);
+	} else {
+		grp = task_pgrp(task);
+		do_each_pid_thread(grp, PIDTYPE_PGID, p) {
+			if (ptrace_may_access(p, PTRACE_MODE_READ))
+				sched_core_set_cookie(p, cookie);
+			else
+				err = -EPERM;
+		} while_each_pid_thread(grp, PIDTYPE_PGID, p);
+	}
+	rcu_read_unlock();
+out_unlock:
+	mutex_unlock(&sched_core_mutex);
+out:
+	put_task_struct(task);
+	return err;
+}
+#endif /* CONFIG_SCHED_CORE */
+
 /*
  * This function gets called by the timer code, with HZ frequency.
  * We call it with interrupts disabled.
@@ -2504,6 +3095,11 @@ void scheduler_tick(void)
 	update_rq_clock(rq);
 	curr->sched_class->task_tick(rq, curr, 0);
 	update_cpu_load_active(rq);
+	psi_task_tick(rq);
+#ifdef CONFIG_SCHED_CORE
+	if (static_key_false(&sched_core_used))
+		sched_core_tick(rq);
+#endif
 	raw_spin_unlock(&rq->lock);
 
 	perf_event_task_tick();
@@ -2793,6 +3389,10 @@ static void __sched __schedule(void)
 		update_rq_clock(rq);
 
 	next = pick_next_task(rq, prev);
+#ifdef CONFIG_SCHED_CORE
+	if (static_key_false(&sched_core_used))
+		next = sched_core_pick(rq, next);
+#endif
 	clear_tsk_need_resched(prev);
 	clear_preempt_need_resched();
 	rq->clock_skip_update = 0;
@@ -3441,7 +4041,8 @@ recheck:
 			return -EINVAL;
 	}
 
-	if (attr->sched_flags & ~(SCHED_FLAG_RESET_ON_FORK))
+	if (attr->sched_flags &
+	    ~(SCHED_FLAG_RESET_ON_FORK | SCHED_FLAG_UTIL_CLAMP))
 		return -EINVAL;
 
 	/*
@@ -3513,6 +4114,13 @@ recheck:
 			return retval;
 	}
 
+	/* Update task specific "requested" clamps */
+	if (attr->sched_flags & SCHED_FLAG_UTIL_CLAMP) {
+		retval = uclamp_validate(p, attr);
+		if (retval)
+			return retval;
+	}
+
 	/*
 	 * make sure no PI-waiters arrive (or leave) while we are
 	 * changing the priority of the task:
@@ -3541,6 +4149,8 @@ recheck:
 			goto change;
 		if (dl_policy(policy) && dl_param_changed(p, attr))
 			goto change;
+		if (attr->sched_flags & SCHED_FLAG_UTIL_CLAMP)
+			goto change;
 
 		p->sched_reset_on_fork = reset_on_fork;
 		task_rq_unlock(rq, p, &flags);
@@ -3607,7 +4217,8 @@ change:
 	 * itself.
 	 */
 	new_effective_prio = rt_mutex_get_effective_prio(p, newprio);
-	if (new_effective_prio == oldprio) {
+	if (new_effective_prio == oldprio &&
+	    !(attr->sched_flags & SCHED_FLAG_UTIL_CLAMP)) {
 		__setscheduler_params(p, attr);
 		task_rq_unlock(rq, p, &flags);
 		return 0;
@@ -3622,6 +4233,7 @@ change:
 
 	prev_class = p->sched_class;
 	__setscheduler(rq, p, attr, true);
+	__setscheduler_uclamp(p, attr);
 
 	if (running)
 		p->sched_class->set_curr_task(rq);
@@ -3781,6 +4393,10 @@ static int sched_copy_attr(struct sched_attr __user *uattr,
 	if (ret)
 		return -EFAULT;
 
+	if ((attr->sched_flags & SCHED_FLAG_UTIL_CLAMP) &&
+	    size < SCHED_ATTR_SIZE_VER1)
+		return -EINVAL;
+
 	/*
 	 * XXX: do we want to be lenient like existing syscalls; or do we want
 	 * to be strict and return an error on out-of-bounds values?
@@ -4004,6 +4620,14 @@ SYSCALL_DEFINE4(sched_getattr, pid_t, pid, struct sched_attr __user *, uattr,
 	else
 		attr.sched_nice = task_nice(p);
 
+#ifdef CONFIG_UCLAMP_TASK
+	/* old user-space asks for the first version of the struct */
+	if (size >= SCHED_ATTR_SIZE_VER1) {
+		attr.sched_util_min = p->uclamp_req[UCLAMP_MIN].value;
+		attr.sched_util_max = p->uclamp_req[UCLAMP_MAX].value;
+	}
+#endif
+
 	rcu_read_unlock();
 
 	retval = sched_read_attr(uattr, &attr, size);
@@ -7168,6 +7792,9 @@ void __init sched_init(void)
 
 		rq = cpu_rq(i);
 		raw_spin_lock_init(&rq->lock);
+#ifdef CONFIG_SCHED_CORE
+		raw_spin_lock_init(&rq->core_lock);
+#endif
 		rq->nr_running = 0;
 		rq->calc_load_active = 0;
 		rq->calc_load_update = jiffies + LOAD_FREQ;
@@ -7275,6 +7902,10 @@ void __init sched_init(void)
 #endif
 	init_sched_fair_class();
 
+	init_uclamp();
+
+	psi_init();
+
 	scheduler_running = 1;
 }
 
@@ -7466,6 +8097,22 @@ static void free_sched_group(struct task_group *tg)
 	kfree(tg);
 }
 
+static inline void alloc_uclamp_sched_group(struct task_group *tg,
+					    struct task_group *parent)
+{
+#ifdef CONFIG_UCLAMP_TASK_GROUP
+	enum uclamp_id clamp_id;
+
+	for (clamp_id = 0; clamp_id < UCLAMP_CNT; clamp_id++) {
+		uclamp_se_set(&tg->uclamp_req[clamp_id],
+			      uclamp_none(clamp_id), false);
+		tg->uclamp[clamp_id] = parent->uclamp[clamp_id];
+	}
+	tg->uclamp_pct[UCLAMP_MIN] = 0;
+	tg->uclamp_pct[UCLAMP_MAX] = 100;
+#endif
+}
+
 /* allocate runqueue etc for a new task group */
 struct task_group *sched_create_group(struct task_group *parent)
 {
@@ -7481,6 +8128,8 @@ struct task_group *sched_create_group(struct task_group *parent)
 	if (!alloc_rt_sched_group(tg, parent))
 		goto err;
 
+	alloc_uclamp_sched_group(tg, parent);
+
 	return tg;
 
 err:
@@ -7978,6 +8627,133 @@ cpu_cgroup_css_alloc(struct cgroup_subsys_state *parent_css)
 	return &tg->css;
 }
 
+#ifdef CONFIG_UCLAMP_TASK_GROUP
+static void uclamp_update_active(struct task_struct *p,
+				 enum uclamp_id clamp_id)
+{
+	unsigned long flags;
+	struct rq *rq;
+
+	/* account the queued tasks under their new effective clamp */
+	rq = task_rq_lock(p, &flags);
+	if (p->uclamp[clamp_id].active) {
+		uclamp_rq_dec_id(rq, p, clamp_id);
+		uclamp_rq_inc_id(rq, p, clamp_id);
+	}
+	task_rq_unlock(rq, p, &flags);
+}
+
+static void uclamp_update_active_tasks(struct cgroup_subsys_state *css,
+				       unsigned int clamps)
+{
+	enum uclamp_id clamp_id;
+	struct css_task_iter it;
+	struct task_struct *p;
+
+	css_task_iter_start(css, &it);
+	while ((p = css_task_iter_next(&it))) {
+		for (clamp_id = 0; clamp_id < UCLAMP_CNT; clamp_id++) {
+			if (clamps & BIT(clamp_id))
+				uclamp_update_active(p, clamp_id);
+		}
+	}
+	css_task_iter_end(&it);
+}
+
+/*
+ * Recompute the clamps in effect for @top_css and its descendants: what
+ * each group asked for, capped by what is in effect for its parent.
+ * Called with uclamp_mutex held.
+ */
+static void cpu_util_update_eff(struct cgroup_subsys_state *top_css)
+{
+	struct cgroup_subsys_state *css;
+	unsigned int eff[UCLAMP_CNT];
+	enum uclamp_id clamp_id;
+	unsigned int clamps;
+
+	rcu_read_lock();
+	css_for_each_descendant_pre(css, top_css) {
+		struct task_group *tg = css_tg(css);
+
+		for (clamp_id = 0; clamp_id < UCLAMP_CNT; clamp_id++) {
+			eff[clamp_id] = min_t(unsigned int,
+					      tg->uclamp_req[clamp_id].value,
+					      tg->parent->uclamp[clamp_id].value);
+		}
+		/* a protection beyond the limit makes no sense */
+		eff[UCLAMP_MIN] = min(eff[UCLAMP_MIN], eff[UCLAMP_MAX]);
+
+		clamps = 0;
+		for (clamp_id = 0; clamp_id < UCLAMP_CNT; clamp_id++) {
+			if (eff[clamp_id] == tg->uclamp[clamp_id].value)
+				continue;
+			uclamp_se_set(&tg->uclamp[clamp_id], eff[clamp_id],
+				      false);
+			clamps |= BIT(clamp_id);
+		}
+
+		/* nothing changed here, nor will it below */
+		if (!clamps) {
+			css = css_rightmost_descendant(css);
+			continue;
+		}
+
+		/* the walk can go on from a pinned css after dropping rcu */
+		if (!css_tryget(css))
+			continue;
+		rcu_read_unlock();
+		uclamp_update_active_tasks(css, clamps);
+		rcu_read_lock();
+		css_put(css);
+	}
+	rcu_read_unlock();
+}
+
+static int cpu_uclamp_write(struct cgroup_subsys_state *css, u64 pct,
+			    enum uclamp_id clamp_id)
+{
+	struct task_group *tg = css_tg(css);
+	unsigned int value;
+
+	if (pct > 100)
+		return -ERANGE;
+	value = DIV_ROUND_CLOSEST((unsigned int)pct * SCHED_CAPACITY_SCALE, 100);
+
+	mutex_lock(&uclamp_mutex);
+	tg->uclamp_pct[clamp_id] = pct;
+	uclamp_se_set(&tg->uclamp_req[clamp_id], value, false);
+	cpu_util_update_eff(css);
+	mutex_unlock(&uclamp_mutex);
+
+	return 0;
+}
+
+static u64 cpu_uclamp_min_read_u64(struct cgroup_subsys_state *css,
+				   struct cftype *cft)
+{
+	return css_tg(css)->uclamp_pct[UCLAMP_MIN];
+}
+
+static int cpu_uclamp_min_write_u64(struct cgroup_subsys_state *css,
+				    struct cftype *cft, u64 pct)
+{
+	return cpu_uclamp_write(css, pct, UCLAMP_MIN);
+}
+
+static u64 cpu_uclamp_max_read_u64(struct cgroup_subsys_state *css,
+				   struct cftype *cft)
+{
+	return css_tg(css)->uclamp_pct[UCLAMP_MAX];
+}
+
+static int cpu_uclamp_max_write_u64(struct cgroup_subsys_state *css,
+				    struct cftype *cft, u64 pct)
+{
+	return cpu_uclamp_write(css, pct, UCLAMP_MAX);
+}
+#endif /* CONFIG_UCLAMP_TASK_GROUP */
+
 static int cpu_cgroup_css_online(struct cgroup_subsys_state *css)
 {
 	struct task_group *tg = css_tg(css);
@@ -7985,6 +8761,20 @@ static int cpu_cgroup_css_online(struct cgroup_subsys_state *css)
 
 	if (parent)
 		sched_online_group(tg, parent);
+#ifdef CONFIG_SCHED_CORE
+	if (parent) {
+		mutex_lock(&sched_core_mutex);
+		tg->core_cookie = parent->core_cookie;
+		mutex_unlock(&sched_core_mutex);
+	}
+#endif
+#ifdef CONFIG_UCLAMP_TASK_GROUP
+	if (parent) {
+		mutex_lock(&uclamp_mutex);
+		cpu_util_update_eff(css);
+		mutex_unlock(&uclamp_mutex);
+	}
+#endif
 	return 0;
 }
 
@@ -8335,6 +9125,53 @@ static u64 cpu_rt_period_read_uint(struct cgroup_subsys_state *css,
 }
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_SCHED_CORE
+static u64 cpu_core_tag_read_u64(struct cgroup_subsys_state *css,
+				 struct cftype *cft)
+{
+	return css_tg(css)->core_tag;
+}
+
+static int cpu_core_tag_write_u64(struct cgroup_subsys_state *css,
+				  struct cftype *cft, u64 val)
+{
+	struct task_group *tg = css_tg(css);
+	struct cgroup_subsys_state *pos;
+	unsigned long cookie;
+
+	if (val > 1)
+		return -ERANGE;
+	if (tg == &root_task_group)
+		return -EINVAL;
+
+	mutex_lock(&sched_core_mutex);
+	if (tg->core_tag == val)
+		goto out;
+
+	tg->core_tag = val;
+	cookie = val ? sched_core_alloc_cookie() : tg->parent->core_cookie;
+
+	/* the new cookie covers all descendants without a tag of their own */
+	rcu_read_lock();
+	css_for_each_descendant_pre(pos, css) {
+		struct task_group *child = css_tg(pos);
+
+		if (child != tg && child->core_tag) {
+			pos = css_rightmost_descendant(pos);
+			continue;
+		}
+		WRITE_ONCE(child->core_cookie, cookie);
+	}
+	rcu_read_unlock();
+
+	/* make every cpu look at the cookies again */
+	on_each_cpu(sched_core_resched, NULL, 0);
+out:
+	mutex_unlock(&sched_core_mutex);
+	return 0;
+}
+#endif /* CONFIG_SCHED_CORE */
+
 static struct cftype cpu_files[] = {
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
@@ -8370,6 +9207,28 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_rt_period_read_uint,
 		.write_u64 = cpu_rt_period_write_uint,
 	},
+#endif
+#ifdef CONFIG_UCLAMP_TASK_GROUP
+	{
+		.name = "uclamp.min",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = cpu_uclamp_min_read_u64,
+		.write_u64 = cpu_uclamp_min_write_u64,
+	},
+	{
+		.name = "uclamp.max",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = cpu_uclamp_max_read_u64,
+		.write_u64 = cpu_uclamp_max_write_u64,
+	},
+#endif
+#ifdef CONFIG_SCHED_CORE
+	{
+		.name = "core_tag",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = cpu_core_tag_read_u64,
+		.write_u64 = cpu_core_tag_write_u64,
+	},
 #endif
 	{ }	/* terminate */
 };
@@ -210,6 +210,8 @@ void print_cfs_rq(struct seq_file *m, int cpu, struct cfs_rq *cfs_rq)
 	SEQ_printf(m, "  .%-30s: %d\n", "nr_spread_over",
 			cfs_rq->nr_spread_over);
 	SEQ_printf(m, "  .%-30s: %d\n", "nr_running", cfs_rq->nr_running);
+	SEQ_printf(m, "  .%-30s: %d\n", "idle_h_nr_running",
+			cfs_rq->idle_h_nr_running);
 	SEQ_printf(m, "  .%-30s: %ld\n", "load", cfs_rq->load.weight);
 #ifdef CONFIG_SMP
 	SEQ_printf(m, "  .%-30s: %ld\n", "runnable_load_avg",
@@ -315,6 +317,12 @@ do {									\
 	P(cpu_load[2]);
 	P(cpu_load[3]);
 	P(cpu_load[4]);
+#ifdef CONFIG_UCLAMP_TASK
+	SEQ_printf(m, "  .%-30s: %u\n", "uclamp.min",
+		   rq->uclamp[UCLAMP_MIN].value);
+	SEQ_printf(m, "  .%-30s: %u\n", "uclamp.max",
+		   rq->uclamp[UCLAMP_MAX].value);
+#endif
 #undef P
 #undef PN
 
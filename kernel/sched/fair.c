@@ -3633,7 +3633,7 @@ static void throttle_cfs_rq(struct cfs_rq *cfs_rq)
 	struct rq *rq = rq_of(cfs_rq);
 	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
 	struct sched_entity *se;
-	long task_delta, dequeue = 1;
+	long task_delta, idle_task_delta, dequeue = 1;
 
 	se = cfs_rq->tg->se[cpu_of(rq_of(cfs_rq))];
 
@@ -3643,6 +3643,7 @@ static void throttle_cfs_rq(struct cfs_rq *cfs_rq)
 	rcu_read_unlock();
 
 	task_delta = cfs_rq->h_nr_running;
+	idle_task_delta = cfs_rq->idle_h_nr_running;
 	for_each_sched_entity(se) {
 		struct cfs_rq *qcfs_rq = cfs_rq_of(se);
 		/* throttled entity or throttle-on-deactivate */
@@ -3652,6 +3653,7 @@ static void throttle_cfs_rq(struct cfs_rq *cfs_rq)
 		if (dequeue)
 			dequeue_entity(qcfs_rq, se, DEQUEUE_SLEEP);
 		qcfs_rq->h_nr_running -= task_delta;
+		qcfs_rq->idle_h_nr_running -= idle_task_delta;
 
 		if (qcfs_rq->load.weight)
 			dequeue = 0;
@@ -3679,7 +3681,7 @@ void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
 	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
 	struct sched_entity *se;
 	int enqueue = 1;
-	long task_delta;
+	long task_delta, idle_task_delta;
 
 	se = cfs_rq->tg->se[cpu_of(rq)];
 
@@ -3699,6 +3701,7 @@ void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
 		return;
 
 	task_delta = cfs_rq->h_nr_running;
+	idle_task_delta = cfs_rq->idle_h_nr_running;
 	for_each_sched_entity(se) {
 		if (se->on_rq)
 			enqueue = 0;
@@ -3707,6 +3710,7 @@ void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
 		if (enqueue)
 			enqueue_entity(cfs_rq, se, ENQUEUE_WAKEUP);
 		cfs_rq->h_nr_running += task_delta;
+		cfs_rq->idle_h_nr_running += idle_task_delta;
 
 		if (cfs_rq_throttled(cfs_rq))
 			break;
@@ -4223,6 +4227,7 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 {
 	struct cfs_rq *cfs_rq;
 	struct sched_entity *se = &p->se;
+	int idle_h_nr_running = p->policy == SCHED_IDLE;
 
 	for_each_sched_entity(se) {
 		if (se->on_rq)
@@ -4239,6 +4244,7 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 		if (cfs_rq_throttled(cfs_rq))
 			break;
 		cfs_rq->h_nr_running++;
+		cfs_rq->idle_h_nr_running += idle_h_nr_running;
 
 		flags = ENQUEUE_WAKEUP;
 	}
@@ -4246,6 +4252,7 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 		cfs_rq->h_nr_running++;
+		cfs_rq->idle_h_nr_running += idle_h_nr_running;
 
 		if (cfs_rq_throttled(cfs_rq))
 			break;
@@ -4273,6 +4280,7 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct cfs_rq *cfs_rq;
 	struct sched_entity *se = &p->se;
 	int task_sleep = flags & DEQUEUE_SLEEP;
+	int idle_h_nr_running = p->policy == SCHED_IDLE;
 
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
@@ -4287,6 +4295,7 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 		if (cfs_rq_throttled(cfs_rq))
 			break;
 		cfs_rq->h_nr_running--;
+		cfs_rq->idle_h_nr_running -= idle_h_nr_running;
 
 		/* Don't dequeue parent if it has other entities besides us */
 		if (cfs_rq->load.weight) {
@@ -4307,6 +4316,7 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 		cfs_rq->h_nr_running--;
+		cfs_rq->idle_h_nr_running -= idle_h_nr_running;
 
 		if (cfs_rq_throttled(cfs_rq))
 			break;
@@ -4329,6 +4339,18 @@ static unsigned long weighted_cpuload(const int cpu)
 	return cpu_rq(cpu)->cfs.runnable_load_avg;
 }
 
+/*
+ * A cpu that only runs SCHED_IDLE tasks is as good as idle for anything
+ * else: whatever we put there preempts them at once.
+ */
+static int sched_idle_cpu(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+
+	return unlikely(rq->nr_running &&
+			rq->nr_running == rq->cfs.idle_h_nr_running);
+}
+
 /*
  * Return a low guess at the load of a migration-source cpu weighted
  * according to the scheduling class and "nice" value.
@@ -4372,6 +4394,32 @@ static unsigned long capacity_orig_of(int cpu)
 	return cpu_rq(cpu)->cpu_capacity_orig;
 }
 
+#ifdef CONFIG_UCLAMP_TASK
+/*
+ * Whether the clamped utilization of @p fits the capacity of @cpu with
+ * a 20% margin.  Only cpus of less than full capacity can fail this.
+ */
+static bool task_fits_cpu(struct task_struct *p, int cpu)
+{
+	unsigned long capacity = capacity_orig_of(cpu);
+	unsigned long util;
+
+	if (capacity >= SCHED_CAPACITY_SCALE)
+		return true;
+
+	util = clamp_t(unsigned long, p->se.avg.utilization_avg_contrib,
+		       uclamp_eff_value(p, UCLAMP_MIN),
+		       uclamp_eff_value(p, UCLAMP_MAX));
+
+	return util * 1280 < capacity * 1024;
+}
+#else
+static inline bool task_fits_cpu(struct task_struct *p, int cpu)
+{
+	return true;
+}
+#endif
+
 static unsigned long cpu_avg_load_per_task(int cpu)
 {
 	struct rq *rq = cpu_rq(cpu);
@@ -4707,6 +4755,10 @@ find_idlest_cpu(struct sched_group *group, struct task_struct *p, int this_cpu)
 
 	/* Traverse only the allowed CPUs */
 	for_each_cpu_and(i, sched_group_cpus(group), tsk_cpus_allowed(p)) {
+		/* running, so no idle state to exit */
+		if (sched_idle_cpu(i))
+			return i;
+
 		if (idle_cpu(i)) {
 			struct rq *rq = cpu_rq(i);
 			struct cpuidle_state *idle = idle_get_state(rq);
@@ -4750,13 +4802,15 @@ static int select_idle_sibling(struct task_struct *p, int target)
 	struct sched_group *sg;
 	int i = task_cpu(p);
 
-	if (idle_cpu(target))
+	if ((idle_cpu(target) || sched_idle_cpu(target)) &&
+	    task_fits_cpu(p, target))
 		return target;
 
 	/*
 	 * If the prevous cpu is cache affine and idle, don't be stupid.
 	 */
-	if (i != target && cpus_share_cache(i, target) && idle_cpu(i))
+	if (i != target && cpus_share_cache(i, target) &&
+	    (idle_cpu(i) || sched_idle_cpu(i)) && task_fits_cpu(p, i))
 		return i;
 
 	/*
@@ -4771,12 +4825,17 @@ static int select_idle_sibling(struct task_struct *p, int target)
 				goto next;
 
 			for_each_cpu(i, sched_group_cpus(sg)) {
-				if (i == target || !idle_cpu(i))
+				if (i == target ||
+				    (!idle_cpu(i) && !sched_idle_cpu(i)))
 					goto next;
 			}
 
-			target = cpumask_first_and(sched_group_cpus(sg),
+			i = cpumask_first_and(sched_group_cpus(sg),
 					tsk_cpus_allowed(p));
+			if (!task_fits_cpu(p, i))
+				goto next;
+
+			target = i;
 			goto done;
 next:
 			sg = sg->next;
@@ -4807,6 +4866,11 @@ static int get_cpu_usage(int cpu)
 	unsigned long usage = cpu_rq(cpu)->cfs.utilization_load_avg;
 	unsigned long capacity = capacity_orig_of(cpu);
 
+#ifdef CONFIG_UCLAMP_TASK
+	if (cpu_rq(cpu)->cfs.h_nr_running)
+		usage = uclamp_rq_util(cpu_rq(cpu), usage);
+#endif
+
 	if (usage >= SCHED_LOAD_SCALE)
 		return capacity;
 
@@ -5691,6 +5755,8 @@ static const unsigned int sched_nr_migrate_break = 32;
 static int detach_tasks(struct lb_env *env)
 {
 	struct list_head *tasks = &env->src_rq->cfs_tasks;
+	unsigned int nr_idle = env->src_rq->cfs.idle_h_nr_running;
+	unsigned int idle_pass = 0;
 	struct task_struct *p;
 	unsigned long load;
 	int detached = 0;
@@ -5700,9 +5766,38 @@ static int detach_tasks(struct lb_env *env)
 	if (env->imbalance <= 0)
 		return 0;
 
+	/*
+	 * Look at the SCHED_IDLE tasks first: they don't mind where they
+	 * run, and moving them leaves the cpu and its warm cache to the
+	 * tasks that do.  At most one trip round the list, moving no more
+	 * than half of them as each weighs next to nothing against the
+	 * imbalance.
+	 */
+	if (nr_idle && nr_idle < env->src_rq->cfs.h_nr_running)
+		idle_pass = min(env->src_rq->cfs.h_nr_running, env->loop_max);
+	nr_idle = (nr_idle + 1) / 2;
+
 	while (!list_empty(tasks)) {
 		p = list_first_entry(tasks, struct task_struct, se.group_node);
 
+		if (idle_pass) {
+			idle_pass--;
+			if (p->policy != SCHED_IDLE || !nr_idle ||
+			    !can_migrate_task(p, env))
+				goto next;
+
+			load = task_h_load(p);
+			detach_task(p, env);
+			list_add(&p->se.group_node, &env->tasks);
+
+			detached++;
+			nr_idle--;
+			env->imbalance -= load;
+			if (env->imbalance <= 0)
+				break;
+			continue;
+		}
+
 		env->loop++;
 		/* We've more or less seen every task there is, call it quits */
 		if (env->loop > env->loop_max)
@@ -7549,6 +7644,10 @@ static void rebalance_domains(struct rq *rq, enum cpu_idle_type idle)
 
 	update_blocked_averages(cpu);
 
+	/* a cpu that only runs SCHED_IDLE tasks pulls like an idle one */
+	if (idle == CPU_NOT_IDLE && sched_idle_cpu(cpu))
+		idle = CPU_IDLE;
+
 	rcu_read_lock();
 	for_each_domain(cpu, sd) {
 		/*
@@ -7592,7 +7691,8 @@ static void rebalance_domains(struct rq *rq, enum cpu_idle_type idle)
 				 * env->dst_cpu, so we can't know our idle
 				 * state even if we migrated tasks. Update it.
 				 */
-				idle = idle_cpu(cpu) ? CPU_IDLE : CPU_NOT_IDLE;
+				idle = idle_cpu(cpu) || sched_idle_cpu(cpu) ?
+					CPU_IDLE : CPU_NOT_IDLE;
 			}
 			sd->last_balance = jiffies;
 			interval = get_sd_balance_interval(sd, idle != CPU_IDLE);
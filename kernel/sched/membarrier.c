@@ -0,0 +1,168 @@
+/*
+ * membarrier system call
+ *
+ * Lets a thread order its memory accesses against those of other threads
+ * that run concurrently, without having them issue barriers themselves:
+ * user-space RCU readers and code being patched by a JIT can then use
+ * plain compiler barriers on their fast paths.
+ *
+ * MEMBARRIER_CMD_SHARED waits for an RCU-sched grace period, which every
+ * CPU passes through by a context switch, idle or user-space execution.
+ * MEMBARRIER_CMD_PRIVATE_EXPEDITED sends an IPI only to the CPUs that are
+ * currently running a thread of the caller's mm, as seen from rq->curr.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <linux/syscalls.h>
+#include <linux/membarrier.h>
+#include <linux/tick.h>
+#include <linux/cpumask.h>
+
+#include "sched.h"
+
+/*
+ * Bitmask made from a "or" of all commands within enum membarrier_cmd,
+ * except MEMBARRIER_CMD_QUERY.
+ */
+#define MEMBARRIER_CMD_BITMASK	\
+	(MEMBARRIER_CMD_SHARED | MEMBARRIER_CMD_PRIVATE_EXPEDITED)
+
+static void ipi_mb(void *info)
+{
+	smp_mb();	/* IPIs should be serializing but paranoid. */
+}
+
+/*
+ * rq->curr is sampled under rq->lock.  Task structs are freed as soon as
+ * the last reference is dropped, by finish_task_switch() for a dead task,
+ * so the lock is what keeps rq->curr around while we look at its mm.
+ *
+ * The scheduler needs no barrier of its own for us: __schedule() updates
+ * rq->curr under the same lock.  A CPU seen running another mm released
+ * the lock after the last user access of one of our threads, and can
+ * only switch to one of them by acquiring it after we released it, that
+ * is after our first smp_mb().  The switch_mm() into our mm comes on top
+ * of that.
+ */
+static bool membarrier_cpu_runs_mm(int cpu, struct mm_struct *mm)
+{
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long flags;
+	bool ret;
+
+	raw_spin_lock_irqsave(&rq->lock, flags);
+	ret = rq->curr->mm == mm;
+	raw_spin_unlock_irqrestore(&rq->lock, flags);
+
+	return ret;
+}
+
+static void membarrier_private_expedited(void)
+{
+	struct mm_struct *mm = current->mm;
+	cpumask_var_t tmpmask;
+	bool fallback = false;
+	int cpu;
+
+	if (num_online_cpus() == 1)
+		return;
+
+	/* System call entry is not a full barrier. */
+	smp_mb();
+
+	/*
+	 * Expedited commands don't block, hence GFP_NOWAIT and a fallback
+	 * of one synchronous IPI per CPU.
+	 */
+	if (!zalloc_cpumask_var(&tmpmask, GFP_NOWAIT))
+		fallback = true;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		/*
+		 * Skipping the current CPU is fine even though we may have
+		 * been migrated since: whatever CPU runs us now is in
+		 * program order with us.
+		 */
+		if (cpu == raw_smp_processor_id())
+			continue;
+		if (!membarrier_cpu_runs_mm(cpu, mm))
+			continue;
+		if (fallback)
+			smp_call_function_single(cpu, ipi_mb, NULL, 1);
+		else
+			cpumask_set_cpu(cpu, tmpmask);
+	}
+	if (!fallback) {
+		preempt_disable();
+		smp_call_function_many(tmpmask, ipi_mb, NULL, 1);
+		preempt_enable();
+		free_cpumask_var(tmpmask);
+	}
+	put_online_cpus();
+
+	/*
+	 * Order the IPIs before the caller's following memory accesses,
+	 * system call exit is not a full barrier either.
+	 */
+	smp_mb();
+}
+
+/**
+ * sys_membarrier - issue memory barriers on a set of threads
+ * @cmd:   Takes command values defined in enum membarrier_cmd.
+ * @flags: Currently needs to be 0. For future extensions.
+ *
+ * If this system call is not implemented, -ENOSYS is returned. If the
+ * command specified does not exist, not available on the running
+ * kernel, or if the command argument is invalid, this system call
+ * returns -EINVAL. For a given command, with flags argument set to 0,
+ * this system call is guaranteed to always return the same value until
+ * reboot.
+ *
+ * All memory accesses performed in program order from each targeted thread
+ * are guaranteed to be ordered with respect to sys_membarrier(). If we use
+ * the semantic "barrier()" to represent a compiler barrier forcing memory
+ * accesses to be performed in program order across the barrier, and
+ * smp_mb() to represent explicit memory barriers forcing full memory
+ * ordering across the barrier, we have the following ordering table for
+ * each pair of barrier(), sys_membarrier() and smp_mb():
+ *
+ * The pair ordering is detailed as (O: ordered, X: not ordered):
+ *
+ *                        barrier()   smp_mb() sys_membarrier()
+ *        barrier()          X           X            O
+ *        smp_mb()           X           O            O
+ *        sys_membarrier()   O           O            O
+ */
+SYSCALL_DEFINE2(membarrier, int, cmd, int, flags)
+{
+	if (unlikely(flags))
+		return -EINVAL;
+	switch (cmd) {
+	case MEMBARRIER_CMD_QUERY:
+	{
+		int cmd_mask = MEMBARRIER_CMD_BITMASK;
+
+		/* the grace period of nohz_full CPUs doesn't imply a barrier */
+		if (tick_nohz_full_enabled())
+			cmd_mask &= ~MEMBARRIER_CMD_SHARED;
+		return cmd_mask;
+	}
+	case MEMBARRIER_CMD_SHARED:
+		if (tick_nohz_full_enabled())
+			return -EINVAL;
+		if (num_online_cpus() > 1)
+			synchronize_sched();
+		return 0;
+	case MEMBARRIER_CMD_PRIVATE_EXPEDITED:
+		membarrier_private_expedited();
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
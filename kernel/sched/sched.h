@@ -9,6 +9,7 @@
 #include <linux/irq_work.h>
 #include <linux/tick.h>
 #include <linux/slab.h>
+#include <linux/psi.h>
 
 #include "cpupri.h"
 #include "cpudeadline.h"
@@ -27,6 +28,10 @@ extern unsigned long calc_load_update;
 extern atomic_long_t calc_load_tasks;
 
 extern long calc_load_fold_active(struct rq *this_rq);
+extern unsigned long calc_load(unsigned long load, unsigned long exp,
+			       unsigned long active);
+extern unsigned long calc_load_n(unsigned long load, unsigned long exp,
+				 unsigned long active, unsigned int n);
 extern void update_cpu_load_active(struct rq *this_rq);
 
 /*
@@ -260,6 +265,19 @@ struct task_group {
 	struct autogroup *autogroup;
 #endif
 
+#ifdef CONFIG_UCLAMP_TASK_GROUP
+	/* cpu.uclamp.{min,max} in percent, as asked for and in effect */
+	unsigned int uclamp_pct[UCLAMP_CNT];
+	struct uclamp_se uclamp_req[UCLAMP_CNT];
+	struct uclamp_se uclamp[UCLAMP_CNT];
+#endif
+
+#ifdef CONFIG_SCHED_CORE
+	/* set through cpu.core_tag, propagated to untagged descendants */
+	unsigned int core_tag;
+	unsigned long core_cookie;
+#endif
+
 	struct cfs_bandwidth cfs_bandwidth;
 };
 
@@ -337,6 +355,8 @@ struct cfs_bandwidth { };
 struct cfs_rq {
 	struct load_weight load;
 	unsigned int nr_running, h_nr_running;
+	/* SCHED_IDLE tasks in h_nr_running */
+	unsigned int idle_h_nr_running;
 
 	u64 exec_clock;
 	u64 min_vruntime;
@@ -546,6 +566,32 @@ extern struct root_domain def_root_domain;
 
 #endif /* CONFIG_SMP */
 
+#ifdef CONFIG_UCLAMP_TASK
+/*
+ * Utilization clamps are aggregated per rq by bucketing the clamp values
+ * of the runnable tasks: each bucket counts its tasks and tracks the
+ * highest value among them, and the clamp of the rq is the value of the
+ * highest non-empty bucket.  So the rq clamp is the max of the task
+ * clamps, overestimated by at most a bucket when a task leaves.
+ */
+#define UCLAMP_BUCKETS		CONFIG_UCLAMP_BUCKETS_COUNT
+#define UCLAMP_BUCKET_DELTA	DIV_ROUND_CLOSEST(SCHED_CAPACITY_SCALE, \
+						  UCLAMP_BUCKETS)
+
+struct uclamp_bucket {
+	unsigned int value;
+	unsigned int tasks;
+};
+
+struct uclamp_rq {
+	unsigned int value;
+	struct uclamp_bucket bucket[UCLAMP_BUCKETS];
+};
+
+/* no clamped task runnable, UCLAMP_MAX holds that of the last one */
+#define UCLAMP_FLAG_IDLE	0x01
+#endif /* CONFIG_UCLAMP_TASK */
+
 /*
  * This is the main, per-CPU runqueue data structure.
  *
@@ -581,6 +627,12 @@ struct rq {
 	unsigned long nr_load_updates;
 	u64 nr_switches;
 
+#ifdef CONFIG_UCLAMP_TASK
+	/* utilization clamps of the runnable RT and CFS tasks */
+	struct uclamp_rq uclamp[UCLAMP_CNT] ____cacheline_aligned;
+	unsigned int uclamp_flags;
+#endif
+
 	struct cfs_rq cfs;
 	struct rt_rq rt;
 	struct dl_rq dl;
@@ -686,6 +738,20 @@ struct rq {
 	/* Must be inspected within a rcu lock section */
 	struct cpuidle_state *idle_state;
 #endif
+
+#ifdef CONFIG_SCHED_CORE
+	/*
+	 * What this cpu runs, as seen by its SMT siblings.  Protected by the
+	 * core_lock of the first sibling, see sched_core_pick().
+	 */
+	raw_spinlock_t core_lock;
+	unsigned int core_busy;
+	unsigned long core_cookie;
+	/* cookie we are forced idle for, and since when */
+	unsigned long core_wait_cookie;
+	u64 core_forceidle_start;
+	u64 core_forceidle_sum;
+#endif
 };
 
 static inline int cpu_of(struct rq *rq)
@@ -1290,6 +1356,26 @@ extern void init_sched_dl_class(void);
 extern void resched_curr(struct rq *rq);
 extern void resched_cpu(int cpu);
 
+#ifdef CONFIG_UCLAMP_TASK
+extern unsigned int uclamp_eff_value(struct task_struct *p,
+				     enum uclamp_id clamp_id);
+
+/*
+ * @util restricted to the clamps of the tasks runnable on @rq.  Both clamps
+ * are max aggregated over tasks with different requests, so min may end up
+ * above max.  The cap wins then: clamp() returns max, and a boosted task
+ * does not lift the utilization above what a capped task on the same rq
+ * allows.
+ */
+static inline unsigned long uclamp_rq_util(struct rq *rq, unsigned long util)
+{
+	unsigned long min = READ_ONCE(rq->uclamp[UCLAMP_MIN].value);
+	unsigned long max = READ_ONCE(rq->uclamp[UCLAMP_MAX].value);
+
+	return clamp(util, min, max);
+}
+#endif
+
 extern struct rt_bandwidth def_rt_bandwidth;
 extern void init_rt_bandwidth(struct rt_bandwidth *rt_b, u64 period, u64 runtime);
 
@@ -1485,6 +1571,92 @@ task_rq_unlock(struct rq *rq, struct task_struct *p, unsigned long *flags)
 	raw_spin_unlock_irqrestore(&p->pi_lock, *flags);
 }
 
+#ifdef CONFIG_PSI
+/*
+ * PSI tracks state that persists across sleeps, such as iowaits and
+ * memory stalls. As a result, it has to distinguish between sleeps,
+ * where a task's runnable state changes, and requeues, where a task
+ * and its state are being moved between CPUs and runqueues.
+ */
+static inline void psi_enqueue(struct task_struct *p, bool wakeup)
+{
+	int clear = 0, set = TSK_RUNNING;
+
+	if (static_key_false(&psi_disabled))
+		return;
+
+	if (!wakeup || p->sched_psi_wake_requeue) {
+		if (p->flags & PF_MEMSTALL)
+			set |= TSK_MEMSTALL;
+		if (p->sched_psi_wake_requeue)
+			p->sched_psi_wake_requeue = 0;
+	} else {
+		if (p->in_iowait)
+			clear |= TSK_IOWAIT;
+	}
+
+	psi_task_change(p, clear, set);
+}
+
+static inline void psi_dequeue(struct task_struct *p, bool sleep)
+{
+	int clear = TSK_RUNNING, set = 0;
+
+	if (static_key_false(&psi_disabled))
+		return;
+
+	if (!sleep) {
+		if (p->flags & PF_MEMSTALL)
+			clear |= TSK_MEMSTALL;
+	} else {
+		if (p->in_iowait)
+			set |= TSK_IOWAIT;
+	}
+
+	psi_task_change(p, clear, set);
+}
+
+/*
+ * A sleeping task being woken up on another cpu is dequeued from the
+ * state of its old cpu here, before set_task_cpu(), and requeued by the
+ * enqueue on the new one.
+ */
+static inline void psi_ttwu_dequeue(struct task_struct *p)
+{
+	if (static_key_false(&psi_disabled))
+		return;
+
+	if (unlikely(p->in_iowait || (p->flags & PF_MEMSTALL))) {
+		struct rq *rq;
+		int clear = 0;
+
+		if (p->in_iowait)
+			clear |= TSK_IOWAIT;
+		if (p->flags & PF_MEMSTALL)
+			clear |= TSK_MEMSTALL;
+
+		rq = __task_rq_lock(p);
+		psi_task_change(p, clear, 0);
+		p->sched_psi_wake_requeue = 1;
+		__task_rq_unlock(rq);
+	}
+}
+
+static inline void psi_task_tick(struct rq *rq)
+{
+	if (static_key_false(&psi_disabled))
+		return;
+
+	if (unlikely(rq->curr->flags & PF_MEMSTALL))
+		psi_memstall_tick(rq->curr, cpu_of(rq));
+}
+#else /* CONFIG_PSI */
+static inline void psi_enqueue(struct task_struct *p, bool wakeup) {}
+static inline void psi_dequeue(struct task_struct *p, bool sleep) {}
+static inline void psi_ttwu_dequeue(struct task_struct *p) {}
+static inline void psi_task_tick(struct rq *rq) {}
+#endif /* CONFIG_PSI */
+
 #ifdef CONFIG_SMP
 #ifdef CONFIG_PREEMPT
 
@@ -2361,6 +2361,8 @@ relock:
 	spin_unlock_irq(&sighand->siglock);
 
 	ksig->sig = signr;
+	if (ksig->sig > 0)
+		rseq_signal_deliver(signal_pt_regs());
 	return ksig->sig > 0;
 }
 
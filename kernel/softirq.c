@@ -62,6 +62,20 @@ const char * const softirq_to_name[NR_SOFTIRQS] = {
 	"TASKLET", "SCHED", "HRTIMER", "RCU"
 };
 
+/*
+ * A vector that has run for longer than its budget within one
+ * __do_softirq() and got raised again is deferred: it is left pending for
+ * ksoftirqd, and irq_exit()/local_bh_enable() keep on running the other
+ * vectors inline, so that e.g. timers and RCU do not queue up behind a
+ * network rx flood.  A vector stops being deferred once ksoftirqd has
+ * caught up with it.  A budget of 0 never defers the vector.
+ */
+unsigned int softirq_budget_us[NR_SOFTIRQS] = {
+	[0 ... NR_SOFTIRQS - 1] = 1000
+};
+
+static DEFINE_PER_CPU(__u32, softirq_deferred);
+
 /*
  * we cannot loop indefinitely here to avoid userspace starvation,
  * but we also don't want to introduce a worst case 1/HZ latency
@@ -77,6 +91,21 @@ static void wakeup_softirqd(void)
 		wake_up_process(tsk);
 }
 
+/*
+ * If all that is pending has been deferred, there is nothing to run
+ * inline: make sure ksoftirqd is on its way and skip __do_softirq().
+ */
+static bool softirq_deferred_only(void)
+{
+	__u32 deferred = __this_cpu_read(softirq_deferred);
+
+	if (likely(!deferred) || (local_softirq_pending() & ~deferred))
+		return false;
+
+	wakeup_softirqd();
+	return true;
+}
+
 /*
  * preempt_count and SOFTIRQ_OFFSET usage:
  * - preempt_count is changed by SOFTIRQ_OFFSET on entering or leaving
@@ -194,6 +223,30 @@ EXPORT_SYMBOL(__local_bh_enable_ip);
 #define MAX_SOFTIRQ_TIME  msecs_to_jiffies(2)
 #define MAX_SOFTIRQ_RESTART 10
 
+/*
+ * Pending vectors in @pending which used up their budget in this
+ * __do_softirq() invocation.
+ */
+static __u32 softirq_over_budget(__u32 pending, const u64 *used)
+{
+	__u32 over = 0;
+	unsigned int vec_nr;
+
+	while (pending) {
+		unsigned int budget;
+
+		vec_nr = __ffs(pending);
+		pending &= pending - 1;
+
+		budget = READ_ONCE(softirq_budget_us[vec_nr]);
+		if (budget && used[vec_nr] >= (u64)budget * NSEC_PER_USEC) {
+			__this_cpu_inc(kstat.softirqs_deferred[vec_nr]);
+			over |= 1U << vec_nr;
+		}
+	}
+	return over;
+}
+
 #ifdef CONFIG_TRACE_IRQFLAGS
 /*
  * When we run softirqs from irq_exit() and thus on the hardirq stack we need
@@ -232,10 +285,13 @@ asmlinkage __visible void __do_softirq(void)
 	unsigned long end = jiffies + MAX_SOFTIRQ_TIME;
 	unsigned long old_flags = current->flags;
 	int max_restart = MAX_SOFTIRQ_RESTART;
+	u64 used[NR_SOFTIRQS] = { 0 };
 	struct softirq_action *h;
+	__u32 deferred, was_deferred;
 	bool in_hardirq;
 	__u32 pending;
 	int softirq_bit;
+	u64 start, now;
 
 	/*
 	 * Mask out PF_MEMALLOC s current task context is borrowed for the
@@ -244,6 +300,10 @@ asmlinkage __visible void __do_softirq(void)
 	 */
 	current->flags &= ~PF_MEMALLOC;
 
+	/* ksoftirqd is where deferred vectors run */
+	was_deferred = __this_cpu_read(softirq_deferred);
+	deferred = current == __this_cpu_read(ksoftirqd) ? 0 : was_deferred;
+
 	pending = local_softirq_pending();
 	account_irq_enter_time(current);
 
@@ -251,12 +311,17 @@ asmlinkage __visible void __do_softirq(void)
 	in_hardirq = lockdep_softirq_start();
 
 restart:
-	/* Reset the pending bitmask before enabling irqs */
-	set_softirq_pending(0);
+	/*
+	 * Reset the pending bitmask before enabling irqs, deferred vectors
+	 * stay pending for ksoftirqd.
+	 */
+	set_softirq_pending(pending & deferred);
+	pending &= ~deferred;
 
 	local_irq_enable();
 
 	h = softirq_vec;
+	now = local_clock();
 
 	while ((softirq_bit = ffs(pending))) {
 		unsigned int vec_nr;
@@ -278,6 +343,10 @@ restart:
 			       prev_count, preempt_count());
 			preempt_count_set(prev_count);
 		}
+		start = now;
+		now = local_clock();
+		used[vec_nr] += now - start;
+		__this_cpu_add(kstat.softirqs_time[vec_nr], now - start);
 		h++;
 		pending >>= softirq_bit;
 	}
@@ -286,13 +355,17 @@ restart:
 	local_irq_disable();
 
 	pending = local_softirq_pending();
-	if (pending) {
-		if (time_before(jiffies, end) && !need_resched() &&
-		    --max_restart)
+	if (pending & ~deferred) {
+		deferred |= softirq_over_budget(pending & ~deferred, used);
+
+		if ((pending & ~deferred) && time_before(jiffies, end) &&
+		    !need_resched() && --max_restart)
 			goto restart;
+	}
 
+	__this_cpu_write(softirq_deferred, (was_deferred | deferred) & pending);
+	if (pending)
 		wakeup_softirqd();
-	}
 
 	lockdep_softirq_end(in_hardirq);
 	account_irq_exit_time(current);
@@ -313,7 +386,7 @@ asmlinkage __visible void do_softirq(void)
 
 	pending = local_softirq_pending();
 
-	if (pending)
+	if (pending && !softirq_deferred_only())
 		do_softirq_own_stack();
 
 	local_irq_restore(flags);
@@ -340,6 +413,9 @@ void irq_enter(void)
 
 static inline void invoke_softirq(void)
 {
+	if (softirq_deferred_only())
+		return;
+
 	if (!force_irqthreads) {
 #ifdef CONFIG_HAVE_IRQ_EXIT_ON_IRQ_STACK
 		/*
@@ -734,6 +810,7 @@ static int cpu_callback(struct notifier_block *nfb, unsigned long action,
 	case CPU_DEAD:
 	case CPU_DEAD_FROZEN:
 		takeover_tasklets((unsigned long)hcpu);
+		per_cpu(softirq_deferred, (unsigned long)hcpu) = 0;
 		break;
 #endif /* CONFIG_HOTPLUG_CPU */
 	}
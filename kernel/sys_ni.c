@@ -67,6 +67,7 @@ cond_syscall(compat_sys_get_robust_list);
 cond_syscall(sys_epoll_create);
 cond_syscall(sys_epoll_create1);
 cond_syscall(sys_epoll_ctl);
+cond_syscall(sys_epoll_ctl_batch);
 cond_syscall(sys_epoll_wait);
 cond_syscall(sys_epoll_pwait);
 cond_syscall(compat_sys_epoll_pwait);
@@ -95,11 +96,15 @@ cond_syscall(sys_mq_timedsend);
 cond_syscall(sys_mq_timedreceive);
 cond_syscall(sys_mq_notify);
 cond_syscall(sys_mq_getsetattr);
+cond_syscall(sys_mq_timedsend_batch);
+cond_syscall(sys_mq_timedreceive_batch);
 cond_syscall(compat_sys_mq_open);
 cond_syscall(compat_sys_mq_timedsend);
 cond_syscall(compat_sys_mq_timedreceive);
 cond_syscall(compat_sys_mq_notify);
 cond_syscall(compat_sys_mq_getsetattr);
+cond_syscall(compat_sys_mq_timedsend_batch);
+cond_syscall(compat_sys_mq_timedreceive_batch);
 cond_syscall(sys_mbind);
 cond_syscall(sys_get_mempolicy);
 cond_syscall(sys_set_mempolicy);
@@ -243,3 +248,9 @@ cond_syscall(sys_bpf);
 
 /* execveat */
 cond_syscall(sys_execveat);
+
+/* restartable sequences */
+cond_syscall(sys_rseq);
+
+/* membarrier */
+cond_syscall(sys_membarrier);
@@ -460,6 +460,14 @@ static struct ctl_table kern_table[] = {
 		.proc_handler	= proc_dointvec,
 	},
 #endif
+	{
+		.procname	= "softirq_budget_us",
+		.data		= &softirq_budget_us,
+		.maxlen		= sizeof(softirq_budget_us),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
 	{
 		.procname	= "panic",
 		.data		= &panic_timeout,
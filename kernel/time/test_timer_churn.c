@@ -0,0 +1,236 @@
+/*
+ * Timer churn benchmark
+ *
+ * Mimics what TCP, neighbour and conntrack do to the timer wheel: lots of
+ * timeouts which are armed, pushed further out and cancelled, and which
+ * hardly ever expire.  One thread per online cpu keeps calling mod_timer()
+ * and del_timer() on its own set of timers for a while, and the cost per
+ * operation is reported.  With remote=1 every thread works on the timers
+ * of the next cpu's thread instead, and keeps them queued on that cpu's
+ * base, which exercises the locking of timers queued on another cpu.
+ *
+ * Results are printed to the kernel log when the module is loaded:
+ *
+ *	modprobe test_timer_churn nr_timers=10000 duration_ms=5000
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/atomic.h>
+#include <linux/completion.h>
+#include <linux/cpu.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/timer.h>
+#include <linux/vmalloc.h>
+
+static unsigned int nr_timers = 10000;
+module_param(nr_timers, uint, 0444);
+MODULE_PARM_DESC(nr_timers, "timers per cpu (default 10000)");
+
+static unsigned int duration_ms = 5000;
+module_param(duration_ms, uint, 0444);
+MODULE_PARM_DESC(duration_ms, "run time in milliseconds (default 5000)");
+
+static unsigned int max_timeout_s = 120;
+module_param(max_timeout_s, uint, 0444);
+MODULE_PARM_DESC(max_timeout_s, "longest timeout in seconds (default 120)");
+
+static bool remote;
+module_param(remote, bool, 0444);
+MODULE_PARM_DESC(remote, "churn the timers of the next cpu's thread");
+
+struct churn_thread {
+	struct task_struct	*task;
+	struct timer_list	*timers;
+	struct churn_thread	*target;
+	unsigned int		cpu;
+	unsigned long		mods;
+	unsigned long		dels;
+	u64			ns;
+};
+
+static struct churn_thread *threads;
+static unsigned int churn_nr_threads;
+static atomic_t churn_fired;
+static atomic_t churn_running;
+static DECLARE_COMPLETION(churn_done);
+
+static void churn_timer_fn(unsigned long data)
+{
+	atomic_inc(&churn_fired);
+}
+
+static int churn_thread_fn(void *data)
+{
+	struct churn_thread *ct = data;
+	struct timer_list *timers = ct->target->timers;
+	unsigned long span = max_t(unsigned long, max_timeout_s, 2) * HZ;
+	unsigned long end = jiffies + msecs_to_jiffies(duration_ms);
+	unsigned int i;
+	u64 start;
+
+	start = local_clock();
+	while (time_before(jiffies, end)) {
+		for (i = 0; i < nr_timers; i++) {
+			u32 rnd = prandom_u32();
+
+			/* Cancel one in four timeouts, push the others out */
+			if (!(rnd & 3)) {
+				del_timer(&timers[i]);
+				ct->dels++;
+			} else if (remote) {
+				/*
+				 * mod_timer() would move the timer over to
+				 * our own base, keep it on the target's.
+				 */
+				del_timer(&timers[i]);
+				timers[i].expires = jiffies + HZ +
+						    (rnd >> 2) % span;
+				add_timer_on(&timers[i], ct->target->cpu);
+				ct->mods++;
+			} else {
+				mod_timer(&timers[i],
+					  jiffies + HZ + (rnd >> 2) % span);
+				ct->mods++;
+			}
+		}
+		cond_resched();
+	}
+	ct->ns = local_clock() - start;
+
+	if (atomic_dec_and_test(&churn_running))
+		complete(&churn_done);
+
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!kthread_should_stop())
+			schedule();
+		__set_current_state(TASK_RUNNING);
+	}
+	return 0;
+}
+
+static void churn_report(void)
+{
+	unsigned long mods = 0, dels = 0;
+	u64 ns = 0;
+	unsigned int i;
+
+	for (i = 0; i < churn_nr_threads; i++) {
+		struct churn_thread *ct = &threads[i];
+		unsigned long ops = ct->mods + ct->dels;
+
+		pr_info("thread %u: %lu mod_timer %lu del_timer, %llu ns/op\n",
+			i, ct->mods, ct->dels,
+			ops ? div64_u64(ct->ns, ops) : 0);
+		mods += ct->mods;
+		dels += ct->dels;
+		ns += ct->ns;
+	}
+
+	pr_info("%u threads, %u timers each%s: %lu ops/s, %llu ns/op, %d expired\n",
+		churn_nr_threads, nr_timers, remote ? ", remote" : "",
+		(unsigned long)div64_u64((u64)(mods + dels) * 1000,
+					 max_t(unsigned int, duration_ms, 1)),
+		mods + dels ? div64_u64(ns, mods + dels) : 0,
+		atomic_read(&churn_fired));
+}
+
+static void churn_free(void)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < churn_nr_threads; i++) {
+		struct churn_thread *ct = &threads[i];
+
+		if (ct->task)
+			kthread_stop(ct->task);
+	}
+
+	for (i = 0; i < churn_nr_threads; i++) {
+		struct churn_thread *ct = &threads[i];
+
+		if (!ct->timers)
+			continue;
+		for (j = 0; j < nr_timers; j++)
+			del_timer_sync(&ct->timers[j]);
+		vfree(ct->timers);
+	}
+	kfree(threads);
+}
+
+static int __init test_timer_churn_init(void)
+{
+	unsigned int i, j, cpu;
+	int err = 0;
+
+	if (!nr_timers)
+		return -EINVAL;
+
+	get_online_cpus();
+
+	churn_nr_threads = num_online_cpus();
+	threads = kcalloc(churn_nr_threads, sizeof(*threads), GFP_KERNEL);
+	if (!threads) {
+		put_online_cpus();
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < churn_nr_threads; i++) {
+		struct churn_thread *ct = &threads[i];
+
+		ct->timers = vzalloc(nr_timers * sizeof(*ct->timers));
+		if (!ct->timers) {
+			err = -ENOMEM;
+			goto out;
+		}
+		for (j = 0; j < nr_timers; j++)
+			setup_timer(&ct->timers[j], churn_timer_fn, 0);
+		ct->target = remote ? &threads[(i + 1) % churn_nr_threads] : ct;
+	}
+
+	i = 0;
+	for_each_online_cpu(cpu) {
+		struct churn_thread *ct = &threads[i++];
+
+		ct->cpu = cpu;
+		ct->task = kthread_create_on_node(churn_thread_fn, ct,
+						  cpu_to_node(cpu),
+						  "timer_churn/%u", cpu);
+		if (IS_ERR(ct->task)) {
+			err = PTR_ERR(ct->task);
+			ct->task = NULL;
+			goto out;
+		}
+		kthread_bind(ct->task, cpu);
+	}
+
+	atomic_set(&churn_running, churn_nr_threads);
+	for (i = 0; i < churn_nr_threads; i++)
+		wake_up_process(threads[i].task);
+
+	wait_for_completion(&churn_done);
+	churn_report();
+out:
+	put_online_cpus();
+	churn_free();
+	return err;
+}
+
+static void __exit test_timer_churn_exit(void)
+{
+}
+
+module_init(test_timer_churn_init);
+module_exit(test_timer_churn_exit);
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("mod_timer()/del_timer() churn benchmark");
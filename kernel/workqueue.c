@@ -871,6 +871,27 @@ struct task_struct *wq_worker_sleeping(struct task_struct *task, int cpu)
 	return to_wakeup ? to_wakeup->task : NULL;
 }
 
+/**
+ * wq_worker_last_func - retrieve worker's last work function
+ * @task: Task to retrieve last work function of.
+ *
+ * Determine the last function a worker executed. This is called from
+ * the scheduler to get a worker's last known identity.
+ *
+ * CONTEXT:
+ * spin_lock_irq(rq->lock)
+ *
+ * Return:
+ * The last work function %current executed as a worker, NULL if it
+ * hasn't executed any work yet.
+ */
+work_func_t wq_worker_last_func(struct task_struct *task)
+{
+	struct worker *worker = kthread_data(task);
+
+	return worker->last_func;
+}
+
 /**
  * worker_set_flags - set worker flags and adjust nr_running accordingly
  * @worker: self
@@ -2059,9 +2080,12 @@ __acquires(&pool->lock)
 	/* we're done with it, release */
 	hash_del(&worker->hentry);
 	worker->current_work = NULL;
-	worker->current_func = NULL;
 	worker->current_pwq = NULL;
 	worker->desc_valid = false;
+
+	/* remembered for the scheduler, see wq_worker_last_func() */
+	worker->last_func = worker->current_func;
+	worker->current_func = NULL;
 	pwq_dec_nr_in_flight(pwq, work_color);
 }
 
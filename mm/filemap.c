@@ -34,6 +34,7 @@
 #include <linux/memcontrol.h>
 #include <linux/cleancache.h>
 #include <linux/rmap.h>
+#include <linux/psi.h>
 #include "internal.h"
 
 #define CREATE_TRACE_POINTS
@@ -108,18 +109,17 @@
  *   ->tasklist_lock            (memory_failure, collect_procs_ao)
  */
 
-static void page_cache_tree_delete(struct address_space *mapping,
-				   struct page *page, void *shadow)
+void page_cache_tree_delete(struct address_space *mapping,
+			    struct page *page, pgoff_t index, void *shadow)
 {
 	struct radix_tree_node *node;
-	unsigned long index;
 	unsigned int offset;
 	unsigned int tag;
 	void **slot;
 
 	VM_BUG_ON(!PageLocked(page));
 
-	__radix_tree_lookup(&mapping->page_tree, page->index, &node, &slot);
+	__radix_tree_lookup(&mapping->page_tree, index, &node, &slot);
 
 	if (shadow) {
 		mapping->nrshadows++;
@@ -141,7 +141,6 @@ static void page_cache_tree_delete(struct address_space *mapping,
 	}
 
 	/* Clear tree tags for the removed page */
-	index = page->index;
 	offset = index & RADIX_TREE_MAP_MASK;
 	for (tag = 0; tag < RADIX_TREE_MAX_TAGS; tag++) {
 		if (test_bit(offset, node->tags[tag]))
@@ -191,7 +190,7 @@ void __delete_from_page_cache(struct page *page, void *shadow)
 	else
 		cleancache_invalidate_page(mapping, page);
 
-	page_cache_tree_delete(mapping, page, shadow);
+	page_cache_tree_delete(mapping, page, page->index, shadow);
 
 	page->mapping = NULL;
 	/* Leave page->index set: truncation lookup relies upon it */
@@ -498,15 +497,14 @@ int replace_page_cache_page(struct page *old, struct page *new, gfp_t gfp_mask)
 }
 EXPORT_SYMBOL_GPL(replace_page_cache_page);
 
-static int page_cache_tree_insert(struct address_space *mapping,
-				  struct page *page, void **shadowp)
+int page_cache_tree_insert(struct address_space *mapping,
+			   struct page *page, pgoff_t index, void **shadowp)
 {
 	struct radix_tree_node *node;
 	void **slot;
 	int error;
 
-	error = __radix_tree_create(&mapping->page_tree, page->index,
-				    &node, &slot);
+	error = __radix_tree_create(&mapping->page_tree, index, &node, &slot);
 	if (error)
 		return error;
 	if (*slot) {
@@ -571,7 +569,7 @@ static int __add_to_page_cache_locked(struct page *page,
 	page->index = offset;
 
 	spin_lock_irq(&mapping->tree_lock);
-	error = page_cache_tree_insert(mapping, page, shadowp);
+	error = page_cache_tree_insert(mapping, page, offset, shadowp);
 	radix_tree_preload_end();
 	if (unlikely(error))
 		goto err_insert;
@@ -626,9 +624,9 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 		 * recently, in which case it should be activated like
 		 * any other repeatedly accessed page.
 		 */
-		if (shadow && workingset_refault(shadow)) {
+		if (shadow && workingset_refault(page, shadow)) {
 			SetPageActive(page);
-			workingset_activation(page);
+			SetPageWorkingset(page);
 		} else
 			ClearPageActive(page);
 		lru_cache_add(page);
@@ -679,10 +677,24 @@ EXPORT_SYMBOL(page_waitqueue);
 void wait_on_page_bit(struct page *page, int bit_nr)
 {
 	DEFINE_WAIT_BIT(wait, &page->flags, bit_nr);
+	bool thrashing = false;
+	unsigned long pflags;
 
-	if (test_bit(bit_nr, &page->flags))
-		__wait_on_bit(page_waitqueue(page), &wait, bit_wait_io,
-							TASK_UNINTERRUPTIBLE);
+	if (!test_bit(bit_nr, &page->flags))
+		return;
+
+	/* waiting for a refault of the workingset is a memory stall */
+	if (bit_nr == PG_locked && !PageUptodate(page) &&
+	    PageWorkingset(page)) {
+		psi_memstall_enter(&pflags);
+		thrashing = true;
+	}
+
+	__wait_on_bit(page_waitqueue(page), &wait, bit_wait_io,
+						TASK_UNINTERRUPTIBLE);
+
+	if (thrashing)
+		psi_memstall_leave(&pflags);
 }
 EXPORT_SYMBOL(wait_on_page_bit);
 
@@ -807,9 +819,19 @@ EXPORT_SYMBOL_GPL(page_endio);
 void __lock_page(struct page *page)
 {
 	DEFINE_WAIT_BIT(wait, &page->flags, PG_locked);
+	bool thrashing = false;
+	unsigned long pflags;
+
+	if (!PageUptodate(page) && PageWorkingset(page)) {
+		psi_memstall_enter(&pflags);
+		thrashing = true;
+	}
 
 	__wait_on_bit_lock(page_waitqueue(page), &wait, bit_wait_io,
 							TASK_UNINTERRUPTIBLE);
+
+	if (thrashing)
+		psi_memstall_leave(&pflags);
 }
 EXPORT_SYMBOL(__lock_page);
 
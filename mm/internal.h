@@ -26,6 +26,18 @@ extern int __do_page_cache_readahead(struct address_space *mapping,
 		struct file *filp, pgoff_t offset, unsigned long nr_to_read,
 		unsigned long lookahead_size);
 
+/*
+ * Radix tree slot management shared by the page cache and the swap
+ * cache, including the tracking of shadow entries.  Called with the
+ * mapping's tree_lock held.
+ */
+extern int page_cache_tree_insert(struct address_space *mapping,
+		struct page *page, pgoff_t index, void **shadowp);
+extern void page_cache_tree_delete(struct address_space *mapping,
+		struct page *page, pgoff_t index, void *shadow);
+extern void __clear_shadow_entry(struct address_space *mapping,
+		pgoff_t index, void *entry);
+
 /*
  * Submit IO for the read-ahead request in file_ra_state.
  */
@@ -99,6 +99,8 @@ static const char * const mem_cgroup_events_names[] = {
 	"pgpgout",
 	"pgfault",
 	"pgmajfault",
+	"workingset_refault",
+	"workingset_activate",
 };
 
 static const char * const mem_cgroup_lru_names[] = {
@@ -130,6 +132,10 @@ struct mem_cgroup_stat_cpu {
 	unsigned long events[MEMCG_NR_EVENTS];
 	unsigned long nr_page_events;
 	unsigned long targets[MEM_CGROUP_NTARGETS];
+
+	/* values at the last flush, see mem_cgroup_css_rstat_flush() */
+	long count_prev[MEM_CGROUP_STAT_NSTATS];
+	unsigned long events_prev[MEMCG_NR_EVENTS];
 };
 
 struct reclaim_iter {
@@ -323,11 +329,17 @@ struct mem_cgroup {
 	 */
 	struct mem_cgroup_stat_cpu __percpu *stat;
 	/*
-	 * used when a cpu is offlined or other synchronizations
+	 * The percpu counters folded by the rstat flush.  *_local covers
+	 * this memcg alone, *_tree its whole subtree and *_pending is what
+	 * the children flushed but hasn't been propagated upwards yet.
 	 * See mem_cgroup_read_stat().
 	 */
-	struct mem_cgroup_stat_cpu nocpu_base;
-	spinlock_t pcp_counter_lock;
+	long stat_local[MEM_CGROUP_STAT_NSTATS];
+	long stat_tree[MEM_CGROUP_STAT_NSTATS];
+	long stat_pending[MEM_CGROUP_STAT_NSTATS];
+	unsigned long events_local[MEMCG_NR_EVENTS];
+	unsigned long events_tree[MEMCG_NR_EVENTS];
+	unsigned long events_pending[MEMCG_NR_EVENTS];
 
 #if defined(CONFIG_MEMCG_KMEM) && defined(CONFIG_INET)
 	struct cg_proto tcp_mem;
@@ -444,13 +456,7 @@ static inline bool mem_cgroup_is_root(struct mem_cgroup *memcg)
 	return (memcg == root_mem_cgroup);
 }
 
-/*
- * We restrict the id in the range of [1, 65535], so it can fit into
- * an unsigned short.
- */
-#define MEM_CGROUP_ID_MAX	USHRT_MAX
-
-static inline unsigned short mem_cgroup_id(struct mem_cgroup *memcg)
+unsigned short mem_cgroup_id(struct mem_cgroup *memcg)
 {
 	return memcg->css.id;
 }
@@ -461,7 +467,7 @@ static inline unsigned short mem_cgroup_id(struct mem_cgroup *memcg)
  * css_tryget_online() if the mem_cgroup is used for charging. (dropping
  * refcnt from swap can be called against removed memcg.)
  */
-static inline struct mem_cgroup *mem_cgroup_from_id(unsigned short id)
+struct mem_cgroup *mem_cgroup_from_id(unsigned short id)
 {
 	struct cgroup_subsys_state *css;
 
@@ -773,56 +779,109 @@ mem_cgroup_largest_soft_limit_node(struct mem_cgroup_tree_per_zone *mctz)
 /*
  * Implementation Note: reading percpu statistics for memcg.
  *
- * Both of vmstat[] and percpu_counter has threshold and do periodic
- * synchronization to implement "quick" read. There are trade-off between
- * reading cost and precision of value. Then, we may have a chance to implement
- * a periodic synchronizion of counter in memcg's counter.
- *
- * But this _read() function is used for user interface now. The user accounts
- * memory usage by memory cgroup and he _always_ requires exact value because
- * he accounts memory. Even if we provide quick-and-fuzzy read, we always
- * have to visit all online cpus and make sum. So, for now, unnecessary
- * synchronization is not implemented. (just implemented for cpu hotplug)
+ * Summing up the percpu counters of every cpu, and of every memcg in the
+ * subtree for hierarchical values, on each read doesn't scale to many
+ * cpus and many cgroups.  Instead, whoever updates the percpu counters
+ * tells rstat about it with memcg_rstat_updated(), and readers call
+ * mem_cgroup_flush_stats() first.  The flush visits only the memcgs which
+ * were updated since the last flush, on each cpu, and folds their percpu
+ * deltas into ->stat_local and ->stat_tree, children before parents.
  *
- * If there are kernel internal actions which can make use of some not-exact
- * value, and reading all cpu value can be performance bottleneck in some
- * common workload, threashold and synchonization as vmstat[] should be
- * implemented.
+ * The counters of dead cpus are simply left in place, they are folded in
+ * like the others and there's no need to drain them.
+ */
+static void memcg_rstat_updated(struct mem_cgroup *memcg)
+{
+	/* preemption is disabled, the counters were updated on this cpu */
+	cgroup_rstat_updated(memcg->css.cgroup, smp_processor_id());
+}
+
+static void mem_cgroup_flush_stats(struct mem_cgroup *memcg)
+{
+	cgroup_rstat_flush(memcg->css.cgroup);
+}
+
+/*
+ * The usage thresholds of the root are checked against the flushed stats
+ * from the charge path, which must not flush itself.  Flush periodically
+ * so they don't go stale without readers.
  */
+#define MEMCG_STATS_FLUSH_TIME	(2UL * HZ)
+
+static void flush_memcg_stats_dwork(struct work_struct *w);
+static DECLARE_DEFERRABLE_WORK(stats_flush_dwork, flush_memcg_stats_dwork);
+
+static void flush_memcg_stats_dwork(struct work_struct *w)
+{
+	mem_cgroup_flush_stats(root_mem_cgroup);
+	queue_delayed_work(system_unbound_wq, &stats_flush_dwork,
+			   MEMCG_STATS_FLUSH_TIME);
+}
+
+static void mem_cgroup_css_rstat_flush(struct cgroup_subsys_state *css,
+				       int cpu)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(css);
+	struct mem_cgroup_stat_cpu *statc = per_cpu_ptr(memcg->stat, cpu);
+	struct mem_cgroup *parent = NULL;
+	int i;
+
+	/*
+	 * Propagate along the cgroup tree whatever use_hierarchy says,
+	 * tree_stat() picks the value matching for_each_mem_cgroup_tree().
+	 */
+	if (css->parent)
+		parent = mem_cgroup_from_css(css->parent);
+
+	for (i = 0; i < MEM_CGROUP_STAT_NSTATS; i++) {
+		long v, delta;
+
+		/* what the children flushed, consumed on the first cpu */
+		delta = memcg->stat_pending[i];
+		memcg->stat_pending[i] = 0;
+
+		v = READ_ONCE(statc->count[i]);
+		memcg->stat_local[i] += v - statc->count_prev[i];
+		delta += v - statc->count_prev[i];
+		statc->count_prev[i] = v;
+
+		if (!delta)
+			continue;
+		memcg->stat_tree[i] += delta;
+		if (parent)
+			parent->stat_pending[i] += delta;
+	}
+
+	for (i = 0; i < MEMCG_NR_EVENTS; i++) {
+		unsigned long v, delta;
+
+		delta = memcg->events_pending[i];
+		memcg->events_pending[i] = 0;
+
+		v = READ_ONCE(statc->events[i]);
+		memcg->events_local[i] += v - statc->events_prev[i];
+		delta += v - statc->events_prev[i];
+		statc->events_prev[i] = v;
+
+		if (!delta)
+			continue;
+		memcg->events_tree[i] += delta;
+		if (parent)
+			parent->events_pending[i] += delta;
+	}
+}
+
+/* These return the values as of the last mem_cgroup_flush_stats() */
 static long mem_cgroup_read_stat(struct mem_cgroup *memcg,
 				 enum mem_cgroup_stat_index idx)
 {
-	long val = 0;
-	int cpu;
-
-	get_online_cpus();
-	for_each_online_cpu(cpu)
-		val += per_cpu(memcg->stat->count[idx], cpu);
-#ifdef CONFIG_HOTPLUG_CPU
-	spin_lock(&memcg->pcp_counter_lock);
-	val += memcg->nocpu_base.count[idx];
-	spin_unlock(&memcg->pcp_counter_lock);
-#endif
-	put_online_cpus();
-	return val;
+	return memcg->stat_local[idx];
 }
 
 static unsigned long mem_cgroup_read_events(struct mem_cgroup *memcg,
 					    enum mem_cgroup_events_index idx)
 {
-	unsigned long val = 0;
-	int cpu;
-
-	get_online_cpus();
-	for_each_online_cpu(cpu)
-		val += per_cpu(memcg->stat->events[idx], cpu);
-#ifdef CONFIG_HOTPLUG_CPU
-	spin_lock(&memcg->pcp_counter_lock);
-	val += memcg->nocpu_base.events[idx];
-	spin_unlock(&memcg->pcp_counter_lock);
-#endif
-	put_online_cpus();
-	return val;
+	return memcg->events_local[idx];
 }
 
 static void mem_cgroup_charge_statistics(struct mem_cgroup *memcg,
@@ -853,6 +912,7 @@ static void mem_cgroup_charge_statistics(struct mem_cgroup *memcg,
 	}
 
 	__this_cpu_add(memcg->stat->nr_page_events, nr_pages);
+	memcg_rstat_updated(memcg);
 }
 
 unsigned long mem_cgroup_get_lru_size(struct lruvec *lruvec, enum lru_list lru)
@@ -1161,6 +1221,7 @@ void __mem_cgroup_count_vm_event(struct mm_struct *mm, enum vm_event_item idx)
 	if (unlikely(!memcg))
 		goto out;
 
+	preempt_disable();
 	switch (idx) {
 	case PGFAULT:
 		this_cpu_inc(memcg->stat->events[MEM_CGROUP_EVENTS_PGFAULT]);
@@ -1171,6 +1232,8 @@ void __mem_cgroup_count_vm_event(struct mm_struct *mm, enum vm_event_item idx)
 	default:
 		BUG();
 	}
+	memcg_rstat_updated(memcg);
+	preempt_enable();
 out:
 	rcu_read_unlock();
 }
@@ -1328,6 +1391,23 @@ int mem_cgroup_inactive_anon_is_low(struct lruvec *lruvec)
 	return inactive * inactive_ratio < active;
 }
 
+/**
+ * mem_cgroup_lruvec_memcg - return the memcg owning an lruvec
+ * @lruvec: the lruvec
+ *
+ * Returns %NULL if the memory controller is disabled.
+ */
+struct mem_cgroup *mem_cgroup_lruvec_memcg(struct lruvec *lruvec)
+{
+	struct mem_cgroup_per_zone *mz;
+
+	if (mem_cgroup_disabled())
+		return NULL;
+
+	mz = container_of(lruvec, struct mem_cgroup_per_zone, lruvec);
+	return mz->memcg;
+}
+
 bool mem_cgroup_lruvec_online(struct lruvec *lruvec)
 {
 	struct mem_cgroup_per_zone *mz;
@@ -1469,6 +1549,8 @@ void mem_cgroup_print_oom_info(struct mem_cgroup *memcg, struct task_struct *p)
 		K((u64)page_counter_read(&memcg->kmem)),
 		K((u64)memcg->kmem.limit), memcg->kmem.failcnt);
 
+	mem_cgroup_flush_stats(memcg);
+
 	for_each_mem_cgroup_tree(iter, memcg) {
 		pr_info("Memory cgroup stats for ");
 		pr_cont_cgroup_path(iter->css.cgroup);
@@ -2043,8 +2125,12 @@ void mem_cgroup_update_page_stat(struct mem_cgroup *memcg,
 {
 	VM_BUG_ON(!rcu_read_lock_held());
 
-	if (memcg)
+	if (memcg) {
+		preempt_disable();
 		this_cpu_add(memcg->stat->count[idx], val);
+		memcg_rstat_updated(memcg);
+		preempt_enable();
+	}
 }
 
 /*
@@ -2052,9 +2138,29 @@ void mem_cgroup_update_page_stat(struct mem_cgroup *memcg,
  * TODO: maybe necessary to use big numbers in big irons.
  */
 #define CHARGE_BATCH	32U
-struct memcg_stock_pcp {
+
+/*
+ * Each cpu caches precharged pages for a few memcgs, so that tasks of
+ * different cgroups sharing a cpu don't drain each other's stock on every
+ * switch.  Uncharges go to the stock as well, up to a limit, and so do
+ * precharges of the kmem counter.  Every stocked page, of either kind,
+ * holds a css reference, while a kmem charge outside the stock holds
+ * none: its references are those of the memory+memsw charge.  The stock
+ * is used from irq context by the uncharge paths, it's only accessed with
+ * irqs disabled.
+ */
+#define MEMCG_STOCK_ENTRIES	4
+#define MEMCG_STOCK_MAX		(2 * CHARGE_BATCH)
+
+struct memcg_stock_entry {
 	struct mem_cgroup *cached; /* this never be root cgroup */
-	unsigned int nr_pages;
+	unsigned int nr_pages;	/* charged to ->memory and ->memsw */
+	unsigned int nr_kmem;	/* charged to ->kmem */
+};
+
+struct memcg_stock_pcp {
+	struct memcg_stock_entry entry[MEMCG_STOCK_ENTRIES];
+	unsigned int evict;	/* next entry to replace when all are used */
 	struct work_struct work;
 	unsigned long flags;
 #define FLUSHING_CACHED_CHARGE	0
@@ -2062,49 +2168,82 @@ struct memcg_stock_pcp {
 static DEFINE_PER_CPU(struct memcg_stock_pcp, memcg_stock);
 static DEFINE_MUTEX(percpu_charge_mutex);
 
+static struct memcg_stock_entry *stock_entry(struct memcg_stock_pcp *stock,
+					     struct mem_cgroup *memcg)
+{
+	int i;
+
+	for (i = 0; i < MEMCG_STOCK_ENTRIES; i++)
+		if (stock->entry[i].cached == memcg)
+			return &stock->entry[i];
+	return NULL;
+}
+
 /**
  * consume_stock: Try to consume stocked charge on this cpu.
  * @memcg: memcg to consume from.
  * @nr_pages: how many pages to charge.
+ * @kmem: consume precharges of the kmem counter instead of memory+memsw
  *
- * The charges will only happen if @memcg matches the current cpu's memcg
- * stock, and at least @nr_pages are available in that stock.  Failure to
+ * The charges will only happen if the current cpu's stock has an entry
+ * for @memcg, with at least @nr_pages available in it.  Failure to
  * service an allocation will refill the stock.
  *
  * returns true if successful, false otherwise.
  */
-static bool consume_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
+static bool consume_stock(struct mem_cgroup *memcg, unsigned int nr_pages,
+			  bool kmem)
 {
-	struct memcg_stock_pcp *stock;
+	struct memcg_stock_entry *entry;
+	unsigned long flags;
 	bool ret = false;
 
 	if (nr_pages > CHARGE_BATCH)
 		return ret;
 
-	stock = &get_cpu_var(memcg_stock);
-	if (memcg == stock->cached && stock->nr_pages >= nr_pages) {
-		stock->nr_pages -= nr_pages;
+	local_irq_save(flags);
+	entry = stock_entry(this_cpu_ptr(&memcg_stock), memcg);
+	if (entry && kmem && entry->nr_kmem >= nr_pages) {
+		entry->nr_kmem -= nr_pages;
+		ret = true;
+	} else if (entry && !kmem && entry->nr_pages >= nr_pages) {
+		entry->nr_pages -= nr_pages;
 		ret = true;
 	}
-	put_cpu_var(memcg_stock);
+	local_irq_restore(flags);
 	return ret;
 }
 
 /*
- * Returns stocks cached in percpu and reset cached information.
+ * Returns the charges cached in a stock entry and resets it.
  */
-static void drain_stock(struct memcg_stock_pcp *stock)
+static void drain_stock_entry(struct memcg_stock_entry *entry)
 {
-	struct mem_cgroup *old = stock->cached;
+	struct mem_cgroup *old = entry->cached;
 
-	if (stock->nr_pages) {
-		page_counter_uncharge(&old->memory, stock->nr_pages);
+	if (entry->nr_pages) {
+		page_counter_uncharge(&old->memory, entry->nr_pages);
 		if (do_swap_account)
-			page_counter_uncharge(&old->memsw, stock->nr_pages);
-		css_put_many(&old->css, stock->nr_pages);
-		stock->nr_pages = 0;
+			page_counter_uncharge(&old->memsw, entry->nr_pages);
 	}
-	stock->cached = NULL;
+	if (entry->nr_kmem)
+		page_counter_uncharge(&old->kmem, entry->nr_kmem);
+	if (entry->nr_pages + entry->nr_kmem)
+		css_put_many(&old->css, entry->nr_pages + entry->nr_kmem);
+	entry->nr_pages = 0;
+	entry->nr_kmem = 0;
+	entry->cached = NULL;
+}
+
+/*
+ * Returns stocks cached in percpu and reset cached information.
+ */
+static void drain_stock(struct memcg_stock_pcp *stock)
+{
+	int i;
+
+	for (i = 0; i < MEMCG_STOCK_ENTRIES; i++)
+		drain_stock_entry(&stock->entry[i]);
 }
 
 /*
@@ -2113,25 +2252,52 @@ static void drain_stock(struct memcg_stock_pcp *stock)
  */
 static void drain_local_stock(struct work_struct *dummy)
 {
-	struct memcg_stock_pcp *stock = this_cpu_ptr(&memcg_stock);
+	struct memcg_stock_pcp *stock;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	stock = this_cpu_ptr(&memcg_stock);
 	drain_stock(stock);
 	clear_bit(FLUSHING_CACHED_CHARGE, &stock->flags);
+	local_irq_restore(flags);
 }
 
 /*
- * Cache charges(val) to local per_cpu area.
- * This will be consumed by consume_stock() function, later.
+ * Cache charges(val) to local per_cpu area, along with their css
+ * references.  This will be consumed by consume_stock() function, later.
  */
-static void refill_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
+static void refill_stock(struct mem_cgroup *memcg, unsigned int nr_pages,
+			 unsigned int nr_kmem)
 {
-	struct memcg_stock_pcp *stock = &get_cpu_var(memcg_stock);
+	struct memcg_stock_entry *entry;
+	struct memcg_stock_pcp *stock;
+	unsigned long flags;
+	int i;
 
-	if (stock->cached != memcg) { /* reset if necessary */
-		drain_stock(stock);
-		stock->cached = memcg;
+	local_irq_save(flags);
+	stock = this_cpu_ptr(&memcg_stock);
+	entry = stock_entry(stock, memcg);
+	if (!entry) {
+		/* take an empty entry, or replace them round robin */
+		for (i = 0; i < MEMCG_STOCK_ENTRIES; i++) {
+			if (!(stock->entry[i].nr_pages + stock->entry[i].nr_kmem)) {
+				entry = &stock->entry[i];
+				break;
+			}
+		}
+		if (!entry) {
+			entry = &stock->entry[stock->evict];
+			stock->evict = (stock->evict + 1) % MEMCG_STOCK_ENTRIES;
+		}
+		drain_stock_entry(entry);
+		entry->cached = memcg;
 	}
-	stock->nr_pages += nr_pages;
-	put_cpu_var(memcg_stock);
+	entry->nr_pages += nr_pages;
+	entry->nr_kmem += nr_kmem;
+	/* don't let batched uncharges pile up */
+	if (entry->nr_pages > MEMCG_STOCK_MAX || entry->nr_kmem > MEMCG_STOCK_MAX)
+		drain_stock_entry(entry);
+	local_irq_restore(flags);
 }
 
 /*
@@ -2150,12 +2316,19 @@ static void drain_all_stock(struct mem_cgroup *root_memcg)
 	curcpu = get_cpu();
 	for_each_online_cpu(cpu) {
 		struct memcg_stock_pcp *stock = &per_cpu(memcg_stock, cpu);
-		struct mem_cgroup *memcg;
+		bool flush = false;
+		int i;
 
-		memcg = stock->cached;
-		if (!memcg || !stock->nr_pages)
-			continue;
-		if (!mem_cgroup_is_descendant(memcg, root_memcg))
+		for (i = 0; i < MEMCG_STOCK_ENTRIES; i++) {
+			struct memcg_stock_entry *entry = &stock->entry[i];
+			struct mem_cgroup *memcg = entry->cached;
+
+			if (!memcg || !(entry->nr_pages + entry->nr_kmem))
+				continue;
+			if (mem_cgroup_is_descendant(memcg, root_memcg))
+				flush = true;
+		}
+		if (!flush)
 			continue;
 		if (!test_and_set_bit(FLUSHING_CACHED_CHARGE, &stock->flags)) {
 			if (cpu == curcpu)
@@ -2169,37 +2342,12 @@ static void drain_all_stock(struct mem_cgroup *root_memcg)
 	mutex_unlock(&percpu_charge_mutex);
 }
 
-/*
- * This function drains percpu counter value from DEAD cpu and
- * move it to local cpu. Note that this function can be preempted.
- */
-static void mem_cgroup_drain_pcp_counter(struct mem_cgroup *memcg, int cpu)
-{
-	int i;
-
-	spin_lock(&memcg->pcp_counter_lock);
-	for (i = 0; i < MEM_CGROUP_STAT_NSTATS; i++) {
-		long x = per_cpu(memcg->stat->count[i], cpu);
-
-		per_cpu(memcg->stat->count[i], cpu) = 0;
-		memcg->nocpu_base.count[i] += x;
-	}
-	for (i = 0; i < MEM_CGROUP_EVENTS_NSTATS; i++) {
-		unsigned long x = per_cpu(memcg->stat->events[i], cpu);
-
-		per_cpu(memcg->stat->events[i], cpu) = 0;
-		memcg->nocpu_base.events[i] += x;
-	}
-	spin_unlock(&memcg->pcp_counter_lock);
-}
-
 static int memcg_cpu_hotplug_callback(struct notifier_block *nb,
 					unsigned long action,
 					void *hcpu)
 {
 	int cpu = (unsigned long)hcpu;
 	struct memcg_stock_pcp *stock;
-	struct mem_cgroup *iter;
 
 	if (action == CPU_ONLINE)
 		return NOTIFY_OK;
@@ -2207,9 +2355,6 @@ static int memcg_cpu_hotplug_callback(struct notifier_block *nb,
 	if (action != CPU_DEAD && action != CPU_DEAD_FROZEN)
 		return NOTIFY_OK;
 
-	for_each_mem_cgroup(iter)
-		mem_cgroup_drain_pcp_counter(iter, cpu);
-
 	stock = &per_cpu(memcg_stock, cpu);
 	drain_stock(stock);
 	return NOTIFY_OK;
@@ -2230,7 +2375,7 @@ static int try_charge(struct mem_cgroup *memcg, gfp_t gfp_mask,
 	if (mem_cgroup_is_root(memcg))
 		goto done;
 retry:
-	if (consume_stock(memcg, nr_pages))
+	if (consume_stock(memcg, nr_pages, false))
 		goto done;
 
 	if (!do_swap_account ||
@@ -2322,7 +2467,7 @@ bypass:
 done_restock:
 	css_get_many(&memcg->css, batch);
 	if (batch > nr_pages)
-		refill_stock(memcg, batch - nr_pages);
+		refill_stock(memcg, batch - nr_pages, 0);
 	if (!(gfp_mask & __GFP_WAIT))
 		goto done;
 	/*
@@ -2351,6 +2496,35 @@ static void cancel_charge(struct mem_cgroup *memcg, unsigned int nr_pages)
 	css_put_many(&memcg->css, nr_pages);
 }
 
+/*
+ * Uncharge @nr_pages of memory+memsw, @nr_kmem of them also charged to
+ * kmem, and drop their css references.  Small uncharges are batched in
+ * the local stock, where the next charge on this cpu is likely to find
+ * them, unless somebody waits for the memcg OOM to resolve or the memcg
+ * is going away.
+ */
+static void uncharge_to_stock(struct mem_cgroup *memcg, unsigned long nr_pages,
+			      unsigned long nr_kmem)
+{
+	if (nr_pages <= CHARGE_BATCH && !atomic_read(&memcg->under_oom) &&
+	    (memcg->css.flags & CSS_ONLINE)) {
+		/* the kmem precharges need their own css references */
+		if (nr_kmem)
+			css_get_many(&memcg->css, nr_kmem);
+		refill_stock(memcg, nr_pages, nr_kmem);
+		return;
+	}
+
+	page_counter_uncharge(&memcg->memory, nr_pages);
+	if (do_swap_account)
+		page_counter_uncharge(&memcg->memsw, nr_pages);
+	if (nr_kmem)
+		page_counter_uncharge(&memcg->kmem, nr_kmem);
+	memcg_oom_recover(memcg);
+
+	css_put_many(&memcg->css, nr_pages);
+}
+
 /*
  * try_get_mem_cgroup_from_page - look up page's memcg association
  * @page: the page
@@ -2454,12 +2628,31 @@ static void commit_charge(struct page *page, struct mem_cgroup *memcg,
 int memcg_charge_kmem(struct mem_cgroup *memcg, gfp_t gfp,
 		      unsigned long nr_pages)
 {
+	unsigned long batch = max_t(unsigned long, CHARGE_BATCH, nr_pages);
 	struct page_counter *counter;
 	int ret = 0;
 
-	ret = page_counter_try_charge(&memcg->kmem, nr_pages, &counter);
-	if (ret < 0)
-		return ret;
+	/*
+	 * Precharge the kmem counter in batches too, slab pages come and
+	 * go one at a time.  Only the memory+memsw charge below holds css
+	 * references, drop the ones that came with a stocked precharge.
+	 */
+	if (consume_stock(memcg, nr_pages, true)) {
+		css_put_many(&memcg->css, nr_pages);
+	} else {
+		ret = page_counter_try_charge(&memcg->kmem, batch, &counter);
+		if (ret < 0 && batch > nr_pages) {
+			batch = nr_pages;
+			ret = page_counter_try_charge(&memcg->kmem, batch,
+						      &counter);
+		}
+		if (ret < 0)
+			return ret;
+		if (batch > nr_pages) {
+			css_get_many(&memcg->css, batch - nr_pages);
+			refill_stock(memcg, 0, batch - nr_pages);
+		}
+	}
 
 	ret = try_charge(memcg, gfp, nr_pages);
 	if (ret == -EINTR)  {
@@ -2491,13 +2684,7 @@ int memcg_charge_kmem(struct mem_cgroup *memcg, gfp_t gfp,
 
 void memcg_uncharge_kmem(struct mem_cgroup *memcg, unsigned long nr_pages)
 {
-	page_counter_uncharge(&memcg->memory, nr_pages);
-	if (do_swap_account)
-		page_counter_uncharge(&memcg->memsw, nr_pages);
-
-	page_counter_uncharge(&memcg->kmem, nr_pages);
-
-	css_put_many(&memcg->css, nr_pages);
+	uncharge_to_stock(memcg, nr_pages, nr_pages);
 }
 
 /*
@@ -2773,6 +2960,7 @@ void mem_cgroup_split_huge_fixup(struct page *head)
 
 	__this_cpu_sub(head->mem_cgroup->stat->count[MEM_CGROUP_STAT_RSS_HUGE],
 		       HPAGE_PMD_NR);
+	memcg_rstat_updated(head->mem_cgroup);
 }
 #endif /* CONFIG_TRANSPARENT_HUGEPAGE */
 
@@ -2781,7 +2969,11 @@ static void mem_cgroup_swap_statistics(struct mem_cgroup *memcg,
 					 bool charge)
 {
 	int val = (charge) ? 1 : -1;
+
+	preempt_disable();
 	this_cpu_add(memcg->stat->count[MEM_CGROUP_STAT_SWAP], val);
+	memcg_rstat_updated(memcg);
+	preempt_enable();
 }
 
 /**
@@ -3111,21 +3303,39 @@ out:
 	return retval;
 }
 
+/*
+ * The hierarchical values, as of the last mem_cgroup_flush_stats().  Like
+ * for_each_mem_cgroup_tree(), they cover the subtree only for the root and
+ * with use_hierarchy.
+ */
+static bool mem_cgroup_tree_stats(struct mem_cgroup *memcg)
+{
+	return mem_cgroup_is_root(memcg) || memcg->use_hierarchy;
+}
+
 static unsigned long tree_stat(struct mem_cgroup *memcg,
 			       enum mem_cgroup_stat_index idx)
 {
-	struct mem_cgroup *iter;
-	long val = 0;
+	long val;
 
-	/* Per-cpu values can be negative, use a signed accumulator */
-	for_each_mem_cgroup_tree(iter, memcg)
-		val += mem_cgroup_read_stat(iter, idx);
+	if (mem_cgroup_tree_stats(memcg))
+		val = memcg->stat_tree[idx];
+	else
+		val = memcg->stat_local[idx];
 
 	if (val < 0) /* race ? */
 		val = 0;
 	return val;
 }
 
+static unsigned long tree_events(struct mem_cgroup *memcg,
+				 enum mem_cgroup_events_index idx)
+{
+	if (mem_cgroup_tree_stats(memcg))
+		return memcg->events_tree[idx];
+	return memcg->events_local[idx];
+}
+
 static inline u64 mem_cgroup_usage(struct mem_cgroup *memcg, bool swap)
 {
 	u64 val;
@@ -3144,6 +3354,14 @@ static inline u64 mem_cgroup_usage(struct mem_cgroup *memcg, bool swap)
 	return val << PAGE_SHIFT;
 }
 
+/* mem_cgroup_usage() for readers, which can afford a flush */
+static u64 mem_cgroup_usage_flushed(struct mem_cgroup *memcg, bool swap)
+{
+	if (mem_cgroup_is_root(memcg))
+		mem_cgroup_flush_stats(memcg);
+	return mem_cgroup_usage(memcg, swap);
+}
+
 enum {
 	RES_USAGE,
 	RES_LIMIT,
@@ -3175,9 +3393,9 @@ static u64 mem_cgroup_read_u64(struct cgroup_subsys_state *css,
 	switch (MEMFILE_ATTR(cft->private)) {
 	case RES_USAGE:
 		if (counter == &memcg->memory)
-			return mem_cgroup_usage(memcg, false);
+			return mem_cgroup_usage_flushed(memcg, false);
 		if (counter == &memcg->memsw)
-			return mem_cgroup_usage(memcg, true);
+			return mem_cgroup_usage_flushed(memcg, true);
 		return (u64)page_counter_read(counter) * PAGE_SIZE;
 	case RES_LIMIT:
 		return (u64)counter->limit * PAGE_SIZE;
@@ -3462,6 +3680,8 @@ static int memcg_stat_show(struct seq_file *m, void *v)
 		     MEM_CGROUP_EVENTS_NSTATS);
 	BUILD_BUG_ON(ARRAY_SIZE(mem_cgroup_lru_names) != NR_LRU_LISTS);
 
+	mem_cgroup_flush_stats(memcg);
+
 	for (i = 0; i < MEM_CGROUP_STAT_NSTATS; i++) {
 		if (i == MEM_CGROUP_STAT_SWAP && !do_swap_account)
 			continue;
@@ -3490,23 +3710,15 @@ static int memcg_stat_show(struct seq_file *m, void *v)
 			   (u64)memsw * PAGE_SIZE);
 
 	for (i = 0; i < MEM_CGROUP_STAT_NSTATS; i++) {
-		long long val = 0;
-
 		if (i == MEM_CGROUP_STAT_SWAP && !do_swap_account)
 			continue;
-		for_each_mem_cgroup_tree(mi, memcg)
-			val += mem_cgroup_read_stat(mi, i) * PAGE_SIZE;
-		seq_printf(m, "total_%s %lld\n", mem_cgroup_stat_names[i], val);
+		seq_printf(m, "total_%s %llu\n", mem_cgroup_stat_names[i],
+			   (u64)tree_stat(memcg, i) * PAGE_SIZE);
 	}
 
-	for (i = 0; i < MEM_CGROUP_EVENTS_NSTATS; i++) {
-		unsigned long long val = 0;
-
-		for_each_mem_cgroup_tree(mi, memcg)
-			val += mem_cgroup_read_events(mi, i);
-		seq_printf(m, "total_%s %llu\n",
-			   mem_cgroup_events_names[i], val);
-	}
+	for (i = 0; i < MEM_CGROUP_EVENTS_NSTATS; i++)
+		seq_printf(m, "total_%s %lu\n", mem_cgroup_events_names[i],
+			   tree_events(memcg, i));
 
 	for (i = 0; i < NR_LRU_LISTS; i++) {
 		unsigned long long val = 0;
@@ -3683,10 +3895,10 @@ static int __mem_cgroup_usage_register_event(struct mem_cgroup *memcg,
 
 	if (type == _MEM) {
 		thresholds = &memcg->thresholds;
-		usage = mem_cgroup_usage(memcg, false);
+		usage = mem_cgroup_usage_flushed(memcg, false);
 	} else if (type == _MEMSWAP) {
 		thresholds = &memcg->memsw_thresholds;
-		usage = mem_cgroup_usage(memcg, true);
+		usage = mem_cgroup_usage_flushed(memcg, true);
 	} else
 		BUG();
 
@@ -3772,10 +3984,10 @@ static void __mem_cgroup_usage_unregister_event(struct mem_cgroup *memcg,
 
 	if (type == _MEM) {
 		thresholds = &memcg->thresholds;
-		usage = mem_cgroup_usage(memcg, false);
+		usage = mem_cgroup_usage_flushed(memcg, false);
 	} else if (type == _MEMSWAP) {
 		thresholds = &memcg->memsw_thresholds;
-		usage = mem_cgroup_usage(memcg, true);
+		usage = mem_cgroup_usage_flushed(memcg, true);
 	} else
 		BUG();
 
@@ -4380,7 +4592,6 @@ static struct mem_cgroup *mem_cgroup_alloc(void)
 	memcg->stat = alloc_percpu(struct mem_cgroup_stat_cpu);
 	if (!memcg->stat)
 		goto out_free;
-	spin_lock_init(&memcg->pcp_counter_lock);
 	return memcg;
 
 out_free:
@@ -4547,6 +4758,9 @@ static void mem_cgroup_css_offline(struct cgroup_subsys_state *css)
 	vmpressure_cleanup(&memcg->vmpressure);
 
 	memcg_deactivate_kmem(memcg);
+
+	/* the cached charges would keep the css pinned */
+	drain_all_stock(memcg);
 }
 
 static void mem_cgroup_css_free(struct cgroup_subsys_state *css)
@@ -4789,6 +5003,8 @@ static int mem_cgroup_move_account(struct page *page,
 		__this_cpu_add(to->stat->count[MEM_CGROUP_STAT_WRITEBACK],
 			       nr_pages);
 	}
+	memcg_rstat_updated(from);
+	memcg_rstat_updated(to);
 
 	/*
 	 * It is safe to change page->mem_cgroup here because the page
@@ -5238,7 +5454,7 @@ static void mem_cgroup_bind(struct cgroup_subsys_state *root_css)
 static u64 memory_current_read(struct cgroup_subsys_state *css,
 			       struct cftype *cft)
 {
-	return mem_cgroup_usage(mem_cgroup_from_css(css), false);
+	return mem_cgroup_usage_flushed(mem_cgroup_from_css(css), false);
 }
 
 static int memory_low_show(struct seq_file *m, void *v)
@@ -5337,6 +5553,8 @@ static int memory_events_show(struct seq_file *m, void *v)
 {
 	struct mem_cgroup *memcg = mem_cgroup_from_css(seq_css(m));
 
+	mem_cgroup_flush_stats(memcg);
+
 	seq_printf(m, "low %lu\n", mem_cgroup_read_events(memcg, MEMCG_LOW));
 	seq_printf(m, "high %lu\n", mem_cgroup_read_events(memcg, MEMCG_HIGH));
 	seq_printf(m, "max %lu\n", mem_cgroup_read_events(memcg, MEMCG_MAX));
@@ -5382,6 +5600,7 @@ struct cgroup_subsys memory_cgrp_subsys = {
 	.css_offline = mem_cgroup_css_offline,
 	.css_free = mem_cgroup_css_free,
 	.css_reset = mem_cgroup_css_reset,
+	.css_rstat_flush = mem_cgroup_css_rstat_flush,
 	.can_attach = mem_cgroup_can_attach,
 	.cancel_attach = mem_cgroup_cancel_attach,
 	.attach = mem_cgroup_move_task,
@@ -5401,7 +5620,10 @@ void mem_cgroup_events(struct mem_cgroup *memcg,
 		       enum mem_cgroup_events_index idx,
 		       unsigned int nr)
 {
+	preempt_disable();
 	this_cpu_add(memcg->stat->events[idx], nr);
+	memcg_rstat_updated(memcg);
+	preempt_enable();
 }
 
 /**
@@ -5596,24 +5818,18 @@ static void uncharge_batch(struct mem_cgroup *memcg, unsigned long pgpgout,
 	unsigned long nr_pages = nr_anon + nr_file;
 	unsigned long flags;
 
-	if (!mem_cgroup_is_root(memcg)) {
-		page_counter_uncharge(&memcg->memory, nr_pages);
-		if (do_swap_account)
-			page_counter_uncharge(&memcg->memsw, nr_pages);
-		memcg_oom_recover(memcg);
-	}
-
 	local_irq_save(flags);
 	__this_cpu_sub(memcg->stat->count[MEM_CGROUP_STAT_RSS], nr_anon);
 	__this_cpu_sub(memcg->stat->count[MEM_CGROUP_STAT_CACHE], nr_file);
 	__this_cpu_sub(memcg->stat->count[MEM_CGROUP_STAT_RSS_HUGE], nr_huge);
 	__this_cpu_add(memcg->stat->events[MEM_CGROUP_EVENTS_PGPGOUT], pgpgout);
 	__this_cpu_add(memcg->stat->nr_page_events, nr_pages);
+	memcg_rstat_updated(memcg);
 	memcg_check_events(memcg, dummy_page);
 	local_irq_restore(flags);
 
 	if (!mem_cgroup_is_root(memcg))
-		css_put_many(&memcg->css, nr_pages);
+		uncharge_to_stock(memcg, nr_pages, 0);
 }
 
 static void uncharge_list(struct list_head *page_list)
@@ -5798,6 +6014,10 @@ static int __init mem_cgroup_init(void)
 		soft_limit_tree.rb_tree_per_node[node] = rtpn;
 	}
 
+	if (!mem_cgroup_disabled())
+		queue_delayed_work(system_unbound_wq, &stats_flush_dwork,
+				   MEMCG_STATS_FLUSH_TIME);
+
 	return 0;
 }
 subsys_initcall(mem_cgroup_init);
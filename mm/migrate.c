@@ -499,6 +499,8 @@ void migrate_page_copy(struct page *newpage, struct page *page)
 		SetPageReferenced(newpage);
 	if (PageUptodate(page))
 		SetPageUptodate(newpage);
+	if (PageWorkingset(page))
+		SetPageWorkingset(newpage);
 	if (TestClearPageActive(page)) {
 		VM_BUG_ON_PAGE(PageUnevictable(page), page);
 		SetPageActive(newpage);
@@ -451,7 +451,7 @@ static void pagevec_move_tail_fn(struct page *page, struct lruvec *lruvec,
 
 	if (PageLRU(page) && !PageActive(page) && !PageUnevictable(page)) {
 		enum lru_list lru = page_lru_base_type(page);
-		list_move_tail(&page->lru, &lruvec->lists[lru]);
+		move_page_to_lru_tail(page, lruvec, lru);
 		(*pgmoved)++;
 	}
 }
@@ -788,7 +788,7 @@ static void lru_deactivate_file_fn(struct page *page, struct lruvec *lruvec,
 		 * The page's writeback ends up during pagevec
 		 * We moves tha page into tail of inactive.
 		 */
-		list_move_tail(&page->lru, &lruvec->lists[lru]);
+		move_page_to_lru_tail(page, lruvec, lru);
 		__count_vm_event(PGROTATED);
 	}
 
@@ -1003,9 +1003,11 @@ void lru_add_page_tail(struct page *page, struct page *page_tail,
 	if (!list)
 		SetPageLRU(page_tail);
 
-	if (likely(PageLRU(page)))
+	if (likely(PageLRU(page))) {
+		/* the tail shares the head's generation and its accounting */
+		page_tail->flags |= page->flags & LRU_GEN_MASK;
 		list_add_tail(&page_tail->lru, &page->lru);
-	else if (list) {
+	} else if (list) {
 		/* page reclaim is reclaiming a huge page */
 		get_page(page_tail);
 		list_add_tail(&page_tail->lru, list);
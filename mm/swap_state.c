@@ -20,6 +20,8 @@
 
 #include <asm/pgtable.h>
 
+#include "internal.h"
+
 /*
  * swapper_space is a fiction, retained to simplify the path through
  * vmscan's shrink_page_list.
@@ -75,8 +77,10 @@ void show_swap_cache_info(void)
 /*
  * __add_to_swap_cache resembles add_to_page_cache_locked on swapper_space,
  * but sets SwapCache flag and private instead of mapping and index.
+ * A shadow entry left behind by the eviction of the page previously in
+ * this swap slot is returned in @shadowp, if non-NULL.
  */
-int __add_to_swap_cache(struct page *page, swp_entry_t entry)
+int __add_to_swap_cache(struct page *page, swp_entry_t entry, void **shadowp)
 {
 	int error;
 	struct address_space *address_space;
@@ -91,10 +95,8 @@ int __add_to_swap_cache(struct page *page, swp_entry_t entry)
 
 	address_space = swap_address_space(entry);
 	spin_lock_irq(&address_space->tree_lock);
-	error = radix_tree_insert(&address_space->page_tree,
-					entry.val, page);
+	error = page_cache_tree_insert(address_space, page, entry.val, shadowp);
 	if (likely(!error)) {
-		address_space->nrpages++;
 		__inc_zone_page_state(page, NR_FILE_PAGES);
 		INC_CACHE_INFO(add_total);
 	}
@@ -122,7 +124,7 @@ int add_to_swap_cache(struct page *page, swp_entry_t entry, gfp_t gfp_mask)
 
 	error = radix_tree_maybe_preload(gfp_mask);
 	if (!error) {
-		error = __add_to_swap_cache(page, entry);
+		error = __add_to_swap_cache(page, entry, NULL);
 		radix_tree_preload_end();
 	}
 	return error;
@@ -130,9 +132,10 @@ int add_to_swap_cache(struct page *page, swp_entry_t entry, gfp_t gfp_mask)
 
 /*
  * This must be called only on pages that have
- * been verified to be in the swap cache.
+ * been verified to be in the swap cache.  A non-NULL
+ * @shadow is left in the page's slot for refault detection.
  */
-void __delete_from_swap_cache(struct page *page)
+void __delete_from_swap_cache(struct page *page, void *shadow)
 {
 	swp_entry_t entry;
 	struct address_space *address_space;
@@ -143,10 +146,9 @@ void __delete_from_swap_cache(struct page *page)
 
 	entry.val = page_private(page);
 	address_space = swap_address_space(entry);
-	radix_tree_delete(&address_space->page_tree, page_private(page));
+	page_cache_tree_delete(address_space, page, entry.val, shadow);
 	set_page_private(page, 0);
 	ClearPageSwapCache(page);
-	address_space->nrpages--;
 	__dec_zone_page_state(page, NR_FILE_PAGES);
 	INC_CACHE_INFO(del_total);
 }
@@ -218,13 +220,34 @@ void delete_from_swap_cache(struct page *page)
 
 	address_space = swap_address_space(entry);
 	spin_lock_irq(&address_space->tree_lock);
-	__delete_from_swap_cache(page);
+	__delete_from_swap_cache(page, NULL);
 	spin_unlock_irq(&address_space->tree_lock);
 
 	swapcache_free(entry);
 	page_cache_release(page);
 }
 
+/*
+ * Drop the shadow entry of a swap slot that is being freed, so that
+ * it does not outlive the slot and get mistaken for the eviction of
+ * an unrelated page that reuses it.
+ */
+void clear_shadow_from_swap_cache(swp_entry_t entry)
+{
+	struct address_space *address_space = swap_address_space(entry);
+	unsigned long flags;
+	void *shadow;
+
+	if (!address_space->nrshadows)
+		return;
+
+	spin_lock_irqsave(&address_space->tree_lock, flags);
+	shadow = radix_tree_lookup(&address_space->page_tree, entry.val);
+	if (radix_tree_exceptional_entry(shadow))
+		__clear_shadow_entry(address_space, entry.val, shadow);
+	spin_unlock_irqrestore(&address_space->tree_lock, flags);
+}
+
 /* 
  * If we are the only user, then try to free up the swap cache. 
  * 
@@ -298,6 +321,7 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 			struct vm_area_struct *vma, unsigned long addr)
 {
 	struct page *found_page, *new_page = NULL;
+	void *shadow = NULL;
 	int err;
 
 	do {
@@ -359,9 +383,13 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 		/* May fail (-ENOMEM) if radix-tree node allocation failed. */
 		__set_page_locked(new_page);
 		SetPageSwapBacked(new_page);
-		err = __add_to_swap_cache(new_page, entry);
+		err = __add_to_swap_cache(new_page, entry, &shadow);
 		if (likely(!err)) {
 			radix_tree_preload_end();
+			if (shadow && workingset_refault(new_page, shadow)) {
+				SetPageActive(new_page);
+				SetPageWorkingset(new_page);
+			}
 			/*
 			 * Initiate read into locked page and return.
 			 */
@@ -23,30 +23,29 @@
 #include <linux/rmap.h>
 #include "internal.h"
 
-static void clear_exceptional_entry(struct address_space *mapping,
-				    pgoff_t index, void *entry)
+/*
+ * Remove the shadow entry @entry at @index, unless it has been replaced
+ * in the meantime.  The caller holds the mapping's tree_lock.
+ */
+void __clear_shadow_entry(struct address_space *mapping, pgoff_t index,
+			  void *entry)
 {
 	struct radix_tree_node *node;
 	void **slot;
 
-	/* Handled by shmem itself */
-	if (shmem_mapping(mapping))
-		return;
-
-	spin_lock_irq(&mapping->tree_lock);
 	/*
 	 * Regular page slots are stabilized by the page lock even
 	 * without the tree itself locked.  These unlocked entries
 	 * need verification under the tree lock.
 	 */
 	if (!__radix_tree_lookup(&mapping->page_tree, index, &node, &slot))
-		goto unlock;
+		return;
 	if (*slot != entry)
-		goto unlock;
+		return;
 	radix_tree_replace_slot(slot, NULL);
 	mapping->nrshadows--;
 	if (!node)
-		goto unlock;
+		return;
 	workingset_node_shadows_dec(node);
 	/*
 	 * Don't track node without shadow entries.
@@ -59,7 +58,17 @@ static void clear_exceptional_entry(struct address_space *mapping,
 	    !list_empty(&node->private_list))
 		list_lru_del(&workingset_shadow_nodes, &node->private_list);
 	__radix_tree_delete_node(&mapping->page_tree, node);
-unlock:
+}
+
+static void clear_exceptional_entry(struct address_space *mapping,
+				    pgoff_t index, void *entry)
+{
+	/* Handled by shmem itself */
+	if (shmem_mapping(mapping))
+		return;
+
+	spin_lock_irq(&mapping->tree_lock);
+	__clear_shadow_entry(mapping, index, entry);
 	spin_unlock_irq(&mapping->tree_lock);
 }
 
@@ -52,6 +52,7 @@
 
 #include <linux/swapops.h>
 #include <linux/balloon_compaction.h>
+#include <linux/psi.h>
 
 #include "internal.h"
 
@@ -181,7 +182,7 @@ bool zone_reclaimable(struct zone *zone)
 		zone_reclaimable_pages(zone) * 6;
 }
 
-static unsigned long get_lru_size(struct lruvec *lruvec, enum lru_list lru)
+unsigned long lruvec_lru_size(struct lruvec *lruvec, enum lru_list lru)
 {
 	if (!mem_cgroup_disabled())
 		return mem_cgroup_get_lru_size(lruvec, lru);
@@ -618,8 +619,13 @@ static int __remove_mapping(struct address_space *mapping, struct page *page,
 
 	if (PageSwapCache(page)) {
 		swp_entry_t swap = { .val = page_private(page) };
+		void *shadow = NULL;
+
+		/* the shadow needs the memcg, get it before the swapout */
+		if (reclaimed && !mapping_exiting(mapping))
+			shadow = workingset_eviction(mapping, page);
 		mem_cgroup_swapout(page, swap);
-		__delete_from_swap_cache(page);
+		__delete_from_swap_cache(page, shadow);
 		spin_unlock_irq(&mapping->tree_lock);
 		swapcache_free(swap);
 	} else {
@@ -1686,9 +1692,14 @@ static void move_active_pages_to_lru(struct lruvec *lruvec,
 		VM_BUG_ON_PAGE(PageLRU(page), page);
 		SetPageLRU(page);
 
+		/*
+		 * The generations may have been switched on or off while the
+		 * page was isolated, lru_gen_change_state() only drains the
+		 * lists it finds.  Let add_page_to_lru_list() pick the list.
+		 */
 		nr_pages = hpage_nr_pages(page);
-		mem_cgroup_update_lru_size(lruvec, lru, nr_pages);
-		list_move(&page->lru, &lruvec->lists[lru]);
+		list_del(&page->lru);
+		add_page_to_lru_list(page, lruvec, lru);
 		pgmoved += nr_pages;
 
 		if (put_page_testzero(page)) {
@@ -1705,7 +1716,6 @@ static void move_active_pages_to_lru(struct lruvec *lruvec,
 				list_add(&page->lru, pages_to_free);
 		}
 	}
-	__mod_zone_page_state(zone, NR_LRU_BASE + lru, pgmoved);
 	if (!is_active_lru(lru))
 		__count_vm_events(PGDEACTIVATE, pgmoved);
 }
@@ -1871,8 +1881,8 @@ static int inactive_file_is_low(struct lruvec *lruvec)
 	unsigned long inactive;
 	unsigned long active;
 
-	inactive = get_lru_size(lruvec, LRU_INACTIVE_FILE);
-	active = get_lru_size(lruvec, LRU_ACTIVE_FILE);
+	inactive = lruvec_lru_size(lruvec, LRU_INACTIVE_FILE);
+	active = lruvec_lru_size(lruvec, LRU_ACTIVE_FILE);
 
 	return active > inactive;
 }
@@ -2030,10 +2040,10 @@ static void get_scan_count(struct lruvec *lruvec, int swappiness,
 	 * anon in [0], file in [1]
 	 */
 
-	anon  = get_lru_size(lruvec, LRU_ACTIVE_ANON) +
-		get_lru_size(lruvec, LRU_INACTIVE_ANON);
-	file  = get_lru_size(lruvec, LRU_ACTIVE_FILE) +
-		get_lru_size(lruvec, LRU_INACTIVE_FILE);
+	anon  = lruvec_lru_size(lruvec, LRU_ACTIVE_ANON) +
+		lruvec_lru_size(lruvec, LRU_INACTIVE_ANON);
+	file  = lruvec_lru_size(lruvec, LRU_ACTIVE_FILE) +
+		lruvec_lru_size(lruvec, LRU_INACTIVE_FILE);
 
 	spin_lock_irq(&zone->lru_lock);
 	if (unlikely(reclaim_stat->recent_scanned[0] > anon / 4)) {
@@ -2071,7 +2081,7 @@ out:
 			unsigned long size;
 			unsigned long scan;
 
-			size = get_lru_size(lruvec, lru);
+			size = lruvec_lru_size(lruvec, lru);
 			scan = size >> sc->priority;
 
 			if (!scan && pass && force_scan)
@@ -2114,6 +2124,604 @@ out:
 	}
 }
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * Multi-gen LRU
+ *
+ * Instead of rotating pages between the active and the inactive list,
+ * which takes an rmap walk for every candidate page, the multi-gen LRU
+ * sorts the pages of a lruvec into generations (see lru_gen_struct).
+ * Aging collects the accessed bits of the mapped pages in bulk, by
+ * walking the page tables of the processes using the lruvec, and moves
+ * the pages found accessed to the youngest generation before starting
+ * a new one.  Eviction takes from the oldest generation of anon or file
+ * pages, whichever refaults less, and only checks the references of the
+ * pages it actually tries to reclaim.
+ */
+
+struct static_key lru_gen_key = STATIC_KEY_INIT_FALSE;
+static bool lru_gen_boot_enabled = IS_ENABLED(CONFIG_LRU_GEN_ENABLED);
+static DEFINE_MUTEX(lru_gen_state_mutex);
+
+/* All user mms, for aging to walk */
+static LIST_HEAD(lru_gen_mm_list);
+static DEFINE_SPINLOCK(lru_gen_mm_lock);
+
+void lru_gen_add_mm(struct mm_struct *mm)
+{
+	spin_lock(&lru_gen_mm_lock);
+	list_add_tail(&mm->lru_gen_list, &lru_gen_mm_list);
+	spin_unlock(&lru_gen_mm_lock);
+}
+
+void lru_gen_del_mm(struct mm_struct *mm)
+{
+	spin_lock(&lru_gen_mm_lock);
+	list_del(&mm->lru_gen_list);
+	spin_unlock(&lru_gen_mm_lock);
+}
+
+/*
+ * Returns a reference to the mm following @prev on the list, and drops
+ * the one on @prev.  The reference keeps an mm on the list.  The final
+ * put is left to a worker, reclaim may be holding locks exit_mmap()
+ * needs.
+ */
+static struct mm_struct *lru_gen_next_mm(struct mm_struct *prev)
+{
+	struct list_head *pos = prev ? &prev->lru_gen_list : &lru_gen_mm_list;
+	struct mm_struct *mm = NULL;
+
+	spin_lock(&lru_gen_mm_lock);
+	for (pos = pos->next; pos != &lru_gen_mm_list; pos = pos->next) {
+		mm = list_entry(pos, struct mm_struct, lru_gen_list);
+		if (atomic_inc_not_zero(&mm->mm_users))
+			break;
+		mm = NULL;
+	}
+	spin_unlock(&lru_gen_mm_lock);
+
+	if (prev)
+		mmput_async(prev);
+	return mm;
+}
+
+/* Account @delta pages of @type as inactive instead of active */
+static void lru_gen_deactivate_size(struct lruvec *lruvec, int type,
+				    long delta)
+{
+	struct zone *zone = lruvec_zone(lruvec);
+	enum lru_list lru = type * LRU_FILE;
+
+	mem_cgroup_update_lru_size(lruvec, lru + LRU_ACTIVE, -delta);
+	mem_cgroup_update_lru_size(lruvec, lru, delta);
+	__mod_zone_page_state(zone, NR_LRU_BASE + lru + LRU_ACTIVE, -delta);
+	__mod_zone_page_state(zone, NR_LRU_BASE + lru, delta);
+}
+
+/* Drop the empty oldest generations, keeping at least MIN_NR_GENS */
+static void lru_gen_inc_min_seq(struct lruvec *lruvec, int type)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+
+	while (lrugen->min_seq[type] + MIN_NR_GENS <= lrugen->max_seq) {
+		int gen = lru_gen_from_seq(lrugen->min_seq[type]);
+
+		if (!list_empty(&lrugen->lists[gen][type]))
+			break;
+		WARN_ON_ONCE(lrugen->nr_pages[gen][type]);
+		lrugen->min_seq[type]++;
+	}
+}
+
+static void lru_gen_inc_max_seq(struct lruvec *lruvec)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int prev = lru_gen_from_seq(lrugen->max_seq - 1);
+	int next = lru_gen_from_seq(lrugen->max_seq + 1);
+	int type;
+
+	for (type = 0; type < 2; type++) {
+		long evicted = atomic_long_read(&lrugen->evicted[type]);
+		long refaulted = atomic_long_read(&lrugen->refaulted[type]);
+
+		/*
+		 * A type that can't be evicted, e.g. anon without swap, may
+		 * use up all generations.  Its oldest pages then wrap around
+		 * into the new youngest generation.
+		 */
+		if (lrugen->max_seq - lrugen->min_seq[type] + 1 >= MAX_NR_GENS)
+			lrugen->min_seq[type]++;
+
+		/*
+		 * The second youngest generation becomes inactive, whatever
+		 * wrapped around becomes active.
+		 */
+		lru_gen_deactivate_size(lruvec, type,
+					lrugen->nr_pages[prev][type] -
+					lrugen->nr_pages[next][type]);
+
+		/* Decay the feedback so that it follows the workload */
+		atomic_long_set(&lrugen->evicted[type], evicted / 2);
+		atomic_long_set(&lrugen->refaulted[type], refaulted / 2);
+	}
+
+	WRITE_ONCE(lrugen->max_seq, lrugen->max_seq + 1);
+}
+
+static void lru_gen_promote(struct lruvec *lruvec, struct page *page, int gen)
+{
+	int old_gen = page_lru_gen(page);
+	int type = page_is_file_cache(page);
+	int nr_pages = hpage_nr_pages(page);
+
+	if (old_gen == gen)
+		return;
+
+	lru_gen_update_size(lruvec, type, old_gen, -nr_pages);
+	lru_gen_set_gen(page, gen);
+	lru_gen_update_size(lruvec, type, gen, nr_pages);
+	list_move(&page->lru, &lruvec->lrugen.lists[gen][type]);
+}
+
+struct lru_gen_walk {
+	struct lruvec *lruvec;
+	/* Generation to promote the accessed pages to */
+	int gen;
+};
+
+static int lru_gen_walk_test(unsigned long addr, unsigned long next,
+			     struct mm_walk *walk)
+{
+	/* Nothing on the evictable lists in these */
+	if (walk->vma->vm_flags & (VM_LOCKED | VM_HUGETLB | VM_SPECIAL))
+		return 1;
+	return 0;
+}
+
+static int lru_gen_walk_pmd(pmd_t *pmd, unsigned long addr,
+			    unsigned long end, struct mm_walk *walk)
+{
+	struct lru_gen_walk *args = walk->private;
+	struct lruvec *lruvec = args->lruvec;
+	struct zone *zone = lruvec_zone(lruvec);
+	struct vm_area_struct *vma = walk->vma;
+	pte_t *orig_pte, *pte;
+	bool locked = false;
+	spinlock_t *ptl;
+
+	/* Huge pages are left to the reference check at eviction */
+	if (pmd_trans_unstable(pmd))
+		return 0;
+
+	orig_pte = pte = pte_offset_map_lock(walk->mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		struct page *page;
+
+		if (!pte_present(*pte) || !pte_young(*pte))
+			continue;
+
+		page = vm_normal_page(vma, addr, *pte);
+		if (!page || page_zone(page) != zone)
+			continue;
+
+		/* The lru_lock nests inside the page table lock */
+		if (!locked) {
+			spin_lock_irq(&zone->lru_lock);
+			locked = true;
+		}
+
+		/*
+		 * Leave the accessed bit alone on pages of other lruvecs,
+		 * their own aging needs it.
+		 */
+		if (!PageLRU(page) || page_lru_gen(page) < 0 ||
+		    mem_cgroup_page_lruvec(page, zone) != lruvec)
+			continue;
+
+		if (ptep_test_and_clear_young(vma, addr, pte))
+			lru_gen_promote(lruvec, page, args->gen);
+	}
+	if (locked)
+		spin_unlock_irq(&zone->lru_lock);
+	pte_unmap_unlock(orig_pte, ptl);
+
+	cond_resched();
+	return 0;
+}
+
+/*
+ * Start a new generation, after promoting the pages accessed through
+ * the page tables of the lruvec's processes to the current youngest.
+ */
+static void lru_gen_age(struct lruvec *lruvec)
+{
+	struct mem_cgroup *memcg = mem_cgroup_lruvec_memcg(lruvec);
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	struct zone *zone = lruvec_zone(lruvec);
+	struct lru_gen_walk args = {
+		.lruvec = lruvec,
+	};
+	struct mm_walk walk = {
+		.pmd_entry = lru_gen_walk_pmd,
+		.test_walk = lru_gen_walk_test,
+		.private = &args,
+	};
+	struct mm_struct *mm = NULL;
+	unsigned long max_seq;
+
+	max_seq = READ_ONCE(lrugen->max_seq);
+	args.gen = lru_gen_from_seq(max_seq);
+
+	while ((mm = lru_gen_next_mm(mm))) {
+		if (memcg && !mm_match_cgroup(mm, memcg))
+			continue;
+		/* Don't wait behind page faults and mmap() */
+		if (!down_read_trylock(&mm->mmap_sem))
+			continue;
+		walk.mm = mm;
+		walk_page_range(FIRST_USER_ADDRESS, mm->highest_vm_end, &walk);
+		up_read(&mm->mmap_sem);
+	}
+
+	spin_lock_irq(&zone->lru_lock);
+	/* Someone else may have aged the lruvec in the meantime */
+	if (max_seq == lrugen->max_seq)
+		lru_gen_inc_max_seq(lruvec);
+	spin_unlock_irq(&zone->lru_lock);
+}
+
+/*
+ * Returns the type, anon (0) or file (1), to evict from next, or -1
+ * when neither has a generation old enough and the lruvec needs aging.
+ */
+static int lru_gen_type_to_scan(struct lruvec *lruvec, int swappiness,
+				bool can_swap)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	bool evictable[2];
+	u64 anon_cost, file_cost;
+	int type;
+
+	for (type = 0; type < 2; type++) {
+		lru_gen_inc_min_seq(lruvec, type);
+		evictable[type] = lrugen->min_seq[type] + MIN_NR_GENS <=
+				  lrugen->max_seq;
+	}
+
+	/* Like get_scan_count(), swappiness 0 leaves anon as a last resort */
+	if (!can_swap || (!swappiness && evictable[1]))
+		evictable[0] = false;
+
+	if (!evictable[0] || !evictable[1]) {
+		if (evictable[1])
+			return 1;
+		return evictable[0] ? 0 : -1;
+	}
+
+	/*
+	 * The feedback loop: evict the type whose evictions turn out to
+	 * be mistakes less often, as measured by the refaults, weighted
+	 * by the priorities swappiness assigns to anon and file.
+	 */
+	anon_cost = (u64)(atomic_long_read(&lrugen->refaulted[0]) + 1) *
+		    (atomic_long_read(&lrugen->evicted[1]) + SWAP_CLUSTER_MAX) *
+		    (200 - swappiness);
+	file_cost = (u64)(atomic_long_read(&lrugen->refaulted[1]) + 1) *
+		    (atomic_long_read(&lrugen->evicted[0]) + SWAP_CLUSTER_MAX) *
+		    swappiness;
+
+	return anon_cost <= file_cost ? 0 : 1;
+}
+
+/*
+ * Isolates a batch of pages from the oldest generation of one type and
+ * tries to reclaim them.  Ages the lruvec first if necessary.
+ */
+static unsigned long lru_gen_evict(struct lruvec *lruvec,
+				   struct scan_control *sc, int swappiness,
+				   bool can_swap, unsigned long *nr_scanned)
+{
+	struct zone_reclaim_stat *reclaim_stat = &lruvec->reclaim_stat;
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	struct zone *zone = lruvec_zone(lruvec);
+	isolate_mode_t isolate_mode = 0;
+	unsigned long nr_reclaimed;
+	unsigned long nr_taken = 0;
+	unsigned long nr_dirty = 0;
+	unsigned long nr_congested = 0;
+	unsigned long nr_unqueued_dirty = 0;
+	unsigned long nr_writeback = 0;
+	unsigned long nr_immediate = 0;
+	unsigned long scanned = 0;
+	struct list_head *list;
+	LIST_HEAD(page_list);
+	int type;
+
+	*nr_scanned = 0;
+
+	while (unlikely(too_many_isolated(zone, 0, sc) ||
+			too_many_isolated(zone, 1, sc))) {
+		congestion_wait(BLK_RW_ASYNC, HZ/10);
+
+		/* We are about to die and free our memory. Return now. */
+		if (fatal_signal_pending(current))
+			return SWAP_CLUSTER_MAX;
+	}
+
+	if (!sc->may_unmap)
+		isolate_mode |= ISOLATE_UNMAPPED;
+	if (!sc->may_writepage)
+		isolate_mode |= ISOLATE_CLEAN;
+
+	spin_lock_irq(&zone->lru_lock);
+	type = lru_gen_type_to_scan(lruvec, swappiness, can_swap);
+	if (type < 0) {
+		spin_unlock_irq(&zone->lru_lock);
+		lru_gen_age(lruvec);
+		spin_lock_irq(&zone->lru_lock);
+		type = lru_gen_type_to_scan(lruvec, swappiness, can_swap);
+	}
+	if (type < 0) {
+		spin_unlock_irq(&zone->lru_lock);
+		return 0;
+	}
+
+	list = &lrugen->lists[lru_gen_from_seq(lrugen->min_seq[type])][type];
+	while (scanned < SWAP_CLUSTER_MAX && !list_empty(list)) {
+		struct page *page = lru_to_page(list);
+		int nr_pages = hpage_nr_pages(page);
+
+		scanned += nr_pages;
+		if (__isolate_lru_page(page, isolate_mode)) {
+			/* Busy, or not for this reclaim mode */
+			list_move(&page->lru, list);
+			continue;
+		}
+		lru_gen_del_page(lruvec, page, true);
+		list_add(&page->lru, &page_list);
+		nr_taken += nr_pages;
+	}
+
+	__mod_zone_page_state(zone, NR_ISOLATED_ANON + type, nr_taken);
+
+	if (global_reclaim(sc)) {
+		__mod_zone_page_state(zone, NR_PAGES_SCANNED, scanned);
+		if (current_is_kswapd())
+			__count_zone_vm_events(PGSCAN_KSWAPD, zone, scanned);
+		else
+			__count_zone_vm_events(PGSCAN_DIRECT, zone, scanned);
+	}
+	spin_unlock_irq(&zone->lru_lock);
+
+	*nr_scanned = scanned;
+	if (nr_taken == 0)
+		return 0;
+
+	nr_reclaimed = shrink_page_list(&page_list, zone, sc, TTU_UNMAP,
+				&nr_dirty, &nr_unqueued_dirty, &nr_congested,
+				&nr_writeback, &nr_immediate,
+				false);
+
+	spin_lock_irq(&zone->lru_lock);
+
+	reclaim_stat->recent_scanned[type] += nr_taken;
+
+	if (global_reclaim(sc)) {
+		if (current_is_kswapd())
+			__count_zone_vm_events(PGSTEAL_KSWAPD, zone,
+					       nr_reclaimed);
+		else
+			__count_zone_vm_events(PGSTEAL_DIRECT, zone,
+					       nr_reclaimed);
+	}
+
+	putback_inactive_pages(lruvec, &page_list);
+
+	__mod_zone_page_state(zone, NR_ISOLATED_ANON + type, -nr_taken);
+
+	spin_unlock_irq(&zone->lru_lock);
+
+	mem_cgroup_uncharge_list(&page_list);
+	free_hot_cold_page_list(&page_list, true);
+
+	return nr_reclaimed;
+}
+
+static void lru_gen_shrink_lruvec(struct lruvec *lruvec, int swappiness,
+				  struct scan_control *sc,
+				  unsigned long *lru_pages)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	struct zone *zone = lruvec_zone(lruvec);
+	unsigned long nr_reclaimed = 0;
+	unsigned long nr_to_scan;
+	struct blk_plug plug;
+	bool scan_adjusted;
+	bool can_swap;
+	long size = 0;
+	int gen, type;
+
+	can_swap = sc->may_swap && get_nr_swap_pages() > 0 &&
+		   (global_reclaim(sc) || swappiness);
+
+	for (gen = 0; gen < MAX_NR_GENS; gen++)
+		for (type = 0; type < 2; type++)
+			size += READ_ONCE(lrugen->nr_pages[gen][type]);
+	*lru_pages = max(size, 0L);
+
+	nr_to_scan = *lru_pages >> sc->priority;
+	if (!global_reclaim(sc) ||
+	    (current_is_kswapd() && !zone_reclaimable(zone)))
+		nr_to_scan = max(nr_to_scan, SWAP_CLUSTER_MAX);
+
+	/* See shrink_lruvec() */
+	scan_adjusted = (global_reclaim(sc) && !current_is_kswapd() &&
+			 sc->priority == DEF_PRIORITY);
+
+	lru_add_drain();
+
+	blk_start_plug(&plug);
+	while (nr_to_scan) {
+		unsigned long scanned;
+
+		nr_reclaimed += lru_gen_evict(lruvec, sc, swappiness, can_swap,
+					      &scanned);
+		if (!scanned)
+			break;
+		nr_to_scan -= min(nr_to_scan, scanned);
+
+		if (nr_reclaimed >= sc->nr_to_reclaim && !scan_adjusted)
+			break;
+	}
+	blk_finish_plug(&plug);
+	sc->nr_reclaimed += nr_reclaimed;
+
+	throttle_vm_writeout(sc->gfp_mask);
+}
+
+static void lru_gen_resched(struct zone *zone)
+{
+	if (need_resched() || spin_needbreak(&zone->lru_lock)) {
+		spin_unlock_irq(&zone->lru_lock);
+		cond_resched();
+		spin_lock_irq(&zone->lru_lock);
+	}
+}
+
+/*
+ * Moves the evictable pages of @lruvec between the active/inactive
+ * lists and the generations.  The state of lru_gen_key decides where
+ * add_page_to_lru_list() puts them, the page flags where they are.
+ */
+static void lru_gen_change_lruvec(struct lruvec *lruvec, bool enable)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	struct zone *zone = lruvec_zone(lruvec);
+	struct list_head *list;
+	struct page *page;
+	enum lru_list lru;
+	unsigned long seq;
+	int type;
+
+	spin_lock_irq(&zone->lru_lock);
+	if (enable) {
+		for_each_evictable_lru(lru) {
+			list = &lruvec->lists[lru];
+			while (!list_empty(list)) {
+				page = lru_to_page(list);
+				del_page_from_lru_list(page, lruvec, lru);
+				add_page_to_lru_list(page, lruvec, lru);
+				lru_gen_resched(zone);
+			}
+		}
+	} else {
+		for (type = 0; type < 2; type++) {
+			for (seq = lrugen->min_seq[type];
+			     seq <= lrugen->max_seq; seq++) {
+				list = &lrugen->lists[lru_gen_from_seq(seq)][type];
+				while (!list_empty(list)) {
+					page = lru_to_page(list);
+					del_page_from_lru_list(page, lruvec,
+							       page_lru(page));
+					add_page_to_lru_list(page, lruvec,
+							     page_lru(page));
+					lru_gen_resched(zone);
+				}
+			}
+		}
+	}
+	spin_unlock_irq(&zone->lru_lock);
+}
+
+static void lru_gen_change_state(bool enable)
+{
+	struct mem_cgroup *memcg;
+	struct zone *zone;
+
+	mutex_lock(&lru_gen_state_mutex);
+	get_online_mems();
+
+	if (enable == lru_gen_enabled())
+		goto unlock;
+
+	if (enable)
+		static_key_slow_inc(&lru_gen_key);
+	else
+		static_key_slow_dec(&lru_gen_key);
+
+	memcg = mem_cgroup_iter(NULL, NULL, NULL);
+	do {
+		for_each_populated_zone(zone)
+			lru_gen_change_lruvec(mem_cgroup_zone_lruvec(zone, memcg),
+					      enable);
+		memcg = mem_cgroup_iter(NULL, memcg, NULL);
+	} while (memcg);
+unlock:
+	put_online_mems();
+	mutex_unlock(&lru_gen_state_mutex);
+}
+
+static ssize_t lru_gen_enabled_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", lru_gen_enabled());
+}
+
+static ssize_t lru_gen_enabled_store(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     const char *buf, size_t count)
+{
+	bool enable;
+
+	if (strtobool(buf, &enable))
+		return -EINVAL;
+
+	lru_gen_change_state(enable);
+	return count;
+}
+
+static struct kobj_attribute lru_gen_enabled_attr =
+	__ATTR(enabled, 0644, lru_gen_enabled_show, lru_gen_enabled_store);
+
+static struct attribute *lru_gen_attrs[] = {
+	&lru_gen_enabled_attr.attr,
+	NULL,
+};
+
+static struct attribute_group lru_gen_attr_group = {
+	.name = "lru_gen",
+	.attrs = lru_gen_attrs,
+};
+
+static int __init setup_lru_gen(char *str)
+{
+	if (strtobool(str, &lru_gen_boot_enabled))
+		pr_warn("lru_gen: unable to parse '%s'\n", str);
+	return 1;
+}
+__setup("lru_gen=", setup_lru_gen);
+
+static int __init lru_gen_init(void)
+{
+	BUILD_BUG_ON(MAX_NR_GENS + 1 > 1U << LRU_GEN_WIDTH);
+
+	if (sysfs_create_group(mm_kobj, &lru_gen_attr_group))
+		pr_err("lru_gen: failed to create sysfs group\n");
+
+	if (lru_gen_boot_enabled)
+		lru_gen_change_state(true);
+	return 0;
+}
+module_init(lru_gen_init);
+#else
+static void lru_gen_shrink_lruvec(struct lruvec *lruvec, int swappiness,
+				  struct scan_control *sc,
+				  unsigned long *lru_pages)
+{
+}
+#endif /* CONFIG_LRU_GEN */
+
 /*
  * This is a basic per-zone page freer.  Used by both kswapd and direct reclaim.
  */
@@ -2129,6 +2737,11 @@ static void shrink_lruvec(struct lruvec *lruvec, int swappiness,
 	struct blk_plug plug;
 	bool scan_adjusted;
 
+	if (lru_gen_enabled()) {
+		lru_gen_shrink_lruvec(lruvec, swappiness, sc, lru_pages);
+		return;
+	}
+
 	get_scan_count(lruvec, swappiness, sc, nr, lru_pages);
 
 	/* Record the original scan target for proportional adjustments later */
@@ -2839,6 +3452,7 @@ unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
 {
 	struct zonelist *zonelist;
 	unsigned long nr_reclaimed;
+	unsigned long pflags;
 	int nid;
 	struct scan_control sc = {
 		.nr_to_reclaim = max(nr_pages, SWAP_CLUSTER_MAX),
@@ -2864,7 +3478,9 @@ unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
 					    sc.may_writepage,
 					    sc.gfp_mask);
 
+	psi_memstall_enter(&pflags);
 	nr_reclaimed = do_try_to_free_pages(zonelist, &sc);
+	psi_memstall_leave(&pflags);
 
 	trace_mm_vmscan_memcg_reclaim_end(nr_reclaimed);
 
@@ -2876,7 +3492,8 @@ static void age_active_anon(struct zone *zone, struct scan_control *sc)
 {
 	struct mem_cgroup *memcg;
 
-	if (!total_swap_pages)
+	/* The multi-gen LRU has no active list to balance */
+	if (!total_swap_pages || lru_gen_enabled())
 		return;
 
 	memcg = mem_cgroup_iter(NULL, NULL, NULL);
@@ -3352,6 +3969,7 @@ static int kswapd(void *p)
 	int balanced_classzone_idx;
 	pg_data_t *pgdat = (pg_data_t*)p;
 	struct task_struct *tsk = current;
+	unsigned long pflags;
 
 	struct reclaim_state reclaim_state = {
 		.reclaimed_slab = 0,
@@ -3428,8 +4046,10 @@ static int kswapd(void *p)
 		if (!ret) {
 			trace_mm_vmscan_kswapd_wake(pgdat->node_id, order);
 			balanced_classzone_idx = classzone_idx;
+			psi_memstall_enter(&pflags);
 			balanced_order = balance_pgdat(pgdat, order,
 						&balanced_classzone_idx);
+			psi_memstall_leave(&pflags);
 		}
 	}
 
@@ -81,6 +81,7 @@
 #include <linux/hash.h>
 #include <linux/slab.h>
 #include <linux/sched.h>
+#include <linux/kthread.h>
 #include <linux/mutex.h>
 #include <linux/string.h>
 #include <linux/mm.h>
@@ -3050,6 +3051,20 @@ int weight_p __read_mostly = 64;            /* old backlog weight */
 static inline void ____napi_schedule(struct softnet_data *sd,
 				     struct napi_struct *napi)
 {
+	struct task_struct *thread;
+
+	if (test_bit(NAPI_STATE_THREADED, &napi->state)) {
+		/* Paired with smp_mb__before_atomic() in napi_set_threaded():
+		 * a napi marked threaded always has its kthread set up.
+		 */
+		thread = READ_ONCE(napi->thread);
+		if (thread) {
+			set_bit(NAPI_STATE_SCHED_THREADED, &napi->state);
+			wake_up_process(thread);
+			return;
+		}
+	}
+
 	list_add_tail(&napi->poll_list, &sd->poll_list);
 	__raise_softirq_irqoff(NET_RX_SOFTIRQ);
 }
@@ -4459,6 +4474,7 @@ void __napi_complete(struct napi_struct *n)
 
 	list_del_init(&n->poll_list);
 	smp_mb__before_atomic();
+	clear_bit(NAPI_STATE_SCHED_THREADED, &n->state);
 	clear_bit(NAPI_STATE_SCHED, &n->state);
 }
 EXPORT_SYMBOL(__napi_complete);
@@ -4487,6 +4503,7 @@ void napi_complete_done(struct napi_struct *n, int work_done)
 			napi_gro_flush(n, false);
 	}
 	if (likely(list_empty(&n->poll_list))) {
+		clear_bit(NAPI_STATE_SCHED_THREADED, &n->state);
 		WARN_ON_ONCE(!test_and_clear_bit(NAPI_STATE_SCHED, &n->state));
 	} else {
 		/* If n->poll_list is not empty, we need to mask irqs */
@@ -4560,6 +4577,86 @@ static enum hrtimer_restart napi_watchdog(struct hrtimer *timer)
 	return HRTIMER_NORESTART;
 }
 
+static int napi_threaded_poll(void *data);
+
+static int napi_kthread_create(struct napi_struct *n)
+{
+	struct napi_struct *pos = n;
+	int idx = 0;
+
+	/* napis are added at the head of dev->napi_list, so the entries
+	 * behind this one give its position in the driver's add order.
+	 */
+	list_for_each_entry_continue(pos, &n->dev->napi_list, dev_list)
+		idx++;
+
+	n->thread = kthread_run(napi_threaded_poll, n, "napi/%s-%d",
+				n->dev->name, idx);
+	if (IS_ERR(n->thread)) {
+		int err = PTR_ERR(n->thread);
+
+		pr_err("%s: napi kthread creation failed: %d\n",
+		       n->dev->name, err);
+		n->thread = NULL;
+		return err;
+	}
+	return 0;
+}
+
+static void napi_set_threaded(struct net_device *dev, bool threaded)
+{
+	struct napi_struct *napi;
+
+	dev->threaded = threaded;
+
+	/* Make sure the kthreads are visible before the THREADED bit */
+	smp_mb__before_atomic();
+
+	list_for_each_entry(napi, &dev->napi_list, dev_list) {
+		if (threaded)
+			set_bit(NAPI_STATE_THREADED, &napi->state);
+		else
+			clear_bit(NAPI_STATE_THREADED, &napi->state);
+	}
+}
+
+/**
+ *	dev_set_threaded - switch napi polling of a device to kthreads
+ *	@dev: device
+ *	@threaded: poll in per-napi kthreads rather than NET_RX_SOFTIRQ
+ *
+ *	Gives each napi context of @dev its own "napi/<dev>-<n>" kthread,
+ *	whose scheduling policy and cpu affinity can then be set like any
+ *	other task's.  The switch takes effect the next time each napi is
+ *	scheduled; the kthreads are kept around until the napi is deleted.
+ *	Must be called under rtnl.
+ */
+int dev_set_threaded(struct net_device *dev, bool threaded)
+{
+	struct napi_struct *napi;
+	int err = 0;
+
+	if (dev->threaded == threaded)
+		return 0;
+
+	if (threaded) {
+		list_for_each_entry(napi, &dev->napi_list, dev_list) {
+			if (napi->thread)
+				continue;
+			err = napi_kthread_create(napi);
+			if (err) {
+				threaded = false;
+				break;
+			}
+		}
+	}
+
+	napi_set_threaded(dev, threaded);
+
+	return err;
+}
+EXPORT_SYMBOL(dev_set_threaded);
+
 void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 		    int (*poll)(struct napi_struct *, int), int weight)
 {
@@ -4581,6 +4678,16 @@ void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 	napi->poll_owner = -1;
 #endif
 	set_bit(NAPI_STATE_SCHED, &napi->state);
+
+	/* A napi added to a threaded device gets its kthread straight away;
+	 * if that fails, fall back to softirq polling for the whole device.
+	 */
+	if (dev->threaded) {
+		if (napi_kthread_create(napi))
+			napi_set_threaded(dev, false);
+		else
+			set_bit(NAPI_STATE_THREADED, &napi->state);
+	}
 }
 EXPORT_SYMBOL(netif_napi_add);
 
@@ -4600,6 +4707,11 @@ EXPORT_SYMBOL(napi_disable);
 
 void netif_napi_del(struct napi_struct *napi)
 {
+	if (napi->thread) {
+		kthread_stop(napi->thread);
+		napi->thread = NULL;
+	}
+
 	list_del_init(&napi->dev_list);
 	napi_free_frags(napi);
 
@@ -4609,15 +4721,10 @@ void netif_napi_del(struct napi_struct *napi)
 }
 EXPORT_SYMBOL(netif_napi_del);
 
-static int napi_poll(struct napi_struct *n, struct list_head *repoll)
+static int __napi_poll(struct napi_struct *n, bool *repoll)
 {
-	void *have;
 	int work, weight;
 
-	list_del_init(&n->poll_list);
-
-	have = netpoll_poll_lock(n);
-
 	weight = n->weight;
 
 	/* This NAPI_STATE_SCHED test is for avoiding a race
@@ -4635,7 +4742,7 @@ static int napi_poll(struct napi_struct *n, struct list_head *repoll)
 	WARN_ON_ONCE(work > weight);
 
 	if (likely(work < weight))
-		goto out_unlock;
+		return work;
 
 	/* Drivers must not modify the NAPI state if they
 	 * consume the entire weight.  In such cases this code
@@ -4644,7 +4751,7 @@ static int napi_poll(struct napi_struct *n, struct list_head *repoll)
 	 */
 	if (unlikely(napi_disable_pending(n))) {
 		napi_complete(n);
-		goto out_unlock;
+		return work;
 	}
 
 	if (n->gro_list) {
@@ -4660,17 +4767,88 @@ static int napi_poll(struct napi_struct *n, struct list_head *repoll)
 	if (unlikely(!list_empty(&n->poll_list))) {
 		pr_warn_once("%s: Budget exhausted after napi rescheduled\n",
 			     n->dev ? n->dev->name : "backlog");
-		goto out_unlock;
+		return work;
 	}
 
-	list_add_tail(&n->poll_list, repoll);
+	*repoll = true;
+
+	return work;
+}
+
+static int napi_poll(struct napi_struct *n, struct list_head *repoll)
+{
+	bool do_repoll = false;
+	void *have;
+	int work;
+
+	list_del_init(&n->poll_list);
+
+	have = netpoll_poll_lock(n);
+
+	work = __napi_poll(n, &do_repoll);
+
+	if (do_repoll)
+		list_add_tail(&n->poll_list, repoll);
 
-out_unlock:
 	netpoll_poll_unlock(have);
 
 	return work;
 }
 
+static int napi_thread_wait(struct napi_struct *napi)
+{
+	set_current_state(TASK_INTERRUPTIBLE);
+
+	while (!kthread_should_stop()) {
+		/* SCHED alone is not enough: napi_disable() and netpoll
+		 * take it too.  Only SCHED_THREADED means ____napi_schedule()
+		 * handed this napi to us; any other wakeup is spurious.
+		 */
+		if (test_bit(NAPI_STATE_SCHED_THREADED, &napi->state)) {
+			WARN_ON(!list_empty(&napi->poll_list));
+			__set_current_state(TASK_RUNNING);
+			return 0;
+		}
+
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+
+	return -1;
+}
+
+static int napi_threaded_poll(void *data)
+{
+	struct napi_struct *napi = data;
+	void *have;
+
+	while (!napi_thread_wait(napi)) {
+		for (;;) {
+			bool repoll = false;
+
+			/* Drivers and the stack expect ->poll() to run with
+			 * bh disabled, as it would from net_rx_action().
+			 * Softirqs raised meanwhile (RPS IPIs, tx completions)
+			 * run on local_bh_enable().
+			 */
+			local_bh_disable();
+
+			have = netpoll_poll_lock(napi);
+			__napi_poll(napi, &repoll);
+			netpoll_poll_unlock(have);
+
+			local_bh_enable();
+
+			if (!repoll)
+				break;
+
+			cond_resched();
+		}
+	}
+	return 0;
+}
+
 static void net_rx_action(struct softirq_action *h)
 {
 	struct softnet_data *sd = this_cpu_ptr(&softnet_data);
@@ -418,6 +418,18 @@ int svc_bind(struct svc_serv *serv, struct net *net)
 }
 EXPORT_SYMBOL_GPL(svc_bind);
 
+static void
+svc_free_pools(struct svc_serv *serv)
+{
+	unsigned int i;
+
+	for (i = 0; i < serv->sv_nrpools; i++) {
+		free_percpu(serv->sv_pools[i].sp_idle_hint);
+		free_percpu(serv->sv_pools[i].sp_cpu_stats);
+	}
+	kfree(serv->sv_pools);
+}
+
 /*
  * Create an RPC service
  */
@@ -477,8 +489,16 @@ __svc_create(struct svc_program *prog, unsigned int bufsize, int npools,
 
 		pool->sp_id = i;
 		INIT_LIST_HEAD(&pool->sp_sockets);
+		init_llist_head(&pool->sp_ready);
 		INIT_LIST_HEAD(&pool->sp_all_threads);
 		spin_lock_init(&pool->sp_lock);
+		pool->sp_idle_hint = alloc_percpu(struct svc_rqst *);
+		pool->sp_cpu_stats = alloc_percpu(struct svc_pool_cpu_stats);
+		if (!pool->sp_idle_hint || !pool->sp_cpu_stats) {
+			svc_free_pools(serv);
+			kfree(serv);
+			return NULL;
+		}
 	}
 
 	return serv;
@@ -555,7 +575,7 @@ svc_destroy(struct svc_serv *serv)
 	if (svc_serv_is_pooled(serv))
 		svc_pool_map_put();
 
-	kfree(serv->sv_pools);
+	svc_free_pools(serv);
 	kfree(serv);
 }
 EXPORT_SYMBOL_GPL(svc_destroy);
@@ -767,6 +787,20 @@ svc_set_num_threads(struct svc_serv *serv, struct svc_pool *pool, int nrservs)
 }
 EXPORT_SYMBOL_GPL(svc_set_num_threads);
 
+/*
+ * Make sure no cpu still points enqueuers at an exiting thread.  Anyone
+ * who already read the hint is inside an RCU read section, and the
+ * svc_rqst is freed with kfree_rcu.
+ */
+static void
+svc_pool_clear_idle_hint(struct svc_pool *pool, struct svc_rqst *rqstp)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		cmpxchg(per_cpu_ptr(pool->sp_idle_hint, cpu), rqstp, NULL);
+}
+
 /*
  * Called from a server thread as it's exiting. Caller must hold the "service
  * mutex" for the service.
@@ -788,6 +822,7 @@ svc_exit_thread(struct svc_rqst *rqstp)
 		list_del_rcu(&rqstp->rq_all);
 	spin_unlock_bh(&pool->sp_lock);
 
+	svc_pool_clear_idle_hint(pool, rqstp);
 	kfree_rcu(rqstp, rq_rcu_head);
 
 	/* Release the server */
@@ -40,6 +40,9 @@ static LIST_HEAD(svc_xprt_class_list);
 /* SMP locking strategy:
  *
  *	svc_pool->sp_lock protects most of the fields of that pool.
+ *	Transports are queued on svc_pool->sp_ready without it; only
+ *	the threads dequeueing them take sp_lock to move them over to
+ *	sp_sockets.
  *	svc_serv->sv_lock protects sv_tempsocks, sv_permsocks, sv_tmpcnt.
  *	when both need to be taken (rare), svc_serv->sv_lock is first.
  *	The "service mutex" protects svc_serv->sv_nrthread.
@@ -320,6 +323,38 @@ static bool svc_xprt_has_something_to_do(struct svc_xprt *xprt)
 	return false;
 }
 
+/*
+ * Try to get @rqstp to service @xprt.  Returns false if it is busy.
+ */
+static bool svc_xprt_claim_thread(struct svc_rqst *rqstp,
+				  struct svc_xprt *xprt, bool queued)
+{
+	/* Do a lockless check first */
+	if (test_bit(RQ_BUSY, &rqstp->rq_flags))
+		return false;
+
+	/*
+	 * Once the xprt has been queued, it can only be dequeued by
+	 * the task that intends to service it. All we can do at that
+	 * point is to try to wake this thread back up so that it can
+	 * do so.
+	 */
+	if (!queued) {
+		spin_lock_bh(&rqstp->rq_lock);
+		if (test_and_set_bit(RQ_BUSY, &rqstp->rq_flags)) {
+			/* already busy, move on... */
+			spin_unlock_bh(&rqstp->rq_lock);
+			return false;
+		}
+
+		/* this one will do */
+		rqstp->rq_xprt = xprt;
+		svc_xprt_get(xprt);
+		spin_unlock_bh(&rqstp->rq_lock);
+	}
+	return true;
+}
+
 static void svc_xprt_do_enqueue(struct svc_xprt *xprt)
 {
 	struct svc_pool *pool;
@@ -345,40 +380,27 @@ static void svc_xprt_do_enqueue(struct svc_xprt *xprt)
 	pool = svc_pool_for_cpu(xprt->xpt_server, cpu);
 
 	atomic_long_inc(&pool->sp_stats.packets);
+	xprt->xpt_qtime = ktime_get();
 
 redo_search:
 	/* find a thread for this xprt */
 	rcu_read_lock();
-	list_for_each_entry_rcu(rqstp, &pool->sp_all_threads, rq_all) {
-		/* Do a lockless check first */
-		if (test_bit(RQ_BUSY, &rqstp->rq_flags))
-			continue;
 
-		/*
-		 * Once the xprt has been queued, it can only be dequeued by
-		 * the task that intends to service it. All we can do at that
-		 * point is to try to wake this thread back up so that it can
-		 * do so.
-		 */
-		if (!queued) {
-			spin_lock_bh(&rqstp->rq_lock);
-			if (test_and_set_bit(RQ_BUSY, &rqstp->rq_flags)) {
-				/* already busy, move on... */
-				spin_unlock_bh(&rqstp->rq_lock);
-				continue;
-			}
-
-			/* this one will do */
-			rqstp->rq_xprt = xprt;
-			svc_xprt_get(xprt);
-			spin_unlock_bh(&rqstp->rq_lock);
-		}
-		rcu_read_unlock();
+	/*
+	 * The thread that last went idle on this cpu is cache hot and
+	 * local; only walk the pool's thread list if it's busy by now.
+	 * The hint is a plain pointer, the rcu read section keeps the
+	 * svc_rqst around, see svc_pool_clear_idle_hint().
+	 */
+	rqstp = READ_ONCE(*this_cpu_ptr(pool->sp_idle_hint));
+	if (rqstp && svc_xprt_claim_thread(rqstp, xprt, queued)) {
+		WRITE_ONCE(*this_cpu_ptr(pool->sp_idle_hint), NULL);
+		goto wake;
+	}
 
-		atomic_long_inc(&pool->sp_stats.threads_woken);
-		wake_up_process(rqstp->rq_task);
-		put_cpu();
-		goto out;
+	list_for_each_entry_rcu(rqstp, &pool->sp_all_threads, rq_all) {
+		if (svc_xprt_claim_thread(rqstp, xprt, queued))
+			goto wake;
 	}
 	rcu_read_unlock();
 
@@ -391,14 +413,19 @@ redo_search:
 	if (!queued) {
 		queued = true;
 		dprintk("svc: transport %p put into queue\n", xprt);
-		spin_lock_bh(&pool->sp_lock);
-		list_add_tail(&xprt->xpt_ready, &pool->sp_sockets);
-		pool->sp_stats.sockets_queued++;
-		spin_unlock_bh(&pool->sp_lock);
+		llist_add(&xprt->xpt_lready, &pool->sp_ready);
+		atomic_long_inc(&pool->sp_stats.sockets_queued);
 		goto redo_search;
 	}
 	rqstp = NULL;
 	put_cpu();
+	goto out;
+wake:
+	rcu_read_unlock();
+
+	atomic_long_inc(&pool->sp_stats.threads_woken);
+	wake_up_process(rqstp->rq_task);
+	put_cpu();
 out:
 	trace_svc_xprt_do_enqueue(xprt, rqstp);
 }
@@ -416,6 +443,25 @@ void svc_xprt_enqueue(struct svc_xprt *xprt)
 }
 EXPORT_SYMBOL_GPL(svc_xprt_enqueue);
 
+static bool svc_pool_has_ready(struct svc_pool *pool)
+{
+	return !list_empty(&pool->sp_sockets) || !llist_empty(&pool->sp_ready);
+}
+
+/*
+ * Move the transports queued on sp_ready over to sp_sockets, oldest
+ * first.  Called with sp_lock held.
+ */
+static void svc_pool_splice_ready(struct svc_pool *pool)
+{
+	struct llist_node *node;
+	struct svc_xprt *xprt, *tmp;
+
+	node = llist_reverse_order(llist_del_all(&pool->sp_ready));
+	llist_for_each_entry_safe(xprt, tmp, node, xpt_lready)
+		list_add_tail(&xprt->xpt_ready, &pool->sp_sockets);
+}
+
 /*
  * Dequeue the first transport, if there is one.
  */
@@ -423,10 +469,12 @@ static struct svc_xprt *svc_xprt_dequeue(struct svc_pool *pool)
 {
 	struct svc_xprt	*xprt = NULL;
 
-	if (list_empty(&pool->sp_sockets))
+	if (!svc_pool_has_ready(pool))
 		goto out;
 
 	spin_lock_bh(&pool->sp_lock);
+	if (list_empty(&pool->sp_sockets))
+		svc_pool_splice_ready(pool);
 	if (likely(!list_empty(&pool->sp_sockets))) {
 		xprt = list_first_entry(&pool->sp_sockets,
 					struct svc_xprt, xpt_ready);
@@ -649,7 +697,7 @@ rqst_should_sleep(struct svc_rqst *rqstp)
 		return false;
 
 	/* was a socket queued? */
-	if (!list_empty(&pool->sp_sockets))
+	if (svc_pool_has_ready(pool))
 		return false;
 
 	/* are we shutting down? */
@@ -696,6 +744,8 @@ static struct svc_xprt *svc_get_next_xprt(struct svc_rqst *rqstp, long timeout)
 	 */
 	set_current_state(TASK_INTERRUPTIBLE);
 	clear_bit(RQ_BUSY, &rqstp->rq_flags);
+	/* preemptible, but a hint for the cpu we just left is fine */
+	WRITE_ONCE(*raw_cpu_ptr(pool->sp_idle_hint), rqstp);
 	smp_mb();
 
 	if (likely(rqst_should_sleep(rqstp)))
@@ -818,6 +868,11 @@ int svc_recv(struct svc_rqst *rqstp, long timeout)
 		goto out;
 	}
 
+	rqstp->rq_stime = ktime_get();
+	this_cpu_inc(rqstp->rq_pool->sp_cpu_stats->xprts_handled);
+	this_cpu_add(rqstp->rq_pool->sp_cpu_stats->wait_ns,
+		     ktime_to_ns(ktime_sub(rqstp->rq_stime, xprt->xpt_qtime)));
+
 	len = svc_handle_xprt(rqstp, xprt);
 
 	/* No data, incomplete (TCP) read, or accept() */
@@ -890,6 +945,10 @@ int svc_send(struct svc_rqst *rqstp)
 	rpc_wake_up(&xprt->xpt_bc_pending);
 	svc_xprt_release(rqstp);
 
+	this_cpu_inc(rqstp->rq_pool->sp_cpu_stats->requests);
+	this_cpu_add(rqstp->rq_pool->sp_cpu_stats->service_ns,
+		     ktime_to_ns(ktime_sub(ktime_get(), rqstp->rq_stime)));
+
 	if (len == -ECONNREFUSED || len == -ENOTCONN || len == -EAGAIN)
 		len = 0;
 out:
@@ -1024,6 +1083,7 @@ static struct svc_xprt *svc_dequeue_net(struct svc_serv *serv, struct net *net)
 		pool = &serv->sv_pools[i];
 
 		spin_lock_bh(&pool->sp_lock);
+		svc_pool_splice_ready(pool);
 		list_for_each_entry_safe(xprt, tmp, &pool->sp_sockets, xpt_ready) {
 			if (xprt->xpt_net != net)
 				continue;
@@ -1334,18 +1394,34 @@ static void svc_pool_stats_stop(struct seq_file *m, void *p)
 static int svc_pool_stats_show(struct seq_file *m, void *p)
 {
 	struct svc_pool *pool = p;
+	struct svc_pool_cpu_stats sum = { };
+	int cpu;
 
 	if (p == SEQ_START_TOKEN) {
-		seq_puts(m, "# pool packets-arrived sockets-enqueued threads-woken threads-timedout\n");
+		seq_puts(m, "# pool packets-arrived sockets-enqueued threads-woken threads-timedout xprts-handled wait-us requests service-us\n");
 		return 0;
 	}
 
-	seq_printf(m, "%u %lu %lu %lu %lu\n",
+	for_each_possible_cpu(cpu) {
+		struct svc_pool_cpu_stats *st;
+
+		st = per_cpu_ptr(pool->sp_cpu_stats, cpu);
+		sum.xprts_handled += st->xprts_handled;
+		sum.wait_ns += st->wait_ns;
+		sum.requests += st->requests;
+		sum.service_ns += st->service_ns;
+	}
+
+	seq_printf(m, "%u %lu %lu %lu %lu %lu %llu %lu %llu\n",
 		pool->sp_id,
 		(unsigned long)atomic_long_read(&pool->sp_stats.packets),
-		pool->sp_stats.sockets_queued,
+		(unsigned long)atomic_long_read(&pool->sp_stats.sockets_queued),
 		(unsigned long)atomic_long_read(&pool->sp_stats.threads_woken),
-		(unsigned long)atomic_long_read(&pool->sp_stats.threads_timedout));
+		(unsigned long)atomic_long_read(&pool->sp_stats.threads_timedout),
+		sum.xprts_handled,
+		div_u64(sum.wait_ns, NSEC_PER_USEC),
+		sum.requests,
+		div_u64(sum.service_ns, NSEC_PER_USEC));
 
 	return 0;
 }
@@ -0,0 +1,234 @@
+/*
+ * ipc-msg: SysV message queue ping-pong between pairs of threads.
+ *
+ * Threads are paired up and each pair bounces a message back and forth
+ * through one of the queues, using its own message types, so that the
+ * queues are shared by several pairs when there are fewer queues than
+ * pairs.  Measures the cost of msgsnd()/msgrcv() including the wakeup of
+ * the receiver, and the contention on the queue lock.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/stat.h"
+#include "../util/parse-options.h"
+#include "../util/header.h"
+#include "bench.h"
+
+#include <err.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/ipc.h>
+#include <sys/msg.h>
+#include <pthread.h>
+
+static unsigned int nthreads = 0;
+static unsigned int nsecs    = 10;
+static unsigned int nqueues  = 1;
+static unsigned int msgsize  = 64;
+static bool done = false, silent = false;
+static int *queues;
+
+static struct timeval start, end, runtime;
+static pthread_mutex_t thread_lock;
+static unsigned int threads_starting;
+static struct stats throughput_stats;
+static pthread_cond_t thread_parent, thread_worker;
+
+struct worker {
+	int tid;
+	pthread_t thread;
+	unsigned long ops;
+};
+
+struct bench_msg {
+	long mtype;
+	char mtext[0];
+};
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads, "Specify amount of threads (rounded up to even)"),
+	OPT_UINTEGER('r', "runtime", &nsecs,    "Specify runtime (in seconds)"),
+	OPT_UINTEGER('q', "queues",  &nqueues,  "Specify amount of message queues"),
+	OPT_UINTEGER('m', "msgsize", &msgsize,  "Specify message size (in bytes)"),
+	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_ipc_msg_usage[] = {
+	"perf bench ipc msg <options>",
+	NULL
+};
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = (struct worker *) arg;
+	int pair = w->tid / 2;
+	int qid = queues[pair % nqueues];
+	/* even threads serve, odd threads reply */
+	long snd_type = 2 * pair + 1 + (w->tid & 1);
+	long rcv_type = 2 * pair + 2 - (w->tid & 1);
+	struct bench_msg *msg;
+
+	msg = calloc(1, sizeof(*msg) + msgsize);
+	if (!msg)
+		err(EXIT_FAILURE, "calloc");
+
+	pthread_mutex_lock(&thread_lock);
+	threads_starting--;
+	if (!threads_starting)
+		pthread_cond_signal(&thread_parent);
+	pthread_cond_wait(&thread_worker, &thread_lock);
+	pthread_mutex_unlock(&thread_lock);
+
+	if (!(w->tid & 1)) {
+		msg->mtype = snd_type;
+		if (msgsnd(qid, msg, msgsize, 0))
+			err(EXIT_FAILURE, "msgsnd");
+	}
+
+	do {
+		if (msgrcv(qid, msg, msgsize, rcv_type, 0) < 0) {
+			/* the queues are removed to stop blocked threads */
+			if (done && (errno == EIDRM || errno == EINVAL))
+				break;
+			err(EXIT_FAILURE, "msgrcv");
+		}
+		msg->mtype = snd_type;
+		if (msgsnd(qid, msg, msgsize, 0)) {
+			if (done && (errno == EIDRM || errno == EINVAL))
+				break;
+			err(EXIT_FAILURE, "msgsnd");
+		}
+		w->ops++;
+	} while (!done);
+
+	free(msg);
+	return NULL;
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+}
+
+static void print_summary(void)
+{
+	unsigned long avg = avg_stats(&throughput_stats);
+	double stddev = stddev_stats(&throughput_stats);
+
+	printf("%sAveraged %ld round trips/sec (+- %.2f%%), total secs = %d\n",
+	       !silent ? "\n" : "", avg, rel_stddev_stats(stddev, avg),
+	       (int) runtime.tv_sec);
+}
+
+int bench_ipc_msg(int argc, const char **argv,
+		  const char *prefix __maybe_unused)
+{
+	int ret = 0;
+	cpu_set_t cpu;
+	struct sigaction act;
+	unsigned int i, ncpus;
+	pthread_attr_t thread_attr;
+	struct worker *worker = NULL;
+
+	argc = parse_options(argc, argv, options, bench_ipc_msg_usage, 0);
+	if (argc || !nqueues) {
+		usage_with_options(bench_ipc_msg_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	if (!nthreads) /* default to the number of CPUs */
+		nthreads = ncpus;
+	nthreads = (nthreads + 1) & ~1U;
+
+	worker = calloc(nthreads, sizeof(*worker));
+	queues = calloc(nqueues, sizeof(*queues));
+	if (!worker || !queues)
+		err(EXIT_FAILURE, "calloc");
+
+	for (i = 0; i < nqueues; i++) {
+		queues[i] = msgget(IPC_PRIVATE, IPC_CREAT | 0600);
+		if (queues[i] < 0)
+			err(EXIT_FAILURE, "msgget");
+	}
+
+	printf("Run summary [PID %d]: %d threads in pairs on %d queues, "
+	       "%d byte messages, for %d secs.\n\n",
+	       getpid(), nthreads, nqueues, msgsize, nsecs);
+
+	init_stats(&throughput_stats);
+	pthread_mutex_init(&thread_lock, NULL);
+	pthread_cond_init(&thread_parent, NULL);
+	pthread_cond_init(&thread_worker, NULL);
+
+	threads_starting = nthreads;
+	pthread_attr_init(&thread_attr);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < nthreads; i++) {
+		worker[i].tid = i;
+
+		CPU_ZERO(&cpu);
+		CPU_SET(i % ncpus, &cpu);
+
+		ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpu);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+		ret = pthread_create(&worker[i].thread, &thread_attr, workerfn,
+				     (void *)(struct worker *) &worker[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	pthread_attr_destroy(&thread_attr);
+
+	pthread_mutex_lock(&thread_lock);
+	while (threads_starting)
+		pthread_cond_wait(&thread_parent, &thread_lock);
+	pthread_cond_broadcast(&thread_worker);
+	pthread_mutex_unlock(&thread_lock);
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	/* wake up the threads blocked in msgrcv() */
+	for (i = 0; i < nqueues; i++)
+		msgctl(queues[i], IPC_RMID, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	pthread_cond_destroy(&thread_parent);
+	pthread_cond_destroy(&thread_worker);
+	pthread_mutex_destroy(&thread_lock);
+
+	for (i = 0; i < nthreads; i++) {
+		unsigned long t = worker[i].ops/runtime.tv_sec;
+		update_stats(&throughput_stats, t);
+		if (!silent)
+			printf("[thread %3d] queue %d [ %ld round trips/sec ]\n",
+			       worker[i].tid, (worker[i].tid / 2) % nqueues, t);
+	}
+
+	print_summary();
+
+	free(queues);
+	free(worker);
+	return ret;
+}
@@ -0,0 +1,199 @@
+/*
+ * ipc-sem: SysV semaphore operations from many threads.
+ *
+ * Each thread increments and decrements a semaphore of one shared set in a
+ * loop.  By default every thread has a semaphore of its own, which measures
+ * the per-semaphore locking and the ipc id lookup; with --complex every
+ * operation also touches the semaphore of the next thread, which takes the
+ * slow path through the lock of the whole set.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/stat.h"
+#include "../util/parse-options.h"
+#include "../util/header.h"
+#include "bench.h"
+
+#include <err.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/ipc.h>
+#include <sys/sem.h>
+#include <pthread.h>
+
+static unsigned int nthreads = 0;
+static unsigned int nsecs    = 10;
+static bool done = false, silent = false, complex_ops = false;
+static int semid;
+
+static struct timeval start, end, runtime;
+static pthread_mutex_t thread_lock;
+static unsigned int threads_starting;
+static struct stats throughput_stats;
+static pthread_cond_t thread_parent, thread_worker;
+
+struct worker {
+	int tid;
+	pthread_t thread;
+	unsigned long ops;
+};
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads,    "Specify amount of threads"),
+	OPT_UINTEGER('r', "runtime", &nsecs,       "Specify runtime (in seconds)"),
+	OPT_BOOLEAN( 'c', "complex", &complex_ops, "Operate on two semaphores at once"),
+	OPT_BOOLEAN( 's', "silent",  &silent,      "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_ipc_sem_usage[] = {
+	"perf bench ipc sem <options>",
+	NULL
+};
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = (struct worker *) arg;
+	unsigned short next = (w->tid + 1) % nthreads;
+	struct sembuf up[2] = {
+		{ .sem_num = w->tid, .sem_op = 1 },
+		{ .sem_num = next,   .sem_op = 1 },
+	};
+	struct sembuf down[2] = {
+		{ .sem_num = w->tid, .sem_op = -1 },
+		{ .sem_num = next,   .sem_op = -1 },
+	};
+	size_t nsops = complex_ops && nthreads > 1 ? 2 : 1;
+
+	pthread_mutex_lock(&thread_lock);
+	threads_starting--;
+	if (!threads_starting)
+		pthread_cond_signal(&thread_parent);
+	pthread_cond_wait(&thread_worker, &thread_lock);
+	pthread_mutex_unlock(&thread_lock);
+
+	do {
+		if (semop(semid, up, nsops) || semop(semid, down, nsops))
+			err(EXIT_FAILURE, "semop");
+		w->ops += 2;
+	} while (!done);
+
+	return NULL;
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+}
+
+static void print_summary(void)
+{
+	unsigned long avg = avg_stats(&throughput_stats);
+	double stddev = stddev_stats(&throughput_stats);
+
+	printf("%sAveraged %ld operations/sec (+- %.2f%%), total secs = %d\n",
+	       !silent ? "\n" : "", avg, rel_stddev_stats(stddev, avg),
+	       (int) runtime.tv_sec);
+}
+
+int bench_ipc_sem(int argc, const char **argv,
+		  const char *prefix __maybe_unused)
+{
+	int ret = 0;
+	cpu_set_t cpu;
+	struct sigaction act;
+	unsigned int i, ncpus;
+	pthread_attr_t thread_attr;
+	struct worker *worker = NULL;
+
+	argc = parse_options(argc, argv, options, bench_ipc_sem_usage, 0);
+	if (argc) {
+		usage_with_options(bench_ipc_sem_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	if (!nthreads) /* default to the number of CPUs */
+		nthreads = ncpus;
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		err(EXIT_FAILURE, "calloc");
+
+	semid = semget(IPC_PRIVATE, nthreads, IPC_CREAT | 0600);
+	if (semid < 0)
+		err(EXIT_FAILURE, "semget");
+
+	printf("Run summary [PID %d]: %d threads doing %s semops for %d secs.\n\n",
+	       getpid(), nthreads, complex_ops ? "complex" : "simple", nsecs);
+
+	init_stats(&throughput_stats);
+	pthread_mutex_init(&thread_lock, NULL);
+	pthread_cond_init(&thread_parent, NULL);
+	pthread_cond_init(&thread_worker, NULL);
+
+	threads_starting = nthreads;
+	pthread_attr_init(&thread_attr);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < nthreads; i++) {
+		worker[i].tid = i;
+
+		CPU_ZERO(&cpu);
+		CPU_SET(i % ncpus, &cpu);
+
+		ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpu);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+		ret = pthread_create(&worker[i].thread, &thread_attr, workerfn,
+				     (void *)(struct worker *) &worker[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	pthread_attr_destroy(&thread_attr);
+
+	pthread_mutex_lock(&thread_lock);
+	while (threads_starting)
+		pthread_cond_wait(&thread_parent, &thread_lock);
+	pthread_cond_broadcast(&thread_worker);
+	pthread_mutex_unlock(&thread_lock);
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	pthread_cond_destroy(&thread_parent);
+	pthread_cond_destroy(&thread_worker);
+	pthread_mutex_destroy(&thread_lock);
+	semctl(semid, 0, IPC_RMID);
+
+	for (i = 0; i < nthreads; i++) {
+		unsigned long t = worker[i].ops/runtime.tv_sec;
+		update_stats(&throughput_stats, t);
+		if (!silent)
+			printf("[thread %3d] semaphore %d [ %ld ops/sec ]\n",
+			       worker[i].tid, worker[i].tid, t);
+	}
+
+	print_summary();
+
+	free(worker);
+	return ret;
+}
@@ -25,9 +25,14 @@
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/syscall.h>
+#include <sched.h>
 
 #include <pthread.h>
 
+#ifndef SCHED_IDLE
+#define SCHED_IDLE	5
+#endif
+
 struct thread_data {
 	int			nr;
 	int			pipe_read;
@@ -41,9 +46,13 @@ static	int			loops = LOOPS_DEFAULT;
 /* Use processes by default: */
 static bool			threaded;
 
+/* SCHED_IDLE cpu burners running in the background: */
+static	int			idle_hogs;
+
 static const struct option options[] = {
 	OPT_INTEGER('l', "loop",	&loops,		"Specify number of loops"),
 	OPT_BOOLEAN('T', "threaded",	&threaded,	"Specify threads/process based task setup"),
+	OPT_INTEGER('H', "idle-hogs",	&idle_hogs,	"Specify number of SCHED_IDLE background hogs"),
 	OPT_END()
 };
 
@@ -75,6 +84,21 @@ static void *worker_thread(void *__tdata)
 	return NULL;
 }
 
+static pid_t start_idle_hog(void)
+{
+	struct sched_param param = { .sched_priority = 0 };
+	pid_t pid;
+
+	pid = fork();
+	BUG_ON(pid < 0);
+	if (pid)
+		return pid;
+
+	BUG_ON(sched_setscheduler(0, SCHED_IDLE, &param));
+	for (;;)
+		;
+}
+
 int bench_sched_pipe(int argc, const char **argv, const char *prefix __maybe_unused)
 {
 	struct thread_data threads[2], *td;
@@ -91,12 +115,20 @@ int bench_sched_pipe(int argc, const char **argv, const char *prefix __maybe_unu
 	 */
 	int __maybe_unused ret, wait_stat;
 	pid_t pid, retpid __maybe_unused;
+	pid_t *hogs = NULL;
 
 	argc = parse_options(argc, argv, options, bench_sched_pipe_usage, 0);
 
 	BUG_ON(pipe(pipe_1));
 	BUG_ON(pipe(pipe_2));
 
+	if (idle_hogs > 0) {
+		hogs = calloc(idle_hogs, sizeof(*hogs));
+		BUG_ON(!hogs);
+		for (t = 0; t < idle_hogs; t++)
+			hogs[t] = start_idle_hog();
+	}
+
 	gettimeofday(&start, NULL);
 
 	for (t = 0; t < nr_threads; t++) {
@@ -148,10 +180,20 @@ int bench_sched_pipe(int argc, const char **argv, const char *prefix __maybe_unu
 	gettimeofday(&stop, NULL);
 	timersub(&stop, &start, &diff);
 
+	for (t = 0; t < idle_hogs; t++) {
+		kill(hogs[t], SIGKILL);
+		waitpid(hogs[t], NULL, 0);
+	}
+	free(hogs);
+
 	switch (bench_format) {
 	case BENCH_FORMAT_DEFAULT:
-		printf("# Executed %d pipe operations between two %s\n\n",
+		printf("# Executed %d pipe operations between two %s\n",
 			loops, threaded ? "threads" : "processes");
+		if (idle_hogs > 0)
+			printf("# with %d SCHED_IDLE hogs in the background\n",
+				idle_hogs);
+		printf("\n");
 
 		result_usec = diff.tv_sec * 1000000;
 		result_usec += diff.tv_usec;
@@ -13,6 +13,7 @@
  *  mem   ... memory access performance
  *  numa  ... NUMA scheduling and MM performance
  *  futex ... Futex performance
+ *  ipc   ... SysV IPC performance
  */
 #include "perf.h"
 #include "util/util.h"
@@ -63,6 +64,13 @@ static struct bench futex_benchmarks[] = {
 	{ NULL,		NULL,						NULL			}
 };
 
+static struct bench ipc_benchmarks[] = {
+	{ "sem",	"Benchmark for SysV semaphore operations",	bench_ipc_sem		},
+	{ "msg",	"Benchmark for SysV message queue ping-pong",	bench_ipc_msg		},
+	{ "all",	"Test all SysV IPC benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
 struct collection {
 	const char	*name;
 	const char	*summary;
@@ -76,6 +84,7 @@ static struct collection collections[] = {
 	{ "numa",	"NUMA scheduling and MM benchmarks",		numa_benchmarks		},
 #endif
 	{"futex",       "Futex stressing benchmarks",                   futex_benchmarks        },
+	{ "ipc",	"SysV IPC benchmarks",				ipc_benchmarks		},
 	{ "all",	"All benchmarks",				NULL			},
 	{ NULL,		NULL,						NULL			}
 };
@@ -0,0 +1,291 @@
+/*
+ * blkio.cost.weight fairness between two cgroups.
+ *
+ * Creates two blkio cgroups below the given blkio controller mount, "low"
+ * and "high", with the same number of tasks each doing 4k O_DIRECT random
+ * reads one at a time on one blk-mq device.  Enables blkio.cost.qos for the
+ * device with a device model of the given number of reads per second and
+ * vrate fixed at 100%, so that the budget rather than the device is the
+ * bottleneck, and reports the reads per second of each group with equal
+ * and then with different weights.
+ *
+ * Best run on null_blk loaded with
+ *	queue_mode=2 irqmode=2 completion_nsec=50000
+ * Fails if the ratio of the reads per second doesn't follow the weights
+ * within a factor of two.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/wait.h>
+
+#define BLOCK_SIZE	4096
+#define SPAN_BLOCKS	(1 << 18)
+
+static char *base;
+static char *dev;
+static int nr_tasks = 4;
+static int seconds = 5;
+static int iops = 20000;
+static int low_weight = 100;
+static int high_weight = 300;
+static unsigned int dev_major, dev_minor;
+
+struct shared {
+	volatile int go;
+	volatile int stop;
+	long ios[0];
+};
+static struct shared *sh;
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void cg_path(char *path, const char *cg, const char *file)
+{
+	snprintf(path, PATH_MAX, "%s/iocost-bench/%s/%s", base, cg, file);
+}
+
+static void write_file(const char *path, const char *val)
+{
+	int fd;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		die(path);
+	if (write(fd, val, strlen(val)) < 0)
+		die(path);
+	close(fd);
+}
+
+static void set_weight(const char *cg, int weight)
+{
+	char path[PATH_MAX];
+	char val[64];
+
+	snprintf(val, sizeof(val), "%u:%u %d\n", dev_major, dev_minor, weight);
+	cg_path(path, cg, "blkio.cost.weight");
+	write_file(path, val);
+}
+
+static void set_root(const char *file, const char *conf)
+{
+	char path[PATH_MAX];
+	char val[256];
+
+	snprintf(path, PATH_MAX, "%s/%s", base, file);
+	snprintf(val, sizeof(val), "%u:%u %s\n", dev_major, dev_minor, conf);
+	write_file(path, val);
+}
+
+static void setup(void)
+{
+	char path[PATH_MAX];
+	char conf[128];
+	struct stat st;
+
+	if (stat(dev, &st))
+		die(dev);
+	if (!S_ISBLK(st.st_mode)) {
+		fprintf(stderr, "%s: not a block device\n", dev);
+		exit(1);
+	}
+	dev_major = major(st.st_rdev);
+	dev_minor = minor(st.st_rdev);
+
+	cg_path(path, "", "");
+	if (mkdir(path, 0755) && errno != EEXIST)
+		die(path);
+	cg_path(path, "low", "");
+	if (mkdir(path, 0755) && errno != EEXIST)
+		die(path);
+	cg_path(path, "high", "");
+	if (mkdir(path, 0755) && errno != EEXIST)
+		die(path);
+
+	snprintf(conf, sizeof(conf), "rrandiops=%d rseqiops=%d", iops, iops);
+	set_root("blkio.cost.model", conf);
+	set_root("blkio.cost.qos", "enable=1 min=100 max=100");
+}
+
+static void cleanup(void)
+{
+	char path[PATH_MAX];
+
+	set_root("blkio.cost.qos", "enable=0");
+
+	cg_path(path, "low", "");
+	if (rmdir(path))
+		perror(path);
+	cg_path(path, "high", "");
+	if (rmdir(path))
+		perror(path);
+	cg_path(path, "", "");
+	if (rmdir(path))
+		perror(path);
+}
+
+static void worker(int i, const char *cg)
+{
+	char path[PATH_MAX];
+	unsigned int seed = i;
+	long ios = 0;
+	char pid[16];
+	void *buf;
+	int fd;
+
+	snprintf(pid, sizeof(pid), "%d\n", getpid());
+	cg_path(path, cg, "cgroup.procs");
+	write_file(path, pid);
+
+	fd = open(dev, O_RDONLY | O_DIRECT);
+	if (fd < 0)
+		die(dev);
+	if (posix_memalign(&buf, BLOCK_SIZE, BLOCK_SIZE))
+		die("posix_memalign");
+
+	while (!sh->go)
+		usleep(1000);
+	while (!sh->stop) {
+		off_t off = (off_t)(rand_r(&seed) % SPAN_BLOCKS) * BLOCK_SIZE;
+
+		if (pread(fd, buf, BLOCK_SIZE, off) != BLOCK_SIZE)
+			die("pread");
+		ios++;
+	}
+	sh->ios[i] = ios;
+	exit(0);
+}
+
+/* returns the ratio of high's to low's reads per second */
+static double run(const char *name)
+{
+	double elapsed, start;
+	long low = 0, high = 0;
+	int i;
+
+	memset(sh->ios, 0, 2 * nr_tasks * sizeof(long));
+	sh->go = 0;
+	sh->stop = 0;
+
+	for (i = 0; i < 2 * nr_tasks; i++) {
+		pid_t pid = fork();
+
+		if (pid < 0)
+			die("fork");
+		if (!pid)
+			worker(i, i < nr_tasks ? "low" : "high");
+	}
+
+	sleep(1);
+	start = now();
+	sh->go = 1;
+	sleep(seconds);
+	sh->stop = 1;
+	while (wait(NULL) > 0)
+		;
+	elapsed = now() - start;
+
+	for (i = 0; i < nr_tasks; i++) {
+		low += sh->ios[i];
+		high += sh->ios[nr_tasks + i];
+	}
+	printf("%-16s low %10.0f reads/s, high %10.0f reads/s, ratio %5.2f\n",
+	       name, low / elapsed, high / elapsed,
+	       (double)high / (low ? low : 1));
+	return (double)high / (low ? low : 1);
+}
+
+int main(int argc, char **argv)
+{
+	double expected, ratio;
+	char name[32];
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:b:n:t:i:l:h:")) != -1) {
+		switch (opt) {
+		case 'd':
+			base = optarg;
+			break;
+		case 'b':
+			dev = optarg;
+			break;
+		case 'n':
+			nr_tasks = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'i':
+			iops = atoi(optarg);
+			break;
+		case 'l':
+			low_weight = atoi(optarg);
+			break;
+		case 'h':
+			high_weight = atoi(optarg);
+			break;
+		default:
+			base = NULL;
+			break;
+		}
+	}
+	if (!base || !dev || nr_tasks < 1 || seconds < 1 || iops < 1 ||
+	    low_weight < 1 || high_weight < 1) {
+		fprintf(stderr, "usage: %s -d blkio_mount -b blockdev "
+			"[-n tasks_per_group] [-t seconds] [-i model_iops] "
+			"[-l low_weight] [-h high_weight]\n", argv[0]);
+		return 1;
+	}
+
+	sh = mmap(NULL, sizeof(*sh) + 2 * nr_tasks * sizeof(long),
+		  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (sh == MAP_FAILED)
+		die("mmap");
+
+	setup();
+
+	set_weight("low", 0);
+	set_weight("high", 0);
+	run("equal weights:");
+
+	set_weight("low", low_weight);
+	set_weight("high", high_weight);
+	snprintf(name, sizeof(name), "%d:%d:", low_weight, high_weight);
+	ratio = run(name);
+
+	cleanup();
+
+	expected = (double)high_weight / low_weight;
+	if (ratio < expected / 2 || ratio > expected * 2) {
+		printf("FAIL: ratio %.2f, expected %.2f\n", ratio, expected);
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
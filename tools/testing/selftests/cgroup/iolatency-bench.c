@@ -0,0 +1,268 @@
+/*
+ * blkio.latency protection of one cgroup against a batch of others.
+ *
+ * Creates two blkio cgroups below the given blkio controller mount,
+ * "protected" with one task doing 4k O_DIRECT random reads one at a time
+ * and "batch" with a number of tasks doing the same, all on one blk-mq
+ * device.  Runs twice, first without and then with a latency target for
+ * the protected group, and reports its average read latency and the
+ * batch group's reads per second each time.
+ *
+ * Best run on null_blk loaded with
+ *	queue_mode=2 irqmode=2 serial_completion=1 completion_nsec=50000
+ * which makes every queued request add to the latency of the next ones.
+ * Fails if the target doesn't lower the protected group's latency.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/wait.h>
+
+#define BLOCK_SIZE	4096
+#define SPAN_BLOCKS	(1 << 18)
+
+static char *base;
+static char *dev;
+static int nr_batch = 16;
+static int seconds = 5;
+static int target_us = 500;
+static unsigned int dev_major, dev_minor;
+
+struct result {
+	long ios;
+	double lat;
+};
+
+struct shared {
+	volatile int go;
+	volatile int stop;
+	struct result res[0];
+};
+static struct shared *sh;
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void cg_path(char *path, const char *cg, const char *file)
+{
+	snprintf(path, PATH_MAX, "%s/iolatency-bench/%s/%s", base, cg, file);
+}
+
+static void write_file(const char *path, const char *val)
+{
+	int fd;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		die(path);
+	if (write(fd, val, strlen(val)) < 0)
+		die(path);
+	close(fd);
+}
+
+static void set_target(int us)
+{
+	char path[PATH_MAX];
+	char val[64];
+
+	snprintf(val, sizeof(val), "%u:%u %d\n", dev_major, dev_minor, us);
+	cg_path(path, "protected", "blkio.latency");
+	write_file(path, val);
+}
+
+static void setup(void)
+{
+	char path[PATH_MAX];
+	struct stat st;
+
+	if (stat(dev, &st))
+		die(dev);
+	if (!S_ISBLK(st.st_mode)) {
+		fprintf(stderr, "%s: not a block device\n", dev);
+		exit(1);
+	}
+	dev_major = major(st.st_rdev);
+	dev_minor = minor(st.st_rdev);
+
+	cg_path(path, "", "");
+	if (mkdir(path, 0755) && errno != EEXIST)
+		die(path);
+	cg_path(path, "protected", "");
+	if (mkdir(path, 0755) && errno != EEXIST)
+		die(path);
+	cg_path(path, "batch", "");
+	if (mkdir(path, 0755) && errno != EEXIST)
+		die(path);
+}
+
+static void cleanup(void)
+{
+	char path[PATH_MAX];
+
+	cg_path(path, "protected", "");
+	if (rmdir(path))
+		perror(path);
+	cg_path(path, "batch", "");
+	if (rmdir(path))
+		perror(path);
+	cg_path(path, "", "");
+	if (rmdir(path))
+		perror(path);
+}
+
+static void worker(int i, const char *cg)
+{
+	char path[PATH_MAX];
+	unsigned int seed = i;
+	double lat = 0;
+	long ios = 0;
+	char pid[16];
+	void *buf;
+	int fd;
+
+	snprintf(pid, sizeof(pid), "%d\n", getpid());
+	cg_path(path, cg, "cgroup.procs");
+	write_file(path, pid);
+
+	fd = open(dev, O_RDONLY | O_DIRECT);
+	if (fd < 0)
+		die(dev);
+	if (posix_memalign(&buf, BLOCK_SIZE, BLOCK_SIZE))
+		die("posix_memalign");
+
+	while (!sh->go)
+		usleep(1000);
+	while (!sh->stop) {
+		off_t off = (off_t)(rand_r(&seed) % SPAN_BLOCKS) * BLOCK_SIZE;
+		double start = now();
+
+		if (pread(fd, buf, BLOCK_SIZE, off) != BLOCK_SIZE)
+			die("pread");
+		lat += now() - start;
+		ios++;
+	}
+	sh->res[i].ios = ios;
+	sh->res[i].lat = lat;
+	exit(0);
+}
+
+static void run(const char *name)
+{
+	double elapsed, start;
+	long batch_ios = 0;
+	int i;
+
+	memset(sh->res, 0, (nr_batch + 1) * sizeof(struct result));
+	sh->go = 0;
+	sh->stop = 0;
+
+	for (i = 0; i <= nr_batch; i++) {
+		pid_t pid = fork();
+
+		if (pid < 0)
+			die("fork");
+		if (!pid)
+			worker(i, i ? "batch" : "protected");
+	}
+
+	sleep(1);
+	start = now();
+	sh->go = 1;
+	sleep(seconds);
+	sh->stop = 1;
+	while (wait(NULL) > 0)
+		;
+	elapsed = now() - start;
+
+	for (i = 1; i <= nr_batch; i++)
+		batch_ios += sh->res[i].ios;
+	printf("%-16s protected %10.1f us/read, batch %10.0f reads/s\n", name,
+	       sh->res[0].ios ? sh->res[0].lat * 1e6 / sh->res[0].ios : 0,
+	       batch_ios / elapsed);
+}
+
+int main(int argc, char **argv)
+{
+	double without, with;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:b:n:t:l:")) != -1) {
+		switch (opt) {
+		case 'd':
+			base = optarg;
+			break;
+		case 'b':
+			dev = optarg;
+			break;
+		case 'n':
+			nr_batch = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'l':
+			target_us = atoi(optarg);
+			break;
+		default:
+			base = NULL;
+			break;
+		}
+	}
+	if (!base || !dev || nr_batch < 1 || seconds < 1 || target_us < 1) {
+		fprintf(stderr, "usage: %s -d blkio_mount -b blockdev "
+			"[-n batch_tasks] [-t seconds] [-l target_us]\n",
+			argv[0]);
+		return 1;
+	}
+
+	sh = mmap(NULL, sizeof(*sh) + (nr_batch + 1) * sizeof(struct result),
+		  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (sh == MAP_FAILED)
+		die("mmap");
+
+	setup();
+
+	set_target(0);
+	run("no target:");
+	without = sh->res[0].lat / (sh->res[0].ios ? sh->res[0].ios : 1);
+
+	set_target(target_us);
+	run("target:");
+	with = sh->res[0].lat / (sh->res[0].ios ? sh->res[0].ios : 1);
+	set_target(0);
+
+	cleanup();
+
+	if (with >= without) {
+		printf("FAIL: target %d us did not lower the latency\n",
+		       target_us);
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
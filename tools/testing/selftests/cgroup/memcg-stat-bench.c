@@ -0,0 +1,214 @@
+/*
+ * memory.stat read cost with many cgroups.
+ *
+ * Creates a number of memory cgroups (2000 by default) below the given
+ * memory controller mount, charges a few pages to each of them, and then
+ * repeatedly:
+ *  - charges and uncharges some memory in a subset of the cgroups, as a
+ *    mostly idle host would between two scrapes of a monitoring agent,
+ *  - reads memory.stat of every cgroup and of their common parent.
+ *
+ * Reports the average time per memory.stat read for the leaves and for the
+ * parent, whose total_* values cover all of them.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TOUCH_PAGES	16
+
+static int nr_cgroups = 2000;
+static int nr_updated = 20;
+static int loops = 10;
+static char *base;
+static char buf[64 << 10];
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void cg_path(char *path, int i, const char *file)
+{
+	if (i < 0)
+		snprintf(path, PATH_MAX, "%s/memcg-stat-bench/%s", base, file);
+	else
+		snprintf(path, PATH_MAX, "%s/memcg-stat-bench/cg%d/%s", base, i,
+			 file);
+}
+
+static void write_file(const char *path, const char *val)
+{
+	int fd;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		die(path);
+	if (write(fd, val, strlen(val)) < 0)
+		die(path);
+	close(fd);
+}
+
+static void enter(int i)
+{
+	char path[PATH_MAX];
+	char pid[16];
+
+	snprintf(pid, sizeof(pid), "%d\n", getpid());
+	if (i < 0)
+		snprintf(path, sizeof(path), "%s/cgroup.procs", base);
+	else
+		cg_path(path, i, "cgroup.procs");
+	write_file(path, pid);
+}
+
+/* charge and uncharge some anonymous memory to cgroup i */
+static void touch(int i)
+{
+	long psize = sysconf(_SC_PAGESIZE);
+	char *p;
+	int j;
+
+	enter(i);
+	p = mmap(NULL, TOUCH_PAGES * psize, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		die("mmap");
+	for (j = 0; j < TOUCH_PAGES; j++)
+		p[j * psize] = 1;
+	munmap(p, TOUCH_PAGES * psize);
+	enter(-1);
+}
+
+static void read_stat(int i)
+{
+	char path[PATH_MAX];
+	int fd;
+
+	cg_path(path, i, "memory.stat");
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		die(path);
+	while (read(fd, buf, sizeof(buf)) > 0)
+		;
+	close(fd);
+}
+
+static void setup(void)
+{
+	char path[PATH_MAX];
+	int i;
+
+	cg_path(path, -1, "");
+	if (mkdir(path, 0755) && errno != EEXIST)
+		die(path);
+	/* make the parent's total_* cover the children on v1 */
+	cg_path(path, -1, "memory.use_hierarchy");
+	if (access(path, F_OK) == 0)
+		write_file(path, "1");
+
+	for (i = 0; i < nr_cgroups; i++) {
+		cg_path(path, i, "");
+		if (mkdir(path, 0755) && errno != EEXIST)
+			die(path);
+		touch(i);
+	}
+}
+
+static void cleanup(void)
+{
+	char path[PATH_MAX];
+	int i;
+
+	for (i = 0; i < nr_cgroups; i++) {
+		cg_path(path, i, "");
+		if (rmdir(path))
+			perror(path);
+	}
+	cg_path(path, -1, "");
+	if (rmdir(path))
+		perror(path);
+}
+
+int main(int argc, char **argv)
+{
+	double leaves = 0, parent = 0, start;
+	int opt, l, i, next = 0;
+
+	while ((opt = getopt(argc, argv, "d:n:u:l:")) != -1) {
+		switch (opt) {
+		case 'd':
+			base = optarg;
+			break;
+		case 'n':
+			nr_cgroups = atoi(optarg);
+			break;
+		case 'u':
+			nr_updated = atoi(optarg);
+			break;
+		case 'l':
+			loops = atoi(optarg);
+			break;
+		default:
+			base = NULL;
+			break;
+		}
+	}
+	if (!base || nr_cgroups < 1 || loops < 1) {
+		fprintf(stderr, "usage: %s -d memcg_mount [-n cgroups] "
+			"[-u updated] [-l loops]\n", argv[0]);
+		return 1;
+	}
+
+	setup();
+
+	for (l = 0; l < loops; l++) {
+		for (i = 0; i < nr_updated; i++) {
+			touch(next);
+			next = (next + 1) % nr_cgroups;
+		}
+
+		start = now();
+		for (i = 0; i < nr_cgroups; i++)
+			read_stat(i);
+		leaves += now() - start;
+
+		start = now();
+		read_stat(-1);
+		parent += now() - start;
+	}
+
+	printf("%d cgroups, %d updated per pass, %ld cpus\n", nr_cgroups,
+	       nr_updated, sysconf(_SC_NPROCESSORS_CONF));
+	printf("%-24s %10.1f us/read\n", "memory.stat (leaf):",
+	       leaves * 1e6 / ((double)loops * nr_cgroups));
+	printf("%-24s %10.1f us/read\n", "memory.stat (parent):",
+	       parent * 1e6 / loops);
+	printf("%-24s %10.1f ms/pass\n", "all cgroups:",
+	       (leaves + parent) * 1e3 / loops);
+
+	cleanup();
+	return 0;
+}
@@ -0,0 +1,281 @@
+/*
+ * epoll wakeups of many epoll sets sharing a listening socket, and the
+ * cost of epoll_ctl() versus epoll_ctl_batch().
+ *
+ * Forks a number of workers that each have their own epoll set watching
+ * the same listening TCP socket on the loopback, like the worker processes
+ * of a web server, and makes a number of connections to it one after the
+ * other.  Workers accept with a non-blocking accept4(), so a wakeup that
+ * finds nothing to accept was wasted.  Runs with the default wakeups, with
+ * EPOLLEXCLUSIVE and with EPOLLROUNDROBIN, and reports the wakeups per
+ * connection and how evenly the connections were spread over the workers.
+ *
+ * Then adds and removes a number of eventfds to an epoll set, one by one
+ * with epoll_ctl() and in one go with epoll_ctl_batch(), and reports the
+ * time per fd.
+ *
+ * Fails if the exclusive wakeups take more than two wakeups per connection.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE	(1 << 28)
+#endif
+#ifndef EPOLLROUNDROBIN
+#define EPOLLROUNDROBIN	(1 << 27)
+#endif
+
+struct epoll_ctl_cmd {
+	int op;
+	int fd;
+	unsigned int events;
+	int result;
+	unsigned long long data;
+};
+
+#define MAX_WORKERS	1024
+
+static int nr_workers = 64;
+static int nr_conns = 10000;
+static int nr_fds = 1000;
+
+struct shared {
+	volatile int ready;
+	volatile int stop;
+	volatile long accepted;
+	long wakeups[MAX_WORKERS];
+	long accepts[MAX_WORKERS];
+};
+static struct shared *sh;
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void worker(int i, int lfd, unsigned int flags)
+{
+	struct epoll_event ev = { .events = EPOLLIN | flags };
+	int epfd;
+
+	epfd = epoll_create1(0);
+	if (epfd < 0)
+		die("epoll_create1");
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev))
+		die("epoll_ctl");
+	__sync_fetch_and_add(&sh->ready, 1);
+
+	while (!sh->stop) {
+		int fd;
+
+		if (epoll_wait(epfd, &ev, 1, 100) <= 0)
+			continue;
+		sh->wakeups[i]++;
+		while ((fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+			close(fd);
+			sh->accepts[i]++;
+			__sync_fetch_and_add(&sh->accepted, 1);
+		}
+	}
+	_exit(0);
+}
+
+/* returns the wakeups per connection */
+static double run_wakeups(const char *name, unsigned int flags)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t len = sizeof(addr);
+	long wakeups = 0, min = -1, max = 0;
+	int lfd, i;
+
+	lfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (lfd < 0)
+		die("socket");
+	if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    listen(lfd, 1024) ||
+	    getsockname(lfd, (struct sockaddr *)&addr, &len))
+		die("listen");
+
+	memset(sh, 0, sizeof(*sh));
+	for (i = 0; i < nr_workers; i++) {
+		pid_t pid = fork();
+
+		if (pid < 0)
+			die("fork");
+		if (!pid)
+			worker(i, lfd, flags);
+	}
+	while (sh->ready < nr_workers)
+		usleep(1000);
+
+	for (i = 0; i < nr_conns; i++) {
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+		if (fd < 0)
+			die("socket");
+		if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)))
+			die("connect");
+		close(fd);
+		/* one connection at a time, so each one is one event */
+		while (sh->accepted <= i)
+			sched_yield();
+	}
+	sh->stop = 1;
+	while (wait(NULL) > 0)
+		;
+	close(lfd);
+
+	for (i = 0; i < nr_workers; i++) {
+		wakeups += sh->wakeups[i];
+		if (min < 0 || sh->accepts[i] < min)
+			min = sh->accepts[i];
+		if (sh->accepts[i] > max)
+			max = sh->accepts[i];
+	}
+	printf("%-16s %8.2f wakeups/conn, accepts per worker min %ld max %ld\n",
+	       name, (double)wakeups / nr_conns, min, max);
+	return (double)wakeups / nr_conns;
+}
+
+static void run_ctl(void)
+{
+	struct epoll_ctl_cmd *cmds;
+	double start, single;
+	int epfd, *fds, i, op;
+
+	epfd = epoll_create1(0);
+	fds = calloc(nr_fds, sizeof(*fds));
+	cmds = calloc(nr_fds, sizeof(*cmds));
+	if (epfd < 0 || !fds || !cmds)
+		die("setup");
+	for (i = 0; i < nr_fds; i++) {
+		fds[i] = eventfd(0, 0);
+		if (fds[i] < 0)
+			die("eventfd");
+	}
+
+	start = now();
+	for (op = EPOLL_CTL_ADD; op <= EPOLL_CTL_DEL; op++) {
+		for (i = 0; i < nr_fds; i++) {
+			struct epoll_event ev = { .events = EPOLLIN };
+
+			if (epoll_ctl(epfd, op, fds[i], &ev))
+				die("epoll_ctl");
+		}
+	}
+	single = now() - start;
+	printf("%-16s %8.0f ns/fd\n", "epoll_ctl:", single * 1e9 / nr_fds);
+
+#ifdef __NR_epoll_ctl_batch
+	start = now();
+	for (op = EPOLL_CTL_ADD; op <= EPOLL_CTL_DEL; op++) {
+		for (i = 0; i < nr_fds; i++) {
+			cmds[i].op = op;
+			cmds[i].fd = fds[i];
+			cmds[i].events = EPOLLIN;
+		}
+		for (i = 0; i < nr_fds; ) {
+			int n = nr_fds - i < 1024 ? nr_fds - i : 1024;
+			long ret = syscall(__NR_epoll_ctl_batch, epfd, 0, n,
+					   cmds + i);
+
+			if (ret < 0)
+				die("epoll_ctl_batch");
+			if (ret < n) {
+				errno = -cmds[i + ret].result;
+				die("epoll_ctl_batch command");
+			}
+			i += n;
+		}
+	}
+	printf("%-16s %8.0f ns/fd\n", "epoll_ctl_batch:",
+	       (now() - start) * 1e9 / nr_fds);
+#else
+	printf("epoll_ctl_batch: no syscall number for this architecture\n");
+#endif
+
+	for (i = 0; i < nr_fds; i++)
+		close(fds[i]);
+	free(cmds);
+	free(fds);
+	close(epfd);
+}
+
+int main(int argc, char **argv)
+{
+	double exclusive;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "w:c:f:")) != -1) {
+		switch (opt) {
+		case 'w':
+			nr_workers = atoi(optarg);
+			break;
+		case 'c':
+			nr_conns = atoi(optarg);
+			break;
+		case 'f':
+			nr_fds = atoi(optarg);
+			break;
+		default:
+			nr_workers = 0;
+			break;
+		}
+	}
+	if (nr_workers < 1 || nr_workers > MAX_WORKERS || nr_conns < 1 ||
+	    nr_fds < 1) {
+		fprintf(stderr, "usage: %s [-w workers] [-c connections] "
+			"[-f fds]\n", argv[0]);
+		return 1;
+	}
+
+	sh = mmap(NULL, sizeof(*sh), PROT_READ | PROT_WRITE,
+		  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (sh == MAP_FAILED)
+		die("mmap");
+
+	run_wakeups("default:", 0);
+	exclusive = run_wakeups("exclusive:", EPOLLEXCLUSIVE);
+	run_wakeups("round-robin:", EPOLLROUNDROBIN);
+	run_ctl();
+
+	if (exclusive > 2) {
+		printf("FAIL: %.2f wakeups per connection with EPOLLEXCLUSIVE\n",
+		       exclusive);
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
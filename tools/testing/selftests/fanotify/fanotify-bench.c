@@ -0,0 +1,329 @@
+/*
+ * Watching a large directory tree: inotify vs. fanotify.
+ *
+ * Builds a tree of many directories (a million by default) and for each
+ * notification API measures:
+ *  - the time and slab memory it takes to start watching the whole tree,
+ *    one watch per directory for inotify, one filesystem mark for fanotify
+ *    in FAN_REPORT_FID mode,
+ *  - the time to create and remove a file in every directory while
+ *    draining the events, and how many events and read() calls that took.
+ *
+ * The tree is created below the given directory, which must live on a
+ * filesystem that supports file handles (ext4, xfs, btrfs...).  fanotify
+ * watches that whole filesystem, so other activity on it shows up too.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <sys/fanotify.h>
+
+#ifndef FAN_MOVED_FROM
+#define FAN_MOVED_FROM		0x00000040
+#define FAN_MOVED_TO		0x00000080
+#define FAN_CREATE		0x00000100
+#define FAN_DELETE		0x00000200
+#endif
+#ifndef FAN_REPORT_FID
+#define FAN_REPORT_FID		0x00000200
+#endif
+#ifndef FAN_MARK_FILESYSTEM
+#define FAN_MARK_FILESYSTEM	0x00000100
+#endif
+
+#define FANOUT		1000
+#define DRAIN_EVERY	256
+
+static int nr_dirs = 1000000;
+static char *base;
+static char buf[256 << 10] __attribute__((aligned(8)));
+
+struct result {
+	double setup;
+	long slab_kb;
+	double run;
+	long events;
+	long reads;
+};
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long slab_kb(void)
+{
+	char line[256];
+	long kb = -1;
+	FILE *f;
+
+	f = fopen("/proc/meminfo", "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "Slab: %ld kB", &kb) == 1)
+			break;
+	fclose(f);
+	return kb;
+}
+
+/* directory i lives at base/t/d<i / FANOUT>/d<i % FANOUT> */
+static void dir_path(char *path, int i)
+{
+	snprintf(path, PATH_MAX, "%s/t/d%d/d%d", base, i / FANOUT, i % FANOUT);
+}
+
+static void top_path(char *path, int i)
+{
+	snprintf(path, PATH_MAX, "%s/t/d%d", base, i);
+}
+
+static int nr_top(void)
+{
+	return (nr_dirs + FANOUT - 1) / FANOUT;
+}
+
+static void make_tree(void)
+{
+	char path[PATH_MAX];
+	double start = now();
+	int i;
+
+	snprintf(path, sizeof(path), "%s/t", base);
+	if (mkdir(path, 0755) && errno != EEXIST)
+		die(path);
+	for (i = 0; i < nr_top(); i++) {
+		top_path(path, i);
+		if (mkdir(path, 0755) && errno != EEXIST)
+			die(path);
+	}
+	for (i = 0; i < nr_dirs; i++) {
+		dir_path(path, i);
+		if (mkdir(path, 0755) && errno != EEXIST)
+			die(path);
+	}
+	sync();
+	printf("%d directories under %s/t, created in %.1f s\n", nr_dirs, base,
+	       now() - start);
+}
+
+static void remove_tree(void)
+{
+	char cmd[PATH_MAX + 16];
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s/t", base);
+	if (system(cmd))
+		fprintf(stderr, "failed to remove %s/t\n", base);
+}
+
+static long drain_inotify(int fd, struct result *res)
+{
+	struct inotify_event *ev;
+	ssize_t len;
+	char *p;
+
+	while ((len = read(fd, buf, sizeof(buf))) > 0) {
+		res->reads++;
+		for (p = buf; p < buf + len; p += sizeof(*ev) + ev->len) {
+			ev = (struct inotify_event *)p;
+			if (ev->mask & IN_Q_OVERFLOW)
+				fprintf(stderr, "inotify queue overflow\n");
+			res->events++;
+		}
+	}
+	if (len < 0 && errno != EAGAIN)
+		die("read inotify");
+	return res->events;
+}
+
+static long drain_fanotify(int fd, struct result *res)
+{
+	struct fanotify_event_metadata *md;
+	ssize_t len;
+
+	while ((len = read(fd, buf, sizeof(buf))) > 0) {
+		res->reads++;
+		for (md = (void *)buf; FAN_EVENT_OK(md, len);
+		     md = FAN_EVENT_NEXT(md, len)) {
+			if (md->mask & FAN_Q_OVERFLOW)
+				fprintf(stderr, "fanotify queue overflow\n");
+			if (md->fd >= 0)
+				close(md->fd);
+			res->events++;
+		}
+	}
+	if (len < 0 && errno != EAGAIN)
+		die("read fanotify");
+	return res->events;
+}
+
+/* create and remove a file in every directory, draining as we go */
+static void workload(int fd, long (*drain)(int, struct result *),
+		     struct result *res)
+{
+	char path[PATH_MAX + 4];
+	double start = now();
+	int i, f;
+
+	for (i = 0; i < nr_dirs; i++) {
+		dir_path(path, i);
+		strcat(path, "/f");
+		f = open(path, O_CREAT | O_WRONLY, 0644);
+		if (f < 0)
+			die(path);
+		close(f);
+		if (unlink(path))
+			die(path);
+		if (i % DRAIN_EVERY == DRAIN_EVERY - 1)
+			drain(fd, res);
+	}
+	/* let the last events trickle in */
+	usleep(100000);
+	drain(fd, res);
+	res->run = now() - start;
+}
+
+static void set_max_watches(void)
+{
+	char val[32];
+	int fd, len;
+
+	fd = open("/proc/sys/fs/inotify/max_user_watches", O_WRONLY);
+	if (fd < 0)
+		return;
+	len = snprintf(val, sizeof(val), "%d\n", nr_dirs + nr_top() + 16);
+	if (write(fd, val, len) != len)
+		perror("max_user_watches");
+	close(fd);
+}
+
+static void bench_inotify(struct result *res)
+{
+	char path[PATH_MAX];
+	uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVE;
+	double start;
+	long slab;
+	int fd, i;
+
+	set_max_watches();
+	sync();
+	slab = slab_kb();
+	start = now();
+
+	fd = inotify_init1(IN_NONBLOCK);
+	if (fd < 0)
+		die("inotify_init1");
+	snprintf(path, sizeof(path), "%s/t", base);
+	if (inotify_add_watch(fd, path, mask) < 0)
+		die(path);
+	for (i = 0; i < nr_top(); i++) {
+		top_path(path, i);
+		if (inotify_add_watch(fd, path, mask) < 0)
+			die(path);
+	}
+	for (i = 0; i < nr_dirs; i++) {
+		dir_path(path, i);
+		if (inotify_add_watch(fd, path, mask) < 0)
+			die(path);
+	}
+
+	res->setup = now() - start;
+	res->slab_kb = slab_kb() - slab;
+	workload(fd, drain_inotify, res);
+	close(fd);
+}
+
+static void bench_fanotify(struct result *res)
+{
+	uint64_t mask = FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM |
+			FAN_MOVED_TO | FAN_ONDIR;
+	double start;
+	long slab;
+	int fd;
+
+	sync();
+	slab = slab_kb();
+	start = now();
+
+	fd = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_FID | FAN_NONBLOCK,
+			   O_RDONLY);
+	if (fd < 0)
+		die("fanotify_init");
+	if (fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, mask,
+			  AT_FDCWD, base))
+		die("fanotify_mark");
+
+	res->setup = now() - start;
+	res->slab_kb = slab_kb() - slab;
+	workload(fd, drain_fanotify, res);
+	close(fd);
+}
+
+static void report(const char *name, struct result *res)
+{
+	printf("%-10s %10.1f %10ld %10.1f %10ld %10ld\n", name,
+	       res->setup * 1e3, res->slab_kb, res->run * 1e3, res->events,
+	       res->reads);
+}
+
+int main(int argc, char **argv)
+{
+	struct result ino = { }, fan = { };
+	int opt, keep = 0;
+
+	while ((opt = getopt(argc, argv, "d:n:k")) != -1) {
+		switch (opt) {
+		case 'd':
+			base = optarg;
+			break;
+		case 'n':
+			nr_dirs = atoi(optarg);
+			break;
+		case 'k':
+			keep = 1;
+			break;
+		default:
+			base = NULL;
+			break;
+		}
+	}
+	if (!base || nr_dirs < 1) {
+		fprintf(stderr, "usage: %s -d dir [-n dirs] [-k]\n", argv[0]);
+		return 1;
+	}
+
+	make_tree();
+	bench_inotify(&ino);
+	bench_fanotify(&fan);
+
+	printf("%-10s %10s %10s %10s %10s %10s\n", "", "setup ms",
+	       "slab kB", "run ms", "events", "reads");
+	report("inotify", &ino);
+	report("fanotify", &fan);
+
+	if (!keep)
+		remove_tree();
+	return 0;
+}
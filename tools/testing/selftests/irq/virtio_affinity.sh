@@ -0,0 +1,199 @@
+#!/bin/bash
+# Checks that multiqueue virtio devices spread their queue interrupts over
+# the cpus and use the same spreading for the cpu -> queue mapping.  Meant
+# to be run in a QEMU guest with several vcpus, ideally on more than one
+# NUMA node, e.g.
+#
+#	qemu-system-x86_64 -enable-kvm -smp 8 -m 4G \
+#		-numa node,cpus=0-3 -numa node,cpus=4-7 \
+#		-drive if=none,id=d0,file=disk.img \
+#		-device virtio-blk-pci,drive=d0,num-queues=4 \
+#		-netdev tap,id=n0,vhost=on,queues=4 \
+#		-device virtio-net-pci,netdev=n0,mq=on,vectors=10 ...
+#
+# For virtio-blk, the cpus of each hardware context must be in the affinity
+# of the queue's interrupt.  For virtio-net, the cpus transmitting on a
+# queue (XPS) must be the ones handling its interrupts.  With at least as
+# many queues as nodes, no queue may span more than one node.
+
+ret=0
+
+if [ $(id -u) != 0 ]; then
+	echo "virtio_affinity: must be run as root" >&2
+	exit 0
+fi
+
+# "0-2,5" -> "0 1 2 5"
+expand_list()
+{
+	local out="" range
+
+	for range in ${1//,/ }; do
+		if [ "${range#*-}" != "$range" ]; then
+			out="$out $(seq ${range%-*} ${range#*-})"
+		else
+			out="$out $range"
+		fi
+	done
+	echo $out
+}
+
+# "00000000,0000000f" -> "0 1 2 3"
+expand_mask()
+{
+	local mask=${1//,/} out="" cpu=0 i digit bit
+
+	for (( i = ${#mask} - 1; i >= 0; i-- )); do
+		digit=$(( 16#${mask:$i:1} ))
+		for bit in 0 1 2 3; do
+			if (( digit & (1 << bit) )); then
+				out="$out $cpu"
+			fi
+			cpu=$(( cpu + 1 ))
+		done
+	done
+	echo $out
+}
+
+online_only()
+{
+	local cpu out=""
+
+	for cpu in $*; do
+		if [ ! -f /sys/devices/system/cpu/cpu$cpu/online ] ||
+		   [ "$(cat /sys/devices/system/cpu/cpu$cpu/online)" = 1 ]; then
+			out="$out $cpu"
+		fi
+	done
+	echo $out
+}
+
+cpu_node()
+{
+	local node
+
+	node=$(ls -d /sys/devices/system/cpu/cpu$1/node* 2>/dev/null)
+	echo ${node##*node}
+}
+
+nr_nodes()
+{
+	ls -d /sys/devices/system/node/node* 2>/dev/null | wc -l
+}
+
+# irq number of the interrupt named e.g. "virtio0-req.1"
+find_irq()
+{
+	awk -v name="$1" '$NF == name { sub(":", "", $1); print $1 }' \
+		/proc/interrupts
+}
+
+subset()
+{
+	local cpu
+
+	for cpu in $1; do
+		case " $2 " in
+		*" $cpu "*) ;;
+		*) return 1 ;;
+		esac
+	done
+	return 0
+}
+
+check_node_local()
+{
+	local name=$1 cpus=$2 cpu node first=""
+
+	for cpu in $cpus; do
+		node=$(cpu_node $cpu)
+		[ -z "$first" ] && first=$node
+		if [ "$node" != "$first" ]; then
+			echo "virtio_affinity: [FAIL] $name spans nodes $first and $node"
+			ret=1
+			return
+		fi
+	done
+}
+
+check_blk()
+{
+	local disk=$1 vdev nr hctx queue irq aff cpus checked=0
+
+	vdev=$(basename $(readlink -f /sys/block/$disk/device))
+	nr=$(ls -d /sys/block/$disk/mq/* | wc -l)
+
+	for hctx in /sys/block/$disk/mq/*; do
+		queue=${hctx##*/}
+		irq=$(find_irq $vdev-req.$queue)
+		if [ -z "$irq" ]; then
+			echo "virtio_affinity: SKIP $disk, no per queue vectors"
+			return
+		fi
+		aff=$(expand_list $(cat /proc/irq/$irq/smp_affinity_list))
+		cpus=$(expand_list $(cat $hctx/cpu_list))
+
+		if ! subset "$cpus" "$aff"; then
+			echo "virtio_affinity: [FAIL] $disk hctx $queue cpus ($cpus) outside irq $irq affinity ($aff)"
+			ret=1
+		fi
+		[ $nr -ge $(nr_nodes) ] && check_node_local "$disk irq $irq" "$aff"
+		checked=$(( checked + 1 ))
+	done
+	echo "virtio_affinity: $disk, $checked queues checked"
+}
+
+check_net()
+{
+	local dev=$1 vdev nr txq queue irq aff xps checked=0
+
+	vdev=$(basename $(readlink -f /sys/class/net/$dev/device))
+	nr=$(ls -d /sys/class/net/$dev/queues/tx-* | wc -l)
+	if [ $nr -lt 2 ]; then
+		echo "virtio_affinity: SKIP $dev, single queue"
+		return
+	fi
+
+	for txq in /sys/class/net/$dev/queues/tx-*; do
+		queue=${txq##*tx-}
+		irq=$(find_irq $vdev-output.$queue)
+		if [ -z "$irq" ]; then
+			echo "virtio_affinity: SKIP $dev, no per queue vectors"
+			return
+		fi
+		# Only the enabled queue pairs are spread
+		xps=$(expand_mask $(cat $txq/xps_cpus))
+		[ -z "$xps" ] && continue
+
+		aff=$(online_only $(expand_list $(cat /proc/irq/$irq/smp_affinity_list)))
+		xps=$(online_only $xps)
+		if [ "$aff" != "$xps" ]; then
+			echo "virtio_affinity: [FAIL] $dev tx-$queue xps ($xps) != irq $irq affinity ($aff)"
+			ret=1
+		fi
+		[ $nr -ge $(nr_nodes) ] && check_node_local "$dev irq $irq" "$aff"
+		checked=$(( checked + 1 ))
+	done
+	echo "virtio_affinity: $dev, $checked queues checked"
+}
+
+found=0
+for disk in /sys/block/vd*; do
+	[ -d $disk/mq ] || continue
+	check_blk ${disk##*/}
+	found=1
+done
+
+for dev in /sys/class/net/*; do
+	[ "$(readlink -f $dev/device/driver)" = /sys/bus/virtio/drivers/virtio_net ] || continue
+	check_net ${dev##*/}
+	found=1
+done
+
+if [ $found = 0 ]; then
+	echo "virtio_affinity: SKIP, no virtio-blk or virtio-net device"
+	exit 0
+fi
+
+[ $ret = 0 ] && echo "virtio_affinity: [PASS]"
+exit $ret
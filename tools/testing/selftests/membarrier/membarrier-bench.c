@@ -0,0 +1,184 @@
+/*
+ * membarrier() versus signals as the slow side of an asymmetric barrier.
+ *
+ * Runs a number of threads spinning in user-space, like the readers of a
+ * user-space RCU, and reports the time it takes another thread to order
+ * itself against all of them:
+ *  - by sending each one a signal whose handler issues a full barrier,
+ *    and waiting for all the handlers to run,
+ *  - with membarrier(MEMBARRIER_CMD_SHARED),
+ *  - with membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED).
+ *
+ * Fails if the expedited membarrier() is slower than the signals.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/membarrier.h>
+
+static int nr_threads;
+static int nr_loops = 10000;
+
+static pthread_t *threads;
+static volatile int stop;
+static volatile long acks;
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void barrier_handler(int sig)
+{
+	__sync_synchronize();
+	__sync_fetch_and_add(&acks, 1);
+}
+
+static void *reader_fn(void *arg)
+{
+	while (!stop)
+		;
+	return NULL;
+}
+
+static void signal_barrier(void)
+{
+	long target = acks + nr_threads;
+	int i;
+
+	__sync_synchronize();
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_kill(threads[i], SIGUSR1))
+			die("pthread_kill");
+	}
+	while (acks < target)
+		sched_yield();
+	__sync_synchronize();
+}
+
+#ifdef __NR_membarrier
+static void shared_barrier(void)
+{
+	if (syscall(__NR_membarrier, MEMBARRIER_CMD_SHARED, 0))
+		die("membarrier");
+}
+
+static void expedited_barrier(void)
+{
+	if (syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0))
+		die("membarrier");
+}
+#endif
+
+/* returns the time per barrier in microseconds */
+static double run(const char *name, void (*fn)(void), int loops)
+{
+	double start, us;
+	int i;
+
+	start = now();
+	for (i = 0; i < loops; i++)
+		fn();
+	us = (now() - start) * 1e6 / loops;
+	printf("%-20s %10.2f us/barrier\n", name, us);
+	return us;
+}
+
+int main(int argc, char **argv)
+{
+	struct sigaction sa;
+	double signals;
+	int opt, i;
+
+	nr_threads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	while ((opt = getopt(argc, argv, "t:l:")) != -1) {
+		switch (opt) {
+		case 't':
+			nr_threads = atoi(optarg);
+			break;
+		case 'l':
+			nr_loops = atoi(optarg);
+			break;
+		default:
+			nr_loops = 0;
+			break;
+		}
+	}
+	if (nr_threads < 1)
+		nr_threads = 1;
+	if (nr_loops < 1) {
+		fprintf(stderr, "usage: %s [-t threads] [-l loops]\n", argv[0]);
+		return 1;
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = barrier_handler;
+	sa.sa_flags = SA_RESTART;
+	if (sigaction(SIGUSR1, &sa, NULL))
+		die("sigaction");
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!threads)
+		die("calloc");
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_create(&threads[i], NULL, reader_fn, NULL))
+			die("pthread_create");
+	}
+
+	signals = run("signals:", signal_barrier, nr_loops);
+#ifdef __NR_membarrier
+	{
+		int cmds = syscall(__NR_membarrier, MEMBARRIER_CMD_QUERY, 0);
+
+		if (cmds < 0)
+			cmds = 0;
+		if (cmds & MEMBARRIER_CMD_SHARED)
+			/* a grace period each, keep it short */
+			run("membarrier shared:", shared_barrier,
+			    nr_loops / 100 ? nr_loops / 100 : 1);
+		if (cmds & MEMBARRIER_CMD_PRIVATE_EXPEDITED) {
+			double expedited;
+
+			expedited = run("membarrier expedited:",
+					expedited_barrier, nr_loops);
+			if (expedited > signals) {
+				printf("FAIL: expedited membarrier slower than signals\n");
+				stop = 1;
+				return 1;
+			}
+		} else {
+			printf("membarrier expedited: not supported\n");
+		}
+	}
+#else
+	printf("membarrier: no syscall number for this architecture\n");
+#endif
+
+	stop = 1;
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+	printf("PASS\n");
+	return 0;
+}
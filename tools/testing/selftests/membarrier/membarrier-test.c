@@ -0,0 +1,135 @@
+/*
+ * membarrier() commands and ordering.
+ *
+ * Checks the commands reported by MEMBARRIER_CMD_QUERY and the error cases
+ * of invalid commands and flags.  Then runs the store buffering pattern
+ * between a thread that only has a compiler barrier between its store and
+ * its load and one that has membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED)
+ * instead, and fails if both loads ever miss the other thread's store.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/membarrier.h>
+
+#define barrier()	__asm__ __volatile__("" : : : "memory")
+
+static int nr_loops = 100000;
+
+static volatile int go, done, x, y, r1;
+static int failed;
+
+static int sys_membarrier(int cmd, int flags)
+{
+#ifdef __NR_membarrier
+	return syscall(__NR_membarrier, cmd, flags);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static void check(int cond, const char *what)
+{
+	if (!cond) {
+		printf("FAIL: %s\n", what);
+		failed = 1;
+	}
+}
+
+static void *reader_fn(void *arg)
+{
+	int i;
+
+	for (i = 1; i <= nr_loops; i++) {
+		while (go != i)
+			;
+		x = 1;
+		barrier();
+		r1 = y;
+		done = i;
+	}
+	return NULL;
+}
+
+static void run_store_buffering(void)
+{
+	pthread_t reader;
+	int i, r2, missed = 0;
+
+	if (pthread_create(&reader, NULL, reader_fn, NULL)) {
+		perror("pthread_create");
+		exit(1);
+	}
+	for (i = 1; i <= nr_loops; i++) {
+		x = 0;
+		y = 0;
+		__sync_synchronize();
+		go = i;
+		y = 1;
+		if (sys_membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0)) {
+			perror("membarrier");
+			exit(1);
+		}
+		r2 = x;
+		while (done != i)
+			;
+		if (!r1 && !r2)
+			missed++;
+	}
+	pthread_join(reader, NULL);
+
+	if (missed) {
+		printf("FAIL: both stores missed in %d of %d runs\n", missed,
+		       nr_loops);
+		failed = 1;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int cmds;
+
+	cmds = sys_membarrier(MEMBARRIER_CMD_QUERY, 0);
+	if (cmds < 0) {
+		if (errno == ENOSYS) {
+			printf("membarrier: not supported by this kernel\n");
+			return 0;
+		}
+		perror("membarrier");
+		return 1;
+	}
+
+	check(sys_membarrier(MEMBARRIER_CMD_QUERY, 1) < 0 && errno == EINVAL,
+	      "non-zero flags return EINVAL");
+	check(sys_membarrier(1 << 30, 0) < 0 && errno == EINVAL,
+	      "unknown command returns EINVAL");
+	if (cmds & MEMBARRIER_CMD_SHARED)
+		check(!sys_membarrier(MEMBARRIER_CMD_SHARED, 0),
+		      "MEMBARRIER_CMD_SHARED");
+	else
+		printf("MEMBARRIER_CMD_SHARED: not supported\n");
+
+	if (cmds & MEMBARRIER_CMD_PRIVATE_EXPEDITED) {
+		check(!sys_membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0),
+		      "MEMBARRIER_CMD_PRIVATE_EXPEDITED");
+		if (sysconf(_SC_NPROCESSORS_ONLN) > 1)
+			run_store_buffering();
+	} else {
+		printf("MEMBARRIER_CMD_PRIVATE_EXPEDITED: not supported\n");
+	}
+
+	if (failed)
+		return 1;
+	printf("PASS\n");
+	return 0;
+}
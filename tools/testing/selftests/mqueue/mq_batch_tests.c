@@ -0,0 +1,310 @@
+/*
+ * POSIX message queue ordering, throughput and latency.
+ *
+ * Checks that messages of mixed priorities come out highest priority first
+ * and in FIFO order within a priority, with mq_receive() and with
+ * mq_timedreceive_batch().
+ *
+ * Then has a child process send a number of messages to the parent, one
+ * per mq_send() and in batches with mq_timedsend_batch() and
+ * mq_timedreceive_batch(), and reports the messages per second, and bounces
+ * one message back and forth between the two and reports the round trip
+ * time.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <mqueue.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+struct mq_batch_msg {
+	unsigned long long msg_ptr;
+	unsigned long long msg_len;
+	unsigned int msg_prio;
+	unsigned int __reserved;
+};
+
+#define MAX_BATCH	256
+#define MSG_SIZE	64
+
+static int nr_msgs = 200000;
+/* the default mq_maxmsg limit for unprivileged users is 10 */
+static int batch = 10;
+static int nr_trips = 20000;
+static int failed;
+
+static const char *q_ping = "/mq_batch_tests_ping";
+static const char *q_pong = "/mq_batch_tests_pong";
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static mqd_t open_queue(const char *name, int flags, long maxmsg)
+{
+	struct mq_attr attr = { .mq_maxmsg = maxmsg, .mq_msgsize = MSG_SIZE };
+	mqd_t mq;
+
+	mq_unlink(name);
+	mq = mq_open(name, O_RDWR | O_CREAT | flags, 0600, &attr);
+	if (mq == (mqd_t)-1)
+		die("mq_open");
+	return mq;
+}
+
+#ifdef __NR_mq_timedsend_batch
+static int send_batch(mqd_t mq, char bufs[][MSG_SIZE], unsigned int *prios,
+		      int n)
+{
+	struct mq_batch_msg msgs[MAX_BATCH];
+	int i, sent = 0;
+
+	for (i = 0; i < n; i++) {
+		msgs[i].msg_ptr = (unsigned long)bufs[i];
+		msgs[i].msg_len = MSG_SIZE;
+		msgs[i].msg_prio = prios ? prios[i] : 0;
+		msgs[i].__reserved = 0;
+	}
+	while (sent < n) {
+		long ret = syscall(__NR_mq_timedsend_batch, mq, msgs + sent,
+				   n - sent, 0, NULL);
+
+		if (ret < 0)
+			die("mq_timedsend_batch");
+		sent += ret;
+	}
+	return sent;
+}
+
+static int receive_batch(mqd_t mq, char bufs[][MSG_SIZE], unsigned int *prios,
+			 int n)
+{
+	struct mq_batch_msg msgs[MAX_BATCH];
+	long ret;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		msgs[i].msg_ptr = (unsigned long)bufs[i];
+		msgs[i].msg_len = MSG_SIZE;
+		msgs[i].__reserved = 0;
+	}
+	ret = syscall(__NR_mq_timedreceive_batch, mq, msgs, n, 0, NULL);
+	if (ret < 0)
+		die("mq_timedreceive_batch");
+	for (i = 0; i < ret; i++) {
+		if (msgs[i].msg_len != MSG_SIZE) {
+			printf("FAIL: batch message %d has %llu bytes\n", i,
+			       msgs[i].msg_len);
+			exit(1);
+		}
+		if (prios)
+			prios[i] = msgs[i].msg_prio;
+	}
+	return ret;
+}
+#endif
+
+/* sends prio/seq pairs and checks they come out in order */
+static void check_order(int use_batch)
+{
+	static const unsigned int prio_of[] = { 3, 0, 7, 3, 1, 7, 0, 2, 7, 3 };
+	int n = sizeof(prio_of) / sizeof(prio_of[0]);
+	char bufs[MAX_BATCH][MSG_SIZE];
+	unsigned int prios[MAX_BATCH];
+	unsigned int last_prio = ~0U;
+	int last_seq = -1, i, got;
+	mqd_t mq;
+
+	mq = open_queue(q_ping, O_NONBLOCK, n);
+	for (i = 0; i < n; i++) {
+		snprintf(bufs[i], MSG_SIZE, "%d", i);
+		if (mq_send(mq, bufs[i], MSG_SIZE, prio_of[i]))
+			die("mq_send");
+	}
+
+	memset(bufs, 0, sizeof(bufs));
+#ifdef __NR_mq_timedsend_batch
+	if (use_batch) {
+		got = receive_batch(mq, bufs, prios, n);
+	} else
+#endif
+	{
+		for (got = 0; got < n; got++)
+			if (mq_receive(mq, bufs[got], MSG_SIZE,
+				       &prios[got]) != MSG_SIZE)
+				die("mq_receive");
+	}
+	if (got != n) {
+		printf("FAIL: got %d of %d messages\n", got, n);
+		failed = 1;
+	}
+
+	for (i = 0; i < got; i++) {
+		int seq = atoi(bufs[i]);
+
+		if (prio_of[seq] != prios[i] || prios[i] > last_prio ||
+		    (prios[i] == last_prio && seq < last_seq)) {
+			printf("FAIL: %s message %d out of order (prio %u)\n",
+			       use_batch ? "batch" : "single", seq, prios[i]);
+			failed = 1;
+		}
+		last_prio = prios[i];
+		last_seq = seq;
+	}
+	mq_close(mq);
+	mq_unlink(q_ping);
+}
+
+static void run_throughput(const char *name, int use_batch)
+{
+	static char bufs[MAX_BATCH][MSG_SIZE];
+	double start;
+	int received = 0;
+	pid_t pid;
+	mqd_t mq;
+
+	mq = open_queue(q_ping, 0, 10);
+
+	start = now();
+	pid = fork();
+	if (pid < 0)
+		die("fork");
+	if (!pid) {
+		int sent = 0;
+
+		while (sent < nr_msgs) {
+#ifdef __NR_mq_timedsend_batch
+			if (use_batch) {
+				int n = nr_msgs - sent < batch ?
+					nr_msgs - sent : batch;
+
+				sent += send_batch(mq, bufs, NULL, n);
+				continue;
+			}
+#endif
+			if (mq_send(mq, bufs[0], MSG_SIZE, 0))
+				die("mq_send");
+			sent++;
+		}
+		_exit(0);
+	}
+
+	while (received < nr_msgs) {
+#ifdef __NR_mq_timedsend_batch
+		if (use_batch) {
+			received += receive_batch(mq, bufs, NULL, batch);
+			continue;
+		}
+#endif
+		if (mq_receive(mq, bufs[0], MSG_SIZE, NULL) != MSG_SIZE)
+			die("mq_receive");
+		received++;
+	}
+	waitpid(pid, NULL, 0);
+	printf("%-16s %10.0f msgs/s\n", name, nr_msgs / (now() - start));
+
+	mq_close(mq);
+	mq_unlink(q_ping);
+}
+
+static void run_latency(void)
+{
+	char buf[MSG_SIZE] = "";
+	mqd_t ping, pong;
+	double start;
+	pid_t pid;
+	int i;
+
+	ping = open_queue(q_ping, 0, 1);
+	pong = open_queue(q_pong, 0, 1);
+
+	pid = fork();
+	if (pid < 0)
+		die("fork");
+	if (!pid) {
+		for (i = 0; i < nr_trips; i++) {
+			if (mq_receive(ping, buf, MSG_SIZE, NULL) != MSG_SIZE ||
+			    mq_send(pong, buf, MSG_SIZE, 0))
+				die("echo");
+		}
+		_exit(0);
+	}
+
+	start = now();
+	for (i = 0; i < nr_trips; i++) {
+		if (mq_send(ping, buf, MSG_SIZE, 0) ||
+		    mq_receive(pong, buf, MSG_SIZE, NULL) != MSG_SIZE)
+			die("ping");
+	}
+	printf("%-16s %10.2f us/round trip\n", "latency:",
+	       (now() - start) * 1e6 / nr_trips);
+	waitpid(pid, NULL, 0);
+
+	mq_close(ping);
+	mq_close(pong);
+	mq_unlink(q_ping);
+	mq_unlink(q_pong);
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:b:t:")) != -1) {
+		switch (opt) {
+		case 'n':
+			nr_msgs = atoi(optarg);
+			break;
+		case 'b':
+			batch = atoi(optarg);
+			break;
+		case 't':
+			nr_trips = atoi(optarg);
+			break;
+		default:
+			nr_msgs = 0;
+			break;
+		}
+	}
+	if (nr_msgs < 1 || batch < 1 || batch > MAX_BATCH || nr_trips < 1) {
+		fprintf(stderr, "usage: %s [-n messages] [-b batch] "
+			"[-t round_trips]\n", argv[0]);
+		return 1;
+	}
+
+	check_order(0);
+	run_throughput("mq_send:", 0);
+#ifdef __NR_mq_timedsend_batch
+	check_order(1);
+	run_throughput("batch:", 1);
+#else
+	printf("mq_timedsend_batch: no syscall number for this architecture\n");
+#endif
+	run_latency();
+
+	if (failed)
+		return 1;
+	printf("PASS\n");
+	return 0;
+}
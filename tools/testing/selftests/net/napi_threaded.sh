@@ -0,0 +1,120 @@
+#!/bin/sh
+# Compares NAPI polling in NET_RX_SOFTIRQ with polling in per-napi kthreads
+# (/sys/class/net/<dev>/threaded).
+#
+# Without arguments only the sysfs interface is checked, on a veth pair:
+# veth delivers through netif_rx() and the per-cpu backlog, so it has no
+# napi contexts of its own and must refuse threaded mode.
+#
+# To benchmark, pass a NAPI capable receive device and the device pktgen
+# should transmit from, e.g. two ports cabled back to back:
+#
+#	./napi_threaded.sh eth1 eth2 [seconds]
+#
+# Receive throughput is reported for both modes.  With PING_ADDR set, the
+# round trip latency to that address is measured while pktgen is running.
+
+RX_DEV=$1
+TX_DEV=$2
+DURATION=${3:-10}
+PGDIR=/proc/net/pktgen
+
+if [ $(id -u) != 0 ]; then
+	echo "napi_threaded: must be run as root" >&2
+	exit 0
+fi
+
+check_sysfs()
+{
+	ip link add napi_veth0 type veth peer name napi_veth1 || return 0
+
+	if [ ! -f /sys/class/net/napi_veth0/threaded ]; then
+		echo "napi_threaded: SKIP, kernel without threaded napi"
+		ip link del napi_veth0
+		return 0
+	fi
+
+	ret=0
+	if echo 1 > /sys/class/net/napi_veth0/threaded 2>/dev/null; then
+		echo "napi_threaded: [FAIL] threaded mode accepted without napi"
+		ret=1
+	elif [ "$(cat /sys/class/net/napi_veth0/threaded)" != 0 ]; then
+		echo "napi_threaded: [FAIL] threaded mode reported without napi"
+		ret=1
+	else
+		echo "napi_threaded: sysfs ok"
+	fi
+
+	ip link del napi_veth0
+	return $ret
+}
+
+pgset()
+{
+	echo "$2" > $1
+}
+
+run_pktgen()
+{
+	modprobe -q pktgen
+	[ -d $PGDIR ] || { echo "napi_threaded: pktgen unavailable" >&2; exit 1; }
+
+	pgset $PGDIR/kpktgend_0 "rem_device_all"
+	pgset $PGDIR/kpktgend_0 "add_device $TX_DEV"
+	pgset $PGDIR/$TX_DEV "count 0"
+	pgset $PGDIR/$TX_DEV "clone_skb 64"
+	pgset $PGDIR/$TX_DEV "pkt_size 60"
+	pgset $PGDIR/$TX_DEV "delay 0"
+	pgset $PGDIR/$TX_DEV "dst 198.18.0.1"
+	pgset $PGDIR/$TX_DEV "dst_mac $(cat /sys/class/net/$RX_DEV/address)"
+
+	pgset $PGDIR/pgctrl "start" &
+}
+
+stop_pktgen()
+{
+	pgset $PGDIR/pgctrl "stop"
+	wait
+	pgset $PGDIR/kpktgend_0 "rem_device_all"
+}
+
+bench()
+{
+	mode=$1
+
+	echo $mode > /sys/class/net/$RX_DEV/threaded || exit 1
+	if [ $mode = 1 ]; then
+		echo "napi threads: $(pgrep -d ' ' "^napi/$RX_DEV-")"
+	fi
+
+	run_pktgen
+	sleep 1
+	start=$(cat /sys/class/net/$RX_DEV/statistics/rx_packets)
+	if [ -n "$PING_ADDR" ]; then
+		ping -q -c $((DURATION * 100)) -i 0.01 $PING_ADDR | tail -1
+	else
+		sleep $DURATION
+	fi
+	end=$(cat /sys/class/net/$RX_DEV/statistics/rx_packets)
+	stop_pktgen
+
+	printf "%-16s %12d pps\n" "threaded=$mode" $(((end - start) / DURATION))
+}
+
+if [ -z "$RX_DEV" ]; then
+	check_sysfs
+	exit $?
+fi
+
+if [ -z "$TX_DEV" ]; then
+	echo "usage: $0 <rx dev> <tx dev> [seconds]" >&2
+	exit 1
+fi
+
+ip link set $RX_DEV up
+ip link set $TX_DEV up
+
+old=$(cat /sys/class/net/$RX_DEV/threaded)
+bench 0
+bench 1
+echo $old > /sys/class/net/$RX_DEV/threaded
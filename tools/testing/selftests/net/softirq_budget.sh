@@ -0,0 +1,73 @@
+#!/bin/sh
+# Timer latency on a cpu flooded with NET_RX softirq work, with and without
+# per vector softirq budgets (/proc/sys/kernel/softirq_budget_us).
+#
+# pktgen transmits over a veth pair from cpu 0, so that the receive side
+# runs in NET_RX softirq on that same cpu, while timer_latency measures how
+# late a SCHED_FIFO task on cpu 0 wakes up.  With a budget of 0 NET_RX is
+# never deferred; with the default budget it is left to ksoftirqd once it
+# overruns, and the woken task no longer waits for it.
+#
+# usage: ./softirq_budget.sh [seconds]
+
+DURATION=${1:-10}
+PGDIR=/proc/net/pktgen
+BUDGET=/proc/sys/kernel/softirq_budget_us
+
+if [ $(id -u) != 0 ]; then
+	echo "softirq_budget: must be run as root" >&2
+	exit 0
+fi
+
+if [ ! -f $BUDGET ]; then
+	echo "softirq_budget: SKIP, kernel without softirq budgets"
+	exit 0
+fi
+
+modprobe -q pktgen
+if [ ! -d $PGDIR ]; then
+	echo "softirq_budget: SKIP, pktgen unavailable"
+	exit 0
+fi
+
+pgset()
+{
+	echo "$2" > $1
+}
+
+net_rx_defer()
+{
+	awk '$1 == "NET_RX_DEFER:" { print $2 }' /proc/softirqs
+}
+
+ip link add sb_veth0 type veth peer name sb_veth1 || exit 1
+ip link set sb_veth0 up
+ip link set sb_veth1 up
+
+old=$(cat $BUDGET)
+nr=$(echo $old | wc -w)
+
+pgset $PGDIR/kpktgend_0 "rem_device_all"
+pgset $PGDIR/kpktgend_0 "add_device sb_veth0"
+pgset $PGDIR/sb_veth0 "count 0"
+pgset $PGDIR/sb_veth0 "pkt_size 60"
+pgset $PGDIR/sb_veth0 "delay 0"
+pgset $PGDIR/sb_veth0 "dst 198.18.0.1"
+pgset $PGDIR/sb_veth0 "dst_mac $(cat /sys/class/net/sb_veth1/address)"
+
+for budget in 0 1000; do
+	echo $(yes $budget | head -n $nr) > $BUDGET
+
+	defer=$(net_rx_defer)
+	pgset $PGDIR/pgctrl "start" &
+	sleep 1
+	printf "%-16s " "budget=${budget}us"
+	./timer_latency 0 $DURATION
+	pgset $PGDIR/pgctrl "stop"
+	wait
+	printf "%-16s %d\n" "NET_RX deferred" $(($(net_rx_defer) - defer))
+done
+
+echo $old > $BUDGET
+pgset $PGDIR/kpktgend_0 "rem_device_all"
+ip link del sb_veth0
@@ -0,0 +1,82 @@
+/*
+ * Timer wakeup latency under softirq load.
+ *
+ * A SCHED_FIFO thread pinned to one cpu sleeps on a periodic absolute
+ * CLOCK_MONOTONIC deadline and records how late it woke up.  Run next to
+ * a softirq flood on the same cpu (see softirq_budget.sh), this shows how
+ * long softirq processing keeps the cpu from the woken task.
+ *
+ * usage: timer_latency [cpu] [seconds] [period_us]
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NSEC_PER_SEC	1000000000LL
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static long long ts_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+	int cpu = argc > 1 ? atoi(argv[1]) : 0;
+	int seconds = argc > 2 ? atoi(argv[2]) : 10;
+	long long period = (argc > 3 ? atoll(argv[3]) : 1000) * 1000;
+	struct sched_param param = { .sched_priority = 50 };
+	long long next, lat, max = 0, sum = 0, loops, i;
+	struct timespec ts, now;
+	cpu_set_t set;
+	int err;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set))
+		die("sched_setaffinity");
+	if (sched_setscheduler(0, SCHED_FIFO, &param))
+		die("sched_setscheduler");
+
+	loops = seconds * NSEC_PER_SEC / period;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	next = ts_ns(&ts);
+
+	for (i = 0; i < loops; i++) {
+		next += period;
+		ts.tv_sec = next / NSEC_PER_SEC;
+		ts.tv_nsec = next % NSEC_PER_SEC;
+
+		err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		if (err) {
+			errno = err;
+			die("clock_nanosleep");
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		lat = ts_ns(&now) - next;
+		sum += lat;
+		if (lat > max)
+			max = lat;
+	}
+
+	printf("%-16s avg %8lld us  max %8lld us\n", "timer latency",
+	       sum / loops / 1000, max / 1000);
+	return 0;
+}
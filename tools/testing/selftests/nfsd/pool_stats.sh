@@ -0,0 +1,116 @@
+#!/bin/sh
+# Push parallel I/O through nfsd over loopback and check that every
+# transport was picked up by a thread: the I/O must finish, the data
+# must read back intact, and /proc/fs/nfsd/pool_stats must account the
+# transports handled and the replies sent.  Needs root, the nfsd module
+# and nfs-utils (rpc.nfsd, exportfs, mount.nfs).
+#
+# usage: pool_stats.sh [writers]
+
+WRITERS=${1:-16}
+STATS=/proc/fs/nfsd/pool_stats
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "pool_stats: must be run as root [SKIP]"
+	exit 0
+fi
+for cmd in rpc.nfsd exportfs mount.nfs; do
+	if ! command -v $cmd > /dev/null; then
+		echo "pool_stats: $cmd not found [SKIP]"
+		exit 0
+	fi
+done
+
+modprobe nfsd 2> /dev/null
+if [ ! -e $STATS ]; then
+	mount -t nfsd nfsd /proc/fs/nfsd 2> /dev/null
+fi
+if [ ! -e $STATS ]; then
+	echo "pool_stats: no $STATS [SKIP]"
+	exit 0
+fi
+
+started=0
+if [ "$(cat /proc/fs/nfsd/threads)" -eq 0 ]; then
+	if ! rpc.nfsd 8 2> /dev/null; then
+		echo "pool_stats: rpc.nfsd failed [SKIP]"
+		exit 0
+	fi
+	started=1
+fi
+
+WORK=$(mktemp -d /tmp/nfsd-pool-stats.XXXXXX)
+cleanup()
+{
+	umount "$WORK/mnt" 2> /dev/null
+	exportfs -u "127.0.0.1:$WORK/export" 2> /dev/null
+	umount "$WORK/export" 2> /dev/null
+	[ $started -eq 1 ] && rpc.nfsd 0
+	rm -rf "$WORK"
+}
+trap cleanup EXIT
+mkdir "$WORK/export" "$WORK/mnt"
+mount -t tmpfs tmpfs "$WORK/export"
+exportfs -o rw,no_root_squash,insecure,fsid=$$ "127.0.0.1:$WORK/export"
+if ! mount -t nfs -o vers=3,hard,timeo=600 "127.0.0.1:$WORK/export" \
+		"$WORK/mnt"; then
+	echo "pool_stats: loopback mount failed [SKIP]"
+	exit 0
+fi
+
+# pool packets sockets woken timedout xprts wait-us requests service-us
+sum()
+{
+	awk '!/^#/ { if (NF != 9) bad = 1
+		     for (i = 2; i <= 9; i++) s[i] += $i }
+	     END { if (bad) { print "bad"; exit }
+		   print s[6], s[8], s[9] }' $STATS
+}
+
+before=$(sum)
+if [ "$before" = "bad" ]; then
+	echo "pool_stats: unexpected format of $STATS [FAIL]"
+	exit 1
+fi
+
+# Many small synchronous writes keep all threads waking up and going idle
+pids=
+i=0
+while [ $i -lt $WRITERS ]; do
+	timeout 300 dd if=/dev/urandom of="$WORK/mnt/f$i" bs=4k count=256 \
+		oflag=sync 2> /dev/null &
+	pids="$pids $!"
+	i=$((i + 1))
+done
+for pid in $pids; do
+	if ! wait $pid; then
+		echo "pool_stats: writes failed or hung [FAIL]"
+		exit 1
+	fi
+done
+
+umount "$WORK/mnt"
+mount -t nfs -o vers=3,hard,timeo=600 "127.0.0.1:$WORK/export" "$WORK/mnt"
+i=0
+while [ $i -lt $WRITERS ]; do
+	if ! timeout 300 cmp -s "$WORK/mnt/f$i" "$WORK/export/f$i"; then
+		echo "pool_stats: f$i differs or read hung [FAIL]"
+		exit 1
+	fi
+	i=$((i + 1))
+done
+
+after=$(sum)
+set -- $before $after
+xprts=$(($4 - $1))
+requests=$(($5 - $2))
+service_us=$(($6 - $3))
+echo "xprts-handled $xprts requests $requests service-us $service_us"
+
+# Every write is at least one request, with some service time
+if [ $requests -lt $((WRITERS * 256)) ] || [ $xprts -eq 0 ] ||
+   [ $service_us -eq 0 ]; then
+	echo "pool_stats: requests not accounted [FAIL]"
+	exit 1
+fi
+echo "pool_stats: [PASS]"
@@ -0,0 +1,218 @@
+/*
+ * Overlayfs deep layer stack benchmark.
+ *
+ * Builds an overlay with many lower layers, all files living in the
+ * bottom one, and times:
+ *  - lookups of names that exist only in the bottom layer,
+ *  - lookups of names that don't exist in any layer,
+ *  - chown of large lower files, which triggers copy up.
+ *
+ * Run once plain and once with -m (metacopy=on) to compare copy up cost.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/mount.h>
+
+static int nr_layers = 32;
+static int nr_files = 1000;
+static int nr_big = 8;
+static long big_size = 64 << 20;
+static int loops = 10;
+static int metacopy;
+
+static char base[] = "/tmp/ovl-bench-XXXXXX";
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void make_dir(const char *name)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s", base, name);
+	if (mkdir(path, 0755) && errno != EEXIST)
+		die(path);
+}
+
+static void make_file(int n, const char *prefix, long size)
+{
+	char path[PATH_MAX];
+	char buf[4096];
+	long done;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/l0/%s%d", base, prefix, n);
+	fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+	if (fd < 0)
+		die(path);
+	memset(buf, 'x', sizeof(buf));
+	for (done = 0; done < size; done += sizeof(buf))
+		if (write(fd, buf, sizeof(buf)) != sizeof(buf))
+			die("write");
+	close(fd);
+}
+
+static void setup(void)
+{
+	char opts[16384];
+	char path[PATH_MAX];
+	int len, i;
+
+	if (!mkdtemp(base))
+		die("mkdtemp");
+
+	for (i = 0; i < nr_layers; i++) {
+		snprintf(path, sizeof(path), "l%d", i);
+		make_dir(path);
+	}
+	make_dir("upper");
+	make_dir("work");
+	make_dir("mnt");
+
+	for (i = 0; i < nr_files; i++)
+		make_file(i, "f", 0);
+	for (i = 0; i < nr_big; i++)
+		make_file(i, "big", big_size);
+	sync();
+
+	len = snprintf(opts, sizeof(opts), "lowerdir=");
+	for (i = nr_layers - 1; i >= 0; i--)
+		len += snprintf(opts + len, sizeof(opts) - len, "%s/l%d%s",
+				base, i, i ? ":" : "");
+	snprintf(opts + len, sizeof(opts) - len,
+		 ",upperdir=%s/upper,workdir=%s/work%s",
+		 base, base, metacopy ? ",metacopy=on" : "");
+
+	snprintf(path, sizeof(path), "%s/mnt", base);
+	if (mount("overlay", path, "overlay", 0, opts))
+		die("mount overlay");
+}
+
+static void cleanup(void)
+{
+	char cmd[PATH_MAX + 16];
+
+	snprintf(cmd, sizeof(cmd), "%s/mnt", base);
+	umount2(cmd, MNT_DETACH);
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", base);
+	if (system(cmd))
+		fprintf(stderr, "failed to remove %s\n", base);
+}
+
+static void bench_lookup(const char *prefix, int expect)
+{
+	char path[PATH_MAX];
+	struct stat st;
+	double start;
+	int i, l, ret;
+
+	start = now();
+	for (l = 0; l < loops; l++) {
+		for (i = 0; i < nr_files; i++) {
+			snprintf(path, sizeof(path), "%s/mnt/%s%d",
+				 base, prefix, i);
+			ret = stat(path, &st);
+			if ((ret == 0) != expect)
+				die(path);
+		}
+	}
+	printf("%-24s %10.0f ns/lookup\n",
+	       expect ? "lookup (bottom layer):" : "lookup (missing):",
+	       (now() - start) * 1e9 / (loops * nr_files));
+}
+
+static void bench_chown(void)
+{
+	char path[PATH_MAX];
+	struct stat st;
+	double start;
+	int i;
+
+	start = now();
+	for (i = 0; i < nr_big; i++) {
+		snprintf(path, sizeof(path), "%s/mnt/big%d", base, i);
+		if (chown(path, 1, 1))
+			die(path);
+	}
+	printf("%-24s %10.3f ms/file\n", "chown copy up:",
+	       (now() - start) * 1e3 / nr_big);
+
+	/* Data must still be there, whatever way it was copied up */
+	snprintf(path, sizeof(path), "%s/mnt/big0", base);
+	if (stat(path, &st))
+		die(path);
+	if (st.st_size != big_size || st.st_uid != 1) {
+		fprintf(stderr, "big0: size %lld uid %d after chown\n",
+			(long long)st.st_size, st.st_uid);
+		exit(1);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "ml:f:b:s:n:")) != -1) {
+		switch (opt) {
+		case 'm':
+			metacopy = 1;
+			break;
+		case 'l':
+			nr_layers = atoi(optarg);
+			break;
+		case 'f':
+			nr_files = atoi(optarg);
+			break;
+		case 'b':
+			nr_big = atoi(optarg);
+			break;
+		case 's':
+			big_size = atol(optarg) << 20;
+			break;
+		case 'n':
+			loops = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-m] [-l layers] [-f files] "
+				"[-b bigfiles] [-s size_mb] [-n loops]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (nr_layers < 1 || nr_files < 1 || nr_big < 1)
+		return 1;
+
+	setup();
+	printf("%d lower layers, metacopy=%s\n", nr_layers,
+	       metacopy ? "on" : "off");
+	bench_lookup("f", 1);
+	bench_lookup("missing", 0);
+	bench_chown();
+	cleanup();
+
+	return 0;
+}
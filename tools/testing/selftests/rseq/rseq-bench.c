@@ -0,0 +1,216 @@
+/*
+ * Per-cpu counters with rseq() versus atomics.
+ *
+ * Runs a number of threads, twice as many as CPUs by default so that they
+ * get preempted and migrated, each incrementing a counter a number of
+ * times, with:
+ *  - a lock prefixed add on one shared counter,
+ *  - a lock prefixed add on a per-cpu counter picked with sched_getcpu(),
+ *  - a plain add on a per-cpu counter in an rseq critical section.
+ * Reports the time per increment of each, and fails if the rseq counters
+ * don't add up to the number of increments, i.e. if an increment was
+ * lost to a preemption or migration that didn't abort the critical
+ * section.
+ *
+ * The rseq critical section is only implemented for x86_64.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "rseq.h"
+
+struct percpu_count {
+	long count;
+} __attribute__((aligned(64)));
+
+static struct percpu_count counts[CPU_SETSIZE];
+static long shared_count;
+static long nr_loops = 10000000;
+static int nr_threads;
+static int failed;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#ifdef __x86_64__
+/* adds @count to @v if still running on @cpu, returns non-zero on abort */
+static inline int rseq_addv(long *v, long count, int cpu)
+{
+	__asm__ __volatile__ goto (
+		".pushsection __rseq_cs, \"aw\"\n\t"
+		".balign 32\n\t"
+		"3:\n\t"
+		".long 0x0, 0x0\n\t"
+		".quad 1f, (2f - 1f), 4f\n\t"
+		".popsection\n\t"
+		"leaq 3b(%%rip), %%rax\n\t"
+		"movq %%rax, %[rseq_cs]\n\t"
+		"1:\n\t"
+		"cmpl %[cpu_id], %[current_cpu_id]\n\t"
+		"jnz %l[abort]\n\t"
+		"addq %[count], %[v]\n\t"
+		"2:\n\t"
+		".pushsection __rseq_failure, \"ax\"\n\t"
+		/* ud1 with the signature as operand, before the abort ip */
+		".byte 0x0f, 0xb9, 0x3d\n\t"
+		".long 0x53053053\n\t"
+		"4:\n\t"
+		"jmp %l[abort]\n\t"
+		".popsection\n\t"
+		: /* asm goto has no outputs */
+		: [cpu_id] "r" (cpu),
+		  [current_cpu_id] "m" (rseq_area.cpu_id),
+		  [rseq_cs] "m" (rseq_area.rseq_cs),
+		  [v] "m" (*v),
+		  [count] "er" (count)
+		: "memory", "cc", "rax"
+		: abort);
+	return 0;
+abort:
+	return 1;
+}
+#define HAVE_RSEQ_ADDV
+#endif
+
+static void *shared_fn(void *arg)
+{
+	long i;
+
+	for (i = 0; i < nr_loops; i++)
+		__sync_fetch_and_add(&shared_count, 1);
+	return NULL;
+}
+
+static void *getcpu_fn(void *arg)
+{
+	long i;
+
+	for (i = 0; i < nr_loops; i++)
+		__sync_fetch_and_add(&counts[sched_getcpu()].count, 1);
+	return NULL;
+}
+
+#ifdef HAVE_RSEQ_ADDV
+static long aborts;
+
+static void *rseq_fn(void *arg)
+{
+	long i, n = 0;
+	int cpu;
+
+	if (rseq_register_current_thread()) {
+		perror("rseq");
+		exit(1);
+	}
+	for (i = 0; i < nr_loops; i++) {
+		/*
+		 * Read the cpu once: after a migration between two reads
+		 * the slot would not match the cpu the commit checks.
+		 */
+		for (;;) {
+			cpu = rseq_area.cpu_id_start;
+			if (!rseq_addv(&counts[cpu].count, 1, cpu))
+				break;
+			n++;
+		}
+	}
+	__sync_fetch_and_add(&aborts, n);
+	rseq_unregister_current_thread();
+	return NULL;
+}
+#endif
+
+static void run(const char *name, void *(*fn)(void *))
+{
+	pthread_t *threads;
+	double start;
+	long sum = 0;
+	int i;
+
+	memset(counts, 0, sizeof(counts));
+	shared_count = 0;
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!threads) {
+		perror("calloc");
+		exit(1);
+	}
+	start = now();
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_create(&threads[i], NULL, fn, NULL)) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+	printf("%-16s %8.2f ns/increment\n", name,
+	       (now() - start) * 1e9 / ((double)nr_loops * nr_threads));
+
+	for (i = 0; i < CPU_SETSIZE; i++)
+		sum += counts[i].count;
+	sum += shared_count;
+	if (sum != nr_loops * nr_threads) {
+		printf("FAIL: %s counted %ld of %ld increments\n", name, sum,
+		       nr_loops * nr_threads);
+		failed = 1;
+	}
+	free(threads);
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+
+	rseq_disable_libc(argv);
+
+	nr_threads = 2 * sysconf(_SC_NPROCESSORS_ONLN);
+	while ((opt = getopt(argc, argv, "t:l:")) != -1) {
+		switch (opt) {
+		case 't':
+			nr_threads = atoi(optarg);
+			break;
+		case 'l':
+			nr_loops = atol(optarg);
+			break;
+		default:
+			nr_threads = 0;
+			break;
+		}
+	}
+	if (nr_threads < 1 || nr_loops < 1) {
+		fprintf(stderr, "usage: %s [-t threads] [-l loops]\n", argv[0]);
+		return 1;
+	}
+
+	run("atomic shared:", shared_fn);
+	run("atomic percpu:", getcpu_fn);
+#ifdef HAVE_RSEQ_ADDV
+	if (rseq_register_current_thread() && errno == ENOSYS) {
+		printf("rseq: not supported by this kernel\n");
+	} else {
+		rseq_unregister_current_thread();
+		run("rseq percpu:", rseq_fn);
+		printf("%-16s %8ld\n", "rseq aborts:", aborts);
+	}
+#else
+	printf("rseq percpu: not implemented for this architecture\n");
+#endif
+
+	if (failed)
+		return 1;
+	printf("PASS\n");
+	return 0;
+}
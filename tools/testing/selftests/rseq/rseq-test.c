@@ -0,0 +1,118 @@
+/*
+ * rseq() registration and cpu_id updates.
+ *
+ * Registers a struct rseq for the main thread and checks the error cases
+ * of registering it again and of unregistering it with the wrong
+ * signature.  Then moves the thread to each allowed CPU in turn with
+ * sched_setaffinity() and checks that cpu_id follows it, and that a
+ * forked child inherits the registration while a new thread doesn't.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#include "rseq.h"
+
+static int failed;
+
+static void check(int cond, const char *what)
+{
+	if (!cond) {
+		printf("FAIL: %s\n", what);
+		failed = 1;
+	}
+}
+
+static void *thread_fn(void *arg)
+{
+	/* registrations are per thread */
+	check(rseq_current_cpu() == RSEQ_CPU_ID_UNINITIALIZED,
+	      "new thread inherited the registration");
+	check(!rseq_register_current_thread(), "register in thread");
+	check(rseq_current_cpu() == sched_getcpu(), "cpu_id in thread");
+	check(!rseq_unregister_current_thread(), "unregister in thread");
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	cpu_set_t allowed, one;
+	pthread_t thread;
+	int cpu, status;
+	pid_t pid;
+
+	rseq_disable_libc(argv);
+
+	if (rseq_register_current_thread()) {
+		if (errno == ENOSYS) {
+			printf("rseq: not supported by this kernel\n");
+			return 0;
+		}
+		perror("rseq");
+		return 1;
+	}
+
+	check(rseq_register_current_thread() < 0 && errno == EBUSY,
+	      "registering twice returns EBUSY");
+	check(syscall(__NR_rseq, &rseq_area, sizeof(rseq_area),
+		      RSEQ_FLAG_UNREGISTER, RSEQ_SIG + 1) < 0 &&
+	      errno == EPERM,
+	      "unregistering with another signature returns EPERM");
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed)) {
+		perror("sched_getaffinity");
+		return 1;
+	}
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (!CPU_ISSET(cpu, &allowed))
+			continue;
+		CPU_ZERO(&one);
+		CPU_SET(cpu, &one);
+		if (sched_setaffinity(0, sizeof(one), &one)) {
+			perror("sched_setaffinity");
+			return 1;
+		}
+		if (rseq_current_cpu() != cpu ||
+		    rseq_area.cpu_id_start != (unsigned int)cpu) {
+			printf("FAIL: on cpu %d, cpu_id %d cpu_id_start %u\n",
+			       cpu, rseq_current_cpu(), rseq_area.cpu_id_start);
+			failed = 1;
+		}
+	}
+	sched_setaffinity(0, sizeof(allowed), &allowed);
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (!pid) {
+		/* the child has the parent's registration */
+		_exit(rseq_register_current_thread() < 0 && errno == EBUSY &&
+		      rseq_current_cpu() == sched_getcpu() ? 0 : 1);
+	}
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		check(0, "forked child inherits the registration");
+
+	if (pthread_create(&thread, NULL, thread_fn, NULL) ||
+	    pthread_join(thread, NULL)) {
+		perror("pthread");
+		return 1;
+	}
+
+	check(!rseq_unregister_current_thread(), "unregister");
+	check(rseq_current_cpu() == RSEQ_CPU_ID_UNINITIALIZED,
+	      "cpu_id reset on unregister");
+
+	if (failed)
+		return 1;
+	printf("PASS\n");
+	return 0;
+}
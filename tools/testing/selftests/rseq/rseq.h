@@ -0,0 +1,74 @@
+/*
+ * Helpers shared by the rseq selftests.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#ifndef RSEQ_SELFTEST_H
+#define RSEQ_SELFTEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <linux/rseq.h>
+
+#ifndef __NR_rseq
+#if defined(__x86_64__)
+#define __NR_rseq	334
+#elif defined(__i386__)
+#define __NR_rseq	386
+#elif defined(__arm__)
+#define __NR_rseq	(0x900000 + 391)
+#else
+#define __NR_rseq	285
+#endif
+#endif
+
+#define RSEQ_SIG	0x53053053
+
+static __thread volatile struct rseq rseq_area = {
+	.cpu_id = RSEQ_CPU_ID_UNINITIALIZED,
+};
+
+static inline int sys_rseq(volatile struct rseq *rseq, int flags)
+{
+	return syscall(__NR_rseq, rseq, sizeof(*rseq), flags, RSEQ_SIG);
+}
+
+static inline int rseq_register_current_thread(void)
+{
+	return sys_rseq(&rseq_area, 0);
+}
+
+static inline int rseq_unregister_current_thread(void)
+{
+	return sys_rseq(&rseq_area, RSEQ_FLAG_UNREGISTER);
+}
+
+static inline int rseq_current_cpu(void)
+{
+	return *(volatile unsigned int *)&rseq_area.cpu_id;
+}
+
+/*
+ * Recent C libraries register their own struct rseq for every thread, and
+ * a thread can only have one.  Run again with that turned off.
+ */
+static inline void rseq_disable_libc(char **argv)
+{
+	static const char tunable[] = "glibc.pthread.rseq=0";
+
+	if (getenv("RSEQ_SELFTEST_EXEC"))
+		return;
+	setenv("RSEQ_SELFTEST_EXEC", "1", 1);
+	setenv("GLIBC_TUNABLES", tunable, 1);
+	execv("/proc/self/exe", argv);
+	perror("execv");
+}
+
+#endif
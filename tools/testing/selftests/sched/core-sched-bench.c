@@ -0,0 +1,275 @@
+/*
+ * Core scheduling: prctl(PR_SCHED_CORE) checks and throughput benchmark.
+ *
+ * Checks that cookies can be created, read back, inherited on fork and
+ * that bad arguments are refused.  Then runs two "tenants", processes with
+ * one cpu-bound thread per online cpu each, first without cookies and then
+ * with a cookie per tenant, so that the two never share a core.  Reports
+ * the loops per second of both runs and the time the cpus spent forced
+ * idle according to /proc/schedstat.
+ *
+ * Fails if the tagged run gets less than 40% of the untagged throughput:
+ * keeping SMT siblings apart may cost up to the siblings' share of a core,
+ * not more.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/prctl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <linux/prctl.h>
+
+#ifndef PR_SCHED_CORE
+#define PR_SCHED_CORE			47
+#define PR_SCHED_CORE_GET		0
+#define PR_SCHED_CORE_CREATE		1
+#define PR_SCHED_CORE_SHARE_TO		2
+#define PR_SCHED_CORE_SHARE_FROM	3
+#define PR_SCHED_CORE_SCOPE_THREAD		0
+#define PR_SCHED_CORE_SCOPE_THREAD_GROUP	1
+#define PR_SCHED_CORE_SCOPE_PROCESS_GROUP	2
+#endif
+
+static int nr_threads;
+static int duration = 5;
+
+static volatile int stop;
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int core_get(pid_t pid, unsigned long long *cookie)
+{
+	return prctl(PR_SCHED_CORE, PR_SCHED_CORE_GET, pid,
+		     PR_SCHED_CORE_SCOPE_THREAD, (unsigned long)cookie);
+}
+
+static int core_create(pid_t pid, int scope)
+{
+	return prctl(PR_SCHED_CORE, PR_SCHED_CORE_CREATE, pid, scope, 0);
+}
+
+/* Sum of the forced idle time of all cpus, in ns, or -1. */
+static long long forceidle_ns(void)
+{
+	long long sum = 0, val;
+	char line[512];
+	int version = 0;
+	FILE *f;
+
+	f = fopen("/proc/schedstat", "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "version %d", &version) == 1)
+			continue;
+		if (strncmp(line, "cpu", 3))
+			continue;
+		if (sscanf(line, "%*s %*u %*u %*u %*u %*u %*u %*u %*u %*u %lld",
+			   &val) != 1) {
+			fclose(f);
+			return -1;
+		}
+		sum += val;
+	}
+	fclose(f);
+	return version >= 16 ? sum : -1;
+}
+
+static int test_api(void)
+{
+	unsigned long long cookie, child_cookie;
+	int status;
+	pid_t pid;
+
+	if (core_get(0, &cookie)) {
+		printf("%-16s not supported\n", "core-sched");
+		return 1;
+	}
+
+	if (core_create(0, PR_SCHED_CORE_SCOPE_THREAD))
+		die("PR_SCHED_CORE_CREATE");
+	if (core_get(0, &cookie))
+		die("PR_SCHED_CORE_GET");
+	if (!cookie) {
+		printf("%-16s FAIL: no cookie after create\n", "api");
+		exit(1);
+	}
+
+	pid = fork();
+	if (pid < 0)
+		die("fork");
+	if (!pid)
+		exit(core_get(0, &child_cookie) || child_cookie != cookie);
+	if (waitpid(pid, &status, 0) < 0)
+		die("waitpid");
+	if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+		printf("%-16s FAIL: cookie not inherited on fork\n", "api");
+		exit(1);
+	}
+
+	if (prctl(PR_SCHED_CORE, PR_SCHED_CORE_GET, 0,
+		  PR_SCHED_CORE_SCOPE_THREAD_GROUP,
+		  (unsigned long)&cookie) != -1 || errno != EINVAL) {
+		printf("%-16s FAIL: get accepted a group scope\n", "api");
+		exit(1);
+	}
+	if (prctl(PR_SCHED_CORE, PR_SCHED_CORE_CREATE, 0,
+		  PR_SCHED_CORE_SCOPE_THREAD, 8) != -1 || errno != EINVAL) {
+		printf("%-16s FAIL: create accepted an address\n", "api");
+		exit(1);
+	}
+	if (prctl(PR_SCHED_CORE, 100, 0, 0, 0) != -1 || errno != EINVAL) {
+		printf("%-16s FAIL: unknown command accepted\n", "api");
+		exit(1);
+	}
+
+	printf("%-16s ok\n", "api");
+	return 0;
+}
+
+static void *spin_fn(void *arg)
+{
+	unsigned long *loops = arg;
+
+	while (!stop)
+		(*loops)++;
+	return NULL;
+}
+
+/* One tenant: nr_threads spinning threads, total loops written to @fd. */
+static void tenant(int fd, int tag)
+{
+	pthread_t *threads;
+	unsigned long *loops, total = 0;
+	int i;
+
+	if (tag && core_create(0, PR_SCHED_CORE_SCOPE_THREAD_GROUP))
+		die("PR_SCHED_CORE_CREATE");
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	loops = calloc(nr_threads * 8, sizeof(*loops));
+	if (!threads || !loops)
+		die("calloc");
+
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_create(&threads[i], NULL, spin_fn, &loops[i * 8]))
+			die("pthread_create");
+	}
+	sleep(duration);
+	stop = 1;
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(threads[i], NULL);
+		total += loops[i * 8];
+	}
+
+	if (write(fd, &total, sizeof(total)) != sizeof(total))
+		die("write");
+	exit(0);
+}
+
+static double run(int tag, long long *forceidle)
+{
+	unsigned long loops, total = 0;
+	long long fi_start;
+	double start, elapsed;
+	int fds[2], i;
+	pid_t pids[2];
+
+	if (pipe(fds))
+		die("pipe");
+
+	fi_start = forceidle_ns();
+	start = now();
+	for (i = 0; i < 2; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0)
+			die("fork");
+		if (!pids[i])
+			tenant(fds[1], tag);
+	}
+	for (i = 0; i < 2; i++) {
+		if (read(fds[0], &loops, sizeof(loops)) != sizeof(loops))
+			die("read");
+		total += loops;
+	}
+	elapsed = now() - start;
+	for (i = 0; i < 2; i++)
+		waitpid(pids[i], NULL, 0);
+	close(fds[0]);
+	close(fds[1]);
+
+	*forceidle = fi_start < 0 ? -1 : forceidle_ns() - fi_start;
+	return total / elapsed;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-t threads] [-d seconds]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	long long fi_plain, fi_tagged;
+	double plain, tagged;
+	int c;
+
+	nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	while ((c = getopt(argc, argv, "t:d:")) != -1) {
+		switch (c) {
+		case 't':
+			nr_threads = atoi(optarg);
+			break;
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (nr_threads < 1 || duration < 1)
+		usage(argv[0]);
+
+	if (test_api())
+		return 0;
+
+	plain = run(0, &fi_plain);
+	tagged = run(1, &fi_tagged);
+
+	printf("%-16s %12.0f loops/s  forced idle %lld ms\n", "untagged",
+	       plain, fi_plain < 0 ? -1 : fi_plain / 1000000);
+	printf("%-16s %12.0f loops/s  forced idle %lld ms\n", "tagged",
+	       tagged, fi_tagged < 0 ? -1 : fi_tagged / 1000000);
+
+	if (tagged < plain * 0.4) {
+		printf("FAIL: tagged throughput %.0f%% of untagged\n",
+		       100 * tagged / plain);
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
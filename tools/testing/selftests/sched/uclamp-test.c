@@ -0,0 +1,353 @@
+/*
+ * Utilization clamping through sched_setattr().
+ *
+ * Checks that the clamps of a task can be set, read back and are refused
+ * when out of range or crossed, that they are reset on fork with
+ * SCHED_FLAG_RESET_ON_FORK, and shows their effect: while the task spins
+ * on a cpu, the clamps of that cpu in /proc/sched_debug must cover them.
+ * With the cpu controller mounted, a task which didn't ask for a clamp
+ * must get the cpu.uclamp.min of its group the same way.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#ifndef SCHED_FLAG_RESET_ON_FORK
+#define SCHED_FLAG_RESET_ON_FORK	0x01
+#endif
+#ifndef SCHED_FLAG_UTIL_CLAMP_MIN
+#define SCHED_FLAG_UTIL_CLAMP_MIN	0x20
+#define SCHED_FLAG_UTIL_CLAMP_MAX	0x40
+#endif
+#define SCHED_FLAG_UTIL_CLAMP	(SCHED_FLAG_UTIL_CLAMP_MIN | \
+				 SCHED_FLAG_UTIL_CLAMP_MAX)
+
+#define SCHED_ATTR_SIZE_VER1	56
+
+struct sched_attr_v1 {
+	uint32_t size;
+	uint32_t sched_policy;
+	uint64_t sched_flags;
+	int32_t sched_nice;
+	uint32_t sched_priority;
+	uint64_t sched_runtime;
+	uint64_t sched_deadline;
+	uint64_t sched_period;
+	uint32_t sched_util_min;
+	uint32_t sched_util_max;
+};
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int set_clamps(uint64_t flags, unsigned int min, unsigned int max)
+{
+	struct sched_attr_v1 attr = {
+		.size = sizeof(attr),
+		.sched_policy = SCHED_OTHER,
+		.sched_flags = flags,
+		.sched_util_min = min,
+		.sched_util_max = max,
+	};
+
+	return syscall(__NR_sched_setattr, 0, &attr, 0);
+}
+
+/*
+ * Probes for clamp support in a child, so that our own clamps are still
+ * the defaults we inherited.
+ */
+static int uclamp_supported(void)
+{
+	int status;
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0)
+		die("fork");
+	if (!pid)
+		exit(set_clamps(SCHED_FLAG_UTIL_CLAMP, 0, 1024) ? 1 : 0);
+	if (waitpid(pid, &status, 0) < 0)
+		die("waitpid");
+	return WIFEXITED(status) && !WEXITSTATUS(status);
+}
+
+static void get_clamps(unsigned int *min, unsigned int *max)
+{
+	struct sched_attr_v1 attr;
+
+	memset(&attr, 0, sizeof(attr));
+	if (syscall(__NR_sched_getattr, 0, &attr, sizeof(attr), 0))
+		die("sched_getattr");
+	if (attr.size < SCHED_ATTR_SIZE_VER1) {
+		printf("%-16s FAIL: short sched_attr (%u bytes)\n", "getattr",
+		       attr.size);
+		exit(1);
+	}
+	*min = attr.sched_util_min;
+	*max = attr.sched_util_max;
+}
+
+static void expect_clamps(const char *what, unsigned int min, unsigned int max)
+{
+	unsigned int cur_min, cur_max;
+
+	get_clamps(&cur_min, &cur_max);
+	if (cur_min != min || cur_max != max) {
+		printf("%-16s FAIL: clamps %u-%u, expected %u-%u\n", what,
+		       cur_min, cur_max, min, max);
+		exit(1);
+	}
+	printf("%-16s ok\n", what);
+}
+
+static void expect_einval(const char *what, unsigned int min, unsigned int max)
+{
+	if (set_clamps(SCHED_FLAG_UTIL_CLAMP, min, max) != -1 ||
+	    errno != EINVAL) {
+		printf("%-16s FAIL: %u-%u accepted\n", what, min, max);
+		exit(1);
+	}
+	printf("%-16s ok\n", what);
+}
+
+/*
+ * The clamp of @cpu in /proc/sched_debug named @name, or -1 if the file
+ * doesn't show it.
+ */
+static int rq_clamp(int cpu, const char *name)
+{
+	char line[256], header[32];
+	int in_cpu = 0, val = -1;
+	FILE *f;
+
+	f = fopen("/proc/sched_debug", "r");
+	if (!f)
+		return -1;
+
+	snprintf(header, sizeof(header), "cpu#%d", cpu);
+	while (fgets(line, sizeof(line), f)) {
+		char *p;
+
+		if (!strncmp(line, "cpu#", 4)) {
+			in_cpu = !strncmp(line, header, strlen(header)) &&
+				 strchr(",\n", line[strlen(header)]);
+			continue;
+		}
+		if (!in_cpu)
+			continue;
+		p = strstr(line, name);
+		if (p && sscanf(p + strlen(name), " : %d", &val) == 1)
+			break;
+	}
+	fclose(f);
+	return val;
+}
+
+/* Spins on cpu 0, so that we are counted in its clamps, and reads them */
+static int spin_rq_clamp_min(void)
+{
+	cpu_set_t set;
+	double end;
+
+	CPU_ZERO(&set);
+	CPU_SET(0, &set);
+	if (sched_setaffinity(0, sizeof(set), &set))
+		die("sched_setaffinity");
+
+	end = now() + 0.1;
+	while (now() < end)
+		;
+	return rq_clamp(0, ".uclamp.min");
+}
+
+static void test_effect(void)
+{
+	int min;
+
+	if (set_clamps(SCHED_FLAG_UTIL_CLAMP, 512, 1024))
+		die("sched_setattr");
+
+	min = spin_rq_clamp_min();
+	if (min < 0) {
+		printf("%-16s skipped, no uclamp in /proc/sched_debug\n",
+		       "rq clamps");
+		return;
+	}
+	if (min < 512) {
+		printf("%-16s FAIL: cpu0 uclamp.min %d while running 512\n",
+		       "rq clamps", min);
+		exit(1);
+	}
+	printf("%-16s ok, cpu0 uclamp.min %d\n", "rq clamps", min);
+}
+
+/* Where the cpu controller is mounted, or NULL */
+static const char *cpu_cgroup_root(void)
+{
+	static char root[256];
+	char line[1024], type[32], opts[512];
+	char *opt, *save;
+	FILE *f;
+
+	f = fopen("/proc/mounts", "r");
+	if (!f)
+		return NULL;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%*s %255s %31s %511s", root, type, opts) != 3 ||
+		    strcmp(type, "cgroup"))
+			continue;
+		for (opt = strtok_r(opts, ",", &save); opt;
+		     opt = strtok_r(NULL, ",", &save)) {
+			if (!strcmp(opt, "cpu")) {
+				fclose(f);
+				return root;
+			}
+		}
+	}
+	fclose(f);
+	return NULL;
+}
+
+static int write_file(const char *dir, const char *name, const char *val)
+{
+	char path[512];
+	FILE *f;
+	int ret;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, "w");
+	if (!f)
+		return -1;
+	ret = fputs(val, f) < 0;
+	ret |= fclose(f);
+	return ret ? -1 : 0;
+}
+
+/*
+ * A task which keeps the default clamps gets the cpu.uclamp.min of its
+ * group: 50% of the capacity, 512.
+ */
+static void test_group(void)
+{
+	const char *root = cpu_cgroup_root();
+	char dir[512], pid_str[16];
+	int status, min;
+	pid_t pid;
+
+	if (!root) {
+		printf("%-16s skipped, no cpu cgroup mounted\n", "group min");
+		return;
+	}
+	snprintf(dir, sizeof(dir), "%s/uclamp-test-%d", root, getpid());
+	if (mkdir(dir, 0755))
+		die("mkdir");
+	if (write_file(dir, "cpu.uclamp.min", "50")) {
+		printf("%-16s skipped, no cpu.uclamp.min\n", "group min");
+		rmdir(dir);
+		return;
+	}
+
+	/* the child starts with the default clamps, not asked for */
+	if (set_clamps(SCHED_FLAG_UTIL_CLAMP | SCHED_FLAG_RESET_ON_FORK,
+		       0, 1024))
+		die("sched_setattr");
+	pid = fork();
+	if (pid < 0)
+		die("fork");
+	if (!pid) {
+		snprintf(pid_str, sizeof(pid_str), "%d", getpid());
+		if (write_file(dir, "tasks", pid_str))
+			die("cgroup tasks");
+		min = spin_rq_clamp_min();
+		if (min < 0) {
+			printf("%-16s skipped, no uclamp in /proc/sched_debug\n",
+			       "group min");
+			exit(0);
+		}
+		if (min < 512) {
+			printf("%-16s FAIL: cpu0 uclamp.min %d in a group with min 512\n",
+			       "group min", min);
+			exit(1);
+		}
+		printf("%-16s ok, cpu0 uclamp.min %d\n", "group min", min);
+		exit(0);
+	}
+	if (waitpid(pid, &status, 0) < 0)
+		die("waitpid");
+	rmdir(dir);
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+		exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int status;
+	pid_t pid;
+
+	if (!uclamp_supported()) {
+		printf("%-16s not supported\n", "uclamp");
+		return 0;
+	}
+	/* before any sched_setattr(), unless inherited from our parent */
+	expect_clamps("defaults", 0, 1024);
+
+	if (set_clamps(SCHED_FLAG_UTIL_CLAMP, 256, 768))
+		die("sched_setattr");
+	expect_clamps("set", 256, 768);
+
+	if (set_clamps(SCHED_FLAG_UTIL_CLAMP_MIN, 300, 0))
+		die("sched_setattr");
+	expect_clamps("set min only", 300, 768);
+
+	expect_einval("min > max", 800, 700);
+	expect_einval("max > 1024", 0, 1025);
+	expect_clamps("unchanged", 300, 768);
+
+	if (set_clamps(SCHED_FLAG_UTIL_CLAMP | SCHED_FLAG_RESET_ON_FORK,
+		       300, 768))
+		die("sched_setattr");
+	pid = fork();
+	if (pid < 0)
+		die("fork");
+	if (!pid) {
+		expect_clamps("reset on fork", 0, 1024);
+		exit(0);
+	}
+	if (waitpid(pid, &status, 0) < 0)
+		die("waitpid");
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+		return 1;
+
+	test_effect();
+	test_group();
+
+	printf("PASS\n");
+	return 0;
+}
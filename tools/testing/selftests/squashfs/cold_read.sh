@@ -0,0 +1,65 @@
+#!/bin/sh
+# Time cold-cache sequential reads of squashfs images made with the lz4,
+# xz and zlib compressors.  Needs root and mksquashfs.
+#
+# usage: cold_read.sh [size_mb]
+
+SIZE_MB=${1:-256}
+FILES=8
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "cold_read: must be run as root [SKIP]"
+	exit 0
+fi
+if ! command -v mksquashfs > /dev/null; then
+	echo "cold_read: mksquashfs not found [SKIP]"
+	exit 0
+fi
+
+WORK=$(mktemp -d /tmp/squashfs-cold-read.XXXXXX)
+trap 'umount "$WORK/mnt" 2>/dev/null; rm -rf "$WORK"' EXIT
+mkdir "$WORK/src" "$WORK/mnt"
+
+# Text compresses reasonably, like most image contents do
+i=0
+while [ $i -lt $FILES ]; do
+	base64 /dev/urandom | head -c $((SIZE_MB * 1024 * 1024 / FILES)) \
+		> "$WORK/src/file$i"
+	i=$((i + 1))
+done
+
+echo "comp    image-MB  read-ms  MB/s"
+for comp in lz4 xz gzip; do
+	img="$WORK/$comp.img"
+	if ! mksquashfs "$WORK/src" "$img" -comp $comp -noappend \
+			> /dev/null 2>&1; then
+		echo "$comp: mksquashfs failed [SKIP]"
+		continue
+	fi
+	if ! mount -t squashfs -o loop,ro "$img" "$WORK/mnt"; then
+		echo "$comp: mount failed [SKIP]"
+		continue
+	fi
+
+	sync
+	echo 3 > /proc/sys/vm/drop_caches
+	start=$(date +%s%N)
+	cat "$WORK"/mnt/* > /dev/null
+	end=$(date +%s%N)
+	umount "$WORK/mnt"
+
+	ms=$(( (end - start) / 1000000 ))
+	[ $ms -eq 0 ] && ms=1
+	printf "%-7s %8d %8d %5d\n" $comp \
+		$(( $(stat -c %s "$img") / 1024 / 1024 )) $ms \
+		$(( SIZE_MB * 1000 / ms ))
+done
+
+# Read back once more and compare, readahead must not corrupt data
+mount -t squashfs -o loop,ro "$WORK/lz4.img" "$WORK/mnt" || exit 0
+echo 3 > /proc/sys/vm/drop_caches
+if ! diff -r "$WORK/src" "$WORK/mnt" > /dev/null; then
+	echo "cold_read: data mismatch [FAIL]"
+	exit 1
+fi
+echo "cold_read: [PASS]"
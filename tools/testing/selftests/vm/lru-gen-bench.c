@@ -0,0 +1,215 @@
+/*
+ * Page reclaim quality and cost under a skewed access pattern.
+ *
+ * Maps an anonymous buffer (default) or reads a file (-f) that is larger
+ * than the memory available to the benchmark, and accesses it page by page
+ * with a hot/cold split: a given percentage of the accesses goes to a small
+ * hot set, the rest to random pages of the whole area, similar to the
+ * requests a key-value cache sees.  Memory should be limited with a memory
+ * cgroup or by the machine size so that reclaim has to run.
+ *
+ * Reports the access rate, the major faults (refaults of anon pages from
+ * swap) or the bytes read from the disk per second of file pages, and the
+ * system time, which covers reclaim.  Compare the results with
+ * /sys/kernel/mm/lru_gen/enabled set to 0 and 1.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+static long size_mb = 1024;
+static int hot_pct = 90;
+static int hot_size_pct = 10;
+static int seconds = 30;
+static char *file;
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double tv(struct timeval *t)
+{
+	return t->tv_sec + t->tv_usec / 1e6;
+}
+
+/* xorshift, rand() is too slow and too short for large areas */
+static unsigned long rnd(void)
+{
+	static unsigned long x = 88172645463325252UL;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return x;
+}
+
+static long next_page(long nr_pages)
+{
+	long hot = nr_pages * hot_size_pct / 100;
+
+	if (hot && rnd() % 100 < (unsigned long)hot_pct)
+		return rnd() % hot;
+	return rnd() % nr_pages;
+}
+
+/* the area being accessed, set up before the measurement starts */
+static char *buf;
+static char *page;
+static int fd = -1;
+
+static void setup_anon(long nr_pages, long psize)
+{
+	long i;
+
+	buf = mmap(NULL, nr_pages * psize, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		die("mmap");
+	for (i = 0; i < nr_pages; i++)
+		buf[i * psize] = 1;
+}
+
+static long run_anon(long nr_pages, long psize, double end)
+{
+	long ops = 0;
+	long i;
+
+	while (now() < end) {
+		for (i = 0; i < 1024; i++)
+			buf[next_page(nr_pages) * psize]++;
+		ops += i;
+	}
+	return ops;
+}
+
+static void setup_file(long nr_pages, long psize)
+{
+	long i;
+
+	page = malloc(psize);
+	if (!page)
+		die("malloc");
+	memset(page, 1, psize);
+
+	fd = open(file, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0)
+		die(file);
+	for (i = 0; i < nr_pages; i++)
+		if (write(fd, page, psize) != psize)
+			die("write");
+	fsync(fd);
+}
+
+static long run_file(long nr_pages, long psize, double end)
+{
+	long ops = 0;
+	long i;
+
+	while (now() < end) {
+		for (i = 0; i < 1024; i++)
+			if (pread(fd, page, psize,
+				  next_page(nr_pages) * psize) != psize)
+				die("pread");
+		ops += i;
+	}
+	return ops;
+}
+
+static void teardown(long nr_pages, long psize)
+{
+	if (file) {
+		close(fd);
+		unlink(file);
+		free(page);
+	} else {
+		munmap(buf, nr_pages * psize);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	long psize = sysconf(_SC_PAGESIZE);
+	struct rusage before, after;
+	double start, elapsed;
+	long nr_pages, ops;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:m:p:s:t:")) != -1) {
+		switch (opt) {
+		case 'f':
+			file = optarg;
+			break;
+		case 'm':
+			size_mb = atol(optarg);
+			break;
+		case 'p':
+			hot_pct = atoi(optarg);
+			break;
+		case 's':
+			hot_size_pct = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		default:
+			seconds = 0;
+			break;
+		}
+	}
+	if (size_mb < 1 || seconds < 1 || hot_pct < 0 || hot_pct > 100 ||
+	    hot_size_pct < 0 || hot_size_pct > 100) {
+		fprintf(stderr, "usage: %s [-f file] [-m size_mb] [-p hot_pct] "
+			"[-s hot_size_pct] [-t seconds]\n", argv[0]);
+		return 1;
+	}
+	nr_pages = (size_mb << 20) / psize;
+
+	/* Populating the area is not part of the measurement */
+	if (file)
+		setup_file(nr_pages, psize);
+	else
+		setup_anon(nr_pages, psize);
+
+	getrusage(RUSAGE_SELF, &before);
+	start = now();
+	if (file)
+		ops = run_file(nr_pages, psize, start + seconds);
+	else
+		ops = run_anon(nr_pages, psize, start + seconds);
+	elapsed = now() - start;
+	getrusage(RUSAGE_SELF, &after);
+	teardown(nr_pages, psize);
+
+	printf("%s, %ld MB, %d%% of accesses to %d%% of the pages\n",
+	       file ? "file" : "anon", size_mb, hot_pct, hot_size_pct);
+	printf("%-20s %12.0f /s\n", "accesses:", ops / elapsed);
+	printf("%-20s %12.0f /s\n", "major faults:",
+	       (after.ru_majflt - before.ru_majflt) / elapsed);
+	printf("%-20s %12.0f /s\n", "blocks read:",
+	       (after.ru_inblock - before.ru_inblock) / elapsed);
+	printf("%-20s %12.2f s\n", "system time:",
+	       tv(&after.ru_stime) - tv(&before.ru_stime));
+	return 0;
+}
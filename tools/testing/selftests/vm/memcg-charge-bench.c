@@ -0,0 +1,245 @@
+/*
+ * Memory cgroup charge path cost with many cgroups sharing a cpu.
+ *
+ * Creates a number of memory cgroups below the given memory controller
+ * mount and runs one task in each, all pinned to the same cpu.  Every task
+ * repeatedly faults in a small anonymous buffer, which charges its pages,
+ * drops it with MADV_DONTNEED, which uncharges them, and yields, so that
+ * the charges of the different cgroups interleave on the cpu.
+ *
+ * With -k, kmem accounting is enabled in the cgroups and the tasks create
+ * and close pipes instead, which charges and uncharges slab pages.
+ *
+ * Reports the number of pages (or pipes) per second over all tasks and the
+ * average cost of one.  Run with -n 1 for the single cgroup baseline.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define BUF_PAGES	64
+
+static int nr_cgroups = 16;
+static int cpu;
+static int seconds = 5;
+static int kmem;
+static char *base;
+
+struct shared {
+	volatile int go;
+	volatile int stop;
+	long ops[0];
+};
+static struct shared *sh;
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void cg_path(char *path, int i, const char *file)
+{
+	if (i < 0)
+		snprintf(path, PATH_MAX, "%s/memcg-charge-bench/%s", base,
+			 file);
+	else
+		snprintf(path, PATH_MAX, "%s/memcg-charge-bench/cg%d/%s", base,
+			 i, file);
+}
+
+static int write_file(const char *path, const char *val)
+{
+	int fd, ret = 0;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -1;
+	if (write(fd, val, strlen(val)) < 0)
+		ret = -1;
+	close(fd);
+	return ret;
+}
+
+static void setup(void)
+{
+	char path[PATH_MAX];
+	int i;
+
+	cg_path(path, -1, "");
+	if (mkdir(path, 0755) && errno != EEXIST)
+		die(path);
+	for (i = 0; i < nr_cgroups; i++) {
+		cg_path(path, i, "");
+		if (mkdir(path, 0755) && errno != EEXIST)
+			die(path);
+		/* kmem accounting has to be enabled before any task joins */
+		cg_path(path, i, "memory.kmem.limit_in_bytes");
+		if (kmem && write_file(path, "1T\n"))
+			die(path);
+	}
+}
+
+static void cleanup(void)
+{
+	char path[PATH_MAX];
+	int i;
+
+	for (i = 0; i < nr_cgroups; i++) {
+		cg_path(path, i, "");
+		if (rmdir(path))
+			perror(path);
+	}
+	cg_path(path, -1, "");
+	if (rmdir(path))
+		perror(path);
+}
+
+static long charge_pages(char *buf, long psize)
+{
+	int i;
+
+	for (i = 0; i < BUF_PAGES; i++)
+		buf[i * psize] = 1;
+	if (madvise(buf, BUF_PAGES * psize, MADV_DONTNEED))
+		die("madvise");
+	return BUF_PAGES;
+}
+
+static long charge_kmem(void)
+{
+	int fds[2];
+
+	if (pipe(fds))
+		die("pipe");
+	close(fds[0]);
+	close(fds[1]);
+	return 1;
+}
+
+static void worker(int i)
+{
+	long psize = sysconf(_SC_PAGESIZE);
+	char path[PATH_MAX];
+	char pid[16];
+	cpu_set_t set;
+	long ops = 0;
+	char *buf;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set))
+		die("sched_setaffinity");
+
+	snprintf(pid, sizeof(pid), "%d\n", getpid());
+	cg_path(path, i, "cgroup.procs");
+	if (write_file(path, pid))
+		die(path);
+
+	buf = mmap(NULL, BUF_PAGES * psize, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		die("mmap");
+
+	while (!sh->go)
+		sched_yield();
+	while (!sh->stop) {
+		ops += kmem ? charge_kmem() : charge_pages(buf, psize);
+		sched_yield();
+	}
+	sh->ops[i] = ops;
+	exit(0);
+}
+
+int main(int argc, char **argv)
+{
+	double start, elapsed;
+	long total = 0;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "d:n:c:t:k")) != -1) {
+		switch (opt) {
+		case 'd':
+			base = optarg;
+			break;
+		case 'n':
+			nr_cgroups = atoi(optarg);
+			break;
+		case 'c':
+			cpu = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'k':
+			kmem = 1;
+			break;
+		default:
+			base = NULL;
+			break;
+		}
+	}
+	if (!base || nr_cgroups < 1 || seconds < 1) {
+		fprintf(stderr, "usage: %s -d memcg_mount [-n cgroups] [-c cpu] "
+			"[-t seconds] [-k]\n", argv[0]);
+		return 1;
+	}
+
+	sh = mmap(NULL, sizeof(*sh) + nr_cgroups * sizeof(long),
+		  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (sh == MAP_FAILED)
+		die("mmap");
+
+	setup();
+	for (i = 0; i < nr_cgroups; i++) {
+		pid_t pid = fork();
+
+		if (pid < 0)
+			die("fork");
+		if (!pid)
+			worker(i);
+	}
+
+	sleep(1);
+	start = now();
+	sh->go = 1;
+	sleep(seconds);
+	sh->stop = 1;
+	while (wait(NULL) > 0)
+		;
+	elapsed = now() - start;
+
+	for (i = 0; i < nr_cgroups; i++)
+		total += sh->ops[i];
+	printf("%d cgroups on cpu %d, %s\n", nr_cgroups, cpu,
+	       kmem ? "pipes" : "anon pages");
+	printf("%-20s %12.0f /s\n", "charge+uncharge:", total / elapsed);
+	printf("%-20s %12.1f ns\n", "per op:", elapsed * 1e9 / total);
+
+	cleanup();
+	return 0;
+}
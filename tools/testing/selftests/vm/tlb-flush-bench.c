@@ -0,0 +1,218 @@
+/*
+ * Cost of TLB shootdowns for a multithreaded process changing its mappings.
+ *
+ * Runs a number of threads that keep the process' mm loaded on other cpus,
+ * either spinning on a shared page or, with -l, mostly sleeping so that
+ * their cpus sit idle in lazy tlb mode, and a number of threads that each
+ * map, touch and unmap a few pages in a loop, and then change the
+ * protection of a few pages back and forth.  Every one of those operations
+ * needs the TLBs of the other cpus running the mm flushed.
+ *
+ * Reports the time per operation and, from /proc/interrupts, the TLB
+ * shootdown IPIs taken per operation along with the flushes that were
+ * merged into an IPI already pending on the target and the flushes that
+ * were not sent to cpus in lazy tlb mode.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#define NR_PAGES	4
+
+static int nr_flushers = 4;
+static int nr_spinners;
+static int seconds = 5;
+static int lazy;
+static long page_size;
+
+static volatile int stop;
+static volatile int phase;
+static volatile long ops;
+static char *shared;
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the sum over all cpus of the /proc/interrupts line @name */
+static unsigned long long irq_count(const char *name)
+{
+	unsigned long long sum = 0;
+	char line[65536];
+	FILE *f;
+
+	f = fopen("/proc/interrupts", "r");
+	if (!f)
+		die("/proc/interrupts");
+	while (fgets(line, sizeof(line), f)) {
+		char *p = line, *end;
+
+		while (*p == ' ')
+			p++;
+		if (strncmp(p, name, strlen(name)) || p[strlen(name)] != ':')
+			continue;
+		p += strlen(name) + 1;
+		for (;;) {
+			unsigned long long n = strtoull(p, &end, 10);
+
+			if (end == p)
+				break;
+			sum += n;
+			p = end;
+		}
+		break;
+	}
+	fclose(f);
+	return sum;
+}
+
+static void *spinner_fn(void *arg)
+{
+	while (!stop) {
+		shared[0]++;
+		if (lazy)
+			usleep(100);
+	}
+	return NULL;
+}
+
+static void *flusher_fn(void *arg)
+{
+	size_t len = NR_PAGES * page_size;
+	char *p = NULL;
+	long n = 0;
+
+	while (!stop) {
+		if (phase == 0) {
+			p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (p == MAP_FAILED)
+				die("mmap");
+			memset(p, 1, len);
+			if (munmap(p, len))
+				die("munmap");
+			p = NULL;
+		} else {
+			if (!p) {
+				p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+					 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (p == MAP_FAILED)
+					die("mmap");
+				memset(p, 1, len);
+			}
+			if (mprotect(p, len, PROT_READ) ||
+			    mprotect(p, len, PROT_READ | PROT_WRITE))
+				die("mprotect");
+			p[0]++;
+		}
+		n++;
+	}
+	if (p)
+		munmap(p, len);
+	__sync_fetch_and_add(&ops, n);
+	return NULL;
+}
+
+static void run(const char *name, int which)
+{
+	unsigned long long tlb, tlc, tlz;
+	pthread_t *threads;
+	double start, elapsed;
+	int i;
+
+	threads = calloc(nr_flushers + nr_spinners, sizeof(*threads));
+	if (!threads)
+		die("calloc");
+
+	stop = 0;
+	ops = 0;
+	phase = which;
+	tlb = irq_count("TLB");
+	tlc = irq_count("TLC");
+	tlz = irq_count("TLZ");
+	start = now();
+	for (i = 0; i < nr_flushers + nr_spinners; i++) {
+		if (pthread_create(&threads[i], NULL,
+				   i < nr_flushers ? flusher_fn : spinner_fn,
+				   NULL))
+			die("pthread_create");
+	}
+	sleep(seconds);
+	stop = 1;
+	for (i = 0; i < nr_flushers + nr_spinners; i++)
+		pthread_join(threads[i], NULL);
+	elapsed = now() - start;
+	tlb = irq_count("TLB") - tlb;
+	tlc = irq_count("TLC") - tlc;
+	tlz = irq_count("TLZ") - tlz;
+
+	if (!ops)
+		ops = 1;
+	printf("%-10s %8.2f us/op, per op: %6.2f shootdowns %6.2f coalesced "
+	       "%6.2f lazy skipped\n", name, elapsed * 1e6 * nr_flushers / ops,
+	       (double)tlb / ops, (double)tlc / ops, (double)tlz / ops);
+	free(threads);
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+
+	nr_spinners = sysconf(_SC_NPROCESSORS_ONLN) - nr_flushers;
+	while ((opt = getopt(argc, argv, "f:s:t:l")) != -1) {
+		switch (opt) {
+		case 'f':
+			nr_flushers = atoi(optarg);
+			break;
+		case 's':
+			nr_spinners = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'l':
+			lazy = 1;
+			break;
+		default:
+			nr_flushers = 0;
+			break;
+		}
+	}
+	if (nr_spinners < 1)
+		nr_spinners = 1;
+	if (nr_flushers < 1 || seconds < 1) {
+		fprintf(stderr, "usage: %s [-f flushers] [-s spinners] "
+			"[-t seconds] [-l]\n", argv[0]);
+		return 1;
+	}
+
+	page_size = sysconf(_SC_PAGESIZE);
+	shared = mmap(NULL, page_size, PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED)
+		die("mmap");
+
+	run("munmap:", 0);
+	run("mprotect:", 1);
+	return 0;
+}